@@ -0,0 +1,234 @@
+#include "AsyncGenerator.h"
+
+#include <string.h>
+
+// Samples rendered between checks for new commands
+static const int32_t	BlockSize = 256;
+
+static bool
+sameSettings(const AsyncGenerator::Settings& a, const AsyncGenerator::Settings& b)
+{
+	return a.numChannels == b.numChannels && a.shape == b.shape && a.step == b.step &&
+		   a.spread == b.spread && a.scale == b.scale && a.lookahead == b.lookahead;
+}
+
+AsyncGenerator::AsyncGenerator() :
+	myDirty(true),
+	mySeq(0),
+	myAhead(0),
+	myRead(0),
+	myUnderruns(0),
+	myCommands(0),
+	myWrite(0),
+	myCapacity(0),
+	myHead(0),
+	myTail(0),
+	myEpoch(0),
+	mySleeping(false),
+	myStop(false)
+{
+	memset(&mySent, 0, sizeof(mySent));
+	memset(&myCurrent, 0, sizeof(myCurrent));
+}
+
+AsyncGenerator::~AsyncGenerator()
+{
+	stop();
+}
+
+void
+AsyncGenerator::start()
+{
+	if (running())
+		return;
+
+	// Drop anything queued for a thread that's gone, the new one starts
+	// from the next command
+	Command stale;
+	while (myQueue.pop(stale))
+		;
+	myEpoch.store(0);
+	myCurrent.seq = 0;
+	myDirty = true;
+
+	myStop.store(false);
+	myThread = std::thread(&AsyncGenerator::producerLoop, this);
+}
+
+void
+AsyncGenerator::stop()
+{
+	if (!running())
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(myWakeMutex);
+		myStop.store(true);
+	}
+	myWake.notify_one();
+	myThread.join();
+}
+
+void
+AsyncGenerator::wake()
+{
+	// The producer sets mySleeping before it checks for work under the
+	// mutex, and this is called after publishing the work, so one of the
+	// two always sees the other.
+	if (mySleeping.load())
+	{
+		std::lock_guard<std::mutex> guard(myWakeMutex);
+		myWake.notify_one();
+	}
+}
+
+int32_t
+AsyncGenerator::read(float** channels, int32_t numSamples, const Settings& settings,
+					 int64_t offset)
+{
+	start();
+
+	// The ring has to hold at least a couple of cooks. It only ever grows,
+	// so a cook that covers a few dropped frames doesn't start it over.
+	int32_t ahead = settings.lookahead > 2 * numSamples ? settings.lookahead : 2 * numSamples;
+	if (ahead > myAhead || settings.lookahead != mySent.lookahead)
+	{
+		myAhead = ahead;
+		myDirty = true;
+	}
+
+	if (myDirty || !sameSettings(settings, mySent))
+	{
+		Command cmd;
+		cmd.seq = mySeq + 1;
+		cmd.at = myRead;
+		cmd.offset = offset;
+		cmd.settings = settings;
+		cmd.ahead = myAhead;
+
+		// Full means the producer is stuck on something, try again next cook
+		if (myQueue.push(cmd))
+		{
+			mySeq = cmd.seq;
+			mySent = settings;
+			myDirty = false;
+			myCommands++;
+			wake();
+		}
+		else
+		{
+			myDirty = true;
+		}
+	}
+
+	int32_t filled = 0;
+	if (!myDirty && myEpoch.load(std::memory_order_acquire) == mySeq)
+	{
+		int64_t avail = myHead.load(std::memory_order_acquire) - myRead;
+		filled = avail < numSamples ? (avail > 0 ? int32_t(avail) : 0) : numSamples;
+
+		int64_t mask = myCapacity - 1;
+		int64_t pos = myRead & mask;
+		int64_t first = myCapacity - pos < filled ? myCapacity - pos : filled;
+		for (int32_t c = 0; c < settings.numChannels; c++)
+		{
+			const float* plane = &myPlanes[size_t(c) * myCapacity];
+			memcpy(channels[c], plane + pos, sizeof(float) * first);
+			if (filled > first)
+				memcpy(channels[c] + first, plane, sizeof(float) * (filled - first));
+		}
+	}
+
+	if (filled < numSamples)
+		myUnderruns++;
+
+	// The caller renders whatever wasn't filled, so the stream moves on by
+	// the whole cook either way
+	myRead += numSamples;
+	myTail.store(myRead);
+	wake();
+	return filled;
+}
+
+void
+AsyncGenerator::apply(const Command& cmd)
+{
+	const Settings& s = cmd.settings;
+
+	int64_t capacity = 1024;
+	while (capacity < cmd.ahead + BlockSize)
+		capacity *= 2;
+	if (capacity != myCapacity || myPlanes.size() != size_t(capacity) * s.numChannels)
+	{
+		myCapacity = capacity;
+		myPlanes.assign(size_t(capacity) * s.numChannels, 0.0f);
+		myPtrs.resize(s.numChannels);
+	}
+
+	myCurrent = cmd;
+	myWrite = cmd.at;
+	myHead.store(myWrite, std::memory_order_release);
+	myEpoch.store(cmd.seq, std::memory_order_release);
+}
+
+bool
+AsyncGenerator::canRender() const
+{
+	if (myCurrent.seq == 0)
+		return false;
+	int64_t tail = myTail.load();
+	return myWrite < tail + myCurrent.ahead;
+}
+
+void
+AsyncGenerator::producerLoop()
+{
+	while (!myStop.load())
+	{
+		Command cmd;
+		while (myQueue.pop(cmd))
+			apply(cmd);
+
+		if (!canRender())
+		{
+			std::unique_lock<std::mutex> guard(myWakeMutex);
+			mySleeping.store(true);
+			myWake.wait(guard, [&]()
+				{
+					return myStop.load() || !myQueue.empty() || canRender();
+				});
+			mySleeping.store(false);
+			continue;
+		}
+
+		// The cook rendered these itself, skip past them
+		int64_t tail = myTail.load(std::memory_order_acquire);
+		if (myWrite < tail)
+		{
+			myWrite = tail;
+			myHead.store(myWrite, std::memory_order_release);
+		}
+
+		// One contiguous block, never past the end of the ring, further
+		// ahead than asked or over samples the cook hasn't read yet
+		int64_t pos = myWrite & (myCapacity - 1);
+		int64_t n = BlockSize;
+		if (n > myCapacity - pos)
+			n = myCapacity - pos;
+		if (n > tail + myCurrent.ahead - myWrite)
+			n = tail + myCurrent.ahead - myWrite;
+
+		// The phase follows from the command, so every block starts exactly
+		// where the cook would have been
+		const Settings& s = myCurrent.settings;
+		int64_t offset = OscillatorBank::advance(myCurrent.offset, s.step, myWrite - myCurrent.at);
+		myBank.setup(s.numChannels, offset, s.spread);
+		myBank.reset(offset);
+		for (int32_t c = 0; c < s.numChannels; c++)
+			myPtrs[c] = &myPlanes[size_t(c) * myCapacity + pos];
+		myBank.render(myPtrs.data(), int32_t(n), s.shape, s.step, s.scale);
+
+		myWrite += n;
+		myHead.store(myWrite, std::memory_order_release);
+	}
+}
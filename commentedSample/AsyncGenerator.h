@@ -0,0 +1,124 @@
+/*
+	Renders the generator's samples ahead of time on a thread of its own, so
+	a cook only has to copy them out.
+
+	The producer thread keeps its own OscillatorBank and writes into a ring
+	with one plane per channel. There is one producer and one consumer (the
+	cook), each only moving its own end of the ring, so the ring is lock
+	free: the producer publishes how far it has rendered with a release
+	store, the cook publishes how far it has read the same way. The producer
+	stays at most 'lookahead' samples in front of the cook.
+
+	Samples are numbered along a stream that only the cook moves forward.
+	Whenever a setting changes (Speed, Shape, Scale, the channel count) or
+	the phase jumps (Reset), the cook sends the producer a command through
+	an SpscQueue stamped with the stream index it takes effect at, which is
+	always the next sample the cook reads. Every command carries the full
+	state at that index, so the producer drops whatever it rendered past it
+	and starts again from there. Until it has, the cook renders those
+	samples itself, as it does when the producer falls behind; the output is
+	the same either way, the producer only saves the cook the work.
+*/
+
+#ifndef __AsyncGenerator__
+#define __AsyncGenerator__
+
+#include "OscillatorBank.h"
+#include "SpscQueue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+class AsyncGenerator
+{
+public:
+	struct Settings
+	{
+		int32_t					numChannels;
+		OscillatorBank::Shape	shape;
+		int64_t					step;
+		double					spread;
+		float					scale;
+
+		// Most samples to render ahead of the cook
+		int32_t					lookahead;
+	};
+
+	AsyncGenerator();
+	~AsyncGenerator();
+
+	// Fills the first samples of 'channels' from the ring and returns how
+	// many it filled. The caller renders the rest, samples [returned,
+	// numSamples), itself. 'offset' is the phase offset of the first sample
+	// of this cook, like OscillatorBank::reset(). Starts the producer thread
+	// on first use.
+	int32_t				read(float** channels, int32_t numSamples, const Settings& settings,
+							 int64_t offset);
+
+	// The next read() resends the settings, for when the offset jumped or
+	// cooks were rendered without read()
+	void				invalidate() { myDirty = true; }
+
+	// Joins the producer thread. read() starts it again.
+	void				stop();
+
+	bool				running() const { return myThread.joinable(); }
+
+	// Cooks that rendered some of their samples themselves
+	int64_t				underruns() const { return myUnderruns; }
+
+	// Commands sent to the producer
+	int64_t				commands() const { return myCommands; }
+
+private:
+	struct Command
+	{
+		uint32_t			seq;
+		int64_t				at;
+		int64_t				offset;
+		Settings			settings;
+		int32_t				ahead;
+	};
+
+	void				start();
+	void				wake();
+	void				producerLoop();
+	void				apply(const Command& cmd);
+	bool				canRender() const;
+
+	// Cook side
+	std::thread			myThread;
+	Settings			mySent;
+	bool				myDirty;
+	uint32_t			mySeq;
+	int32_t				myAhead;
+	int64_t				myRead;
+	int64_t				myUnderruns;
+	int64_t				myCommands;
+
+	SpscQueue<Command, 16>	myQueue;
+
+	// Producer side, only read by the cook once myEpoch says they belong to
+	// the last command it sent
+	Command				myCurrent;
+	int64_t				myWrite;
+	int64_t				myCapacity;
+	std::vector<float>	myPlanes;
+	std::vector<float*>	myPtrs;
+	OscillatorBank		myBank;
+
+	std::atomic<int64_t>	myHead;
+	std::atomic<int64_t>	myTail;
+	std::atomic<uint32_t>	myEpoch;
+
+	std::mutex				myWakeMutex;
+	std::condition_variable	myWake;
+	std::atomic<bool>		mySleeping;
+	std::atomic<bool>		myStop;
+};
+
+#endif
@@ -0,0 +1,529 @@
+#include "BiquadBank.h"
+#include "ChannelKernels.h"
+#include "ScratchArena.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef CK_X86
+	#include <immintrin.h>
+#endif
+
+static const int32_t	Lanes = BiquadBank::Lanes;
+static const int32_t	MaxStages = BiquadBank::MaxStages;
+
+// Floats of one stage of a group: b0 b1 b2 a1 a2, and the 2 state values
+static const int32_t	CoefsPerStage = 5 * Lanes;
+static const int32_t	StatePerStage = 2 * Lanes;
+
+// Filters 'n' samples of the Lanes channels in 'lanes' in place, through
+// 'stages' biquads of a group
+typedef void	(*GroupKernel)(float* const* lanes, int32_t n, const float* coefs,
+							   float* state, int32_t stages);
+
+
+// ----------------------------------------------------------------------------
+// Scalar
+
+static void
+runScalar(float* const* lanes, int32_t n, const float* coefs, float* state, int32_t stages)
+{
+	// One stage at a time over the whole channel gives the same result as
+	// one sample at a time through every stage
+	for (int32_t l = 0; l < Lanes; l++)
+	{
+		float* x = lanes[l];
+		for (int32_t k = 0; k < stages; k++)
+		{
+			const float* c = coefs + k * CoefsPerStage + l;
+			float* z = state + k * StatePerStage + l;
+			float b0 = c[0], b1 = c[Lanes], b2 = c[2 * Lanes], a1 = c[3 * Lanes], a2 = c[4 * Lanes];
+			float z1 = z[0], z2 = z[Lanes];
+			for (int32_t i = 0; i < n; i++)
+			{
+				float in = x[i];
+				float y = b0 * in + z1;
+				z1 = b1 * in - a1 * y + z2;
+				z2 = b2 * in - a2 * y;
+				x[i] = y;
+			}
+			z[0] = z1;
+			z[Lanes] = z2;
+		}
+	}
+}
+
+#ifdef CK_X86
+
+// ----------------------------------------------------------------------------
+// SSE2, a quarter of the group at a time
+
+template <int S>
+static inline __m128
+stepSSE2(__m128 x, const __m128 (*c)[5], __m128 (*z)[2])
+{
+	for (int k = 0; k < S; k++)
+	{
+		__m128 y = _mm_add_ps(_mm_mul_ps(c[k][0], x), z[k][0]);
+		z[k][0] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(c[k][1], x), _mm_mul_ps(c[k][3], y)), z[k][1]);
+		z[k][1] = _mm_sub_ps(_mm_mul_ps(c[k][2], x), _mm_mul_ps(c[k][4], y));
+		x = y;
+	}
+	return x;
+}
+
+template <int S>
+static void
+filterSSE2(float* const* lanes, int32_t n, const float* coefs, float* state)
+{
+	for (int32_t q = 0; q < Lanes; q += 4)
+	{
+		__m128 c[S][5];
+		__m128 z[S][2];
+		for (int k = 0; k < S; k++)
+		{
+			for (int j = 0; j < 5; j++)
+				c[k][j] = _mm_loadu_ps(coefs + k * CoefsPerStage + j * Lanes + q);
+			for (int j = 0; j < 2; j++)
+				z[k][j] = _mm_loadu_ps(state + k * StatePerStage + j * Lanes + q);
+		}
+
+		// 4 samples of the 4 channels are turned into 4 vectors of one
+		// sample of every channel, and back
+		float* const* ch = lanes + q;
+		int32_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128 r0 = _mm_loadu_ps(ch[0] + i);
+			__m128 r1 = _mm_loadu_ps(ch[1] + i);
+			__m128 r2 = _mm_loadu_ps(ch[2] + i);
+			__m128 r3 = _mm_loadu_ps(ch[3] + i);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			r0 = stepSSE2<S>(r0, c, z);
+			r1 = stepSSE2<S>(r1, c, z);
+			r2 = stepSSE2<S>(r2, c, z);
+			r3 = stepSSE2<S>(r3, c, z);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_storeu_ps(ch[0] + i, r0);
+			_mm_storeu_ps(ch[1] + i, r1);
+			_mm_storeu_ps(ch[2] + i, r2);
+			_mm_storeu_ps(ch[3] + i, r3);
+		}
+		for (; i < n; i++)
+		{
+			float v[4];
+			for (int l = 0; l < 4; l++)
+				v[l] = ch[l][i];
+			_mm_storeu_ps(v, stepSSE2<S>(_mm_loadu_ps(v), c, z));
+			for (int l = 0; l < 4; l++)
+				ch[l][i] = v[l];
+		}
+
+		for (int k = 0; k < S; k++)
+		{
+			for (int j = 0; j < 2; j++)
+				_mm_storeu_ps(state + k * StatePerStage + j * Lanes + q, z[k][j]);
+		}
+	}
+}
+
+static void
+runSSE2(float* const* lanes, int32_t n, const float* coefs, float* state, int32_t stages)
+{
+	switch (stages)
+	{
+		case 1:		filterSSE2<1>(lanes, n, coefs, state); break;
+		case 2:		filterSSE2<2>(lanes, n, coefs, state); break;
+		case 3:		filterSSE2<3>(lanes, n, coefs, state); break;
+		default:	filterSSE2<4>(lanes, n, coefs, state); break;
+	}
+}
+
+
+// ----------------------------------------------------------------------------
+// AVX2, half the group at a time
+
+// Rows r[0..7] become columns
+CK_TARGET("avx2") static inline void
+transpose8(__m256* r)
+{
+	__m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+	__m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+	__m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+	__m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+	__m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+	__m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+	__m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+	__m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+	__m256 s0 = _mm256_shuffle_ps(t0, t2, 0x44);
+	__m256 s1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+	__m256 s2 = _mm256_shuffle_ps(t1, t3, 0x44);
+	__m256 s3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+	__m256 s4 = _mm256_shuffle_ps(t4, t6, 0x44);
+	__m256 s5 = _mm256_shuffle_ps(t4, t6, 0xEE);
+	__m256 s6 = _mm256_shuffle_ps(t5, t7, 0x44);
+	__m256 s7 = _mm256_shuffle_ps(t5, t7, 0xEE);
+	r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+template <int S>
+CK_TARGET("avx2,fma") static inline __m256
+stepAVX2(__m256 x, const __m256 (*c)[5], __m256 (*z)[2])
+{
+	for (int k = 0; k < S; k++)
+	{
+		__m256 y = _mm256_fmadd_ps(c[k][0], x, z[k][0]);
+		z[k][0] = _mm256_fmadd_ps(c[k][1], x, _mm256_fnmadd_ps(c[k][3], y, z[k][1]));
+		z[k][1] = _mm256_fnmadd_ps(c[k][4], y, _mm256_mul_ps(c[k][2], x));
+		x = y;
+	}
+	return x;
+}
+
+template <int S>
+CK_TARGET("avx2,fma") static void
+filterAVX2(float* const* lanes, int32_t n, const float* coefs, float* state)
+{
+	for (int32_t h = 0; h < Lanes; h += 8)
+	{
+		__m256 c[S][5];
+		__m256 z[S][2];
+		for (int k = 0; k < S; k++)
+		{
+			for (int j = 0; j < 5; j++)
+				c[k][j] = _mm256_loadu_ps(coefs + k * CoefsPerStage + j * Lanes + h);
+			for (int j = 0; j < 2; j++)
+				z[k][j] = _mm256_loadu_ps(state + k * StatePerStage + j * Lanes + h);
+		}
+
+		float* const* ch = lanes + h;
+		int32_t i = 0;
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256 r[8];
+			for (int l = 0; l < 8; l++)
+				r[l] = _mm256_loadu_ps(ch[l] + i);
+			transpose8(r);
+			for (int j = 0; j < 8; j++)
+				r[j] = stepAVX2<S>(r[j], c, z);
+			transpose8(r);
+			for (int l = 0; l < 8; l++)
+				_mm256_storeu_ps(ch[l] + i, r[l]);
+		}
+		for (; i < n; i++)
+		{
+			float v[8];
+			for (int l = 0; l < 8; l++)
+				v[l] = ch[l][i];
+			_mm256_storeu_ps(v, stepAVX2<S>(_mm256_loadu_ps(v), c, z));
+			for (int l = 0; l < 8; l++)
+				ch[l][i] = v[l];
+		}
+
+		for (int k = 0; k < S; k++)
+		{
+			for (int j = 0; j < 2; j++)
+				_mm256_storeu_ps(state + k * StatePerStage + j * Lanes + h, z[k][j]);
+		}
+	}
+}
+
+static void
+runAVX2(float* const* lanes, int32_t n, const float* coefs, float* state, int32_t stages)
+{
+	switch (stages)
+	{
+		case 1:		filterAVX2<1>(lanes, n, coefs, state); break;
+		case 2:		filterAVX2<2>(lanes, n, coefs, state); break;
+		case 3:		filterAVX2<3>(lanes, n, coefs, state); break;
+		default:	filterAVX2<4>(lanes, n, coefs, state); break;
+	}
+}
+
+
+// ----------------------------------------------------------------------------
+// AVX-512, the whole group at once
+
+template <int S>
+CK_TARGET("avx512f") static inline __m512
+stepAVX512(__m512 x, const __m512 (*c)[5], __m512 (*z)[2])
+{
+	for (int k = 0; k < S; k++)
+	{
+		__m512 y = _mm512_fmadd_ps(c[k][0], x, z[k][0]);
+		z[k][0] = _mm512_fmadd_ps(c[k][1], x, _mm512_fnmadd_ps(c[k][3], y, z[k][1]));
+		z[k][1] = _mm512_fnmadd_ps(c[k][4], y, _mm512_mul_ps(c[k][2], x));
+		x = y;
+	}
+	return x;
+}
+
+template <int S>
+CK_TARGET("avx512f") static void
+filterAVX512(float* const* lanes, int32_t n, const float* coefs, float* state)
+{
+	__m512 c[S][5];
+	__m512 z[S][2];
+	for (int k = 0; k < S; k++)
+	{
+		for (int j = 0; j < 5; j++)
+			c[k][j] = _mm512_loadu_ps(coefs + k * CoefsPerStage + j * Lanes);
+		for (int j = 0; j < 2; j++)
+			z[k][j] = _mm512_loadu_ps(state + k * StatePerStage + j * Lanes);
+	}
+
+	// 8 samples of the 16 channels, as two 8 x 8 transposes whose columns
+	// are put side by side
+	int32_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 lo[8];
+		__m256 hi[8];
+		for (int l = 0; l < 8; l++)
+		{
+			lo[l] = _mm256_loadu_ps(lanes[l] + i);
+			hi[l] = _mm256_loadu_ps(lanes[l + 8] + i);
+		}
+		transpose8(lo);
+		transpose8(hi);
+		for (int j = 0; j < 8; j++)
+		{
+			__m512 x = _mm512_castpd_ps(_mm512_insertf64x4(
+							_mm512_castps_pd(_mm512_castps256_ps512(lo[j])),
+							_mm256_castps_pd(hi[j]), 1));
+			x = stepAVX512<S>(x, c, z);
+			lo[j] = _mm512_castps512_ps256(x);
+			hi[j] = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(x), 1));
+		}
+		transpose8(lo);
+		transpose8(hi);
+		for (int l = 0; l < 8; l++)
+		{
+			_mm256_storeu_ps(lanes[l] + i, lo[l]);
+			_mm256_storeu_ps(lanes[l + 8] + i, hi[l]);
+		}
+	}
+	for (; i < n; i++)
+	{
+		float v[Lanes];
+		for (int l = 0; l < Lanes; l++)
+			v[l] = lanes[l][i];
+		_mm512_storeu_ps(v, stepAVX512<S>(_mm512_loadu_ps(v), c, z));
+		for (int l = 0; l < Lanes; l++)
+			lanes[l][i] = v[l];
+	}
+
+	for (int k = 0; k < S; k++)
+	{
+		for (int j = 0; j < 2; j++)
+			_mm512_storeu_ps(state + k * StatePerStage + j * Lanes, z[k][j]);
+	}
+}
+
+static void
+runAVX512(float* const* lanes, int32_t n, const float* coefs, float* state, int32_t stages)
+{
+	switch (stages)
+	{
+		case 1:		filterAVX512<1>(lanes, n, coefs, state); break;
+		case 2:		filterAVX512<2>(lanes, n, coefs, state); break;
+		case 3:		filterAVX512<3>(lanes, n, coefs, state); break;
+		default:	filterAVX512<4>(lanes, n, coefs, state); break;
+	}
+}
+
+#endif // CK_X86
+
+static GroupKernel
+selectKernel()
+{
+	switch (ChannelKernels::get().level)
+	{
+#ifdef CK_X86
+		case CPUFeatureLevel::AVX512:	return runAVX512;
+		case CPUFeatureLevel::AVX2:		return runAVX2;
+		case CPUFeatureLevel::SSE2:		return runSSE2;
+#endif
+		default:						return runScalar;
+	}
+}
+
+
+// ----------------------------------------------------------------------------
+
+BiquadBank::BiquadBank() :
+	myType(Type::Off),
+	myStages(0),
+	myNumChannels(0),
+	mySampleRate(0.0),
+	myFrequency(0.0),
+	myQ(0.0),
+	myUpdates(0)
+{
+}
+
+void
+BiquadBank::setup(Type type, int32_t stages, double frequency, double q,
+				  const OP_DATInput* perChannel, int32_t numChannels, double sampleRate)
+{
+	if (stages < 1)
+		stages = 1;
+	if (stages > MaxStages)
+		stages = MaxStages;
+
+	bool restart = type != myType || stages != myStages || numChannels != myNumChannels;
+	bool changed = myPerChannel.update(perChannel, 2);
+	if (!restart && !changed && frequency == myFrequency && q == myQ && sampleRate == mySampleRate)
+		return;
+
+	myType = type;
+	myStages = stages;
+	myNumChannels = numChannels;
+	myFrequency = frequency;
+	myQ = q;
+	mySampleRate = sampleRate;
+	if (restart)
+		myState.assign(size_t(numGroups()) * MaxStages * StatePerStage, 0.0f);
+
+	myFrequencies.assign(numChannels, frequency);
+	myQs.assign(numChannels, q);
+	int32_t c = 0;
+	for (int32_t r = 0; perChannel && r < perChannel->numRows && c < numChannels; r++)
+	{
+		const char* cell = perChannel->getCell(r, 0);
+		char* end = nullptr;
+		double f = cell ? strtod(cell, &end) : 0.0;
+		if (!cell || end == cell)
+			continue;
+		myFrequencies[c] = f;
+
+		cell = perChannel->numCols > 1 ? perChannel->getCell(r, 1) : nullptr;
+		double channelQ = cell ? strtod(cell, &end) : 0.0;
+		if (cell && end != cell)
+			myQs[c] = channelQ;
+		c++;
+	}
+
+	computeCoefficients();
+}
+
+void
+BiquadBank::computeCoefficients()
+{
+	myUpdates++;
+
+	// Lanes past the last channel keep all zero coefficients, so they
+	// output 0 whatever they're given
+	myCoefficients.assign(size_t(numGroups()) * MaxStages * CoefsPerStage, 0.0f);
+	for (int32_t ch = 0; ch < myNumChannels; ch++)
+	{
+		// The Audio EQ Cookbook (Robert Bristow-Johnson) filters, with the
+		// frequency kept below Nyquist
+		double f = myFrequencies[ch];
+		double q = myQs[ch] > 0.01 ? myQs[ch] : 0.01;
+		double nyquist = 0.5 * mySampleRate;
+		if (f > 0.98 * nyquist)
+			f = 0.98 * nyquist;
+		if (f < 1e-4 * nyquist)
+			f = 1e-4 * nyquist;
+
+		double w0 = 2.0 * 3.14159265358979323846 * f / mySampleRate;
+		double cosw = cos(w0);
+		double alpha = sin(w0) / (2.0 * q);
+
+		double b[3];
+		switch (myType)
+		{
+			case Type::Highpass:
+				b[0] = (1.0 + cosw) / 2.0;
+				b[1] = -(1.0 + cosw);
+				b[2] = (1.0 + cosw) / 2.0;
+				break;
+			case Type::Bandpass:
+				b[0] = alpha;
+				b[1] = 0.0;
+				b[2] = -alpha;
+				break;
+			case Type::Notch:
+				b[0] = 1.0;
+				b[1] = -2.0 * cosw;
+				b[2] = 1.0;
+				break;
+			default:
+				b[0] = (1.0 - cosw) / 2.0;
+				b[1] = 1.0 - cosw;
+				b[2] = (1.0 - cosw) / 2.0;
+				break;
+		}
+		double a0 = 1.0 + alpha;
+		double a1 = -2.0 * cosw;
+		double a2 = 1.0 - alpha;
+
+		int32_t g = ch / Lanes;
+		int32_t l = ch % Lanes;
+		for (int32_t k = 0; k < myStages; k++)
+		{
+			float* dst = &myCoefficients[(size_t(g) * MaxStages + k) * CoefsPerStage + l];
+			dst[0] = float(b[0] / a0);
+			dst[Lanes] = float(b[1] / a0);
+			dst[2 * Lanes] = float(b[2] / a0);
+			dst[3 * Lanes] = float(a1 / a0);
+			dst[4 * Lanes] = float(a2 / a0);
+		}
+	}
+}
+
+void
+BiquadBank::process(float* const* channels, int32_t numSamples, int32_t begin, int32_t end,
+					ScratchArena& arena)
+{
+	if (myType == Type::Off || numSamples < 1)
+		return;
+
+	GroupKernel run = selectKernel();
+
+	// Lanes past the last channel read and write here
+	float* spare = nullptr;
+	float* lanes[Lanes];
+	for (int32_t g = begin; g < end; g++)
+	{
+		for (int32_t l = 0; l < Lanes; l++)
+		{
+			int32_t ch = g * Lanes + l;
+			if (ch < myNumChannels)
+			{
+				lanes[l] = channels[ch];
+				continue;
+			}
+			if (!spare)
+			{
+				spare = arena.allocate<float>(numSamples);
+				memset(spare, 0, sizeof(float) * numSamples);
+			}
+			lanes[l] = spare;
+		}
+
+		float* state = &myState[size_t(g) * MaxStages * StatePerStage];
+		run(lanes, numSamples, &myCoefficients[size_t(g) * MaxStages * CoefsPerStage],
+			state, myStages);
+
+		// A filter left ringing down to silence ends up in denormals, which
+		// are very slow to compute with, and a NaN or infinity in the input
+		// would stay in the state forever. Both are cleared between cooks.
+		for (int32_t i = 0; i < myStages * StatePerStage; i++)
+		{
+			float v = fabsf(state[i]);
+			if (!(v >= 1e-30f && v <= FLT_MAX))
+				state[i] = 0.0f;
+		}
+	}
+}
@@ -0,0 +1,102 @@
+/*
+	Cascaded biquad filters over every output channel, for the filter stage
+	of the example's input branch.
+
+	Every channel runs the same type of filter (low-pass, high-pass,
+	band-pass or notch), as 1 to 4 biquads in a row, each one the Audio EQ
+	Cookbook filter for the channel's frequency and Q. The frequency and Q
+	are shared by every channel unless a DAT gives them per channel.
+
+	A biquad is a recursion: every sample depends on the one before it, so
+	one channel can't be split across SIMD lanes. Different channels are
+	independent though, so the channels are kept in groups of 16 and a
+	group is filtered together, one SIMD lane per channel: 16 channels at a
+	time with AVX-512, 2 x 8 with AVX2 and 4 x 4 with SSE2. The filter
+	state and coefficients are laid out structure of arrays, 16 channels of
+	each value next to each other, so every one is a single vector load.
+	The samples of a group are moved in and out of the lanes a square at a
+	time (8 samples of 8 channels with AVX2) with a transpose in registers.
+
+	Coefficients are only worked out again when the settings change.
+*/
+
+#ifndef __BiquadBank__
+#define __BiquadBank__
+
+#include "CPlusPlus_Common.h"
+#include "DATSnapshot.h"
+
+#include <stdint.h>
+#include <vector>
+
+class ScratchArena;
+
+class BiquadBank
+{
+public:
+	// Matches the order of the "Filter" menu
+	enum class Type : int32_t
+	{
+		Off = 0,
+		Lowpass,
+		Highpass,
+		Bandpass,
+		Notch,
+	};
+
+	// Biquads in a row
+	static const int32_t	MaxStages = 4;
+
+	// Channels filtered together
+	static const int32_t	Lanes = 16;
+
+	BiquadBank();
+
+	// Sets up the filters of 'numChannels' channels at 'sampleRate'.
+	// 'perChannel' can give channels their own frequency and Q: its rows
+	// that start with a number are the channels in order, as frequency and
+	// optionally Q. The rest get 'frequency' and 'q'. The filters start
+	// over when the type, number of stages or channels change.
+	void				setup(Type type, int32_t stages, double frequency, double q,
+							  const OP_DATInput* perChannel, int32_t numChannels,
+							  double sampleRate);
+
+	// Groups of Lanes channels, the last one may be partly used
+	int32_t				numGroups() const { return (numChannels() + Lanes - 1) / Lanes; }
+	int32_t				numChannels() const { return myNumChannels; }
+
+	// Filters 'numSamples' samples of the channels in groups [begin, end)
+	// in place. Different groups can be filtered from different threads.
+	// The last group's unused lanes run on a buffer from 'arena'.
+	void				process(float* const* channels, int32_t numSamples, int32_t begin,
+								int32_t end, ScratchArena& arena);
+
+	// Number of times the coefficients were worked out
+	int64_t				updates() const { return myUpdates; }
+
+private:
+	void				computeCoefficients();
+
+	Type				myType;
+	int32_t				myStages;
+	int32_t				myNumChannels;
+	double				mySampleRate;
+	double				myFrequency;
+	double				myQ;
+	DATSnapshot			myPerChannel;
+
+	// Frequency and Q of every channel
+	std::vector<double>	myFrequencies;
+	std::vector<double>	myQs;
+
+	// Per group and stage, b0 b1 b2 a1 a2 for each of the Lanes channels
+	std::vector<float>	myCoefficients;
+
+	// Per group and stage, the 2 values of transposed direct form II state
+	// for each of the Lanes channels
+	std::vector<float>	myState;
+
+	int64_t				myUpdates;
+};
+
+#endif
@@ -68,10 +68,26 @@ this mostly to fill in the gaps in my own knowledge.
 
 
 #include "CPlusPlusCHOPExample.h"
+#include "AsyncGenerator.h"
+#include "BiquadBank.h"
+#include "ChannelRecorder.h"
+#include "ChannelRouter.h"
+#include "ChannelKernels.h"
+#include "ChannelNamePool.h"
+#include "CookCache.h"
+#include "CookProfiler.h"
+#include "InputMixer.h"
+#include "OscillatorBank.h"
+#include "ParameterRegistry.h"
+#include "RecordingPlayer.h"
+#include "SpectrumAnalyzer.h"
+#include "ThreadPool.h"
+#include "TopReducer.h"
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
 #include <assert.h>
+#include <atomic>
 
 
 
@@ -153,8 +169,48 @@ DestroyCHOPInstance(CHOP_CPlusPlusBase* instance)
 //		<<LearnC++>>  This is the function definition for the constructor. Within this function we define our private variables. 
 CPlusPlusCHOPExample::CPlusPlusCHOPExample(const OP_NodeInfo* info) : myNodeInfo(info)
 {
+	myThreadPool = ThreadPool::acquire();
 	myExecuteCount = 0;
-	myOffset = 0.0;
+	myOffset = 0;
+	myStep = 0;
+	myShape = 0;
+	myWarning = nullptr;
+	myParsFetched = false;
+	myBranch = Branch::Unknown;
+	myTableDATEnabled = -1;
+	myMixParsEnabled = -1;
+	myLookaheadEnabled = -1;
+	myRegionDATEnabled = -1;
+	myRouteDATEnabled = -1;
+	myResampleRateEnabled = -1;
+	myFilterParsEnabled = -1;
+	myBandParsEnabled = -1;
+	myRouting = false;
+	myAnalyzing = false;
+	myAsyncUsed = false;
+	myRecordFailed = false;
+	myPublishFailed = false;
+	myPlaying = false;
+	myPlayFailed = false;
+	myReducing = false;
+	myGenerating = false;
+	myNameSource = nullptr;
+	myInfoTableCook = -1;
+
+	//		<<LearnC++>>  The stages of the cook that get timed, they show up in the Info CHOP as "<stage>MeanUs".
+	myParametersStage = myProfiler.addStage("parameters");
+	myPrepareStage = myProfiler.addStage("prepare");
+	myAppendStage = myProfiler.addStage("append");
+	myMixStage = myProfiler.addStage("mix");
+	myRouteStage = myProfiler.addStage("route");
+	myFilterStage = myProfiler.addStage("filter");
+	mySpectrumStage = myProfiler.addStage("spectrum");
+	myTableStage = myProfiler.addStage("table");
+	myRenderStage = myProfiler.addStage("render");
+	myRecordStage = myProfiler.addStage("record");
+	myPublishStage = myProfiler.addStage("publish");
+	myPlayStage = myProfiler.addStage("play");
+	myTopStage = myProfiler.addStage("top");
 }
 
 //		<<LearnC++>>  This is the function definition for the de-constructor. Generally nothing happens here. If you open a socket or port connection - you would close it here. 
@@ -178,7 +234,12 @@ CPlusPlusCHOPExample::getGeneralInfo(CHOP_GeneralInfo* ginfo)
 	*/
 
 	// This will cause the node to cook every frame
-	ginfo->cookEveryFrameIfAsked = true;
+	//		<<LearnC++>>  The generator, the playback and the TOP reduction depend on time so they have to cook every frame. When an input is connected the output
+	//		only depends on the input and the parameters, and TouchDesigner already re-cooks us when either of those changes,
+	//		so with "Cache" on we let an idle network stop cooking. getGeneralInfo can't see the inputs, so this uses what
+	//		the last cook found. A filter keeps changing the output after the input stops, so it needs every frame too.
+	ginfo->cookEveryFrameIfAsked = !(myPars.cache && myBranch == Branch::Input &&
+									 BiquadBank::Type(myPars.filter) == BiquadBank::Type::Off);
 	ginfo->timeslice = true;
 	ginfo->inputMatchIndex = 0;
 }
@@ -197,15 +258,112 @@ CPlusPlusCHOPExample::getOutputInfo(CHOP_OutputInfo* info)
 			The CHOP_OutputInfo object has many members. Much more info can be found in CHOP_CPlusPlusBase.h lines 93-130.
 	*/
 
+	//		<<LearnC++>>  getOutputInfo is the first function in the cook that can see the parameters, so this is where
+	//		they are all fetched into myPars. execute() uses the same values instead of asking TouchDesigner again.
+	{
+		CookProfiler::Scope timer(myProfiler, myParametersStage);
+		myParameters.update(info->opInputs);
+	}
+	myParsFetched = true;
+
 	// If there is an input connected, we are going to match it's channel names etc
 	// otherwise we'll specify our own.
+	myNameSource = nullptr;
+	myRouting = false;
+	myAnalyzing = false;
+	myPlaying = false;
+	myReducing = false;
+	myGenerating = false;
+	bool playable = updatePlayer();
 	if (info->opInputs->getNumInputs() > 0)
 	{
-		return false;
+		//		<<LearnC++>>  With "Spectrum" on, the output has a channel for every bin (or band) of every channel of the first
+		//		input, and one sample per FFT frame instead of one per input sample, so its sample rate is the input's divided
+		//		by the number of samples between frames.
+		SpectrumAnalyzer::Mode spectrum = SpectrumAnalyzer::Mode(myPars.spectrum);
+		if (spectrum != SpectrumAnalyzer::Mode::Off)
+		{
+			const OP_CHOPInput* first = info->opInputs->getInputCHOP(0);
+			if (!first)
+				return false;
+
+			myAnalyzing = true;
+			mySpectrum.setup(first, spectrum, 128 << myPars.fftSize, 1 << myPars.overlap, myPars.bands,
+							 SpectrumAnalyzer::Spacing(myPars.bandSpacing), myPars.bandRange[0],
+							 myPars.bandRange[1]);
+			info->numChannels = mySpectrum.numChannels() > 0 ? mySpectrum.numChannels() : 1;
+			info->sampleRate = (float)mySpectrum.sampleRate();
+			return true;
+		}
+
+		//		<<LearnC++>>  When only the first input is used, returning false tells TouchDesigner to copy its channels.
+		//		When mixing, the output has the channels of whichever input has the most, so the smaller inputs are
+		//		spread over it (see InputMixer.h). Then we have to say how many channels there are and name them.
+		//		With "Resample" on the output runs at "Resample Rate" instead of the input's rate, which also has to be
+		//		said here, so even the first input's channels aren't just copied.
+		InputMixer::Mode mode = InputMixer::Mode(myPars.mix);
+		if (mode == InputMixer::Mode::First && !myPars.resample)
+			return false;
+
+		//		<<LearnC++>>  When routing, the output channels are the destinations listed in the Route DAT. myRouter only reads
+		//		the DAT again when it changes, so a table of thousands of routes costs nothing here on most cooks.
+		if (mode == InputMixer::Mode::Route)
+		{
+			const OP_CHOPInput* first = info->opInputs->getInputCHOP(0);
+			if (!first)
+				return false;
+
+			myRouting = true;
+			myRouter.setup(myPars.routeDAT, first);
+			info->numChannels = myRouter.numOutputs() > 0 ? myRouter.numOutputs() : 1;
+			info->sampleRate = myPars.resample ? (float)myPars.resampleRate : (float)first->sampleRate;
+			return true;
+		}
+
+		const OP_CHOPInput* widest = info->opInputs->getInputCHOP(InputMixer::widestInput(info->opInputs, mode));
+		if (!widest)
+			return false;
+
+		myNameSource = widest;
+		info->numChannels = widest->numChannels;
+		info->sampleRate = myPars.resample ? (float)myPars.resampleRate : (float)widest->sampleRate;
+		return true;
+	}
+	else if (playable)
+	{
+		//		<<LearnC++>>  The recording decides how many channels there are and their sample rate. Nothing else is read from
+		//		the file here, a recording of any length opens instantly.
+		myPlaying = true;
+		info->numChannels = myPlayer.numChannels();
+		info->sampleRate = (float)myPlayer.sampleRate();
+		return true;
+	}
+	else if (myPars.top)
+	{
+		//		<<LearnC++>>  The channels depend on the size of the TOP's image and what it's reduced to, one channel per
+		//		row, column, histogram bin or region color. The image itself only arrives in execute().
+		myReducing = true;
+		OP_CPUMemPixelType type = TopReducer::downloadType(myPars.top, TopReducer::Pixels(myPars.topPixels));
+		myTopReducer.setup(TopReducer::Mode(myPars.topReduce), type, myPars.top->width,
+						   myPars.top->height, myPars.topBins, myPars.regionDAT);
+		info->numChannels = myTopReducer.numChannels() > 0 ? myTopReducer.numChannels() : 1;
+
+		// One sample per frame of a 60 fps timeline, each image only gives one value per channel
+		info->sampleRate = 60;
+		return true;
 	}
 	else
 	{
-		info->numChannels = 1;
+		// The number of generated channels comes from the "Channels" parameter,
+		// which defaults to the single channel the example always produced.
+		info->numChannels = myPars.channels;
+		if (info->numChannels < 1)
+			info->numChannels = 1;
+
+		//		<<LearnC++>>  The names only have to be made again when the pattern, the DAT or the number of channels changes.
+		//		Every other cook getChannelName() just hands back a pointer to the name that's already there.
+		myChannelNames.update(myPars.channelNames.c_str(), myPars.nameDAT, info->numChannels);
+		myGenerating = true;
 
 		// Since we are outputting a timeslice, the system will dictate
 		// the numSamples and startIndex of the CHOP data
@@ -223,6 +381,26 @@ CPlusPlusCHOPExample::getOutputInfo(CHOP_OutputInfo* info)
 const char*
 CPlusPlusCHOPExample::getChannelName(int32_t index, void* reserved)
 {
+	//		<<LearnC++>>  When mixing inputs the channels are named after the widest input, picked in getOutputInfo.
+	if (myNameSource && index < myNameSource->numChannels)
+		return myNameSource->getChannelName(index);
+
+	if (myRouting && index < myRouter.numOutputs())
+		return myRouter.outputName(index);
+
+	if (myAnalyzing && index < mySpectrum.numChannels())
+		return mySpectrum.channelName(index);
+
+	//		<<LearnC++>>  A recording keeps the names its channels were recorded with. They point straight into the mapped file.
+	if (myPlaying && index < myPlayer.numChannels())
+		return myPlayer.channelName(index);
+
+	if (myReducing && index < myTopReducer.numChannels())
+		return myTopReducer.channelName(index);
+
+	if (myGenerating && index < myChannelNames.size())
+		return myChannelNames.name(index);
+
 	//		<<LearnC++>> TouchDesigner will actually augment this to be chan1, chan2, chan3 when returned multiple times. 
 	return "chan1";
 }
@@ -252,75 +430,480 @@ CPlusPlusCHOPExample::execute(const CHOP_Output* output,
 {
 	//		<<LearnC++>>  This will increment a counter each time the execute is called. Nice debugging tool to make sure the DLL is actually working, but not essential. 
 	myExecuteCount++;
-	
-	//		<<LearnC++>>  This is an example of how to get data from the inputs. Here we are grabbing the parameter labeled "Scale".
-	double	 scale = inputs->getParDouble("Scale");
+	myWarning = nullptr;
+
+	//		<<LearnC++>>  myProfiler times everything from here to the end of execute. The stages inside are timed with a
+	//		CookProfiler::Scope, which reads the clock when it's created and records the time when it goes out of scope at
+	//		the closing bracket.
+	myProfiler.beginCook();
+
+	/*
+			<<LearnC++>>  Every buffer a stage needs only for this cook comes out of myArena instead of a std::vector.
+			Taking one just moves an offset along a block the arena already has, and reset() hands the whole block back
+			at once, so the cook doesn't stop to ask the heap for memory. The block only grows when a cook needs more than
+			any cook before it. See ScratchArena.h.
+	*/
+	myArena.reset();
 
+	//		<<LearnC++>>  The parameters were normally fetched in getOutputInfo already. This only happens if it wasn't called this cook.
+	if (!myParsFetched)
+	{
+		CookProfiler::Scope timer(myProfiler, myParametersStage);
+		myParameters.update(inputs);
+	}
+	myParsFetched = false;
 	
+	//		<<LearnC++>>  This is an example of how to get data from the inputs. Here we are using the parameter labeled "Scale".
+	double	 scale = myPars.scale;
+
+	//		<<LearnC++>>  "Threads" caps how many threads work on this cook (0 means use every core), and "Minwork" is the
+	//		smallest number of samples worth giving to a thread. The channel loops below are split into ranges of at least
+	//		'grain' channels, so a small cook never pays for waking up the worker threads.
+	int32_t	 threads = myPars.threads;
+	int32_t	 minWork = myPars.minWork;
+	int32_t	 grain = output->numSamples > 0 ? minWork / output->numSamples : minWork;
+	if (grain < 1)
+		grain = 1;
+
+	/*
+			<<LearnC++>>  Pulses pressed since the last cook are waiting in myEvents, each stamped with the sample it was
+			pressed at. A change of Speed or Shape joins them here, stamped with this cook's first sample, so everything
+			that changes the generator goes the same way and in the right order. The generator renders up to each event
+			and applies it right there (see EventQueue.h). The other branches don't care where in the block a Reset falls.
+	*/
+	if (myGenerating)
+	{
+		bool entered = myBranch != Branch::Generator;
+		if (entered || myParameters.changed(&myPars.speed))
+			myEvents.push(EventQueue::Kind::Speed, output->startIndex, myPars.speed);
+		if (entered || myParameters.changed(&myPars.shape))
+			myEvents.push(EventQueue::Kind::Shape, output->startIndex, myPars.shape);
+	}
+	const std::vector<EventQueue::Event>& events = myEvents.collect(output->startIndex, output->numSamples,
+																	 output->sampleRate);
+	if (!myGenerating)
+	{
+		for (const EventQueue::Event& e : events)
+			applyEvent(e);
+	}
+
+	/*
+			<<LearnC++>>  Below is what happens if an input is connected and "Spectrum" is on. getOutputInfo() already set
+			the output to one sample per FFT frame, so every output sample of this cook is a frame of the first input to
+			analyze, usually a few of them. mySpectrum keeps the input's samples from cook to cook, since frames overlap
+			and reach back before this cook's timeslice. The FFT works on 16 channels at once, one in each lane of a SIMD
+			register (see FFTPlan.h), and different groups of 16 channels are handed out to different threads.
+	*/
+	if (myAnalyzing && inputs->getNumInputs() > 0)
+	{
+		if (myBranch != Branch::Spectrum)
+		{
+			enableBranchPars(inputs, Branch::Spectrum);
+			myAsync.stop();
+		}
+
+		bool useBands = SpectrumAnalyzer::Mode(myPars.spectrum) == SpectrumAnalyzer::Mode::Bands;
+		if (myBandParsEnabled != int32_t(useBands))
+		{
+			inputs->enablePar("Bands", useBands);
+			inputs->enablePar("Bandspacing", useBands);
+			inputs->enablePar("Bandrange", useBands);
+			myBandParsEnabled = useBands;
+		}
+
+		CookProfiler::Scope timer(myProfiler, mySpectrumStage);
+		myCache.invalidate();
+		const OP_CHOPInput* first = inputs->getInputCHOP(0);
+		const ChannelKernels& kernels = ChannelKernels::get();
+		mySpectrum.begin(first, output);
+		myThreadPool->parallelFor(first->numChannels, grain, threads,
+			[&](int32_t begin, int32_t end)
+			{
+				mySpectrum.appendChannels(begin, end);
+			});
+
+		// A batch of channels transforms a frame of each of its 16 channels per output sample
+		int64_t batchWork = int64_t(FFTPlan::Lanes) * mySpectrum.frameSize() * mySpectrum.numFrames();
+		int32_t batchGrain = batchWork > 0 && minWork / batchWork > 1 ? int32_t(minWork / batchWork) : 1;
+		myThreadPool->parallelFor(mySpectrum.numBatches(), batchGrain, threads,
+			[&](int32_t begin, int32_t end)
+			{
+				mySpectrum.process(output->channels, output->numChannels, begin, end, kernels, myArena);
+			});
+
+		// An input without channels still has the one output channel getOutputInfo() asked for
+		for (int32_t i = mySpectrum.numChannels(); i < output->numChannels; i++)
+			memset(output->channels[i], 0, sizeof(float) * output->numSamples);
+
+		// Every frame reads its samples of every input channel, every output sample is written once
+		myProfiler.addBytes(mySpectrumStage, int64_t(sizeof(float)) *
+							(int64_t(mySpectrum.numFrames()) * mySpectrum.frameSize() * first->numChannels +
+							 int64_t(output->numChannels) * output->numSamples));
+	}
 	/*		
 			<<LearnC++>>  Below is a conditional which looks to see how many input channels there are. The there are more that 0, we will complete the 
 			nested code. 
 	*/
 	// In this case we'll just take the first input and re-output it scaled.
 
-	if (inputs->getNumInputs() > 0)
+	else if (inputs->getNumInputs() > 0)
 	{
 
 		//		<<LearnC++>>  Below we will disable to the parameters not being used. This will prevent them from using cycles to read them.
+		//		enablePar is only called when the input has just been connected, since the parameters stay disabled after that.
 
 		// We know the first CHOP has the same number of channels
-		// because we returned false from getOutputInfo. 
+		// because we returned false from getOutputInfo, or asked for as many.
+
+		if (myBranch != Branch::Input)
+		{
+			enableBranchPars(inputs, Branch::Input);
 
-		inputs->enablePar("Speed", 0);	// not used
-		inputs->enablePar("Reset", 0);	// not used
-		inputs->enablePar("Shape", 0);	// not used
+			//		<<LearnC++>>  The generator's producer thread has nothing to do while an input is connected.
+			myAsync.stop();
+		}
+
+		//		<<LearnC++>>  The per input gains and the channel matching only matter when more than the first input is used,
+		//		and the Route DAT only when routing.
+		InputMixer::Mode mixMode = InputMixer::Mode(myPars.mix);
+		bool routing = myRouting && mixMode == InputMixer::Mode::Route;
+		bool mixing = mixMode == InputMixer::Mode::Sum || mixMode == InputMixer::Mode::Average;
+		if (myMixParsEnabled != int32_t(mixing))
+		{
+			inputs->enablePar("Gain", mixing);
+			inputs->enablePar("Match", mixing);
+			myMixParsEnabled = mixing;
+		}
+		if (myRouteDATEnabled != int32_t(mixMode == InputMixer::Mode::Route))
+		{
+			inputs->enablePar("Routedat", mixMode == InputMixer::Mode::Route);
+			myRouteDATEnabled = mixMode == InputMixer::Mode::Route;
+		}
+		if (myResampleRateEnabled != int32_t(myPars.resample))
+		{
+			inputs->enablePar("Resamplerate", myPars.resample);
+			myResampleRateEnabled = myPars.resample;
+		}
+		if (routing && myRouter.numOutputs() == 0)
+			myWarning = "The Route mix needs a Route DAT with rows of source, destination and gain";
+		else if (routing && myRouter.unresolved() > 0)
+			myWarning = "Some routes in the Route DAT name a source channel the first input doesn't have";
+
+		// getOutputInfo() didn't get to set up the routes, so treat this cook like "First Input Only"
+		if (mixMode == InputMixer::Mode::Route && !routing)
+			mixMode = InputMixer::Mode::First;
+
+		//		<<LearnC++>>  The kernel table holds the fastest version of each loop this CPU can run (SSE2, AVX2, AVX-512...). See ChannelKernels.h.
+		const ChannelKernels& kernels = ChannelKernels::get();
+
+		/*
+				<<LearnC++>>  Here we are actually setting the output channels to a scaled (or mixed) version of the input channels.
+				Note the syntax:
+					output->channels[ channel index ]
+
+				is the array of samples for one channel.
+
+				Both the inputs and the output are timeslices: an input holds the samples from its startIndex on, and
+				we have to fill in the samples from output->startIndex on. myMixer keeps an InputRing for every input,
+				holding any input samples the output hasn't reached yet, and finds exactly the window the output asks for.
+
+				With "Mix" set to "First Input Only" only the first input is used, multiplied by Scale. Otherwise every
+				connected input is added up with its own gain, one pass over each output channel no matter how many inputs
+				there are (see ChannelKernels::mix). Set to "Route by DAT", each output channel is the sum of the input
+				channels the Route DAT sends to it, which is a sparse matrix multiplied by the input (see ChannelRouter.h).
+
+				An input whose sample rate isn't the output's (with "Resample" on) is run through a low pass filter and
+				read at the output's times instead (see Resampler.h). The rings keep enough of every input for the filter
+				to reach back into earlier cooks, so the output is continuous from one timeslice to the next.
+
+				Every channel is independent, so channels can be worked on by different threads.
+				myThreadPool->parallelFor hands out ranges of channels to the worker threads and calls the lambda (the
+				[&](...){ } block) for each range. Small cooks just run the lambda once on this thread.
+		*/
+		const float fscale = float(scale);
+		{
+			CookProfiler::Scope timer(myProfiler, myPrepareStage);
+			myMixer.prepare(inputs, output, mixMode, InputMixer::Match(myPars.match),
+							myPars.gains, 4, fscale);
+		}
 
-		int ind = 0;
+		{
+			CookProfiler::Scope timer(myProfiler, myAppendStage);
+			for (int32_t k = 0; k < myMixer.numInputs(); k++)
+			{
+				if (!myMixer.needsAppend(k))
+					continue;
+				myThreadPool->parallelFor(myMixer.input(k)->numChannels, grain, threads,
+					[&](int32_t begin, int32_t end)
+					{
+						myMixer.appendChannels(k, begin, end);
+					});
+
+				// Read from the input and written to the ring
+				myProfiler.addBytes(myAppendStage, 2 * int64_t(sizeof(float)) *
+									myMixer.appended(k) * myMixer.input(k)->numChannels);
+			}
+		}
 
-		//		<<LearnC++>>  We have two for loops here in order to iterate through each channel and each sample in the channel.
-		for (int i = 0 ; i < output->numChannels; i++)
+		/*
+				<<LearnC++>>  myCache holds a copy of the last output. The key below describes this cook without looking at
+				any samples: which CHOPs are connected, which part of them (startIndex), which part of the output and every
+				parameter. If it's the same as last cook, the input channels feeding each output channel are hashed, and any
+				output channel whose inputs are also the same is copied from the cache instead of being worked out again.
+		*/
+		CookProfiler::Stage mixStage = routing ? myRouteStage : myMixStage;
+		CookProfiler::Scope mixTimer(myProfiler, mixStage);
+
+		//		<<LearnC++>>  When routing, myRouter first finds where this cook's samples of every input channel it reads are.
+		if (routing)
+			myRouter.gather(myMixer, output->numSamples, kernels, myArena);
+
+		bool cacheable = false;
+		if (myPars.cache)
 		{
-			for (int j = 0; j < output->numSamples; j++)
+			uint64_t key = myParameters.fingerprint();
+			if (routing)
+				key = CookCache::mix(key, myRouter.layoutHash());
+			for (int32_t k = 0; k < myMixer.numInputs(); k++)
 			{
-				//		<<LearnC++>>  Here we are getting the input CHOP at the first input index. 
-				const OP_CHOPInput	*cinput = inputs->getInputCHOP(0);
-				/*		
-						<<LearnC++>>  Here we are actually setting the output channels to a scaled version of the input channels. 
-						Note the syntax:
-							output->channels[ channel index ][ sample index ]
-						
-						This is set to the input channel/sample multiplied by scale.
-						"ind" is a wrapped value which is increment below if the input samples are shorter than the output samples. 
-				*/
-				output->channels[i][j] = float(cinput->getChannelData(i)[ind] * scale);
-				//		<<LearnC++>>  Increment ind to step through the next sample.
-				ind++;
-
-				//		<<LearnC++>>  The Modulus operator wraps back around. 
-				// Make sure we don't read past the end of the CHOP input
-				ind = ind % cinput->numSamples;
-
-				//		<<LearnC++>>  End of the nested loop that handles samples.
+				const OP_CHOPInput* in = myMixer.input(k);
+				key = CookCache::mix(key, (uint64_t)in->opId);
+				key = CookCache::mix(key, (uint64_t)(uint32_t)in->numChannels);
+				key = CookCache::mix(key, (uint64_t)(uint32_t)in->numSamples);
+				key = CookCache::mix(key, in->sampleRate);
+
+				// A streaming input moves its startIndex every cook, which makes the key different every cook, so the
+				// channels aren't hashed and stored for nothing. Only an input that stays put is keyed by where the
+				// output window sits relative to it: past its end the output just holds its last sample, so the key
+				// stays the same while the timeline runs. Before its start the output comes from the ring, which
+				// depends on where the input was.
+				if (myMixer.moved(k))
+				{
+					key = CookCache::mix(key, in->startIndex);
+				}
+				else
+				{
+					double rel = output->startIndex - in->startIndex;
+					if (rel > in->numSamples)
+						rel = in->numSamples;
+					key = CookCache::mix(key, rel);
+					if (rel < 0.0 || in->sampleRate != output->sampleRate)
+						key = CookCache::mix(key, in->startIndex);
+				}
 			}
-			//		<<LearnC++>>  End of the loop that handles channels.
+			key = CookCache::mix(key, (double)output->sampleRate);
+			cacheable = myCache.begin(key, output->numChannels, output->numSamples);
+		}
+		else
+		{
+			myCache.invalidate();
+		}
+
+		std::atomic<int32_t> reused(0);
+		myThreadPool->parallelFor(output->numChannels, grain, threads,
+			[&](int32_t begin, int32_t end)
+			{
+				//		<<LearnC++>>  Routing a whole range of channels at once lets myRouter go through the samples a block
+				//		at a time, reading each block of the inputs while it's still in the CPU's cache.
+				if (routing && !cacheable)
+				{
+					myRouter.route(output->channels, begin, end, fscale, kernels);
+					return;
+				}
+
+				InputMixer::Scratch scratch(myArena);
+				int32_t hits = 0;
+				for (int32_t i = begin; i < end; i++)
+				{
+					uint64_t hash = 0;
+					if (cacheable)
+					{
+						hash = routing ? myRouter.hashSources(i) : myMixer.hashSources(i);
+						if (myCache.fetch(i, hash, output->channels[i]))
+						{
+							hits++;
+							continue;
+						}
+					}
+
+					if (routing)
+						myRouter.route(output->channels, i, i + 1, fscale, kernels);
+					else
+						myMixer.mixChannel(i, output->channels[i], scratch, kernels);
+
+					if (cacheable)
+						myCache.store(i, hash, output->channels[i]);
+				}
+				reused += hits;
+			});
+
+		if (myPars.cache)
+			myCache.finish(reused);
+
+		// Every input is read once for each output channel (or route), which is written once
+		int64_t reads = routing ? myRouter.numRoutes() : int64_t(output->numChannels) * myMixer.numInputs();
+		myProfiler.addBytes(mixStage, int64_t(sizeof(float)) * output->numSamples *
+							(reads + output->numChannels));
+		mixTimer.stop();
+
+		/*
+				<<LearnC++>>  The "Filter" stage runs every output channel through "Filter Stages" biquad filters in a row,
+				after the scale and the mix. A filter remembers the last couple of samples it saw, so every sample depends
+				on the one before and a channel has to be worked through in order. Instead, myFilters works on 16 channels
+				at once, one in each lane of a SIMD register (see BiquadBank.h). The filter coefficients only get worked out
+				again when a filter parameter, the Filter DAT or the number of channels changes.
+		*/
+		BiquadBank::Type filterType = BiquadBank::Type(myPars.filter);
+		bool filtering = filterType != BiquadBank::Type::Off;
+		if (myFilterParsEnabled != int32_t(filtering))
+		{
+			inputs->enablePar("Filterfreq", filtering);
+			inputs->enablePar("Filterq", filtering);
+			inputs->enablePar("Filterstages", filtering);
+			inputs->enablePar("Filterdat", filtering);
+			myFilterParsEnabled = filtering;
+		}
+		if (filtering)
+		{
+			CookProfiler::Scope timer(myProfiler, myFilterStage);
+			myFilters.setup(filterType, myPars.filterStages, myPars.filterFreq, myPars.filterQ,
+							myPars.filterDAT, output->numChannels, output->sampleRate);
+
+			int32_t groupGrain = grain / BiquadBank::Lanes > 0 ? grain / BiquadBank::Lanes : 1;
+			myThreadPool->parallelFor(myFilters.numGroups(), groupGrain, threads,
+				[&](int32_t begin, int32_t end)
+				{
+					myFilters.process(output->channels, output->numSamples, begin, end, myArena);
+				});
+
+			// Read and written in place
+			myProfiler.addBytes(myFilterStage, 2 * int64_t(sizeof(float)) * output->numChannels *
+								output->numSamples);
+		}
+	}
+	/*
+			<<LearnC++>>  Below is what happens if no inputs are connected and "Play" is on. The samples are copied straight
+			out of the recording, which is mapped into memory rather than loaded (see RecordingPlayer.h). Pages of the
+			file are only read from disk when something touches them, and myPlayer's own thread asks for the pages just
+			ahead of the play head before this cook gets to them. Each cook finds its samples by output->startIndex, the
+			same index they were recorded with, so scrubbing or looping the timeline plays the matching part of the file.
+	*/
+	else if (myPlaying && myPlayer.isOpen())
+	{
+		if (myBranch != Branch::Playback)
+		{
+			enableBranchPars(inputs, Branch::Playback);
+			myAsync.stop();
+		}
+
+		CookProfiler::Scope timer(myProfiler, myPlayStage);
+		myCache.invalidate();
+		myPlayer.read(output->channels, output->numChannels, (int64_t)output->startIndex, output->numSamples);
+
+		//		<<LearnC++>>  Scale works the same as it does on an input.
+		const float fscale = float(scale);
+		if (fscale != 1.0f)
+		{
+			const ChannelKernels& kernels = ChannelKernels::get();
+			myThreadPool->parallelFor(output->numChannels, grain, threads,
+				[&](int32_t begin, int32_t end)
+				{
+					for (int32_t i = begin; i < end; i++)
+						kernels.scale(output->channels[i], output->channels[i], output->numSamples, fscale);
+				});
 		}
 
+		// Read from the mapping and written to the output
+		myProfiler.addBytes(myPlayStage, 2 * int64_t(sizeof(float)) * output->numChannels *
+							output->numSamples);
+	}
+	/*
+			<<LearnC++>>  Below is what happens if no inputs are connected and a TOP is set in the "TOP" parameter.
+			getTOPDataInCPUMemory() copies the TOP's image from the GPU into CPU memory. Asking for a Delayed download
+			means the copy is only started this frame and handed to us next frame, so the cook never waits on the GPU.
+			The price is that the channels are always one frame behind the TOP (and empty for the very first frame).
+			myTopReducer then adds up the pixels with SIMD code, several bands of rows at a time on different threads,
+			and every channel holds its value for the whole cook.
+	*/
+	else if (myReducing && myPars.top)
+	{
+		if (myBranch != Branch::Top)
+		{
+			enableBranchPars(inputs, Branch::Top);
+			myAsync.stop();
+		}
+
+		TopReducer::Mode mode = TopReducer::Mode(myPars.topReduce);
+		bool useRegions = mode == TopReducer::Mode::Regions;
+		if (myRegionDATEnabled != int32_t(useRegions))
+		{
+			inputs->enablePar("Regiondat", useRegions);
+			inputs->enablePar("Topbins", !useRegions);
+			myRegionDATEnabled = useRegions;
+		}
+		if (useRegions && myTopReducer.numChannels() == 0)
+			myWarning = "The Regions reduction needs a Region DAT with rows of name, u, v, width and height";
+
+		CookProfiler::Scope timer(myProfiler, myTopStage);
+		myCache.invalidate();
+		if (myTopReducer.update(inputs, myPars.top, *myThreadPool, threads, minWork, myArena))
+			myProfiler.addBytes(myTopStage, myTopReducer.imageBytes());
+
+		const float* values = myTopReducer.values();
+		int32_t numValues = myTopReducer.numChannels();
+		const float fscale = float(scale);
+		myThreadPool->parallelFor(output->numChannels, grain, threads,
+			[&](int32_t begin, int32_t end)
+			{
+				for (int32_t i = begin; i < end; i++)
+				{
+					float v = i < numValues ? values[i] * fscale : 0.0f;
+					float* dst = output->channels[i];
+					for (int32_t j = 0; j < output->numSamples; j++)
+						dst[j] = v;
+				}
+			});
 	}
 	//		<<LearnC++>>  Below is what happens if not inputs are connected. If inputs->getNumInputs() <= 0.
 	else // If not input is connected, lets output a sine wave instead
 	{
-		//		<<LearnC++>>  Enable the parameters incase they were disabled before. 
-		inputs->enablePar("Speed", 1);
-		inputs->enablePar("Reset", 1);
-
-		//		<<LearnC++>>  Grab the parameter labeled "Speed"
-		double speed = inputs->getParDouble("Speed");
-		double step = speed * 0.01f;
+		//		<<LearnC++>>  Enable the parameters incase they were disabled before, but only when the input was just disconnected.
+		if (myBranch != Branch::Generator)
+		{
+			enableBranchPars(inputs, Branch::Generator);
+		}
 
+		//		<<LearnC++>>  The events at the very start of the block are applied before anything else. After that myStep and
+		//		myShape are what the block starts with.
+		size_t next = 0;
+		while (next < events.size() && events[next].position == 0)
+			applyEvent(events[next++]);
 
-		// menu items can be evaluated as either an integer menu position, or a string
-		int shape = inputs->getParInt("Shape");
-//		const char *shape_str = inputs->getParString("Shape");
+		//		<<LearnC++>>  The "Table" shape plays back one cycle of numbers from a DAT. The wavetable is only rebuilt when the DAT changes.
+		//		The block may only switch to it partway through, but the DAT can only be read here.
+		bool useTable = myShape == int(OscillatorBank::Shape::Table);
+		for (size_t e = next; e < events.size(); e++)
+		{
+			if (events[e].kind == EventQueue::Kind::Shape && int(events[e].value) == int(OscillatorBank::Shape::Table))
+				useTable = true;
+		}
+		bool tableShape = myPars.shape == int(OscillatorBank::Shape::Table);
+		if (myTableDATEnabled != int32_t(tableShape))
+		{
+			inputs->enablePar("Tabledat", tableShape);
+			myTableDATEnabled = tableShape;
+		}
+		if (myLookaheadEnabled != int32_t(myPars.async))
+		{
+			inputs->enablePar("Lookahead", myPars.async);
+			myLookaheadEnabled = myPars.async;
+		}
+		if (useTable)
+		{
+			CookProfiler::Scope timer(myProfiler, myTableStage);
+			if (!myOscillators.wavetables().updateUserTable(myPars.tableDAT))
+				myWarning = "The Table shape needs a Table DAT with at least 2 numbers in it";
+		}
 
 		// keep each channel at a different phase
 		double phase = 2.0f * 3.14159f / (float)(output->numChannels);
@@ -330,42 +913,135 @@ CPlusPlusCHOPExample::execute(const CHOP_Output* output,
 		// Since we are outputting at 120, for each frame that has passed we'll be
 		// outputing 2 samples (assuming the timeline is running at 60hz).
 
-		//		<<LearnC++>>  This should look familiar to what is above. Two for loops, one for channel and one for samples. 
-		for (int i = 0; i < output->numChannels; i++)
+		/*
+				<<LearnC++>>  Every channel has its own oscillator in myOscillators. Each oscillator remembers its own phase
+				and moves it forward by "step" for every sample, so every sample gets its own value and the wave is smooth
+				even when more than one sample is output per cook.
+
+				The bank only re-seeds the phases when the number of channels changes, otherwise they keep running
+				from where the last cook left them.
+		*/
+		CookProfiler::Scope renderTimer(myProfiler, myRenderStage);
+		myOscillators.setup(output->numChannels, myOffset, phase);
+
+		//		<<LearnC++>>  With a Speed of 0 the oscillators stand still, so the output only changes when a parameter or the
+		//		table does. That's the one case where the generator's last output can be reused, as long as no event
+		//		changes the generator partway through the block.
+		bool cacheable = false;
+		if (myPars.cache && myStep == 0 && next == events.size())
+		{
+			uint64_t key = myParameters.fingerprint();
+			key = CookCache::mix(key, (uint64_t)myOscillators.wavetables().userTableBuilds());
+			key = CookCache::mix(key, (uint64_t)myOffset);
+			cacheable = myCache.begin(key, output->numChannels, output->numSamples);
+		}
+		else
 		{
-			double offset = myOffset + phase*i;
+			myCache.invalidate();
+		}
 
+		//		<<LearnC++>>  Render up to the next event, apply it (and any others on the same sample), and carry on from there.
+		//		An event stamped past the end of the block is applied after its last sample.
+		std::atomic<int32_t> reused(0);
+		int32_t pos = 0;
+		for (;;)
+		{
+			int32_t until = next < events.size() ? events[next].position : output->numSamples;
+			if (until > pos)
+				renderGenerator(output, pos, until - pos, phase, float(scale), cacheable, grain, threads, reused);
+			pos = until;
+			if (next == events.size())
+				break;
+			while (next < events.size() && events[next].position == pos)
+				applyEvent(events[next++]);
+		}
+		if (!myPars.async)
+			myAsync.stop();
 
-			double v = 0.0f;
-			//		<<LearnC++>>  This switch case detirmines the shape the waveform will have. This is grabbed from a paramter on line 321.
-			switch(shape)
-			{
-				case 0:		// sine
-					v = sin(offset);
-					break;
+		if (myPars.cache)
+			myCache.finish(reused);
 
-				case 1:		// square
-					v = fabs(fmod(offset, 1.0)) > 0.5;
-					break;
+		myProfiler.addBytes(myRenderStage, int64_t(sizeof(float)) * output->numChannels *
+							output->numSamples);
+	}
 
-				case 2:		// ramp	
-					v = fabs(fmod(offset, 1.0));
-					break;
-			}
+	/*
+			<<LearnC++>>  With "Record" on, every cook's output is appended to "Record File" (the format is described in
+			ChannelRecorder.h). All this does during the cook is copy the samples into a buffer; another thread writes
+			the buffer to disk once it's full. Changing the file starts a new recording.
+	*/
+	if (myPars.record)
+	{
+		CookProfiler::Scope timer(myProfiler, myRecordStage);
+		if (myParameters.changed(&myPars.record) || myParameters.changed(&myPars.recordFile) ||
+			myParameters.changed(&myPars.recordDirect))
+		{
+			myRecorder.close();
+			myRecordFailed = false;
+		}
 
+		if (!myRecorder.isOpen() && !myRecordFailed && !myPars.recordFile.empty())
+			myRecordFailed = !myRecorder.open(myPars.recordFile.c_str(), myPars.recordDirect, output);
 
-			v *= scale;
+		if (myRecorder.isOpen())
+		{
+			myRecorder.write(output);
+			myProfiler.addBytes(myRecordStage, 2 * int64_t(sizeof(float)) * output->numChannels *
+								output->numSamples);
+		}
 
-			for (int j = 0; j < output->numSamples; j++)
-			{
-				//		<<LearnC++>>  Data is passed into the channels/samples here.
-				output->channels[i][j] = float(v);
-				offset += step;
-			}
+		if (myRecorder.error())
+			myWarning = myRecorder.error();
+	}
+	else if (myRecorder.isOpen())
+	{
+		myRecorder.close();
+	}
+
+	/*
+			<<LearnC++>>  With "Publish" on, every cook's output is also put in shared memory called "Publish Name", where
+			other programs on this machine can read it as it's made (see SharedOutputPublisher.h, and
+			linuxHost/SharedOutputReader.h for the reading side). It's a ring of the last "Publish Slots" cooks. We only
+			copy the channels into the next slot, several threads at a time, and never wait for the readers: one that
+			can't keep up just misses cooks.
+	*/
+	if (myPars.publish)
+	{
+		CookProfiler::Scope timer(myProfiler, myPublishStage);
+		if (myParameters.changed(&myPars.publish) || myParameters.changed(&myPars.publishName) ||
+			myParameters.changed(&myPars.publishSlots))
+		{
+			myPublisher.close();
+			myPublishFailed = false;
+		}
+
+		if (!myPublisher.isOpen() && !myPublishFailed)
+			myPublishFailed = !myPublisher.open(myPars.publishName.c_str(), myPars.publishSlots);
+
+		if (myPublisher.begin(output))
+		{
+			myThreadPool->parallelFor(output->numChannels, grain, threads,
+				[&](int32_t begin, int32_t end)
+				{
+					myPublisher.writeChannels(output, begin, end);
+				});
+			myPublisher.end();
+			myProfiler.addBytes(myPublishStage, 2 * int64_t(sizeof(float)) * output->numChannels *
+								output->numSamples);
 		}
 
-		myOffset += step * output->numSamples; 
+		if (myPublisher.error())
+			myWarning = myPublisher.error();
+	}
+	else if (myPublisher.isOpen())
+	{
+		myPublisher.close();
 	}
+
+	if (myPars.play && myPlayer.error())
+		myWarning = myPlayer.error();
+
+	myProfiler.endCook(int64_t(output->numChannels) * output->numSamples);
 	/*
 			<<LearnC++>>
 			It's important to remember that this function is called each time the operator cooks.
@@ -378,13 +1054,203 @@ CPlusPlusCHOPExample::execute(const CHOP_Output* output,
 	*/
 }
 
+//		<<LearnC++>>  Every parameter that only some branches of execute() use is listed here once, with a bit for each branch
+//		that uses it. Switching branches enables exactly the listed parameters that have the new branch's bit. Some of them also
+//		depend on another parameter, like "Gain" only when mixing, so their cached states go back to unknown and the branch's own
+//		checks switch them again in this same cook.
+void
+CPlusPlusCHOPExample::enableBranchPars(OP_Inputs* inputs, Branch branch)
+{
+	const int32_t Input = 1 << int32_t(Branch::Input);
+	const int32_t Generator = 1 << int32_t(Branch::Generator);
+	const int32_t Top = 1 << int32_t(Branch::Top);
+	const int32_t Spectrum = 1 << int32_t(Branch::Spectrum);
+
+	static const struct
+	{
+		const char*	name;
+		int32_t		branches;
+	} BranchPars[] =
+	{
+		{ "Speed",			Generator },
+		{ "Reset",			Generator },
+		{ "Cuephase",		Generator },
+		{ "Cue",			Generator },
+		{ "Shape",			Generator },
+		{ "Channels",		Generator },
+		{ "Channelnames",	Generator },
+		{ "Namedat",		Generator },
+		{ "Tabledat",		Generator },
+		{ "Async",			Generator },
+		{ "Lookahead",		Generator },
+		{ "Mix",			Input },
+		{ "Gain",			Input },
+		{ "Match",			Input },
+		{ "Routedat",		Input },
+		{ "Resample",		Input },
+		{ "Resamplerate",	Input },
+		{ "Filter",			Input },
+		{ "Filterfreq",		Input },
+		{ "Filterq",		Input },
+		{ "Filterstages",	Input },
+		{ "Filterdat",		Input },
+		{ "Spectrum",		Input | Spectrum },
+		{ "Fftsize",		Spectrum },
+		{ "Overlap",		Spectrum },
+		{ "Bands",			Spectrum },
+		{ "Bandspacing",	Spectrum },
+		{ "Bandrange",		Spectrum },
+		{ "Regiondat",		Top },
+		{ "Topbins",		Top },
+	};
+
+	int32_t bit = 1 << int32_t(branch);
+	for (const auto& par : BranchPars)
+		inputs->enablePar(par.name, (par.branches & bit) != 0);
+
+	myBranch = branch;
+	myTableDATEnabled = -1;
+	myMixParsEnabled = -1;
+	myLookaheadEnabled = -1;
+	myRegionDATEnabled = -1;
+	myRouteDATEnabled = -1;
+	myResampleRateEnabled = -1;
+	myFilterParsEnabled = -1;
+	myBandParsEnabled = -1;
+}
+
+//		<<LearnC++>>  Pulses and parameter changes come here from myEvents once the generator reaches the sample they were
+//		stamped with. A Reset or Cue moves the phase, so the cached output and anything myAsync rendered ahead are no good. A Cue
+//		jumps to "Cuephase" as this cook fetched it.
+void
+CPlusPlusCHOPExample::applyEvent(const EventQueue::Event& event)
+{
+	switch (event.kind)
+	{
+		case EventQueue::Kind::Reset:
+		case EventQueue::Kind::Cue:
+			myOffset = event.kind == EventQueue::Kind::Cue ? OscillatorBank::toFixed(myPars.cuePhase) : 0;
+			myOscillators.reset(myOffset);
+			myCache.invalidate();
+			myAsync.invalidate();
+			break;
+
+		//		<<LearnC++>>  The phase is a 64-bit fixed point number (see OscillatorBank.h), so the step is converted to it once
+		//		here and after that only ever added. That keeps myOffset exact however many days the generator runs for.
+		case EventQueue::Kind::Speed:
+			myStep = OscillatorBank::toFixed(event.value * 0.01f);
+			break;
+
+		// menu items can be evaluated as either an integer menu position, or a string
+		case EventQueue::Kind::Shape:
+			myShape = int32_t(event.value);
+			break;
+	}
+}
+
+/*
+		<<LearnC++>>  With "Async" on, myAsync's own thread renders the samples ahead of time and this cook only copies
+		them out. Any change of Speed, Shape, Scale or Channels is sent to that thread as a command, stamped with the
+		first sample it applies to (see AsyncGenerator.h). Samples it hasn't got to yet, and shapes it doesn't do
+		(the Table shape reads a DAT, which can only be done during the cook), are rendered here as usual.
+*/
+void
+CPlusPlusCHOPExample::renderGenerator(const CHOP_Output* output, int32_t first, int32_t numSamples,
+									  double spread, float scale, bool cacheable, int32_t grain,
+									  int32_t threads, std::atomic<int32_t>& reused)
+{
+	int64_t	step = myStep;
+	OscillatorBank::Shape shape = OscillatorBank::Shape(myShape);
+
+	float**	channels = output->channels;
+	if (first > 0)
+	{
+		myRemainder.resize(output->numChannels);
+		for (int32_t i = 0; i < output->numChannels; i++)
+			myRemainder[i] = output->channels[i] + first;
+		channels = myRemainder.data();
+	}
+
+	bool async = myPars.async && shape != OscillatorBank::Shape::Table && !cacheable;
+	if (async)
+	{
+		AsyncGenerator::Settings settings;
+		settings.numChannels = output->numChannels;
+		settings.shape = shape;
+		settings.step = step;
+		settings.spread = spread;
+		settings.scale = scale;
+		settings.lookahead = myPars.lookahead;
+
+		int32_t filled = myAsync.read(channels, numSamples, settings, myOffset);
+		if (filled > 0 && filled < numSamples)
+		{
+			myRemainder.resize(output->numChannels);
+			for (int32_t i = 0; i < output->numChannels; i++)
+				myRemainder[i] = output->channels[i] + first + filled;
+			channels = myRemainder.data();
+		}
+		numSamples -= filled;
+
+		//		<<LearnC++>>  The oscillators haven't moved while the producer was rendering, so put them where they should be.
+		myOscillators.reset(OscillatorBank::advance(myOffset, step, filled));
+		myOffset = OscillatorBank::advance(myOffset, step, filled);
+	}
+	else
+	{
+		if (myAsyncUsed)
+			myOscillators.reset(myOffset);
+		myAsync.invalidate();
+	}
+	myAsyncUsed = async;
+
+	/*
+			<<LearnC++>>  The shape comes from the menu created in setupParameters. The menu index matches OscillatorBank::Shape.
+			select() picks a loop written for just this shape (and for Scale being 1 or not) before the threads start,
+			so the loop every thread runs doesn't have to check the shape for every channel. The loops are templates,
+			see OscillatorBank::renderRangeT: the compiler makes a copy for each shape with the other shapes' code left out.
+	*/
+	if (numSamples > 0)
+	{
+		myOscillators.select(shape, scale);
+		myThreadPool->parallelFor(output->numChannels, grain, threads,
+			[&](int32_t begin, int32_t end)
+			{
+				if (!cacheable)
+				{
+					myOscillators.renderRange(channels, begin, end, numSamples, step, scale);
+					return;
+				}
+
+				int32_t hits = 0;
+				for (int32_t i = begin; i < end; i++)
+				{
+					if (myCache.fetch(i, 0, output->channels[i]))
+					{
+						hits++;
+						continue;
+					}
+					myOscillators.renderRange(channels, i, i + 1, numSamples, step, scale);
+					myCache.store(i, 0, output->channels[i]);
+				}
+				reused += hits;
+			});
+	}
+
+	myOffset = OscillatorBank::advance(myOffset, step, numSamples);
+}
+
 //		<<LearnC++>>  This function allows us to set the number of channels to output to an Info CHOP.   
 int32_t
 CPlusPlusCHOPExample::getNumInfoCHOPChans()
 {
 	// We return the number of channel we want to output to any Info CHOP
 	// connected to the CHOP. In this example we are just going to send one channel.
-	return 2;
+	//		<<LearnC++>>  5 counters, 6 channels of cook times, the async underruns, 2 channels for the recorder, 1 for the
+	//		player, 1 for the TOP reduction, 1 for the router, 1 for the filters, 1 for the spectrum, 1 for the resampling,
+	//		1 for the channel names, 2 for the scratch arena, 1 for publishing, 3 for the events and the mean time of every
+	//		stage myProfiler knows about.
+	return 27 + myProfiler.numStages();
 }
 
 
@@ -402,122 +1268,324 @@ CPlusPlusCHOPExample::getInfoCHOPChan(int32_t index,
 		chan->value = (float)myExecuteCount;
 	}
 
+	//		<<LearnC++>>  myOffset itself is exact, but an Info CHOP channel is a float, so this only shows it to about 7 digits.
+	//		After a long run the channel moves in steps while the generator doesn't.
 	if (index == 1)
 	{
 		chan->name = "offset";
-		chan->value = (float)myOffset;
+		chan->value = (float)OscillatorBank::toUnits(myOffset);
 	}
-}
-
-//		<<LearnC++>>  This funciton is called to set the Info DAT size. More info available in CPlusPlus_Common.h lines 349-369.
-bool		
-CPlusPlusCHOPExample::getInfoDATSize(OP_InfoDATSize* infoSize)
-{
-	infoSize->rows = 2;
-	infoSize->cols = 2;
-	// Setting this to false means we'll be assigning values to the table
-	// one row at a time. True means we'll do it one column at a time.
-	infoSize->byColumn = false;
-	return true;
-}
 
-//		<<LearnC++>>  This function sets the Info DAT data. There is some precompiler trickery in here in order to make this compatable with macOS. More info in CPlusPlus_Common.h lines 371-384.
-void
-CPlusPlusCHOPExample::getInfoDATEntries(int32_t index,
-										int32_t nEntries,
-										OP_InfoDATEntries* entries)
-{
-	// It's safe to use static buffers here because Touch will make it's own
-	// copies of the strings immediately after this call returns
-	// (so the buffers can be reuse for each column/row)
-	static char tempBuffer1[4096];
-	static char tempBuffer2[4096];
+	if (index == 2)
+	{
+		chan->name = "threads";
+		chan->value = (float)myThreadPool->lastThreadCount();
+	}
 
-	if (index == 0)
+	if (index == 3)
 	{
-		// Set the value for the first column
-#ifdef WIN32
-		strcpy_s(tempBuffer1, "executeCount");
-#else // macOS
-        strlcpy(tempBuffer1, "executeCount", sizeof(tempBuffer1));
-#endif
-		entries->values[0] = tempBuffer1;
+		chan->name = "cacheHits";
+		chan->value = (float)myCache.hits();
+	}
 
-		// Set the value for the second column
-#ifdef WIN32
-		sprintf_s(tempBuffer2, "%d", myExecuteCount);
-#else // macOS
-        snprintf(tempBuffer2, sizeof(tempBuffer2), "%d", myExecuteCount);
-#endif
-		entries->values[1] = tempBuffer2;
+	if (index == 4)
+	{
+		chan->name = "cacheMisses";
+		chan->value = (float)myCache.misses();
 	}
 
-	if (index == 1)
+	//		<<LearnC++>>  The cook times are kept in nanoseconds, the Info CHOP shows them in microseconds.
+	const LatencyHistogram& cook = myProfiler.cook();
+
+	if (index == 5)
 	{
-		// Set the value for the first column
-#ifdef WIN32
-        strcpy_s(tempBuffer1, "offset");
-#else // macOS
-        strlcpy(tempBuffer1, "offset", sizeof(tempBuffer1));
-#endif
-		entries->values[0] = tempBuffer1;
-
-		// Set the value for the second column
-#ifdef WIN32
-        sprintf_s(tempBuffer2, "%g", myOffset);
-#else // macOS
-        snprintf(tempBuffer2, sizeof(tempBuffer2), "%g", myOffset);
-#endif
-		entries->values[1] = tempBuffer2;
+		chan->name = "cookLastUs";
+		chan->value = (float)(cook.last() / 1000.0);
 	}
-}
 
-/*		
-		<<LearnC++>>  
-		Here is the next really important one for make super customized CPlusPlus CHOPs. This function allows us to set up custom parameters that we can
-		access from within other function called defined above. 
-*/
-void
-CPlusPlusCHOPExample::setupParameters(OP_ParameterManager* manager)
-{
-	/*
-			<<LearnC++>>
-			Below 4 parameters are defined. Note the syntax below:
-				
-				{															// This bracket is used to declare the scope of the variables inside.
-					TypeOfParameter np;										// TypeOfParameter is one of the parameter objects defined in CPlusPlus_Common.h lines 388-457
+	if (index == 6)
+	{
+		chan->name = "cookMeanUs";
+		chan->value = (float)(cook.mean() / 1000.0);
+	}
 
-					np.member1 = var;										// Members of the parameter are set here. 
-					np.member2 = var;
-					np.member3 = var;
+	if (index == 7)
+	{
+		chan->name = "cookP50Us";
+		chan->value = (float)(cook.percentile(0.5) / 1000.0);
+	}
 
-					OP_ParAppendResult res = manager->appendType(np);		// appendType is different for each type of parameter you try to append. More info in CPlusPlus_Common.h lines 475-509. 
-					assert(res == OP_ParAppendResult::Success);				// Assert means to check if the condition is true - if it isn't stop the program. This checks to make sure we have append the parameter.
-				}															// Ends the scope.
+	if (index == 8)
+	{
+		chan->name = "cookP99Us";
+		chan->value = (float)(cook.percentile(0.99) / 1000.0);
+	}
 
-			We do this once for each parameter we want to create. 
-			
-	*/
+	if (index == 9)
+	{
+		chan->name = "cookMaxUs";
+		chan->value = (float)(cook.max() / 1000.0);
+	}
 
+	if (index == 10)
+	{
+		chan->name = "samplesPerSec";
+		chan->value = (float)myProfiler.samplesPerSecond();
+	}
 
+	if (index == 11)
+	{
+		chan->name = "asyncUnderruns";
+		chan->value = (float)myAsync.underruns();
+	}
 
-	// speed
+	if (index == 12)
 	{
-		OP_NumericParameter	np;
+		chan->name = "recordMB";
+		chan->value = (float)(myRecorder.bytesWritten() / (1024.0 * 1024.0));
+	}
 
-		np.name = "Speed";
-		np.label = "Speed";
-		np.defaultValues[0] = 1.0;
-		np.minSliders[0] = -10.0;
-		np.maxSliders[0] =  10.0;
-		
-		OP_ParAppendResult res = manager->appendFloat(np);
-		assert(res == OP_ParAppendResult::Success);
+	if (index == 13)
+	{
+		chan->name = "recordStalls";
+		chan->value = (float)myRecorder.stalls();
 	}
 
-	// scale
+	if (index == 14)
 	{
-		OP_NumericParameter	np;
+		chan->name = "playPrefetchMB";
+		chan->value = (float)(myPlayer.prefetched() / (1024.0 * 1024.0));
+	}
+
+	if (index == 15)
+	{
+		chan->name = "topReductions";
+		chan->value = (float)myTopReducer.reductions();
+	}
+
+	if (index == 16)
+	{
+		chan->name = "routes";
+		chan->value = (float)myRouter.numRoutes();
+	}
+
+	if (index == 17)
+	{
+		chan->name = "filterUpdates";
+		chan->value = (float)myFilters.updates();
+	}
+
+	if (index == 18)
+	{
+		chan->name = "spectrumFrames";
+		chan->value = (float)mySpectrum.frames();
+	}
+
+	if (index == 19)
+	{
+		chan->name = "resampleDelayMs";
+		chan->value = (float)(myMixer.resampleDelay() * 1000.0);
+	}
+
+	if (index == 20)
+	{
+		chan->name = "nameBuilds";
+		chan->value = (float)myChannelNames.builds();
+	}
+
+	if (index == 21)
+	{
+		chan->name = "scratchPeakKB";
+		chan->value = (float)(myArena.peak() / 1024.0);
+	}
+
+	if (index == 22)
+	{
+		chan->name = "scratchGrowths";
+		chan->value = (float)myArena.growths();
+	}
+
+	if (index == 23)
+	{
+		chan->name = "published";
+		chan->value = (float)myPublisher.published();
+	}
+
+	//		<<LearnC++>>  Events that missed their cook's block land on its nearest edge, and ones that didn't fit in the queue
+	//		are lost. Both should stay at 0.
+	if (index == 24)
+	{
+		chan->name = "events";
+		chan->value = (float)myEvents.collected();
+	}
+
+	if (index == 25)
+	{
+		chan->name = "eventsMoved";
+		chan->value = (float)myEvents.moved();
+	}
+
+	if (index == 26)
+	{
+		chan->name = "eventsDropped";
+		chan->value = (float)myEvents.dropped();
+	}
+
+	if (index >= 27 && index < 27 + myProfiler.numStages())
+	{
+		CookProfiler::Stage stage = index - 27;
+		chan->name = myProfiler.stageInfoName(stage);
+		chan->value = (float)(myProfiler.stage(stage).mean() / 1000.0);
+	}
+}
+
+//		<<LearnC++>>  Opens the "Play File" the first time it's needed and closes it again when "Play" is turned off, so the
+//		file isn't held open (or mapped) while it isn't being played.
+bool
+CPlusPlusCHOPExample::updatePlayer()
+{
+	if (myParameters.changed(&myPars.play) || myParameters.changed(&myPars.playFile))
+	{
+		myPlayer.close();
+		myPlayFailed = false;
+	}
+
+	if (!myPars.play)
+		return false;
+
+	if (!myPlayer.isOpen() && !myPlayFailed && !myPars.playFile.empty())
+		myPlayFailed = !myPlayer.open(myPars.playFile.c_str());
+
+	myPlayer.setPrefetchBytes(size_t(myPars.prefetchMB) << 20);
+	return myPlayer.isOpen();
+}
+
+//		<<LearnC++>>  This funciton is called to set the Info DAT size. More info available in CPlusPlus_Common.h lines 349-369.
+bool		
+CPlusPlusCHOPExample::getInfoDATSize(OP_InfoDATSize* infoSize)
+{
+	//		<<LearnC++>>  The Info DAT shows a profile of the cook: one row for the whole cook and one for every stage
+	//		myProfiler times. The table is only built once per cook, the first time an Info DAT asks for it.
+	if (myInfoTableCook != myExecuteCount)
+	{
+		buildInfoTable();
+		myInfoTableCook = myExecuteCount;
+	}
+
+	infoSize->rows = myInfoTable.rows();
+	infoSize->cols = myInfoTable.cols();
+	// Setting this to false means we'll be assigning values to the table
+	// one row at a time. True means we'll do it one column at a time.
+	infoSize->byColumn = false;
+	return true;
+}
+
+//		<<LearnC++>>  Formats every cell of the Info DAT. The strings are written into myInfoTable, which belongs to this
+//		instance of the CHOP, so two CHOPs using the .dll never write over each other's text.
+void
+CPlusPlusCHOPExample::buildInfoTable()
+{
+	myInfoTable.clear(7);
+	myInfoTable.add("stage");
+	myInfoTable.add("calls");
+	myInfoTable.add("lastUs");
+	myInfoTable.add("meanUs");
+	myInfoTable.add("p99Us");
+	myInfoTable.add("maxUs");
+	myInfoTable.add("bytesPerCall");
+
+	const LatencyHistogram& cook = myProfiler.cook();
+	myInfoTable.add("cook");
+	myInfoTable.add("%llu", (unsigned long long)cook.count());
+	myInfoTable.add("%.3f", cook.last() / 1000.0);
+	myInfoTable.add("%.3f", cook.mean() / 1000.0);
+	myInfoTable.add("%.3f", cook.percentile(0.99) / 1000.0);
+	myInfoTable.add("%.3f", cook.max() / 1000.0);
+	myInfoTable.add("%.0f", cook.count() ? double(myProfiler.cookBytes()) / double(cook.count()) : 0.0);
+
+	for (CookProfiler::Stage s = 0; s < myProfiler.numStages(); s++)
+	{
+		const LatencyHistogram& times = myProfiler.stage(s);
+		myInfoTable.add("%s", myProfiler.stageName(s));
+		myInfoTable.add("%llu", (unsigned long long)times.count());
+		myInfoTable.add("%.3f", times.last() / 1000.0);
+		myInfoTable.add("%.3f", times.mean() / 1000.0);
+		myInfoTable.add("%.3f", times.percentile(0.99) / 1000.0);
+		myInfoTable.add("%.3f", times.max() / 1000.0);
+		myInfoTable.add("%.0f", times.count() ? double(myProfiler.stageBytes(s)) / double(times.count()) : 0.0);
+	}
+}
+
+//		<<LearnC++>>  This function sets the Info DAT data. It's called once for every row, and we hand TouchDesigner the
+//		cells getInfoDATSize already formatted. More info in CPlusPlus_Common.h lines 371-384.
+void
+CPlusPlusCHOPExample::getInfoDATEntries(int32_t index,
+										int32_t nEntries,
+										OP_InfoDATEntries* entries)
+{
+	// TouchDesigner makes its own copies of the strings as soon as this call
+	// returns, so pointing into myInfoTable is enough.
+	for (int32_t i = 0; i < nEntries; i++)
+		entries->values[i] = myInfoTable.cell(index, i);
+}
+
+//		<<LearnC++>>  Returning a string here puts the node into a warning state, with the string as the message. nullptr means no warning.
+const char*
+CPlusPlusCHOPExample::getWarningString()
+{
+	return myWarning;
+}
+
+/*		
+		<<LearnC++>>  
+		Here is the next really important one for make super customized CPlusPlus CHOPs. This function allows us to set up custom parameters that we can
+		access from within other function called defined above. 
+*/
+void
+CPlusPlusCHOPExample::setupParameters(OP_ParameterManager* manager)
+{
+	/*
+			<<LearnC++>>
+			Below 4 parameters are defined. Note the syntax below:
+				
+				{															// This bracket is used to declare the scope of the variables inside.
+					TypeOfParameter np;										// TypeOfParameter is one of the parameter objects defined in CPlusPlus_Common.h lines 388-457
+
+					np.member1 = var;										// Members of the parameter are set here. 
+					np.member2 = var;
+					np.member3 = var;
+
+					OP_ParAppendResult res = manager->appendType(np);		// appendType is different for each type of parameter you try to append. More info in CPlusPlus_Common.h lines 475-509. 
+					assert(res == OP_ParAppendResult::Success);				// Assert means to check if the condition is true - if it isn't stop the program. This checks to make sure we have append the parameter.
+				}															// Ends the scope.
+
+			We do this once for each parameter we want to create. 
+
+			Instead of calling manager->appendType(np) directly, this example goes through myParameters.appendType(manager, np, &value).
+			That appends the parameter the same way, and also ties it to a member of myPars so every cook can fetch all of the
+			parameters in one go (see ParameterRegistry.h).
+			
+	*/
+
+
+
+	// speed
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Speed";
+		np.label = "Speed";
+		np.defaultValues[0] = 1.0;
+		np.minSliders[0] = -10.0;
+		np.maxSliders[0] =  10.0;
+		
+		OP_ParAppendResult res = myParameters.appendFloat(manager, np, &myPars.speed);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// scale
+	{
+		OP_NumericParameter	np;
 
 		np.name = "Scale";
 		np.label = "Scale";
@@ -525,7 +1593,7 @@ CPlusPlusCHOPExample::setupParameters(OP_ParameterManager* manager)
 		np.minSliders[0] = -10.0;
 		np.maxSliders[0] =  10.0;
 		
-		OP_ParAppendResult res = manager->appendFloat(np);
+		OP_ParAppendResult res = myParameters.appendFloat(manager, np, &myPars.scale);
 		assert(res == OP_ParAppendResult::Success);
 	}
 
@@ -538,10 +1606,580 @@ CPlusPlusCHOPExample::setupParameters(OP_ParameterManager* manager)
 
 		sp.defaultValue = "Sine";
 
-		const char *names[] = { "Sine", "Square", "Ramp" };
-		const char *labels[] = { "Sine", "Square", "Ramp" };
+		const char *names[] = { "Sine", "Square", "Ramp", "Triangle", "Table" };
+		const char *labels[] = { "Sine", "Square", "Ramp", "Triangle", "Table" };
+
+		OP_ParAppendResult res = myParameters.appendMenu(manager, sp, 5, names, labels, &myPars.shape);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// table DAT, one cycle of the waveform used by the "Table" shape
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Tabledat";
+		sp.label = "Table DAT";
+
+		OP_ParAppendResult res = myParameters.appendDAT(manager, sp, &myPars.tableDAT);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// channels
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Channels";
+		np.label = "Channels";
+		np.defaultValues[0] = 1;
+		np.minValues[0] = 1;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 1;
+		np.maxSliders[0] = 64;
+
+		OP_ParAppendResult res = myParameters.appendInt(manager, np, &myPars.channels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// channel names, a pattern like sensor[0-63] or t[xyz], see ChannelNamePool.h
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Channelnames";
+		sp.label = "Channel Names";
+		sp.defaultValue = "";
+
+		OP_ParAppendResult res = myParameters.appendString(manager, sp, &myPars.channelNames);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// name DAT, a channel name per row, used instead of the pattern when set
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Namedat";
+		sp.label = "Name DAT";
+
+		OP_ParAppendResult res = myParameters.appendDAT(manager, sp, &myPars.nameDAT);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// threads
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Threads";
+		np.label = "Threads (0 = All)";
+		np.defaultValues[0] = 0;
+		np.minValues[0] = 0;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 0;
+		np.maxSliders[0] = 32;
+
+		OP_ParAppendResult res = myParameters.appendInt(manager, np, &myPars.threads);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// minimum work per thread
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Minwork";
+		np.label = "Min Samples per Thread";
+		np.defaultValues[0] = 16384;
+		np.minValues[0] = 1;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 1;
+		np.maxSliders[0] = 65536;
+
+		OP_ParAppendResult res = myParameters.appendInt(manager, np, &myPars.minWork);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// what to do with more than one input
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Mix";
+		sp.label = "Mix";
+
+		sp.defaultValue = "First";
+
+		const char *names[] = { "First", "Sum", "Average", "Route" };
+		const char *labels[] = { "First Input Only", "Sum", "Weighted Average", "Route by DAT" };
+
+		OP_ParAppendResult res = myParameters.appendMenu(manager, sp, 4, names, labels, &myPars.mix);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// gain of each of the first 4 inputs when mixing, the rest get 1
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Gain";
+		np.label = "Input Gain";
+		for (int i = 0; i < 4; i++)
+		{
+			np.defaultValues[i] = 1.0;
+			np.minSliders[i] = 0.0;
+			np.maxSliders[i] = 2.0;
+		}
+
+		OP_ParAppendResult res = myParameters.appendFloat(manager, np, myPars.gains, 4);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// how channels of different inputs are paired up when mixing
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Match";
+		sp.label = "Match By";
+
+		sp.defaultValue = "Index";
+
+		const char *names[] = { "Index", "Name" };
+		const char *labels[] = { "Channel Index", "Channel Name" };
+
+		OP_ParAppendResult res = myParameters.appendMenu(manager, sp, 2, names, labels, &myPars.match);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// routes of the first input's channels, one per row as source, destination, gain
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Routedat";
+		sp.label = "Route DAT";
+
+		OP_ParAppendResult res = myParameters.appendDAT(manager, sp, &myPars.routeDAT);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// convert the inputs to a different sample rate
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Resample";
+		np.label = "Resample";
+
+		OP_ParAppendResult res = myParameters.appendToggle(manager, np, &myPars.resample);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// the output's sample rate when resampling
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Resamplerate";
+		np.label = "Resample Rate";
+		np.defaultValues[0] = 60.0;
+		np.minValues[0] = 1.0;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 1.0;
+		np.maxSliders[0] = 1000.0;
+
+		OP_ParAppendResult res = myParameters.appendFloat(manager, np, &myPars.resampleRate);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// filter every output channel of the input branch
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Filter";
+		sp.label = "Filter";
+
+		sp.defaultValue = "Off";
+
+		const char *names[] = { "Off", "Lowpass", "Highpass", "Bandpass", "Notch" };
+		const char *labels[] = { "Off", "Low Pass", "High Pass", "Band Pass", "Notch" };
 
-		OP_ParAppendResult res = manager->appendMenu(sp, 3, names, labels);
+		OP_ParAppendResult res = myParameters.appendMenu(manager, sp, 5, names, labels, &myPars.filter);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// cutoff or center frequency of the filter
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Filterfreq";
+		np.label = "Filter Frequency (Hz)";
+		np.defaultValues[0] = 10.0;
+		np.minValues[0] = 0.0;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 1000.0;
+
+		OP_ParAppendResult res = myParameters.appendFloat(manager, np, &myPars.filterFreq);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// resonance of the filter, or the width of a band pass or notch
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Filterq";
+		np.label = "Filter Q";
+		np.defaultValues[0] = 0.707;
+		np.minValues[0] = 0.01;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 0.1;
+		np.maxSliders[0] = 10.0;
+
+		OP_ParAppendResult res = myParameters.appendFloat(manager, np, &myPars.filterQ);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// biquads in a row, each one makes the filter steeper
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Filterstages";
+		np.label = "Filter Stages";
+		np.defaultValues[0] = 1;
+		np.minValues[0] = 1;
+		np.maxValues[0] = BiquadBank::MaxStages;
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+		np.minSliders[0] = 1;
+		np.maxSliders[0] = BiquadBank::MaxStages;
+
+		OP_ParAppendResult res = myParameters.appendInt(manager, np, &myPars.filterStages);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// frequency and Q of each channel, one row per channel
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Filterdat";
+		sp.label = "Filter DAT";
+
+		OP_ParAppendResult res = myParameters.appendDAT(manager, sp, &myPars.filterDAT);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// output the spectrum of the first input instead of its samples
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Spectrum";
+		sp.label = "Spectrum";
+
+		sp.defaultValue = "Off";
+
+		const char *names[] = { "Off", "Magnitude", "Phase", "Bands" };
+		const char *labels[] = { "Off", "Magnitude", "Phase", "Band Energy" };
+
+		OP_ParAppendResult res = myParameters.appendMenu(manager, sp, 4, names, labels, &myPars.spectrum);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// samples per FFT frame
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Fftsize";
+		sp.label = "FFT Size";
+
+		sp.defaultValue = "1024";
+
+		const char *names[] = { "128", "256", "512", "1024", "2048", "4096", "8192" };
+		const char *labels[] = { "128", "256", "512", "1024", "2048", "4096", "8192" };
+
+		OP_ParAppendResult res = myParameters.appendMenu(manager, sp, 7, names, labels, &myPars.fftSize);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// frames per FFT size, a new frame starts every size / overlap samples
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Overlap";
+		sp.label = "Overlap";
+
+		sp.defaultValue = "2";
+
+		const char *names[] = { "1", "2", "4", "8" };
+		const char *labels[] = { "None", "2x", "4x", "8x" };
+
+		OP_ParAppendResult res = myParameters.appendMenu(manager, sp, 4, names, labels, &myPars.overlap);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// frequency bands the bins are added up into
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Bands";
+		np.label = "Bands";
+		np.defaultValues[0] = 16;
+		np.minValues[0] = 1;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 1;
+		np.maxSliders[0] = 64;
+
+		OP_ParAppendResult res = myParameters.appendInt(manager, np, &myPars.bands);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// bands of equal width in Hz, or in octaves
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Bandspacing";
+		sp.label = "Band Spacing";
+
+		sp.defaultValue = "Log";
+
+		const char *names[] = { "Linear", "Log" };
+		const char *labels[] = { "Linear (Hz)", "Log (Octaves)" };
+
+		OP_ParAppendResult res = myParameters.appendMenu(manager, sp, 2, names, labels, &myPars.bandSpacing);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// lowest and highest frequency covered by the bands
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Bandrange";
+		np.label = "Band Range (Hz)";
+		np.defaultValues[0] = 20.0;
+		np.defaultValues[1] = 20000.0;
+		for (int i = 0; i < 2; i++)
+		{
+			np.minValues[i] = 0.0;
+			np.clampMins[i] = true;
+			np.minSliders[i] = 0.0;
+			np.maxSliders[i] = 24000.0;
+		}
+
+		OP_ParAppendResult res = myParameters.appendFloat(manager, np, myPars.bandRange, 2);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// render the generator ahead of time on another thread
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Async";
+		np.label = "Render Ahead on a Thread";
+		np.defaultValues[0] = 0;
+
+		OP_ParAppendResult res = myParameters.appendToggle(manager, np, &myPars.async);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// how far ahead, in samples
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Lookahead";
+		np.label = "Lookahead (Samples)";
+		np.defaultValues[0] = 512;
+		np.minValues[0] = 1;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 1;
+		np.maxSliders[0] = 8192;
+
+		OP_ParAppendResult res = myParameters.appendInt(manager, np, &myPars.lookahead);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// record the output to a file
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Record";
+		np.label = "Record";
+		np.defaultValues[0] = 0;
+
+		OP_ParAppendResult res = myParameters.appendToggle(manager, np, &myPars.record);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// the file to record to, overwritten when recording starts
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Recordfile";
+		sp.label = "Record File";
+
+		OP_ParAppendResult res = myParameters.appendFile(manager, sp, &myPars.recordFile);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// bypass the OS file cache while recording
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Recorddirect";
+		np.label = "Unbuffered Writes";
+		np.defaultValues[0] = 0;
+
+		OP_ParAppendResult res = myParameters.appendToggle(manager, np, &myPars.recordDirect);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// publish the output to shared memory for other processes
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Publish";
+		np.label = "Publish";
+		np.defaultValues[0] = 0;
+
+		OP_ParAppendResult res = myParameters.appendToggle(manager, np, &myPars.publish);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// the name of the shared memory, readers open it by this name
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Publishname";
+		sp.label = "Publish Name";
+		sp.defaultValue = "chop_output";
+
+		OP_ParAppendResult res = myParameters.appendString(manager, sp, &myPars.publishName);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// how many cooks the shared memory holds before the oldest is overwritten
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Publishslots";
+		np.label = "Publish Slots";
+		np.defaultValues[0] = SharedOutputPublisher::DefaultSlots;
+		np.minValues[0] = 2;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 2;
+		np.maxSliders[0] = 64;
+
+		OP_ParAppendResult res = myParameters.appendInt(manager, np, &myPars.publishSlots);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// play a recording back while no input is connected
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Play";
+		np.label = "Play";
+		np.defaultValues[0] = 0;
+
+		OP_ParAppendResult res = myParameters.appendToggle(manager, np, &myPars.play);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// a file written with "Record"
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Playfile";
+		sp.label = "Play File";
+
+		OP_ParAppendResult res = myParameters.appendFile(manager, sp, &myPars.playFile);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// how much of the file to read ahead of the play head
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Prefetch";
+		np.label = "Prefetch (MB)";
+		np.defaultValues[0] = 64;
+		np.minValues[0] = 1;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 1;
+		np.maxSliders[0] = 1024;
+
+		OP_ParAppendResult res = myParameters.appendInt(manager, np, &myPars.prefetchMB);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// a TOP to reduce to channels while no input is connected
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Top";
+		sp.label = "TOP";
+
+		OP_ParAppendResult res = myParameters.appendTOP(manager, sp, &myPars.top);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// what the TOP's image is reduced to
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Topreduce";
+		sp.label = "TOP Reduce To";
+
+		sp.defaultValue = "Rows";
+
+		const char *names[] = { "Rows", "Columns", "Histogram", "Regions" };
+		const char *labels[] = { "Row Averages", "Column Averages", "Luminance Histogram", "Region Averages" };
+
+		OP_ParAppendResult res = myParameters.appendMenu(manager, sp, 4, names, labels, &myPars.topReduce);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// how the TOP's pixels are downloaded
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Toppixels";
+		sp.label = "TOP Pixel Format";
+
+		sp.defaultValue = "Auto";
+
+		const char *names[] = { "Auto", "BGRA8Fixed", "R32Float", "RGBA32Float" };
+		const char *labels[] = { "Auto", "8-bit Fixed (BGRA)", "32-bit Float (Mono)", "32-bit Float (RGBA)" };
+
+		OP_ParAppendResult res = myParameters.appendMenu(manager, sp, 4, names, labels, &myPars.topPixels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// luminance histogram bins
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Topbins";
+		np.label = "Histogram Bins";
+		np.defaultValues[0] = 64;
+		np.minValues[0] = 1;
+		np.clampMins[0] = true;
+		np.minSliders[0] = 1;
+		np.maxSliders[0] = 256;
+
+		OP_ParAppendResult res = myParameters.appendInt(manager, np, &myPars.topBins);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// regions to average, one per row as name, u, v, width, height
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Regiondat";
+		sp.label = "Region DAT";
+
+		OP_ParAppendResult res = myParameters.appendDAT(manager, sp, &myPars.regionDAT);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// reuse the last output when nothing has changed
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Cache";
+		np.label = "Reuse Unchanged Output";
+		np.defaultValues[0] = 1;
+
+		OP_ParAppendResult res = myParameters.appendToggle(manager, np, &myPars.cache);
 		assert(res == OP_ParAppendResult::Success);
 	}
 
@@ -552,7 +2190,42 @@ CPlusPlusCHOPExample::setupParameters(OP_ParameterManager* manager)
 		np.name = "Reset";
 		np.label = "Reset";
 		
-		OP_ParAppendResult res = manager->appendPulse(np);
+		OP_ParAppendResult res = myParameters.appendPulse(manager, np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// where the Cue pulse jumps the generator to, in the units of the "offset" Info channel
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Cuephase";
+		np.label = "Cue Phase";
+		np.defaultValues[0] = 0.0;
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 10.0;
+
+		OP_ParAppendResult res = myParameters.appendFloat(manager, np, &myPars.cuePhase);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Cue";
+		np.label = "Cue";
+
+		OP_ParAppendResult res = myParameters.appendPulse(manager, np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// clears the cook times shown in the Info CHOP
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Resetstats";
+		np.label = "Reset Stats";
+
+		OP_ParAppendResult res = myParameters.appendPulse(manager, np);
 		assert(res == OP_ParAppendResult::Success);
 	}
 
@@ -562,9 +2235,19 @@ CPlusPlusCHOPExample::setupParameters(OP_ParameterManager* manager)
 void 
 CPlusPlusCHOPExample::pulsePressed(const char* name)
 {
+	//		<<LearnC++>>  A pulse can arrive while worker threads are still busy with the generator, so it doesn't touch the phase
+	//		itself. It's queued as an event for the sample being played right now and the next cook applies it there. myPars
+	//		still holds the last cook's parameters, so the Cue doesn't take "Cuephase" along, the cook reads it when it applies it.
 	if (!strcmp(name, "Reset"))
+		myEvents.push(EventQueue::Kind::Reset, myEvents.now());
+
+	if (!strcmp(name, "Cue"))
+		myEvents.push(EventQueue::Kind::Cue, myEvents.now());
+
+	if (!strcmp(name, "Resetstats"))
 	{
-		myOffset = 0.0;
+		myProfiler.reset();
+		myInfoTableCook = -1;
 	}
 }
 
@@ -60,19 +60,70 @@
 */
 
 #include "CHOP_CPlusPlusBase.h"
+#include "AsyncGenerator.h"
+#include "BiquadBank.h"
+#include "ChannelNamePool.h"
+#include "ChannelRecorder.h"
+#include "ChannelRouter.h"
+#include "CookCache.h"
+#include "CookProfiler.h"
+#include "EventQueue.h"
+#include "InfoTable.h"
+#include "InputMixer.h"
+#include "OscillatorBank.h"
+#include "ParameterRegistry.h"
+#include "RecordingPlayer.h"
+#include "ScratchArena.h"
+#include "SharedOutputPublisher.h"
+#include "SpectrumAnalyzer.h"
+#include "ThreadPool.h"
+#include "TopReducer.h"
+
+#include <atomic>
+#include <memory>
 
 /*
-This example file implements a class that does 2 different things depending on
-if a CHOP is connected to the CPlusPlus CHOPs input or not.
+This example file implements a class that does 5 different things depending on
+if a CHOP is connected to the CPlusPlus CHOPs input or not, and on the "Play"
+and "TOP" parameters.
 The example is timesliced, which is the more complex way of working.
 
 If an input is connected the node will output the same number of channels as the
-input and divide the first 'N' samples in the input channel by 2. 'N' being the current
-timeslice size. This is noteworthy because if the input isn't changing then the output
-will look wierd since depending on the timeslice size some number of the first samples
-of the input will get used.
+input, multiplied by the Scale parameter. The input's samples are matched to the
+output by their index on the timeline (see InputRing.h), so the output is the same
+stretch of time as the input even when a cook covers several frames. An input that
+isn't changing just holds its value.
+With the "Mix" parameter set to Sum or Weighted Average every connected input is
+mixed together instead, each with its own gain (see InputMixer.h). Set to Route,
+the first input's channels are routed to output channels listed in a DAT, each
+output the sum of any number of inputs with their own gains (see ChannelRouter.h).
+With "Resample" on, the output runs at "Resample Rate" and every input is
+filtered and resampled to it, 1 kHz sensors into a 60 Hz network for example
+(see Resampler.h).
+The "Filter" parameter then runs every output channel through a chain of
+low-pass, high-pass, band-pass or notch filters (see BiquadBank.h).
+
+If an input is connected and "Spectrum" is on, the node outputs the spectrum of
+every channel of the first input instead: the magnitude or phase of every FFT
+bin, or the energy in a set of frequency bands, one sample per FFT frame (see
+SpectrumAnalyzer.h).
+
+With "Publish" on, every cook's output is also put in shared memory for other
+programs on the same machine to read (see SharedOutputPublisher.h).
+
+If no input is connected and "Play" is on, the node plays back a file written
+with "Record", straight from the file on disk (see RecordingPlayer.h).
+
+If no input is connected and a TOP is set in the "TOP" parameter, the node
+reduces the TOP's image to channels: the average of every row or column, a
+luminance histogram or the average color of regions listed in a DAT (see
+TopReducer.h).
 
 If no input is connected then the node will output a smooth sine wave at 120hz.
+Its channels are named by the "Channel Names" pattern, sensor[0-63] for
+example, or by the rows of the "Name DAT" (see ChannelNamePool.h).
+"Reset" puts its phase back to 0 and "Cue" jumps it to "Cue Phase", both at
+the sample that was playing when they were pressed (see EventQueue.h).
 */
 
 
@@ -173,6 +224,12 @@ public:
 											OP_InfoDATEntries* entries) override;
 
 
+	//	<<LearnC++>>
+	//	This function is called near the end of the cook. Returning a string puts the node into a warning state.
+	//	For more information refer to line 314 in "CHOP_CPlusPlusBase.h"
+	virtual const char*	getWarningString() override;
+
+
 	//	<<LearnC++>> 
 	//	Set up custom paramters that can be accessed within the execute call.  
 	//	For more information refer to line 336 in "CPlusPlusCHOPExample.h"
@@ -193,6 +250,40 @@ public:
 */
 private:
 
+	// Fills myInfoTable with the cook profile, see getInfoDATSize()
+	void					buildInfoTable();
+
+	// Opens or closes myPlayer to match the "Play" parameters. True if
+	// there's a recording to play.
+	bool					updatePlayer();
+
+	// Which branch of execute() the last cook took: passing on the inputs,
+	// generating, playing a recording, reducing a TOP or analyzing the
+	// spectrum
+	enum class Branch
+	{
+		Unknown,
+		Input,
+		Generator,
+		Playback,
+		Top,
+		Spectrum
+	};
+
+	// Enables the parameters 'branch' uses and disables the rest of the
+	// branch specific ones, see the table in the .cpp
+	void					enableBranchPars(OP_Inputs* inputs, Branch branch);
+
+	// Changes the generator the way 'event' says, see EventQueue.h
+	void					applyEvent(const EventQueue::Event& event);
+
+	// Renders the generator's samples [first, first + numSamples) of this
+	// cook with the current myStep and myShape, and moves myOffset past them
+	void					renderGenerator(const CHOP_Output* output, int32_t first,
+											int32_t numSamples, double spread, float scale,
+											bool cacheable, int32_t grain, int32_t threads,
+											std::atomic<int32_t>& reused);
+
 	// We don't need to store this pointer, but we do for the example.
 	// The OP_NodeInfo class store information about the node that's using
 	// this instance of the class (like its name).
@@ -203,7 +294,178 @@ private:
 	int32_t					 myExecuteCount;
 
 
-	double					 myOffset;
+	// The generator's phase, fixed point like OscillatorBank's phases
+	int64_t					 myOffset;
+
+	// The generator's step and shape as of the last event applied. "Speed"
+	// and "Shape" only get here through myEvents.
+	int64_t					 myStep;
+	int32_t					 myShape;
 
+	// Pulses and parameter changes waiting for the sample they take effect
+	// at. Pushed from any thread, collected at the start of each cook.
+	EventQueue				 myEvents;
+
+	// Set during execute() when something needs the user's attention,
+	// returned from getWarningString()
+	const char*				 myWarning;
+
+	// One phase accumulator per generated channel, used when no input is
+	// connected.
+	OscillatorBank			 myOscillators;
+
+	// Worker threads shared with every other instance, used to split the
+	// channel loops across cores
+	std::shared_ptr<ThreadPool>	 myThreadPool;
+
+	//	<<LearnC++>>
+	//	The value of every parameter for the current cook. myParameters fills these in once per cook, so the rest of
+	//	the code reads plain members instead of asking TouchDesigner for each parameter by name.
+	struct Parameters
+	{
+		double				speed;
+		double				cuePhase;
+		double				scale;
+		int32_t				shape;
+		const OP_DATInput*	tableDAT;
+		int32_t				channels;
+		std::string			channelNames;
+		const OP_DATInput*	nameDAT;
+		int32_t				threads;
+		int32_t				minWork;
+		bool				cache;
+		int32_t				mix;
+		double				gains[4];
+		int32_t				match;
+		const OP_DATInput*	routeDAT;
+		bool				resample;
+		double				resampleRate;
+		int32_t				filter;
+		double				filterFreq;
+		double				filterQ;
+		int32_t				filterStages;
+		const OP_DATInput*	filterDAT;
+		int32_t				spectrum;
+		int32_t				fftSize;
+		int32_t				overlap;
+		int32_t				bands;
+		int32_t				bandSpacing;
+		double				bandRange[2];
+		bool				async;
+		int32_t				lookahead;
+		bool				record;
+		std::string			recordFile;
+		bool				recordDirect;
+		bool				publish;
+		std::string			publishName;
+		int32_t				publishSlots;
+		bool				play;
+		std::string			playFile;
+		int32_t				prefetchMB;
+		const OP_TOPInput*	top;
+		int32_t				topReduce;
+		int32_t				topPixels;
+		int32_t				topBins;
+		const OP_DATInput*	regionDAT;
+	};
+
+	Parameters				 myPars;
+	ParameterRegistry		 myParameters;
+
+	// True when getOutputInfo() already fetched the parameters this cook
+	bool					 myParsFetched;
+
+	// The branch of the last cook and whether the parameters that depend
+	// on other parameters are enabled, so enablePar() is only called when
+	// they change. -1 (and Branch::Unknown) is unknown.
+	Branch					 myBranch;
+	int32_t					 myTableDATEnabled;
+	int32_t					 myMixParsEnabled;
+	int32_t					 myLookaheadEnabled;
+	int32_t					 myRegionDATEnabled;
+	int32_t					 myRouteDATEnabled;
+	int32_t					 myResampleRateEnabled;
+	int32_t					 myFilterParsEnabled;
+	int32_t					 myBandParsEnabled;
+
+	// The last output, reused when a cook's inputs and parameters are the
+	// same as the one before
+	CookCache				 myCache;
+
+	// Lines up and mixes the inputs, see InputMixer.h
+	InputMixer				 myMixer;
+
+	// The routes of the "Route" mix. myRouting is set by getOutputInfo()
+	// when this cook routes the input.
+	ChannelRouter			 myRouter;
+	bool					 myRouting;
+
+	// The "Filter" stage of the input branch
+	BiquadBank				 myFilters;
+
+	// The spectrum of the first input. myAnalyzing is set by getOutputInfo()
+	// when this cook outputs it.
+	SpectrumAnalyzer		 mySpectrum;
+	bool					 myAnalyzing;
+
+	// Renders the generator ahead of time on its own thread when "Async" is
+	// on. myOscillators is only used for what it couldn't render in time.
+	AsyncGenerator			 myAsync;
+	bool					 myAsyncUsed;
+	std::vector<float*>		 myRemainder;
+
+	// Writes the output to "Record File" while "Record" is on. myRecordFailed
+	// stops a file that can't be created from being tried again every cook.
+	ChannelRecorder			 myRecorder;
+	bool					 myRecordFailed;
+
+	// Puts the output in shared memory while "Publish" is on. myPublishFailed
+	// stops a name that can't be used from being tried again every cook.
+	SharedOutputPublisher	 myPublisher;
+	bool					 myPublishFailed;
+
+	// The recording played while "Play" is on. myPlaying is set by
+	// getOutputInfo() when this cook plays it, myPlayFailed stops a file
+	// that can't be opened from being tried again every cook.
+	RecordingPlayer			 myPlayer;
+	bool					 myPlaying;
+	bool					 myPlayFailed;
+
+	// Reduces the "TOP" parameter's image to channels. myReducing is set by
+	// getOutputInfo() when this cook does.
+	TopReducer				 myTopReducer;
+	bool					 myReducing;
+
+	// The input the output's channels are named after when mixing, only
+	// valid during a cook
+	const OP_CHOPInput*		 myNameSource;
+
+	// The generator's channel names, from "Channel Names" or "Name DAT".
+	// myGenerating is set by getOutputInfo() when this cook uses them.
+	ChannelNamePool			 myChannelNames;
+	bool					 myGenerating;
+
+	// Where the stages' temporary buffers come from, reset every cook
+	ScratchArena			 myArena;
+
+	// How long each cook, and each stage of it, takes. Shown in the Info CHOP.
+	CookProfiler			 myProfiler;
+	CookProfiler::Stage		 myParametersStage;
+	CookProfiler::Stage		 myPrepareStage;
+	CookProfiler::Stage		 myAppendStage;
+	CookProfiler::Stage		 myMixStage;
+	CookProfiler::Stage		 myRouteStage;
+	CookProfiler::Stage		 myFilterStage;
+	CookProfiler::Stage		 mySpectrumStage;
+	CookProfiler::Stage		 myTableStage;
+	CookProfiler::Stage		 myRenderStage;
+	CookProfiler::Stage		 myRecordStage;
+	CookProfiler::Stage		 myPublishStage;
+	CookProfiler::Stage		 myPlayStage;
+	CookProfiler::Stage		 myTopStage;
+
+	// The Info DAT, and the execute count it was built for. -1 rebuilds it.
+	InfoTable				 myInfoTable;
+	int32_t					 myInfoTableCook;
 
 };
@@ -0,0 +1,430 @@
+#include "ChannelKernels.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef CK_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#endif
+#endif
+
+
+// ----------------------------------------------------------------------------
+// Scalar versions, used on non-x86 builds and for the tails of the SIMD loops
+// ----------------------------------------------------------------------------
+
+static void
+scaleScalar(float* dst, const float* src, int32_t n, float scale)
+{
+	for (int32_t i = 0; i < n; i++)
+		dst[i] = src[i] * scale;
+}
+
+static void
+scaleOffsetScalar(float* dst, const float* src, int32_t n, float scale, float offset)
+{
+	for (int32_t i = 0; i < n; i++)
+		dst[i] = src[i] * scale + offset;
+}
+
+static void
+clampScalar(float* dst, const float* src, int32_t n, float lo, float hi)
+{
+	for (int32_t i = 0; i < n; i++)
+	{
+		float v = src[i] < lo ? lo : src[i];
+		dst[i] = v > hi ? hi : v;
+	}
+}
+
+static void
+mulAddScalar(float* dst, const float* src, int32_t n, float gain)
+{
+	for (int32_t i = 0; i < n; i++)
+		dst[i] += src[i] * gain;
+}
+
+static void
+mixScalar(float* dst, const float* const* srcs, const float* gains, int32_t numSrcs,
+		  int32_t n, int32_t offset)
+{
+	for (int32_t i = offset; i < n; i++)
+	{
+		float acc = 0.0f;
+		for (int32_t k = 0; k < numSrcs; k++)
+			acc += srcs[k][i] * gains[k];
+		dst[i] = acc;
+	}
+}
+
+static void
+mixScalar(float* dst, const float* const* srcs, const float* gains, int32_t numSrcs,
+		  int32_t n)
+{
+	mixScalar(dst, srcs, gains, numSrcs, n, 0);
+}
+
+
+#ifdef CK_X86
+
+// ----------------------------------------------------------------------------
+// SSE2, 4 samples at a time
+// ----------------------------------------------------------------------------
+
+static void
+scaleSSE2(float* dst, const float* src, int32_t n, float scale)
+{
+	__m128 s = _mm_set1_ps(scale);
+	int32_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(src + i), s));
+	scaleScalar(dst + i, src + i, n - i, scale);
+}
+
+static void
+scaleOffsetSSE2(float* dst, const float* src, int32_t n, float scale, float offset)
+{
+	__m128 s = _mm_set1_ps(scale);
+	__m128 o = _mm_set1_ps(offset);
+	int32_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i), s), o));
+	scaleOffsetScalar(dst + i, src + i, n - i, scale, offset);
+}
+
+static void
+clampSSE2(float* dst, const float* src, int32_t n, float lo, float hi)
+{
+	__m128 l = _mm_set1_ps(lo);
+	__m128 h = _mm_set1_ps(hi);
+	int32_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(dst + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), l), h));
+	clampScalar(dst + i, src + i, n - i, lo, hi);
+}
+
+static void
+mulAddSSE2(float* dst, const float* src, int32_t n, float gain)
+{
+	__m128 g = _mm_set1_ps(gain);
+	int32_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 d = _mm_loadu_ps(dst + i);
+		_mm_storeu_ps(dst + i, _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+	}
+	mulAddScalar(dst + i, src + i, n - i, gain);
+}
+
+static void
+mixSSE2(float* dst, const float* const* srcs, const float* gains, int32_t numSrcs,
+		int32_t n)
+{
+	int32_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 acc = _mm_setzero_ps();
+		for (int32_t k = 0; k < numSrcs; k++)
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(srcs[k] + i), _mm_set1_ps(gains[k])));
+		_mm_storeu_ps(dst + i, acc);
+	}
+	mixScalar(dst, srcs, gains, numSrcs, n, i);
+}
+
+
+// ----------------------------------------------------------------------------
+// AVX2, 8 samples at a time, unrolled by two so there are two independent
+// load/multiply/store chains in flight.
+// ----------------------------------------------------------------------------
+
+CK_TARGET("avx2,fma") static void
+scaleAVX2(float* dst, const float* src, int32_t n, float scale)
+{
+	__m256 s = _mm256_set1_ps(scale);
+	int32_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		__m256 a = _mm256_loadu_ps(src + i);
+		__m256 b = _mm256_loadu_ps(src + i + 8);
+		_mm256_storeu_ps(dst + i, _mm256_mul_ps(a, s));
+		_mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(b, s));
+	}
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(src + i), s));
+	scaleScalar(dst + i, src + i, n - i, scale);
+}
+
+CK_TARGET("avx2,fma") static void
+scaleOffsetAVX2(float* dst, const float* src, int32_t n, float scale, float offset)
+{
+	__m256 s = _mm256_set1_ps(scale);
+	__m256 o = _mm256_set1_ps(offset);
+	int32_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		__m256 a = _mm256_loadu_ps(src + i);
+		__m256 b = _mm256_loadu_ps(src + i + 8);
+		_mm256_storeu_ps(dst + i, _mm256_fmadd_ps(a, s, o));
+		_mm256_storeu_ps(dst + i + 8, _mm256_fmadd_ps(b, s, o));
+	}
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(dst + i, _mm256_fmadd_ps(_mm256_loadu_ps(src + i), s, o));
+	scaleOffsetScalar(dst + i, src + i, n - i, scale, offset);
+}
+
+CK_TARGET("avx2,fma") static void
+clampAVX2(float* dst, const float* src, int32_t n, float lo, float hi)
+{
+	__m256 l = _mm256_set1_ps(lo);
+	__m256 h = _mm256_set1_ps(hi);
+	int32_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(dst + i, _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), l), h));
+	clampScalar(dst + i, src + i, n - i, lo, hi);
+}
+
+CK_TARGET("avx2,fma") static void
+mulAddAVX2(float* dst, const float* src, int32_t n, float gain)
+{
+	__m256 g = _mm256_set1_ps(gain);
+	int32_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 d = _mm256_loadu_ps(dst + i);
+		_mm256_storeu_ps(dst + i, _mm256_fmadd_ps(_mm256_loadu_ps(src + i), g, d));
+	}
+	mulAddScalar(dst + i, src + i, n - i, gain);
+}
+
+CK_TARGET("avx2,fma") static void
+mixAVX2(float* dst, const float* const* srcs, const float* gains, int32_t numSrcs,
+		int32_t n)
+{
+	// Two vectors per pass so each source's load and FMA overlap with the
+	// other's
+	int32_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		__m256 a0 = _mm256_setzero_ps();
+		__m256 a1 = _mm256_setzero_ps();
+		for (int32_t k = 0; k < numSrcs; k++)
+		{
+			__m256 g = _mm256_set1_ps(gains[k]);
+			a0 = _mm256_fmadd_ps(_mm256_loadu_ps(srcs[k] + i), g, a0);
+			a1 = _mm256_fmadd_ps(_mm256_loadu_ps(srcs[k] + i + 8), g, a1);
+		}
+		_mm256_storeu_ps(dst + i, a0);
+		_mm256_storeu_ps(dst + i + 8, a1);
+	}
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 a0 = _mm256_setzero_ps();
+		for (int32_t k = 0; k < numSrcs; k++)
+			a0 = _mm256_fmadd_ps(_mm256_loadu_ps(srcs[k] + i), _mm256_set1_ps(gains[k]), a0);
+		_mm256_storeu_ps(dst + i, a0);
+	}
+	mixScalar(dst, srcs, gains, numSrcs, n, i);
+}
+
+
+// ----------------------------------------------------------------------------
+// AVX-512, 16 samples at a time. The tail is done with a masked load/store
+// instead of falling back to scalar code.
+// ----------------------------------------------------------------------------
+
+CK_TARGET("avx512f") static void
+scaleAVX512(float* dst, const float* src, int32_t n, float scale)
+{
+	__m512 s = _mm512_set1_ps(scale);
+	int32_t i = 0;
+	for (; i + 16 <= n; i += 16)
+		_mm512_storeu_ps(dst + i, _mm512_mul_ps(_mm512_loadu_ps(src + i), s));
+	if (i < n)
+	{
+		__mmask16 m = (__mmask16)((1u << (n - i)) - 1);
+		_mm512_mask_storeu_ps(dst + i, m, _mm512_mul_ps(_mm512_maskz_loadu_ps(m, src + i), s));
+	}
+}
+
+CK_TARGET("avx512f") static void
+scaleOffsetAVX512(float* dst, const float* src, int32_t n, float scale, float offset)
+{
+	__m512 s = _mm512_set1_ps(scale);
+	__m512 o = _mm512_set1_ps(offset);
+	int32_t i = 0;
+	for (; i + 16 <= n; i += 16)
+		_mm512_storeu_ps(dst + i, _mm512_fmadd_ps(_mm512_loadu_ps(src + i), s, o));
+	if (i < n)
+	{
+		__mmask16 m = (__mmask16)((1u << (n - i)) - 1);
+		_mm512_mask_storeu_ps(dst + i, m,
+							  _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, src + i), s, o));
+	}
+}
+
+CK_TARGET("avx512f") static void
+clampAVX512(float* dst, const float* src, int32_t n, float lo, float hi)
+{
+	__m512 l = _mm512_set1_ps(lo);
+	__m512 h = _mm512_set1_ps(hi);
+	int32_t i = 0;
+	for (; i + 16 <= n; i += 16)
+		_mm512_storeu_ps(dst + i, _mm512_min_ps(_mm512_max_ps(_mm512_loadu_ps(src + i), l), h));
+	if (i < n)
+	{
+		__mmask16 m = (__mmask16)((1u << (n - i)) - 1);
+		__m512 v = _mm512_maskz_loadu_ps(m, src + i);
+		_mm512_mask_storeu_ps(dst + i, m, _mm512_min_ps(_mm512_max_ps(v, l), h));
+	}
+}
+
+CK_TARGET("avx512f") static void
+mulAddAVX512(float* dst, const float* src, int32_t n, float gain)
+{
+	__m512 g = _mm512_set1_ps(gain);
+	int32_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		__m512 d = _mm512_loadu_ps(dst + i);
+		_mm512_storeu_ps(dst + i, _mm512_fmadd_ps(_mm512_loadu_ps(src + i), g, d));
+	}
+	if (i < n)
+	{
+		__mmask16 m = (__mmask16)((1u << (n - i)) - 1);
+		__m512 d = _mm512_maskz_loadu_ps(m, dst + i);
+		_mm512_mask_storeu_ps(dst + i, m,
+							  _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, src + i), g, d));
+	}
+}
+
+CK_TARGET("avx512f") static void
+mixAVX512(float* dst, const float* const* srcs, const float* gains, int32_t numSrcs,
+		  int32_t n)
+{
+	int32_t i = 0;
+	for (; i + 32 <= n; i += 32)
+	{
+		__m512 a0 = _mm512_setzero_ps();
+		__m512 a1 = _mm512_setzero_ps();
+		for (int32_t k = 0; k < numSrcs; k++)
+		{
+			__m512 g = _mm512_set1_ps(gains[k]);
+			a0 = _mm512_fmadd_ps(_mm512_loadu_ps(srcs[k] + i), g, a0);
+			a1 = _mm512_fmadd_ps(_mm512_loadu_ps(srcs[k] + i + 16), g, a1);
+		}
+		_mm512_storeu_ps(dst + i, a0);
+		_mm512_storeu_ps(dst + i + 16, a1);
+	}
+	for (; i < n; i += 16)
+	{
+		__mmask16 m = n - i >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - i)) - 1);
+		__m512 a0 = _mm512_setzero_ps();
+		for (int32_t k = 0; k < numSrcs; k++)
+			a0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, srcs[k] + i), _mm512_set1_ps(gains[k]), a0);
+		_mm512_mask_storeu_ps(dst + i, m, a0);
+	}
+}
+
+#endif // CK_X86
+
+
+// ----------------------------------------------------------------------------
+// Dispatch
+// ----------------------------------------------------------------------------
+
+static const ChannelKernels theKernels[] =
+{
+	{ CPUFeatureLevel::Scalar, "scalar",
+	  scaleScalar, scaleOffsetScalar, clampScalar, mulAddScalar, mixScalar },
+#ifdef CK_X86
+	{ CPUFeatureLevel::SSE2, "sse2",
+	  scaleSSE2, scaleOffsetSSE2, clampSSE2, mulAddSSE2, mixSSE2 },
+	{ CPUFeatureLevel::AVX2, "avx2",
+	  scaleAVX2, scaleOffsetAVX2, clampAVX2, mulAddAVX2, mixAVX2 },
+	{ CPUFeatureLevel::AVX512, "avx512",
+	  scaleAVX512, scaleOffsetAVX512, clampAVX512, mulAddAVX512, mixAVX512 },
+#endif
+};
+
+CPUFeatureLevel
+ChannelKernels::detectLevel()
+{
+#ifndef CK_X86
+	return CPUFeatureLevel::Scalar;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	bool sse2 = (info[3] & (1 << 26)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	bool fma = (info[2] & (1 << 12)) != 0;
+	unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+
+	bool avx2 = false;
+	bool avx512 = false;
+	if (maxLeaf >= 7)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+		avx512 = (info[1] & (1 << 16)) != 0;
+	}
+
+	if (avx512 && (xcr0 & 0xE6) == 0xE6)
+		return CPUFeatureLevel::AVX512;
+	if (avx && avx2 && fma && (xcr0 & 0x6) == 0x6)
+		return CPUFeatureLevel::AVX2;
+	return sse2 ? CPUFeatureLevel::SSE2 : CPUFeatureLevel::Scalar;
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return CPUFeatureLevel::AVX512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return CPUFeatureLevel::AVX2;
+	if (__builtin_cpu_supports("sse2"))
+		return CPUFeatureLevel::SSE2;
+	return CPUFeatureLevel::Scalar;
+#endif
+}
+
+const ChannelKernels&
+ChannelKernels::forLevel(CPUFeatureLevel level)
+{
+	static const CPUFeatureLevel supported = detectLevel();
+	if (level > supported)
+		level = supported;
+
+	const int count = int(sizeof(theKernels) / sizeof(theKernels[0]));
+	for (int i = count - 1; i > 0; i--)
+	{
+		if (theKernels[i].level <= level)
+			return theKernels[i];
+	}
+	return theKernels[0];
+}
+
+const ChannelKernels&
+ChannelKernels::get()
+{
+	// The level can be capped with the CHOP_KERNEL_LEVEL environment variable
+	// (scalar, sse2, avx2 or avx512), which is handy for comparing them.
+	static const ChannelKernels& selected = []() -> const ChannelKernels&
+	{
+		CPUFeatureLevel level = detectLevel();
+		const char* env = getenv("CHOP_KERNEL_LEVEL");
+		if (env)
+		{
+			for (const ChannelKernels& k : theKernels)
+			{
+				if (!strcmp(env, k.name))
+					level = k.level;
+			}
+		}
+		return forLevel(level);
+	}();
+	return selected;
+}
@@ -0,0 +1,82 @@
+/*
+	Vectorized kernels for processing a block of contiguous channel samples.
+
+	Each kernel is compiled for several instruction sets (plain C++, SSE2, AVX2
+	and AVX-512) and the best one the CPU supports is picked the first time
+	ChannelKernels::get() is called. Call sites just grab the table once per
+	cook and call through the function pointers:
+
+		const ChannelKernels& k = ChannelKernels::get();
+		k.scale(dst, src, n, 0.5f);
+
+	All kernels are safe to call with dst == src (in place), and with any
+	alignment or length.
+*/
+
+#ifndef __ChannelKernels__
+#define __ChannelKernels__
+
+#include <stdint.h>
+
+// Other kernel files use these to compile a function for a specific
+// instruction set. CK_X86 is defined on x86/x64 builds only; everywhere else
+// just the scalar kernels are built.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define CK_X86 1
+#endif
+
+// GCC and Clang need to be told a function may use a newer instruction set
+// than the rest of the file is compiled for. MSVC lets any function use any
+// intrinsic, so there it expands to nothing.
+#if defined(_MSC_VER)
+	#define CK_TARGET(isa)
+#else
+	#define CK_TARGET(isa)	__attribute__((target(isa)))
+#endif
+
+enum class CPUFeatureLevel : int32_t
+{
+	Scalar = 0,
+	SSE2,
+	AVX2,
+	AVX512,
+};
+
+
+class ChannelKernels
+{
+public:
+	// The kernels for the best instruction set this CPU supports
+	static const ChannelKernels&	get();
+
+	// The kernels for a specific level. Asking for a level the CPU doesn't
+	// support returns the best supported level below it.
+	static const ChannelKernels&	forLevel(CPUFeatureLevel level);
+
+	// Highest level supported by this CPU (and this build)
+	static CPUFeatureLevel			detectLevel();
+
+	CPUFeatureLevel		level;
+	const char*			name;
+
+	// dst[i] = src[i] * scale
+	void	(*scale)(float* dst, const float* src, int32_t n, float scale);
+
+	// dst[i] = src[i] * scale + offset
+	void	(*scaleOffset)(float* dst, const float* src, int32_t n, float scale,
+						   float offset);
+
+	// dst[i] = min(max(src[i], lo), hi)
+	void	(*clamp)(float* dst, const float* src, int32_t n, float lo, float hi);
+
+	// dst[i] += src[i] * gain
+	void	(*mulAdd)(float* dst, const float* src, int32_t n, float gain);
+
+	// dst[i] = srcs[0][i] * gains[0] + srcs[1][i] * gains[1] + ...
+	// All the sources are summed in registers in one pass over dst, so there
+	// are no temporaries however many there are. dst may be one of srcs.
+	void	(*mix)(float* dst, const float* const* srcs, const float* gains,
+				   int32_t numSrcs, int32_t n);
+};
+
+#endif
@@ -0,0 +1,257 @@
+#include "ChannelNamePool.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// One part of a name in a pattern: text that's copied as it is, or the
+// choices of a part in brackets
+struct NamePart
+{
+	std::string		text;
+
+	// For a part in brackets, how many choices it has
+	int64_t			choices;
+
+	// A range of numbers, first to last either way, padded with zeros to
+	// 'width' digits when the first one was written with leading zeros
+	bool			numeric;
+	int64_t			first;
+	int64_t			step;
+	int32_t			width;
+};
+
+static bool
+parseNumber(const char* s, const char* end, int64_t& value)
+{
+	if (s == end || end - s > 18)
+		return false;
+	value = 0;
+	for (; s < end; s++)
+	{
+		if (*s < '0' || *s > '9')
+			return false;
+		value = value * 10 + (*s - '0');
+	}
+	return true;
+}
+
+// What's between '[' and ']': "0-4095", "001-128", "a-f" or "xyz"
+static NamePart
+parseBrackets(const char* s, const char* end)
+{
+	NamePart part;
+	part.choices = 0;
+	part.numeric = false;
+	part.first = 0;
+	part.step = 1;
+	part.width = 0;
+
+	const char* dash = s < end ? (const char*)memchr(s + 1, '-', end - s - 1) : nullptr;
+	int64_t a, b;
+	if (dash && parseNumber(s, dash, a) && parseNumber(dash + 1, end, b))
+	{
+		part.numeric = true;
+		part.first = a;
+		part.step = a <= b ? 1 : -1;
+		part.choices = (a <= b ? b - a : a - b) + 1;
+		if (*s == '0' && dash - s > 1)
+			part.width = (int32_t)(dash - s);
+		return part;
+	}
+
+	// A range of characters, or every character listed
+	if (end - s == 3 && s[1] == '-')
+	{
+		for (int32_t c = (unsigned char)s[0]; ; c += s[0] <= s[2] ? 1 : -1)
+		{
+			part.text.push_back((char)c);
+			if (c == (unsigned char)s[2])
+				break;
+		}
+	}
+	else
+	{
+		part.text.assign(s, end);
+	}
+	part.choices = (int64_t)part.text.size();
+	return part;
+}
+
+ChannelNamePool::ChannelNamePool() :
+	myCount(-1),
+	myFromDAT(false),
+	myBuilds(0)
+{
+}
+
+void
+ChannelNamePool::clear()
+{
+	myChars.clear();
+	myOffsets.clear();
+	myCount = -1;
+}
+
+ChannelNamePool&
+ChannelNamePool::start()
+{
+	// The block always ends with the 0 of the last name, appending goes
+	// in front of it
+	myOffsets.push_back((uint32_t)myChars.size());
+	myChars.push_back('\0');
+	return *this;
+}
+
+ChannelNamePool&
+ChannelNamePool::append(const char* text)
+{
+	size_t n = strlen(text);
+	myChars.insert(myChars.end() - 1, text, text + n);
+	return *this;
+}
+
+ChannelNamePool&
+ChannelNamePool::append(int64_t number)
+{
+	char digits[24];
+	snprintf(digits, sizeof(digits), "%lld", (long long)number);
+	return append(digits);
+}
+
+bool
+ChannelNamePool::update(const char* pattern, const OP_DATInput* dat, int32_t count)
+{
+	if (!pattern)
+		pattern = "";
+	if (count < 0)
+		count = 0;
+
+	// The snapshot has to see every cook's DAT, even when the pattern is
+	// what changed, or it would miss an edit made at the same time
+	bool datChanged = mySnapshot.update(dat, 1);
+	bool fromDAT = dat != nullptr;
+	if (count == myCount && fromDAT == myFromDAT && !datChanged &&
+		(fromDAT || myPattern == pattern))
+		return false;
+
+	myChars.clear();
+	myOffsets.clear();
+	myChars.reserve(size_t(count) * 12);
+	myOffsets.reserve(count);
+
+	if (fromDAT)
+	{
+		for (int32_t r = 0; r < dat->numRows && size() < count; r++)
+		{
+			const char* cell = dat->numCols > 0 ? dat->getCell(r, 0) : nullptr;
+			if (cell && *cell)
+				add(cell);
+			else
+				start().append("chan").append((int64_t)r + 1);
+		}
+	}
+	else
+	{
+		expand(pattern, count);
+	}
+	fill(count);
+
+	myPattern = pattern;
+	myCount = count;
+	myFromDAT = fromDAT;
+	myBuilds++;
+	return true;
+}
+
+void
+ChannelNamePool::expand(const char* pattern, int32_t count)
+{
+	std::vector<NamePart> parts;
+	std::vector<int64_t> counters;
+	char digits[24];
+
+	const char* p = pattern;
+	while (*p && size() < count)
+	{
+		// One space separated name at a time
+		while (*p == ' ' || *p == '\t')
+			p++;
+		const char* end = p;
+		while (*end && *end != ' ' && *end != '\t')
+			end++;
+		if (end == p)
+			break;
+
+		parts.clear();
+		std::string literal;
+		for (const char* s = p; s < end; )
+		{
+			const char* close = *s == '[' ? (const char*)memchr(s, ']', end - s) : nullptr;
+			if (!close || close == s + 1)
+			{
+				literal.push_back(*s++);
+				continue;
+			}
+			NamePart text;
+			text.text.swap(literal);
+			text.choices = 0;
+			parts.push_back(text);
+			parts.push_back(parseBrackets(s + 1, close));
+			s = close + 1;
+		}
+		NamePart text;
+		text.text.swap(literal);
+		text.choices = 0;
+		parts.push_back(text);
+		p = end;
+
+		// Counts through the choices like an odometer, the last part in
+		// brackets turning fastest
+		counters.assign(parts.size(), 0);
+		bool done = false;
+		while (!done && size() < count)
+		{
+			start();
+			for (size_t k = 0; k < parts.size(); k++)
+			{
+				const NamePart& part = parts[k];
+				if (part.choices == 0)
+				{
+					append(part.text.c_str());
+				}
+				else if (part.numeric)
+				{
+					snprintf(digits, sizeof(digits), "%0*lld", part.width,
+							 (long long)(part.first + part.step * counters[k]));
+					append(digits);
+				}
+				else
+				{
+					digits[0] = part.text[size_t(counters[k])];
+					digits[1] = '\0';
+					append(digits);
+				}
+			}
+
+			done = true;
+			for (size_t k = parts.size(); k-- > 0; )
+			{
+				if (parts[k].choices == 0)
+					continue;
+				if (++counters[k] < parts[k].choices)
+				{
+					done = false;
+					break;
+				}
+				counters[k] = 0;
+			}
+		}
+	}
+}
+
+void
+ChannelNamePool::fill(int32_t count)
+{
+	for (int32_t i = size(); i < count; i++)
+		start().append("chan").append((int64_t)i + 1);
+}
@@ -0,0 +1,82 @@
+/*
+	The names of a CHOP's output channels, kept one after the other in a
+	single block of characters.
+
+	getChannelName() is called once per channel every time the host lays
+	out the output, so with thousands of channels it has to be nothing more
+	than returning a pointer. The pool makes its names once and hands out
+	pointers into its block until they change.
+
+	The names can come from a pattern like the ones TouchDesigner uses for
+	channel names, where every part in brackets is expanded:
+		sensor[0-4095]		sensor0, sensor1 ... sensor4095
+		ch[001-128]			ch001, ch002 ... ch128
+		t[xyz] r[xyz]		tx, ty, tz, rx, ry, rz
+		pt[0-2][xy]			pt0x, pt0y, pt1x ... pt2y
+	Names are separated by spaces, and the last bracket of a name changes
+	fastest. Or the names come from the first column of a DAT, a name per
+	row. Either way channels past the last name get TouchDesigner's default
+	names, chan1, chan2 and so on, counting from the first channel.
+
+	Code that works out its own names (the spectrum, the TOP reduction) adds
+	them a piece at a time with start() and append() instead.
+*/
+
+#ifndef __ChannelNamePool__
+#define __ChannelNamePool__
+
+#include "CPlusPlus_Common.h"
+#include "DATSnapshot.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class ChannelNamePool
+{
+public:
+	ChannelNamePool();
+
+	// Makes 'count' names from 'dat' when it's set, otherwise from
+	// 'pattern'. Does nothing unless the pattern, the DAT's contents or the
+	// count changed since the last call. Returns true when the names were
+	// made again.
+	bool				update(const char* pattern, const OP_DATInput* dat, int32_t count);
+
+	int32_t				size() const { return (int32_t)myOffsets.size(); }
+	bool				empty() const { return myOffsets.empty(); }
+	const char*			name(int32_t i) const { return &myChars[myOffsets[i]]; }
+
+	// Removes every name, the next update() makes them again
+	void				clear();
+
+	// Starts a new name at the end of the pool, empty until append() adds
+	// to it. The pieces of a name are added in order:
+	//		names.start().append("row").append(i).append("_r");
+	ChannelNamePool&	start();
+	ChannelNamePool&	append(const char* text);
+	ChannelNamePool&	append(int64_t number);
+
+	// Adds a whole name
+	void				add(const char* name) { start().append(name); }
+
+	// Number of times update() made the names again
+	int64_t				builds() const { return myBuilds; }
+
+private:
+	void				expand(const char* pattern, int32_t count);
+	void				fill(int32_t count);
+
+	// Every name followed by a 0, and where each one starts
+	std::vector<char>		myChars;
+	std::vector<uint32_t>	myOffsets;
+
+	// What the last update() made the names from
+	std::string				myPattern;
+	int32_t					myCount;
+	bool					myFromDAT;
+	DATSnapshot				mySnapshot;
+	int64_t					myBuilds;
+};
+
+#endif
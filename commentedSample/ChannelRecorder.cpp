@@ -0,0 +1,407 @@
+#include "ChannelRecorder.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+	#include <windows.h>
+	#include <malloc.h>
+#else
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+const ChannelRecorder::FileHandle	ChannelRecorder::InvalidFile = INVALID_HANDLE_VALUE;
+#else
+const ChannelRecorder::FileHandle	ChannelRecorder::InvalidFile = -1;
+#endif
+
+static size_t
+roundUp(size_t bytes, size_t to)
+{
+	return (bytes + to - 1) / to * to;
+}
+
+static char*
+allocPages(size_t bytes)
+{
+#ifdef _WIN32
+	return (char*)_aligned_malloc(bytes, ChannelRecorder::PageBytes);
+#else
+	void* p = nullptr;
+	if (posix_memalign(&p, ChannelRecorder::PageBytes, bytes) != 0)
+		return nullptr;
+	return (char*)p;
+#endif
+}
+
+static void
+freePages(char* p)
+{
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+static void
+put32(char* dst, uint32_t v)
+{
+	memcpy(dst, &v, sizeof(v));
+}
+
+static void
+put64(char* dst, uint64_t v)
+{
+	memcpy(dst, &v, sizeof(v));
+}
+
+ChannelRecorder::ChannelRecorder() :
+	myFile(InvalidFile),
+	myDirect(false),
+	myNumChannels(0),
+	mySampleRate(0.0),
+	myChunkSize(0),
+	mySequence(0),
+	myActive(nullptr),
+	myStop(false),
+	myFailed(false),
+	myBytesWritten(0),
+	myStalls(0)
+{
+	for (Buffer& b : myBuffers)
+	{
+		b.data = nullptr;
+		b.used = ChunkHeaderBytes;
+		b.bytes = 0;
+		b.blocks = 0;
+		b.firstIndex = 0;
+		b.endIndex = 0;
+	}
+}
+
+ChannelRecorder::~ChannelRecorder()
+{
+	close();
+	for (Buffer& b : myBuffers)
+		freePages(b.data);
+}
+
+void
+ChannelRecorder::fail(const char* message)
+{
+	std::lock_guard<std::mutex> guard(myMutex);
+	if (myFailed.load(std::memory_order_relaxed))
+		return;
+	myError = message;
+	myFailed.store(true, std::memory_order_release);
+}
+
+bool
+ChannelRecorder::open(const char* path, bool direct, const CHOP_Output* output)
+{
+	close();
+	myError.clear();
+	myFailed.store(false);
+	myBytesWritten.store(0);
+	myStalls = 0;
+
+	if (output->numChannels < 1)
+	{
+		fail("Nothing to record");
+		return false;
+	}
+
+	// Big enough for at least one sample of every channel, however many
+	// there are
+	myNumChannels = output->numChannels;
+	mySampleRate = output->sampleRate;
+	myChunkSize = roundUp(ChunkHeaderBytes + BlockHeaderBytes + sizeof(float) * myNumChannels, PageBytes);
+	if (myChunkSize < ChunkBytes)
+		myChunkSize = ChunkBytes;
+
+	for (Buffer& b : myBuffers)
+	{
+		freePages(b.data);
+		b.data = allocPages(myChunkSize);
+		if (!b.data)
+		{
+			fail("Not enough memory for the recording buffers");
+			return false;
+		}
+		b.used = ChunkHeaderBytes;
+		b.blocks = 0;
+	}
+
+#ifdef _WIN32
+	DWORD flags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN;
+	myFile = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+						 flags | (direct ? FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH : 0), nullptr);
+	myDirect = direct && myFile != InvalidFile;
+	if (myFile == InvalidFile && direct)
+		myFile = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, flags, nullptr);
+#else
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+	myDirect = false;
+#ifdef O_DIRECT
+	if (direct)
+	{
+		// tmpfs and a few others refuse O_DIRECT
+		myFile = ::open(path, flags | O_DIRECT, 0644);
+		myDirect = myFile != InvalidFile;
+	}
+#endif
+	if (myFile == InvalidFile)
+		myFile = ::open(path, flags, 0644);
+#endif
+
+	if (myFile == InvalidFile)
+	{
+		fail("Can't create the record file");
+		return false;
+	}
+
+	// The header, padded to a whole number of pages like everything else
+	size_t names = 0;
+	for (int32_t c = 0; c < myNumChannels; c++)
+		names += strlen(output->names[c]) + 1;
+	size_t headerBytes = roundUp(FileHeaderBytes + names, PageBytes);
+
+	char* header = allocPages(headerBytes);
+	if (!header)
+	{
+		fail("Not enough memory for the recording buffers");
+		close();
+		return false;
+	}
+	memset(header, 0, headerBytes);
+	memcpy(header, "CHOPREC1", 8);
+	put32(header + 8, 1);
+	put32(header + 12, (uint32_t)headerBytes);
+	put32(header + 16, (uint32_t)myNumChannels);
+	memcpy(header + 24, &mySampleRate, sizeof(double));
+	char* p = header + FileHeaderBytes;
+	for (int32_t c = 0; c < myNumChannels; c++)
+	{
+		size_t len = strlen(output->names[c]) + 1;
+		memcpy(p, output->names[c], len);
+		p += len;
+	}
+	bool ok = writeAll(header, headerBytes);
+	freePages(header);
+	if (!ok)
+	{
+		close();
+		return false;
+	}
+
+	mySequence = 0;
+	myActive = &myBuffers[0];
+	myFree.assign(1, &myBuffers[1]);
+	myFull.clear();
+	myStop = false;
+	myWriter = std::thread(&ChannelRecorder::writerLoop, this);
+	return true;
+}
+
+void
+ChannelRecorder::close()
+{
+	if (!isOpen())
+		return;
+
+	if (myWriter.joinable())
+	{
+		if (myActive && myActive->blocks > 0)
+			flush();
+
+		{
+			std::lock_guard<std::mutex> guard(myMutex);
+			myStop = true;
+		}
+		myFullReady.notify_one();
+		myWriter.join();
+	}
+
+#ifdef _WIN32
+	CloseHandle(myFile);
+#else
+	::close(myFile);
+#endif
+	myFile = InvalidFile;
+	myActive = nullptr;
+}
+
+void
+ChannelRecorder::write(const CHOP_Output* output)
+{
+	if (!isOpen() || myFailed.load(std::memory_order_relaxed))
+		return;
+
+	if (output->numChannels != myNumChannels || fabs(output->sampleRate - mySampleRate) > 1e-6 * mySampleRate)
+	{
+		fail("Recording stopped, the number of channels or the sample rate changed");
+		return;
+	}
+
+	int64_t start = (int64_t)output->startIndex;
+	int32_t numSamples = output->numSamples;
+	size_t sampleBytes = sizeof(float) * myNumChannels;
+
+	int32_t done = 0;
+	while (done < numSamples)
+	{
+		if (!myActive)
+		{
+			// Both buffers are full, the disk is behind. Wait for one.
+			std::unique_lock<std::mutex> guard(myMutex);
+			if (myFree.empty())
+			{
+				myStalls++;
+				myFreeReady.wait(guard, [&]() { return !myFree.empty() || myFailed.load(); });
+				if (myFree.empty())
+					return;
+			}
+			myActive = myFree.back();
+			myFree.pop_back();
+		}
+
+		// As many samples as fit in what's left of the chunk
+		Buffer* b = myActive;
+		size_t room = myChunkSize - b->used;
+		int32_t take = room > BlockHeaderBytes ? int32_t((room - BlockHeaderBytes) / sampleBytes) : 0;
+		if (take > numSamples - done)
+			take = numSamples - done;
+		if (take <= 0)
+		{
+			flush();
+			continue;
+		}
+
+		int64_t blockStart = start + done;
+		if (b->blocks == 0)
+		{
+			b->firstIndex = blockStart;
+			b->endIndex = blockStart;
+		}
+		if (blockStart + take > b->endIndex)
+			b->endIndex = blockStart + take;
+
+		char* block = b->data + b->used;
+		put64(block, (uint64_t)blockStart);
+		put32(block + 8, (uint32_t)take);
+		put32(block + 12, 0);
+
+		float* dst = (float*)(block + BlockHeaderBytes);
+		for (int32_t c = 0; c < myNumChannels; c++)
+		{
+			memcpy(dst, output->channels[c] + done, sizeof(float) * take);
+			dst += take;
+		}
+
+		b->used += roundUp(BlockHeaderBytes + sampleBytes * take, 16);
+		b->blocks++;
+		done += take;
+	}
+}
+
+void
+ChannelRecorder::flush()
+{
+	Buffer* b = myActive;
+	if (!b)
+		return;
+
+	// Only whole pages are written, the padding is zeroed so the file
+	// never holds stale samples
+	b->bytes = roundUp(b->used, PageBytes);
+	memset(b->data + b->used, 0, b->bytes - b->used);
+
+	char* h = b->data;
+	memset(h, 0, ChunkHeaderBytes);
+	memcpy(h, "CHNK", 4);
+	put32(h + 4, (uint32_t)myNumChannels);
+	put32(h + 8, b->blocks);
+	put64(h + 16, (uint64_t)b->used);
+	put64(h + 24, (uint64_t)b->bytes);
+	put64(h + 32, mySequence++);
+	put64(h + 40, (uint64_t)b->firstIndex);
+	put64(h + 48, (uint64_t)b->endIndex);
+
+	myActive = nullptr;
+	{
+		std::lock_guard<std::mutex> guard(myMutex);
+		myFull.push_back(b);
+		if (!myFree.empty())
+		{
+			myActive = myFree.back();
+			myFree.pop_back();
+		}
+	}
+	myFullReady.notify_one();
+}
+
+bool
+ChannelRecorder::writeAll(const char* data, size_t bytes)
+{
+	while (bytes > 0)
+	{
+#ifdef _WIN32
+		DWORD wrote = 0;
+		DWORD chunk = bytes > (1u << 30) ? (1u << 30) : (DWORD)bytes;
+		if (!WriteFile(myFile, data, chunk, &wrote, nullptr) || wrote == 0)
+		{
+			fail("Writing the record file failed");
+			return false;
+		}
+#else
+		ssize_t wrote = ::write(myFile, data, bytes);
+		if (wrote < 0 && errno == EINTR)
+			continue;
+		if (wrote <= 0)
+		{
+			fail(errno == ENOSPC ? "Recording stopped, the disk is full" :
+								   "Writing the record file failed");
+			return false;
+		}
+#endif
+		data += wrote;
+		bytes -= wrote;
+		myBytesWritten.fetch_add(wrote, std::memory_order_relaxed);
+	}
+	return true;
+}
+
+void
+ChannelRecorder::writerLoop()
+{
+	for (;;)
+	{
+		Buffer* b;
+		{
+			std::unique_lock<std::mutex> guard(myMutex);
+			myFullReady.wait(guard, [&]() { return myStop || !myFull.empty(); });
+			if (myFull.empty())
+				return;
+			b = myFull.front();
+			myFull.pop_front();
+		}
+
+		// After a failure the rest is dropped, but buffers still go back so
+		// the cook never waits on a dead writer
+		if (!myFailed.load(std::memory_order_relaxed))
+			writeAll(b->data, b->bytes);
+
+		b->used = ChunkHeaderBytes;
+		b->blocks = 0;
+		{
+			std::lock_guard<std::mutex> guard(myMutex);
+			myFree.push_back(b);
+		}
+		myFreeReady.notify_one();
+	}
+}
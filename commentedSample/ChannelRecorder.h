@@ -0,0 +1,157 @@
+/*
+	Streams every cook's output channels to a file, for looking at long
+	sessions offline.
+
+	The cook only copies its samples into a page-aligned chunk buffer, as
+	one block laid out channel after channel, so the copy is a single
+	sequential run of memory however many channels there are. When a chunk
+	is full it's handed to a writer thread, which writes the whole chunk
+	with one large sequential write while the cook fills the other buffer.
+	The cook only ever waits if the disk falls a whole chunk behind (counted
+	in stalls()).
+
+	The file is made of page-aligned chunks of column-major blocks, so it
+	can be written with O_DIRECT (FILE_FLAG_NO_BUFFERING on Windows) and
+	read back with mmap. All values are little endian.
+
+		File header, padded with zeros to a multiple of 4096 bytes:
+			char		magic[8]		"CHOPREC1"
+			uint32		version			1
+			uint32		headerBytes		size of the padded header
+			uint32		numChannels
+			uint32		reserved
+			double		sampleRate
+			char		names[]			numChannels null-terminated names
+
+		Then any number of chunks, each padded to a multiple of 4096 bytes:
+			char		magic[4]		"CHNK"
+			uint32		numChannels
+			uint32		numBlocks
+			uint32		reserved
+			uint64		usedBytes		header and blocks, without the padding
+			uint64		chunkBytes		size of the padded chunk
+			uint64		sequence		0, 1, 2...
+			int64		firstIndex		startIndex of the first block
+			int64		endIndex		end of the block that ends last
+			(padding to 64 bytes)
+			numBlocks blocks
+
+		A block is one cook (or the part of a cook that fit in the chunk),
+		padded to a multiple of 16 bytes:
+			int64		startIndex		index of the block's first sample
+			uint32		numSamples		samples per channel
+			uint32		reserved
+			float		samples[numChannels][numSamples]
+
+	Every block has its own startIndex, so jumps in the timeline are just
+	visible in the indexes.
+*/
+
+#ifndef __ChannelRecorder__
+#define __ChannelRecorder__
+
+#include "CHOP_CPlusPlusBase.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ChannelRecorder
+{
+public:
+	// Size of each of the two chunk buffers, larger if one sample of every
+	// channel doesn't fit
+	static const size_t		ChunkBytes = 4 << 20;
+
+	// File offsets, sizes and buffer addresses are all multiples of this
+	static const size_t		PageBytes = 4096;
+
+	// Sizes of the headers described above
+	static const size_t		FileHeaderBytes = 32;
+	static const size_t		ChunkHeaderBytes = 64;
+	static const size_t		BlockHeaderBytes = 16;
+
+	ChannelRecorder();
+	~ChannelRecorder();
+
+	// Creates 'path' and writes the header for the channels of 'output'.
+	// 'direct' asks for writes that bypass the OS cache, which quietly falls
+	// back to normal writes where the file system doesn't support it.
+	// Returns false and sets error() if the file can't be created.
+	bool				open(const char* path, bool direct, const CHOP_Output* output);
+
+	// Writes what's left in the chunk buffer and closes the file
+	void				close();
+
+	bool				isOpen() const { return myFile != InvalidFile; }
+
+	// Copies this cook's samples into the chunk buffer. Recording stops
+	// with an error if the number of channels or the rate changes.
+	void				write(const CHOP_Output* output);
+
+	// Why recording stopped, nullptr while all is well
+	const char*			error() const { return myFailed.load(std::memory_order_acquire) ? myError.c_str() : nullptr; }
+
+	int64_t				bytesWritten() const { return myBytesWritten.load(std::memory_order_relaxed); }
+
+	// Times write() had to wait for the writer thread
+	int64_t				stalls() const { return myStalls; }
+
+	// True if the file was opened with O_DIRECT / FILE_FLAG_NO_BUFFERING
+	bool				direct() const { return myDirect; }
+
+private:
+#ifdef _WIN32
+	typedef void*		FileHandle;
+#else
+	typedef int			FileHandle;
+#endif
+	static const FileHandle	InvalidFile;
+
+	struct Buffer
+	{
+		char*			data;
+		size_t			used;
+		size_t			bytes;
+		uint32_t		blocks;
+		int64_t			firstIndex;
+		int64_t			endIndex;
+	};
+
+	void				fail(const char* message);
+	void				flush();
+	bool				writeAll(const char* data, size_t bytes);
+	void				writerLoop();
+
+	FileHandle			myFile;
+	bool				myDirect;
+	int32_t				myNumChannels;
+	double				mySampleRate;
+
+	// Size of the chunk buffers
+	size_t				myChunkSize;
+	uint64_t			mySequence;
+
+	Buffer				myBuffers[2];
+	Buffer*				myActive;
+
+	std::mutex				myMutex;
+	std::condition_variable	myFullReady;
+	std::condition_variable	myFreeReady;
+	std::deque<Buffer*>		myFull;
+	std::vector<Buffer*>	myFree;
+	bool					myStop;
+	std::thread				myWriter;
+
+	std::string				myError;
+	std::atomic<bool>		myFailed;
+	std::atomic<int64_t>	myBytesWritten;
+	int64_t					myStalls;
+};
+
+#endif
@@ -0,0 +1,294 @@
+#include "ChannelRouter.h"
+#include "ChannelKernels.h"
+#include "CookCache.h"
+#include "InputMixer.h"
+#include "ScratchArena.h"
+
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <unordered_map>
+#include <utility>
+
+// Input samples of one block of route(), sized to stay in L2 with room
+// for the outputs being written
+static const int32_t	BlockBytes = 128 * 1024;
+
+// Sources summed by one ChannelKernels::mix call
+static const int32_t	MaxBatch = 32;
+
+// True if 's' is a channel index rather than a name
+static bool
+isIndex(const char* s)
+{
+	if (!*s)
+		return false;
+	for (; *s; s++)
+	{
+		if (*s < '0' || *s > '9')
+			return false;
+	}
+	return true;
+}
+
+ChannelRouter::ChannelRouter() :
+	myByName(false),
+	myInputKey(0),
+	myUnresolved(0),
+	myLayoutHash(0),
+	myNumInputs(0),
+	myNumSamples(0),
+	myBlock(MaxBatch)
+{
+	myRowStart.push_back(0);
+}
+
+void
+ChannelRouter::setup(const OP_DATInput* dat, const OP_CHOPInput* input)
+{
+	parse(dat);
+	resolve(input);
+}
+
+void
+ChannelRouter::parse(const OP_DATInput* dat)
+{
+	if (!mySnapshot.update(dat, 3))
+		return;
+
+	myRoutes.clear();
+	myNames.clear();
+	myByName = false;
+	if (!dat || dat->numCols < 2)
+		return;
+
+	std::unordered_map<std::string, int32_t> destinations;
+	for (int32_t r = 0; r < dat->numRows; r++)
+	{
+		const char* source = dat->getCell(r, 0);
+		const char* destination = dat->getCell(r, 1);
+		if (!source || !*source || !destination || !*destination)
+			continue;
+
+		Route route;
+		route.gain = 1.0f;
+		const char* cell = dat->numCols > 2 ? dat->getCell(r, 2) : nullptr;
+		if (cell && *cell)
+		{
+			char* end = nullptr;
+			route.gain = (float)strtod(cell, &end);
+			if (end == cell)
+				continue;
+		}
+
+		auto it = destinations.find(destination);
+		if (it == destinations.end())
+		{
+			it = destinations.emplace(destination, myNames.size()).first;
+			myNames.add(destination);
+		}
+		route.source = source;
+		route.destination = it->second;
+		myByName |= !isIndex(source);
+		myRoutes.push_back(route);
+	}
+}
+
+void
+ChannelRouter::resolve(const OP_CHOPInput* input)
+{
+	uint64_t key = CookCache::mix((uint64_t)mySnapshot.changes(), (uint64_t)(input ? input->opId + 1 : 0));
+	if (input)
+	{
+		// Sources given by name have to notice a rename. That's one pass over
+		// the names each cook, much less than building the matrix again.
+		key = CookCache::mix(key, (uint64_t)(uint32_t)input->numChannels);
+		for (int32_t c = 0; myByName && c < input->numChannels; c++)
+		{
+			const char* name = input->getChannelName(c);
+			key = CookCache::hash(name, strlen(name), key);
+		}
+	}
+	if (key == myInputKey && myRowStart.size() == size_t(myNames.size()) + 1)
+		return;
+	myInputKey = key;
+
+	int32_t numInputs = input ? input->numChannels : 0;
+	std::unordered_map<std::string, int32_t> sources;
+	if (myByName)
+	{
+		sources.reserve(numInputs);
+		for (int32_t c = numInputs - 1; c >= 0; c--)
+			sources[input->getChannelName(c)] = c;
+	}
+
+	// The routes of every output channel, sorted by source so the inputs
+	// are read in order and duplicates end up next to each other
+	std::vector<std::vector<std::pair<int32_t, float>>> rows(myNames.size());
+	myUnresolved = 0;
+	for (const Route& route : myRoutes)
+	{
+		int32_t src = -1;
+		if (isIndex(route.source.c_str()))
+		{
+			long index = strtol(route.source.c_str(), nullptr, 10);
+			src = index < numInputs ? (int32_t)index : -1;
+		}
+		else
+		{
+			auto it = sources.find(route.source);
+			if (it != sources.end())
+				src = it->second;
+		}
+
+		if (src < 0)
+			myUnresolved++;
+		else
+			rows[route.destination].push_back(std::make_pair(src, route.gain));
+	}
+
+	myRowStart.assign(1, 0);
+	mySources.clear();
+	myGains.clear();
+	std::vector<bool> used(numInputs, false);
+	for (auto& row : rows)
+	{
+		std::sort(row.begin(), row.end(),
+			[](const std::pair<int32_t, float>& a, const std::pair<int32_t, float>& b)
+			{
+				return a.first < b.first;
+			});
+		for (size_t i = 0; i < row.size(); i++)
+		{
+			if (i > 0 && row[i].first == row[i - 1].first)
+			{
+				myGains.back() += row[i].second;
+				continue;
+			}
+			mySources.push_back(row[i].first);
+			myGains.push_back(row[i].second);
+			used[row[i].first] = true;
+		}
+		myRowStart.push_back((int32_t)mySources.size());
+	}
+
+	// The matrix's columns are only the input channels that are used, so
+	// gather() has nothing to look at for the rest
+	std::vector<int32_t> column(numInputs, -1);
+	myUsed.clear();
+	for (int32_t c = 0; c < numInputs; c++)
+	{
+		if (used[c])
+		{
+			column[c] = (int32_t)myUsed.size();
+			myUsed.push_back(c);
+		}
+	}
+	for (int32_t& src : mySources)
+		src = column[src];
+	myWindows.assign(myUsed.size(), nullptr);
+	myNumInputs = numInputs;
+
+	int32_t block = BlockBytes / (int32_t(sizeof(float)) * std::max<int32_t>((int32_t)myUsed.size(), 1));
+	myBlock = std::max<int32_t>(block & ~15, 16);
+
+	myLayoutHash = CookCache::hash(myRowStart.data(), sizeof(int32_t) * myRowStart.size(), myInputKey);
+	myLayoutHash = CookCache::hash(mySources.data(), sizeof(int32_t) * mySources.size(), myLayoutHash);
+	myLayoutHash = CookCache::hash(myGains.data(), sizeof(float) * myGains.size(), myLayoutHash);
+	myLayoutHash = CookCache::hash(myUsed.data(), sizeof(int32_t) * myUsed.size(), myLayoutHash);
+}
+
+void
+ChannelRouter::gather(const InputMixer& mixer, int32_t numSamples, const ChannelKernels& kernels,
+					  ScratchArena& arena)
+{
+	myNumSamples = numSamples;
+	if (mixer.numInputs() < 1 || mixer.input(0)->numChannels != myNumInputs)
+	{
+		std::fill(myWindows.begin(), myWindows.end(), nullptr);
+		return;
+	}
+
+	// Nearly always every window is straight in the input, or else every
+	// one of them is in the ring. Otherwise they're assembled here.
+	int32_t count = (int32_t)myUsed.size();
+	mixer.windows(0, myUsed.data(), count, myWindows.data());
+	if (count == 0 || myWindows[0])
+		return;
+
+	float* assembled = arena.allocate<float>(size_t(count) * numSamples);
+	ScratchArena::Buffer<float> assembly(arena);
+	for (int32_t i = 0; i < count; i++)
+	{
+		float* dst = &assembled[size_t(i) * numSamples];
+		mixer.readInput(0, myUsed[i], dst, kernels, assembly);
+		myWindows[i] = dst;
+	}
+}
+
+uint64_t
+ChannelRouter::hashSources(int32_t channel) const
+{
+	uint64_t h = (uint64_t)channel;
+	if (channel >= (int32_t)myRowStart.size() - 1)
+		return h;
+	for (int32_t r = myRowStart[channel]; r < myRowStart[channel + 1]; r++)
+	{
+		const float* src = myWindows[mySources[r]];
+		if (src)
+			h = CookCache::hash(src, sizeof(float) * myNumSamples, h);
+	}
+	return h;
+}
+
+void
+ChannelRouter::route(float* const* channels, int32_t begin, int32_t end, float scale,
+					 const ChannelKernels& kernels) const
+{
+	const float* srcs[MaxBatch];
+	float gains[MaxBatch];
+
+	for (int32_t s0 = 0; s0 < myNumSamples; s0 += myBlock)
+	{
+		int32_t n = std::min(myBlock, myNumSamples - s0);
+		for (int32_t c = begin; c < end; c++)
+		{
+			// Rows with more routes than one mix call takes carry what was
+			// summed so far into the next call as its first source
+			float* dst = channels[c] + s0;
+			if (c >= (int32_t)myRowStart.size() - 1)
+			{
+				memset(dst, 0, sizeof(float) * n);
+				continue;
+			}
+
+			int32_t count = 0;
+			bool written = false;
+			for (int32_t r = myRowStart[c]; r < myRowStart[c + 1]; r++)
+			{
+				const float* src = myWindows[mySources[r]];
+				if (!src)
+					continue;
+				if (count == 0 && written)
+				{
+					srcs[0] = dst;
+					gains[0] = 1.0f;
+					count = 1;
+				}
+				srcs[count] = src + s0;
+				gains[count] = myGains[r] * scale;
+				if (++count == MaxBatch)
+				{
+					kernels.mix(dst, srcs, gains, count, n);
+					written = true;
+					count = 0;
+				}
+			}
+
+			if (count > 0)
+				kernels.mix(dst, srcs, gains, count, n);
+			else if (!written)
+				memset(dst, 0, sizeof(float) * n);
+		}
+	}
+}
@@ -0,0 +1,126 @@
+/*
+	Routes the channels of the first input to the output through a sparse
+	gain matrix read from a DAT, for the "Route" mix of the example.
+
+	Every row of the DAT is one route, as source, destination and gain:
+		source		an input channel, by name or by index
+		destination	the name of an output channel
+		gain		what the source is multiplied by, 1 if the cell is empty
+	The output has one channel per distinct destination, in the order they
+	first appear. Routes with the same source and destination add up. Rows
+	whose gain isn't a number (like a header) are skipped, and routes whose
+	source isn't in the input are counted in unresolved() and left out.
+
+	The routes are kept as a CSR (compressed sparse row) matrix, one row per
+	output channel holding the input channels that feed it and their gains.
+	The DAT is only parsed again when its contents change, and the sources
+	are only looked up again when the input's channels change.
+
+	Each cook is then a sparse matrix times the block of input samples.
+	Every output channel is one pass of ChannelKernels::mix over its
+	sources. The samples are worked on in blocks short enough that the
+	input samples of one block stay in cache while every output channel of
+	a thread's range reads them, since one input usually feeds several
+	outputs.
+*/
+
+#ifndef __ChannelRouter__
+#define __ChannelRouter__
+
+#include "CHOP_CPlusPlusBase.h"
+#include "ChannelNamePool.h"
+#include "DATSnapshot.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class ChannelKernels;
+class InputMixer;
+class ScratchArena;
+
+class ChannelRouter
+{
+public:
+	ChannelRouter();
+
+	// Reads the routes from 'dat' and looks their sources up in 'input'.
+	// Either can be nullptr, which leaves no routes.
+	void				setup(const OP_DATInput* dat, const OP_CHOPInput* input);
+
+	int32_t				numOutputs() const { return myNames.size(); }
+	const char*			outputName(int32_t c) const { return myNames.name(c); }
+
+	// Number of routes in the matrix, after duplicates were added up
+	int32_t				numRoutes() const { return (int32_t)mySources.size(); }
+
+	// Number of DAT rows whose source isn't in the input
+	int32_t				unresolved() const { return myUnresolved; }
+
+	// A fingerprint of the routes and which input channels they read, for
+	// the cook cache
+	uint64_t			layoutHash() const { return myLayoutHash; }
+
+	// Finds this cook's samples of every input channel some route reads,
+	// through the input's ring in 'mixer' (input 0). Samples that aren't
+	// contiguous in the input are assembled into buffers from 'arena'.
+	void				gather(const InputMixer& mixer, int32_t numSamples,
+							   const ChannelKernels& kernels, ScratchArena& arena);
+
+	// A fingerprint of the samples feeding output channel c, call after
+	// gather()
+	uint64_t			hashSources(int32_t channel) const;
+
+	// Writes output channels [begin, end), every sample multiplied by
+	// 'scale'. Call after gather(). Different ranges can be written from
+	// different threads.
+	void				route(float* const* channels, int32_t begin, int32_t end,
+							  float scale, const ChannelKernels& kernels) const;
+
+private:
+	// One row of the DAT, as written
+	struct Route
+	{
+		std::string		source;
+		int32_t			destination;
+		float			gain;
+	};
+
+	void				parse(const OP_DATInput* dat);
+	void				resolve(const OP_CHOPInput* input);
+
+	// What the DAT held last time, so it's only parsed when it changes
+	DATSnapshot			mySnapshot;
+
+	std::vector<Route>	myRoutes;
+
+	ChannelNamePool		myNames;
+
+	// True if some route gives its source by name
+	bool				myByName;
+
+	// What the input's channels were last time, so sources are only looked
+	// up again when they change
+	uint64_t			myInputKey;
+
+	// The matrix: the routes of output channel c are
+	// [myRowStart[c], myRowStart[c + 1]) of mySources and myGains, with the
+	// sources as indexes into myUsed
+	std::vector<int32_t>	myRowStart;
+	std::vector<int32_t>	mySources;
+	std::vector<float>		myGains;
+	int32_t				myUnresolved;
+	uint64_t			myLayoutHash;
+
+	// The input channels read by some route, which are the columns of the
+	// matrix, and this cook's samples of each
+	std::vector<int32_t>		myUsed;
+	std::vector<const float*>	myWindows;
+	int32_t				myNumInputs;
+	int32_t				myNumSamples;
+
+	// Samples per block of route()
+	int32_t				myBlock;
+};
+
+#endif
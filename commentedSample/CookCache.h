@@ -0,0 +1,82 @@
+/*
+	Keeps a copy of the CHOP's last output so a cook whose inputs and
+	parameters haven't changed can be answered by copying it instead of
+	computing it again.
+
+	A cook is described in two parts:
+	- a key, a fingerprint of everything cheap to look at: the input CHOP's
+	  opId, startIndex, size and rate, the output size and the parameter
+	  snapshot. When the key differs from the last cook nothing more is
+	  done. A streaming input moves its startIndex every cook and the key
+	  has to change with it, or every cook would hash and store every
+	  channel only to miss; keyed that way it pays almost nothing for the
+	  cache.
+	- a hash of each input channel's samples, only worked out once the key
+	  has repeated. Channels whose samples hash the same as last time are
+	  copied from the cache, the others are recomputed and stored, so a
+	  change to a few channels only recomputes those.
+
+	fetch() and store() for different channels can be called from different
+	threads at the same time.
+*/
+
+#ifndef __CookCache__
+#define __CookCache__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class CookCache
+{
+public:
+	CookCache();
+
+	// Starts a cook producing numChannels x numSamples. Returns true when
+	// 'key' is the same as last cook's, which is when fetch() can succeed
+	// and store() is worth calling.
+	bool				begin(uint64_t key, int32_t numChannels, int32_t numSamples);
+
+	// Copies the stored channel into 'dst' if it was stored with the same
+	// 'dataHash'. Only valid after begin() returned true.
+	bool				fetch(int32_t channel, uint64_t dataHash, float* dst) const;
+
+	// Remembers 'src' as the output of 'channel' for 'dataHash'
+	void				store(int32_t channel, uint64_t dataHash, const float* src);
+
+	// Forgets everything, e.g. after a reset that the key can't see
+	void				invalidate();
+
+	// Adds up this cook's results once all channels are done.
+	// 'reused' is how many channels came from fetch().
+	void				finish(int32_t reused);
+
+	// Cooks where every channel came from the cache, and cooks where at
+	// least one had to be computed.
+	int64_t				hits() const { return myHits; }
+	int64_t				misses() const { return myMisses; }
+
+	// Channels reused in the last cook
+	int32_t				lastReused() const { return myLastReused; }
+
+	// Fingerprint helpers, for building keys and channel hashes
+	static uint64_t		hash(const void* data, size_t bytes, uint64_t seed);
+	static uint64_t		mix(uint64_t h, uint64_t v);
+	static uint64_t		mix(uint64_t h, double v);
+
+private:
+	uint64_t				myKey;
+	bool					myKeyValid;
+	int32_t					myNumChannels;
+	int32_t					myNumSamples;
+
+	std::vector<float>		myData;
+	std::vector<uint64_t>	myHashes;
+	std::vector<uint8_t>	myStored;
+
+	int64_t					myHits;
+	int64_t					myMisses;
+	int32_t					myLastReused;
+};
+
+#endif
@@ -0,0 +1,162 @@
+#include "CookProfiler.h"
+
+#include <math.h>
+
+LatencyHistogram::LatencyHistogram()
+{
+	reset();
+}
+
+int32_t
+LatencyHistogram::bucketOf(uint64_t ns)
+{
+	if (ns < (uint64_t)SubCount)
+		return (int32_t)ns;
+
+	// Position of the top bit, then the SubBits bits below it pick the
+	// linear step inside that power of two
+	int32_t top = 63;
+	while (!(ns >> top))
+		top--;
+	int32_t sub = (int32_t)(ns >> (top - SubBits)) & (SubCount - 1);
+	return SubCount + (top - SubBits) * SubCount + sub;
+}
+
+uint64_t
+LatencyHistogram::bucketStart(int32_t b)
+{
+	if (b < SubCount)
+		return (uint64_t)b;
+
+	int32_t top = (b - SubCount) / SubCount + SubBits;
+	uint64_t sub = (uint64_t)((b - SubCount) % SubCount);
+	return (uint64_t(1) << top) | (sub << (top - SubBits));
+}
+
+void
+LatencyHistogram::record(uint64_t ns)
+{
+	myBuckets[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+	myCount.fetch_add(1, std::memory_order_relaxed);
+	mySum.fetch_add(ns, std::memory_order_relaxed);
+	myLast.store(ns, std::memory_order_relaxed);
+
+	uint64_t seen = myMax.load(std::memory_order_relaxed);
+	while (ns > seen && !myMax.compare_exchange_weak(seen, ns, std::memory_order_relaxed))
+		;
+}
+
+void
+LatencyHistogram::reset()
+{
+	for (int32_t b = 0; b < NumBuckets; b++)
+		myBuckets[b].store(0, std::memory_order_relaxed);
+	myCount.store(0, std::memory_order_relaxed);
+	mySum.store(0, std::memory_order_relaxed);
+	myMax.store(0, std::memory_order_relaxed);
+	myLast.store(0, std::memory_order_relaxed);
+}
+
+double
+LatencyHistogram::mean() const
+{
+	uint64_t n = count();
+	return n ? double(total()) / double(n) : 0.0;
+}
+
+uint64_t
+LatencyHistogram::percentile(double p) const
+{
+	// Sum the buckets rather than trusting myCount, a record() running at
+	// the same time may have bumped one and not yet the other
+	uint64_t n = 0;
+	for (int32_t b = 0; b < NumBuckets; b++)
+		n += myBuckets[b].load(std::memory_order_relaxed);
+	if (n == 0)
+		return 0;
+
+	uint64_t rank = (uint64_t)ceil(p * double(n));
+	if (rank < 1)
+		rank = 1;
+
+	uint64_t seen = 0;
+	for (int32_t b = 0; b < NumBuckets; b++)
+	{
+		seen += myBuckets[b].load(std::memory_order_relaxed);
+		if (seen >= rank)
+		{
+			// The middle of the bucket, but never more than anything recorded
+			uint64_t lo = bucketStart(b);
+			uint64_t hi = b + 1 < NumBuckets ? bucketStart(b + 1) : lo;
+			uint64_t v = lo + (hi - lo) / 2;
+			uint64_t most = max();
+			return most && v > most ? most : v;
+		}
+	}
+	return max();
+}
+
+
+CookProfiler::CookProfiler() :
+	myCookStart(0),
+	mySamples(0),
+	myCookBytes(0)
+{
+}
+
+CookProfiler::Stage
+CookProfiler::addStage(const char* name)
+{
+	std::unique_ptr<StageInfo> info(new StageInfo);
+	info->name = name;
+	info->infoName = std::string(name) + "MeanUs";
+	info->bytes.store(0, std::memory_order_relaxed);
+	myStages.push_back(std::move(info));
+	return (Stage)myStages.size() - 1;
+}
+
+void
+CookProfiler::beginCook()
+{
+	myCookStart = now();
+}
+
+void
+CookProfiler::endCook(int64_t samples)
+{
+	myCook.record(now() - myCookStart);
+	mySamples.fetch_add(samples, std::memory_order_relaxed);
+}
+
+void
+CookProfiler::record(Stage s, uint64_t ns)
+{
+	myStages[s]->times.record(ns);
+}
+
+void
+CookProfiler::addBytes(Stage s, int64_t bytes)
+{
+	myStages[s]->bytes.fetch_add(bytes, std::memory_order_relaxed);
+	myCookBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+double
+CookProfiler::samplesPerSecond() const
+{
+	uint64_t ns = myCook.total();
+	return ns ? double(mySamples.load(std::memory_order_relaxed)) * 1e9 / double(ns) : 0.0;
+}
+
+void
+CookProfiler::reset()
+{
+	myCook.reset();
+	for (auto& s : myStages)
+	{
+		s->times.reset();
+		s->bytes.store(0, std::memory_order_relaxed);
+	}
+	mySamples.store(0, std::memory_order_relaxed);
+	myCookBytes.store(0, std::memory_order_relaxed);
+}
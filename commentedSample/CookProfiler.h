@@ -0,0 +1,162 @@
+/*
+	Cheap timing of every cook and of the stages inside it.
+
+	Each stage (and the cook as a whole) gets a LatencyHistogram. The
+	histogram buckets are log-linear: 16 linear buckets per power of two, so
+	any time from a nanosecond to hours lands in a bucket within about 6% of
+	its value, in a fixed 8KB table. Recording a time is a handful of
+	relaxed atomic adds, with no locks and no allocation, so it's safe to
+	record from worker threads and to read the stats from another thread
+	while a cook is running.
+
+	Times come from std::chrono::steady_clock, which is a vDSO call on Linux
+	and QueryPerformanceCounter on Windows; both already read the TSC where
+	it's reliable, without us having to calibrate it.
+*/
+
+#ifndef __CookProfiler__
+#define __CookProfiler__
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class LatencyHistogram
+{
+public:
+	// Values below 2^SubBits get a bucket each, above that every power of
+	// two is split into 2^SubBits buckets
+	static const int32_t	SubBits = 4;
+	static const int32_t	SubCount = 1 << SubBits;
+	static const int32_t	NumBuckets = SubCount + (64 - SubBits) * SubCount;
+
+	LatencyHistogram();
+
+	void			record(uint64_t ns);
+	void			reset();
+
+	uint64_t		count() const { return myCount.load(std::memory_order_relaxed); }
+	uint64_t		last() const { return myLast.load(std::memory_order_relaxed); }
+	uint64_t		max() const { return myMax.load(std::memory_order_relaxed); }
+	uint64_t		total() const { return mySum.load(std::memory_order_relaxed); }
+	double			mean() const;
+
+	// The value below which a fraction 'p' (0 to 1) of the recorded values
+	// fall, to the resolution of the buckets
+	uint64_t		percentile(double p) const;
+
+	static int32_t	bucketOf(uint64_t ns);
+
+	// The smallest value that lands in bucket 'b'
+	static uint64_t	bucketStart(int32_t b);
+
+private:
+	std::atomic<uint64_t>	myBuckets[NumBuckets];
+	std::atomic<uint64_t>	myCount;
+	std::atomic<uint64_t>	mySum;
+	std::atomic<uint64_t>	myMax;
+	std::atomic<uint64_t>	myLast;
+};
+
+
+class CookProfiler
+{
+public:
+	typedef int32_t		Stage;
+
+	CookProfiler();
+
+	// Adds a stage to time. Stages are normally added once, from the
+	// constructor of whatever owns the profiler.
+	Stage				addStage(const char* name);
+
+	int32_t				numStages() const { return (int32_t)myStages.size(); }
+	const char*			stageName(Stage s) const { return myStages[s]->name.c_str(); }
+
+	// "<name>MeanUs", for naming Info CHOP channels
+	const char*			stageInfoName(Stage s) const { return myStages[s]->infoName.c_str(); }
+
+	const LatencyHistogram&	stage(Stage s) const { return myStages[s]->times; }
+
+	// Bytes a stage read and wrote since the last reset. The stage reports
+	// them itself with addBytes(), they're worked out from the sizes of what
+	// it touched rather than measured.
+	int64_t				stageBytes(Stage s) const { return myStages[s]->bytes.load(std::memory_order_relaxed); }
+	void				addBytes(Stage s, int64_t bytes);
+
+	// Sum of every stage's bytes
+	int64_t				cookBytes() const { return myCookBytes.load(std::memory_order_relaxed); }
+
+	// The whole of execute()
+	const LatencyHistogram&	cook() const { return myCook; }
+
+	void				beginCook();
+
+	// 'samples' is channels x samples produced by this cook
+	void				endCook(int64_t samples);
+
+	void				record(Stage s, uint64_t ns);
+
+	// Output samples produced per second of cook time, over every cook
+	// since the last reset
+	double				samplesPerSecond() const;
+
+	void				reset();
+
+	static uint64_t		now()
+						{
+							return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+								std::chrono::steady_clock::now().time_since_epoch()).count();
+						}
+
+	// Times the rest of the enclosing block as one call of a stage
+	class Scope
+	{
+	public:
+		Scope(CookProfiler& profiler, Stage stage) :
+			myProfiler(profiler), myStage(stage), myStart(now()), myRunning(true)
+		{
+		}
+
+		~Scope()
+		{
+			stop();
+		}
+
+		// Records the time now rather than at the end of the scope
+		void	stop()
+		{
+			if (myRunning)
+				myProfiler.record(myStage, now() - myStart);
+			myRunning = false;
+		}
+
+	private:
+		CookProfiler&	myProfiler;
+		Stage			myStage;
+		uint64_t		myStart;
+		bool			myRunning;
+	};
+
+private:
+	struct StageInfo
+	{
+		std::string			name;
+		std::string			infoName;
+		LatencyHistogram	times;
+		std::atomic<int64_t>	bytes;
+	};
+
+	// Pointers so the histograms never move once threads may be using them
+	std::vector<std::unique_ptr<StageInfo>>	myStages;
+
+	LatencyHistogram		myCook;
+	uint64_t				myCookStart;
+	std::atomic<int64_t>	mySamples;
+	std::atomic<int64_t>	myCookBytes;
+};
+
+#endif
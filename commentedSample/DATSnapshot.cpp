@@ -0,0 +1,60 @@
+#include "DATSnapshot.h"
+
+DATSnapshot::DATSnapshot() :
+	myOpId(0),
+	myRows(0),
+	myCols(0),
+	myChanges(0)
+{
+}
+
+bool
+DATSnapshot::update(const OP_DATInput* dat, int32_t maxCols)
+{
+	uint32_t opId = dat ? dat->opId + 1 : 0;
+	int32_t numRows = dat ? dat->numRows : 0;
+	int32_t numCols = dat ? (dat->numCols < maxCols ? dat->numCols : maxCols) : 0;
+	bool same = myChanges > 0 && opId == myOpId && numRows == myRows && numCols == myCols;
+
+	const char* p = myCells.data();
+	const char* end = p + myCells.size();
+	for (int32_t r = 0; r < numRows && same; r++)
+	{
+		for (int32_t c = 0; c < numCols && same; c++)
+		{
+			const char* cell = dat->getCell(r, c);
+			for (const char* q = cell ? cell : ""; ; q++, p++)
+			{
+				if (p == end || *p != *q)
+				{
+					same = false;
+					break;
+				}
+				if (!*q)
+				{
+					p++;
+					break;
+				}
+			}
+		}
+	}
+	if (same && p == end)
+		return false;
+
+	myCells.clear();
+	for (int32_t r = 0; r < numRows; r++)
+	{
+		for (int32_t c = 0; c < numCols; c++)
+		{
+			const char* cell = dat->getCell(r, c);
+			if (cell)
+				myCells.append(cell);
+			myCells.push_back('\0');
+		}
+	}
+	myOpId = opId;
+	myRows = numRows;
+	myCols = numCols;
+	myChanges++;
+	return true;
+}
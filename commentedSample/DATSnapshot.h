@@ -0,0 +1,42 @@
+/*
+	Tells when a DAT's contents change.
+
+	TouchDesigner doesn't say when a DAT was edited, so code that builds
+	something from a DAT (a routing matrix, filter settings) has to look at
+	the cells every cook to know whether to build it again. This keeps a
+	copy of the cells, one after the other, and compares the DAT with it a
+	character at a time. That's a lot cheaper than hashing thousands of
+	short strings and can't miss a change.
+*/
+
+#ifndef __DATSnapshot__
+#define __DATSnapshot__
+
+#include "CPlusPlus_Common.h"
+
+#include <stdint.h>
+#include <string>
+
+class DATSnapshot
+{
+public:
+	DATSnapshot();
+
+	// True the first time, and whenever 'dat' is a different DAT or holds
+	// something different from the last call. Only the first 'maxCols'
+	// columns are looked at. 'dat' can be nullptr.
+	bool				update(const OP_DATInput* dat, int32_t maxCols);
+
+	// Number of times update() returned true
+	int64_t				changes() const { return myChanges; }
+
+private:
+	// The cells, each ending in a 0
+	std::string			myCells;
+	uint32_t			myOpId;
+	int32_t				myRows;
+	int32_t				myCols;
+	int64_t				myChanges;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include "EventQueue.h"
+#include "CookProfiler.h"
+
+#include <algorithm>
+
+EventQueue::EventQueue() :
+	myCollected(0),
+	myMoved(0),
+	myDropped(0),
+	myClockSequence(0),
+	myClockIndex(0),
+	myClockTime(0),
+	myClockRate(0.0)
+{
+	myDue.reserve(Capacity);
+}
+
+bool
+EventQueue::push(Kind kind, int64_t at, double value)
+{
+	Event e;
+	e.kind = kind;
+	e.at = at;
+	e.value = value;
+	e.position = 0;
+	if (myQueue.push(e))
+		return true;
+	myDropped.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+int64_t
+EventQueue::now() const
+{
+	int64_t index;
+	uint64_t time;
+	double rate;
+	for (;;)
+	{
+		uint32_t before = myClockSequence.load(std::memory_order_acquire);
+		index = myClockIndex.load(std::memory_order_relaxed);
+		time = myClockTime.load(std::memory_order_relaxed);
+		rate = myClockRate.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (!(before & 1) && myClockSequence.load(std::memory_order_relaxed) == before)
+			break;
+	}
+
+	// Before the first cook there's nothing to go on
+	uint64_t t = CookProfiler::now();
+	if (rate <= 0.0 || t <= time)
+		return index;
+	return index + int64_t(double(t - time) * rate * 1e-9);
+}
+
+const std::vector<EventQueue::Event>&
+EventQueue::collect(int64_t startIndex, int32_t numSamples, double sampleRate)
+{
+	// The block being cooked ends at the sample being played now
+	uint32_t sequence = myClockSequence.load(std::memory_order_relaxed);
+	myClockSequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	myClockIndex.store(startIndex + numSamples, std::memory_order_relaxed);
+	myClockTime.store(CookProfiler::now(), std::memory_order_relaxed);
+	myClockRate.store(sampleRate, std::memory_order_relaxed);
+	myClockSequence.store(sequence + 2, std::memory_order_release);
+
+	myDue.clear();
+	Event e;
+	while (myQueue.pop(e))
+	{
+		int64_t position = e.at - startIndex;
+		if (position < 0 || position > numSamples)
+		{
+			position = position < 0 ? 0 : numSamples;
+			myMoved++;
+		}
+		e.position = int32_t(position);
+		myDue.push_back(e);
+	}
+
+	// Events at the same sample keep the order they were pushed in
+	std::stable_sort(myDue.begin(), myDue.end(),
+		[](const Event& a, const Event& b) { return a.position < b.position; });
+	myCollected += int64_t(myDue.size());
+	return myDue;
+}
@@ -0,0 +1,102 @@
+/*
+	Things that happen to the generator between cooks, applied at the exact
+	sample they were meant for.
+
+	Pulses arrive through pulsePressed() whenever the user clicks, and
+	parameter changes are only seen once a cook starts. Rather than change
+	the CHOP's state on the spot, which would race with worker threads
+	still rendering, each one is pushed here as an event stamped with the
+	index of the output sample it takes effect at. Any thread can push, the
+	queue is an MpscQueue.
+
+	At the start of execute() the cook collects every queued event and gets
+	them back sorted by their position inside the block it's about to
+	output, so it can render up to an event, apply it, and carry on from
+	that very sample.
+
+	A pulse doesn't know which sample it belongs to, so now() works it out:
+	the end of the last cook's block, moved on by the time since that cook
+	at its sample rate. When cooks come late and cover several frames at
+	once, a click halfway between two of them still lands halfway through
+	the next block instead of at its start.
+*/
+
+#ifndef __EventQueue__
+#define __EventQueue__
+
+#include "MpscQueue.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+class EventQueue
+{
+public:
+	enum class Kind : int32_t
+	{
+		// Puts the generator's phase back to 0
+		Reset,
+		// Jumps the phase to the "Cuephase" parameter of the cook that applies
+		// it, in the units of the "offset" Info channel
+		Cue,
+		// A new "Speed" or "Shape" parameter, 'value' is the parameter's value
+		Speed,
+		Shape,
+	};
+
+	struct Event
+	{
+		Kind		kind;
+		int64_t		at;
+		double		value;
+
+		// Samples into the cook that collected it, set by collect()
+		int32_t		position;
+	};
+
+	// Events that can be waiting between two cooks
+	static const int32_t	Capacity = 256;
+
+	EventQueue();
+
+	// Any thread. Queues an event for output sample 'at'. False, and
+	// counted in dropped(), when the queue is full.
+	bool				push(Kind kind, int64_t at, double value = 0.0);
+
+	// Any thread. The index of the output sample being played right now,
+	// as far as can be told from the last cook.
+	int64_t				now() const;
+
+	// Cook only. Takes every queued event for the samples [startIndex,
+	// startIndex + numSamples) being cooked now and returns them in the
+	// order they take effect. An event stamped outside the block is moved
+	// to its nearest edge, position 0 or numSamples, and counted in
+	// moved(). Valid until the next collect().
+	const std::vector<Event>&	collect(int64_t startIndex, int32_t numSamples, double sampleRate);
+
+	// Events collect() has returned
+	int64_t				collected() const { return myCollected; }
+
+	// Events that were stamped outside the cook that collected them
+	int64_t				moved() const { return myMoved; }
+
+	// Events push() couldn't queue
+	int64_t				dropped() const { return myDropped.load(std::memory_order_relaxed); }
+
+private:
+	MpscQueue<Event, Capacity>	myQueue;
+	std::vector<Event>			myDue;
+	int64_t						myCollected;
+	int64_t						myMoved;
+	std::atomic<int64_t>		myDropped;
+
+	// Where the output was at the start of the last cook, for now(). Written
+	// by the cook as a seqlock: odd while it's being changed.
+	std::atomic<uint32_t>		myClockSequence;
+	std::atomic<int64_t>		myClockIndex;
+	std::atomic<uint64_t>		myClockTime;
+	std::atomic<double>			myClockRate;
+};
+
+#endif
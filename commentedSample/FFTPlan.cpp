@@ -0,0 +1,651 @@
+#include "FFTPlan.h"
+#include "ChannelKernels.h"
+
+#include <math.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+#ifdef CK_X86
+	#include <immintrin.h>
+#endif
+
+static const int32_t	Lanes = FFTPlan::Lanes;
+
+// Loading the frames, and the three steps of a transform over 'm' complex
+// rows. See the scalar versions for what each one does.
+typedef void	(*LoadKernel)(const float* const* frames, const float* window,
+							  const int32_t* order, int32_t m, float* re, float* im);
+typedef void	(*Radix2Kernel)(float* re, float* im, int32_t m);
+typedef void	(*Radix4Kernel)(float* re, float* im, int32_t m, int32_t h, const float* tw);
+typedef void	(*SplitKernel)(float* re, float* im, int32_t m, const float* tw);
+
+struct FFTKernels
+{
+	LoadKernel		load;
+	Radix2Kernel	radix2;
+	Radix4Kernel	radix4;
+	SplitKernel		split;
+};
+
+
+// ----------------------------------------------------------------------------
+// Scalar
+
+// Sample pairs (2i, 2i + 1) of every frame into row order[i], a row at a
+// time so every row is written whole
+static void
+loadScalar(const float* const* frames, const float* window, const int32_t* order, int32_t m,
+		   float* re, float* im)
+{
+	for (int32_t i = 0; i < m; i++)
+	{
+		float* dr = re + size_t(order[i]) * Lanes;
+		float* di = im + size_t(order[i]) * Lanes;
+		float w0 = window[2 * i], w1 = window[2 * i + 1];
+		for (int32_t l = 0; l < Lanes; l++)
+		{
+			dr[l] = frames[l][2 * i] * w0;
+			di[l] = frames[l][2 * i + 1] * w1;
+		}
+	}
+}
+
+// 2 point transforms of rows (0, 1), (2, 3) ...
+static void
+radix2Scalar(float* re, float* im, int32_t m)
+{
+	for (int32_t r = 0; r < m; r += 2)
+	{
+		float* ar = re + size_t(r) * Lanes;
+		float* ai = im + size_t(r) * Lanes;
+		for (int32_t l = 0; l < Lanes; l++)
+		{
+			float xr = ar[l], xi = ai[l];
+			float yr = ar[Lanes + l], yi = ai[Lanes + l];
+			ar[l] = xr + yr;
+			ai[l] = xi + yi;
+			ar[Lanes + l] = xr - yr;
+			ai[Lanes + l] = xi - yi;
+		}
+	}
+}
+
+// Combines the 4 transforms of h points in every block of 4h rows into one
+// of 4h points. This is two radix-2 passes done at once, so it takes 3
+// complex multiplies per butterfly instead of 4 and goes over the rows half
+// as many times.
+static void
+radix4Scalar(float* re, float* im, int32_t m, int32_t h, const float* tw)
+{
+	size_t step = size_t(h) * Lanes;
+	for (int32_t s = 0; s < m; s += 4 * h)
+	{
+		for (int32_t k = 0; k < h; k++)
+		{
+			const float* w = tw + 6 * k;
+			float* ar = re + size_t(s + k) * Lanes;
+			float* ai = im + size_t(s + k) * Lanes;
+			for (int32_t l = 0; l < Lanes; l++)
+			{
+				float r0 = ar[l], i0 = ai[l];
+				float r1 = ar[step + l], i1 = ai[step + l];
+				float r2 = ar[2 * step + l], i2 = ai[2 * step + l];
+				float r3 = ar[3 * step + l], i3 = ai[3 * step + l];
+
+				float t1r = r1 * w[2] - i1 * w[3], t1i = r1 * w[3] + i1 * w[2];
+				float t2r = r2 * w[0] - i2 * w[1], t2i = r2 * w[1] + i2 * w[0];
+				float t3r = r3 * w[4] - i3 * w[5], t3i = r3 * w[5] + i3 * w[4];
+
+				float s0r = r0 + t1r, s0i = i0 + t1i;
+				float s1r = r0 - t1r, s1i = i0 - t1i;
+				float pr = t2r + t3r, pi = t2i + t3i;
+				float qr = t2r - t3r, qi = t2i - t3i;
+
+				ar[l] = s0r + pr;
+				ai[l] = s0i + pi;
+				ar[step + l] = s1r + qi;
+				ai[step + l] = s1i - qr;
+				ar[2 * step + l] = s0r - pr;
+				ai[2 * step + l] = s0i - pi;
+				ar[3 * step + l] = s1r - qi;
+				ai[3 * step + l] = s1i + qr;
+			}
+		}
+	}
+}
+
+// Turns the transform Z of the m complex samples into bins 0 to m of the
+// real frame. Bins k and m - k both come from Z[k] and Z[m - k]:
+//		E = (Z[k] + conj(Z[m - k])) / 2		the even samples' transform
+//		O = (Z[k] - conj(Z[m - k])) / 2i	the odd samples' transform
+//		X[k] = E + W^k O,  X[m - k] = conj(E - W^k O)
+static void
+splitScalar(float* re, float* im, int32_t m, const float* tw)
+{
+	float* lastR = re + size_t(m) * Lanes;
+	float* lastI = im + size_t(m) * Lanes;
+	for (int32_t l = 0; l < Lanes; l++)
+	{
+		float zr = re[l], zi = im[l];
+		re[l] = zr + zi;
+		im[l] = 0.0f;
+		lastR[l] = zr - zi;
+		lastI[l] = 0.0f;
+	}
+
+	for (int32_t k = 1; k <= m / 2; k++)
+	{
+		float wr = tw[2 * k], wi = tw[2 * k + 1];
+		float* ar = re + size_t(k) * Lanes;
+		float* ai = im + size_t(k) * Lanes;
+		float* br = re + size_t(m - k) * Lanes;
+		float* bi = im + size_t(m - k) * Lanes;
+		for (int32_t l = 0; l < Lanes; l++)
+		{
+			float er = 0.5f * (ar[l] + br[l]), ei = 0.5f * (ai[l] - bi[l]);
+			float or_ = 0.5f * (ai[l] + bi[l]), oi = 0.5f * (br[l] - ar[l]);
+			float tr = or_ * wr - oi * wi, ti = or_ * wi + oi * wr;
+			ar[l] = er + tr;
+			ai[l] = ei + ti;
+			br[l] = er - tr;
+			bi[l] = ti - ei;
+		}
+	}
+}
+
+#ifdef CK_X86
+
+// ----------------------------------------------------------------------------
+// SSE2, a quarter of every row at a time
+
+// 4 samples of 4 frames at a time, transposed into 2 pairs of rows
+static void
+loadSSE2(const float* const* frames, const float* window, const int32_t* order, int32_t m,
+		 float* re, float* im)
+{
+	for (int32_t q = 0; q < Lanes; q += 4)
+	{
+		const float* const* f = frames + q;
+		for (int32_t i = 0; i < m; i += 2)
+		{
+			__m128 r0 = _mm_loadu_ps(f[0] + 2 * i);
+			__m128 r1 = _mm_loadu_ps(f[1] + 2 * i);
+			__m128 r2 = _mm_loadu_ps(f[2] + 2 * i);
+			__m128 r3 = _mm_loadu_ps(f[3] + 2 * i);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			size_t a = size_t(order[i]) * Lanes + q;
+			size_t b = size_t(order[i + 1]) * Lanes + q;
+			_mm_storeu_ps(re + a, _mm_mul_ps(r0, _mm_set1_ps(window[2 * i])));
+			_mm_storeu_ps(im + a, _mm_mul_ps(r1, _mm_set1_ps(window[2 * i + 1])));
+			_mm_storeu_ps(re + b, _mm_mul_ps(r2, _mm_set1_ps(window[2 * i + 2])));
+			_mm_storeu_ps(im + b, _mm_mul_ps(r3, _mm_set1_ps(window[2 * i + 3])));
+		}
+	}
+}
+
+static void
+radix2SSE2(float* re, float* im, int32_t m)
+{
+	for (int32_t r = 0; r < m; r += 2)
+	{
+		float* ar = re + size_t(r) * Lanes;
+		float* ai = im + size_t(r) * Lanes;
+		for (int32_t q = 0; q < Lanes; q += 4)
+		{
+			__m128 xr = _mm_loadu_ps(ar + q), xi = _mm_loadu_ps(ai + q);
+			__m128 yr = _mm_loadu_ps(ar + Lanes + q), yi = _mm_loadu_ps(ai + Lanes + q);
+			_mm_storeu_ps(ar + q, _mm_add_ps(xr, yr));
+			_mm_storeu_ps(ai + q, _mm_add_ps(xi, yi));
+			_mm_storeu_ps(ar + Lanes + q, _mm_sub_ps(xr, yr));
+			_mm_storeu_ps(ai + Lanes + q, _mm_sub_ps(xi, yi));
+		}
+	}
+}
+
+static void
+radix4SSE2(float* re, float* im, int32_t m, int32_t h, const float* tw)
+{
+	size_t step = size_t(h) * Lanes;
+	for (int32_t s = 0; s < m; s += 4 * h)
+	{
+		for (int32_t k = 0; k < h; k++)
+		{
+			const float* w = tw + 6 * k;
+			__m128 w1r = _mm_set1_ps(w[0]), w1i = _mm_set1_ps(w[1]);
+			__m128 w2r = _mm_set1_ps(w[2]), w2i = _mm_set1_ps(w[3]);
+			__m128 w3r = _mm_set1_ps(w[4]), w3i = _mm_set1_ps(w[5]);
+			float* ar = re + size_t(s + k) * Lanes;
+			float* ai = im + size_t(s + k) * Lanes;
+			for (int32_t q = 0; q < Lanes; q += 4)
+			{
+				__m128 r0 = _mm_loadu_ps(ar + q), i0 = _mm_loadu_ps(ai + q);
+				__m128 r1 = _mm_loadu_ps(ar + step + q), i1 = _mm_loadu_ps(ai + step + q);
+				__m128 r2 = _mm_loadu_ps(ar + 2 * step + q), i2 = _mm_loadu_ps(ai + 2 * step + q);
+				__m128 r3 = _mm_loadu_ps(ar + 3 * step + q), i3 = _mm_loadu_ps(ai + 3 * step + q);
+
+				__m128 t1r = _mm_sub_ps(_mm_mul_ps(r1, w2r), _mm_mul_ps(i1, w2i));
+				__m128 t1i = _mm_add_ps(_mm_mul_ps(r1, w2i), _mm_mul_ps(i1, w2r));
+				__m128 t2r = _mm_sub_ps(_mm_mul_ps(r2, w1r), _mm_mul_ps(i2, w1i));
+				__m128 t2i = _mm_add_ps(_mm_mul_ps(r2, w1i), _mm_mul_ps(i2, w1r));
+				__m128 t3r = _mm_sub_ps(_mm_mul_ps(r3, w3r), _mm_mul_ps(i3, w3i));
+				__m128 t3i = _mm_add_ps(_mm_mul_ps(r3, w3i), _mm_mul_ps(i3, w3r));
+
+				__m128 s0r = _mm_add_ps(r0, t1r), s0i = _mm_add_ps(i0, t1i);
+				__m128 s1r = _mm_sub_ps(r0, t1r), s1i = _mm_sub_ps(i0, t1i);
+				__m128 pr = _mm_add_ps(t2r, t3r), pi = _mm_add_ps(t2i, t3i);
+				__m128 qr = _mm_sub_ps(t2r, t3r), qi = _mm_sub_ps(t2i, t3i);
+
+				_mm_storeu_ps(ar + q, _mm_add_ps(s0r, pr));
+				_mm_storeu_ps(ai + q, _mm_add_ps(s0i, pi));
+				_mm_storeu_ps(ar + step + q, _mm_add_ps(s1r, qi));
+				_mm_storeu_ps(ai + step + q, _mm_sub_ps(s1i, qr));
+				_mm_storeu_ps(ar + 2 * step + q, _mm_sub_ps(s0r, pr));
+				_mm_storeu_ps(ai + 2 * step + q, _mm_sub_ps(s0i, pi));
+				_mm_storeu_ps(ar + 3 * step + q, _mm_sub_ps(s1r, qi));
+				_mm_storeu_ps(ai + 3 * step + q, _mm_add_ps(s1i, qr));
+			}
+		}
+	}
+}
+
+static void
+splitSSE2(float* re, float* im, int32_t m, const float* tw)
+{
+	float* lastR = re + size_t(m) * Lanes;
+	float* lastI = im + size_t(m) * Lanes;
+	for (int32_t q = 0; q < Lanes; q += 4)
+	{
+		__m128 zr = _mm_loadu_ps(re + q), zi = _mm_loadu_ps(im + q);
+		_mm_storeu_ps(re + q, _mm_add_ps(zr, zi));
+		_mm_storeu_ps(im + q, _mm_setzero_ps());
+		_mm_storeu_ps(lastR + q, _mm_sub_ps(zr, zi));
+		_mm_storeu_ps(lastI + q, _mm_setzero_ps());
+	}
+
+	__m128 half = _mm_set1_ps(0.5f);
+	for (int32_t k = 1; k <= m / 2; k++)
+	{
+		__m128 wr = _mm_set1_ps(tw[2 * k]), wi = _mm_set1_ps(tw[2 * k + 1]);
+		float* ar = re + size_t(k) * Lanes;
+		float* ai = im + size_t(k) * Lanes;
+		float* br = re + size_t(m - k) * Lanes;
+		float* bi = im + size_t(m - k) * Lanes;
+		for (int32_t q = 0; q < Lanes; q += 4)
+		{
+			__m128 xr = _mm_loadu_ps(ar + q), xi = _mm_loadu_ps(ai + q);
+			__m128 yr = _mm_loadu_ps(br + q), yi = _mm_loadu_ps(bi + q);
+			__m128 er = _mm_mul_ps(half, _mm_add_ps(xr, yr));
+			__m128 ei = _mm_mul_ps(half, _mm_sub_ps(xi, yi));
+			__m128 or_ = _mm_mul_ps(half, _mm_add_ps(xi, yi));
+			__m128 oi = _mm_mul_ps(half, _mm_sub_ps(yr, xr));
+			__m128 tr = _mm_sub_ps(_mm_mul_ps(or_, wr), _mm_mul_ps(oi, wi));
+			__m128 ti = _mm_add_ps(_mm_mul_ps(or_, wi), _mm_mul_ps(oi, wr));
+			_mm_storeu_ps(ar + q, _mm_add_ps(er, tr));
+			_mm_storeu_ps(ai + q, _mm_add_ps(ei, ti));
+			_mm_storeu_ps(br + q, _mm_sub_ps(er, tr));
+			_mm_storeu_ps(bi + q, _mm_sub_ps(ti, ei));
+		}
+	}
+}
+
+
+// ----------------------------------------------------------------------------
+// AVX2, half of every row at a time
+
+// Rows r[0..7] become columns
+CK_TARGET("avx2") static inline void
+transpose8(__m256* r)
+{
+	__m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+	__m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+	__m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+	__m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+	__m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+	__m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+	__m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+	__m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+	__m256 s0 = _mm256_shuffle_ps(t0, t2, 0x44);
+	__m256 s1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+	__m256 s2 = _mm256_shuffle_ps(t1, t3, 0x44);
+	__m256 s3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+	__m256 s4 = _mm256_shuffle_ps(t4, t6, 0x44);
+	__m256 s5 = _mm256_shuffle_ps(t4, t6, 0xEE);
+	__m256 s6 = _mm256_shuffle_ps(t5, t7, 0x44);
+	__m256 s7 = _mm256_shuffle_ps(t5, t7, 0xEE);
+	r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+// 8 samples of 8 frames at a time, transposed into 4 pairs of rows. Also
+// used for AVX-512, where the loads and transposes are the same.
+CK_TARGET("avx2") static void
+loadAVX2(const float* const* frames, const float* window, const int32_t* order, int32_t m,
+		 float* re, float* im)
+{
+	for (int32_t q = 0; q < Lanes; q += 8)
+	{
+		const float* const* f = frames + q;
+		for (int32_t i = 0; i < m; i += 4)
+		{
+			__m256 r[8];
+			for (int32_t l = 0; l < 8; l++)
+				r[l] = _mm256_loadu_ps(f[l] + 2 * i);
+			transpose8(r);
+			for (int32_t j = 0; j < 4; j++)
+			{
+				size_t a = size_t(order[i + j]) * Lanes + q;
+				_mm256_storeu_ps(re + a, _mm256_mul_ps(r[2 * j], _mm256_set1_ps(window[2 * (i + j)])));
+				_mm256_storeu_ps(im + a, _mm256_mul_ps(r[2 * j + 1], _mm256_set1_ps(window[2 * (i + j) + 1])));
+			}
+		}
+	}
+}
+
+CK_TARGET("avx2,fma") static void
+radix2AVX2(float* re, float* im, int32_t m)
+{
+	for (int32_t r = 0; r < m; r += 2)
+	{
+		float* ar = re + size_t(r) * Lanes;
+		float* ai = im + size_t(r) * Lanes;
+		for (int32_t q = 0; q < Lanes; q += 8)
+		{
+			__m256 xr = _mm256_loadu_ps(ar + q), xi = _mm256_loadu_ps(ai + q);
+			__m256 yr = _mm256_loadu_ps(ar + Lanes + q), yi = _mm256_loadu_ps(ai + Lanes + q);
+			_mm256_storeu_ps(ar + q, _mm256_add_ps(xr, yr));
+			_mm256_storeu_ps(ai + q, _mm256_add_ps(xi, yi));
+			_mm256_storeu_ps(ar + Lanes + q, _mm256_sub_ps(xr, yr));
+			_mm256_storeu_ps(ai + Lanes + q, _mm256_sub_ps(xi, yi));
+		}
+	}
+}
+
+CK_TARGET("avx2,fma") static void
+radix4AVX2(float* re, float* im, int32_t m, int32_t h, const float* tw)
+{
+	size_t step = size_t(h) * Lanes;
+	for (int32_t s = 0; s < m; s += 4 * h)
+	{
+		for (int32_t k = 0; k < h; k++)
+		{
+			const float* w = tw + 6 * k;
+			__m256 w1r = _mm256_set1_ps(w[0]), w1i = _mm256_set1_ps(w[1]);
+			__m256 w2r = _mm256_set1_ps(w[2]), w2i = _mm256_set1_ps(w[3]);
+			__m256 w3r = _mm256_set1_ps(w[4]), w3i = _mm256_set1_ps(w[5]);
+			float* ar = re + size_t(s + k) * Lanes;
+			float* ai = im + size_t(s + k) * Lanes;
+			for (int32_t q = 0; q < Lanes; q += 8)
+			{
+				__m256 r0 = _mm256_loadu_ps(ar + q), i0 = _mm256_loadu_ps(ai + q);
+				__m256 r1 = _mm256_loadu_ps(ar + step + q), i1 = _mm256_loadu_ps(ai + step + q);
+				__m256 r2 = _mm256_loadu_ps(ar + 2 * step + q), i2 = _mm256_loadu_ps(ai + 2 * step + q);
+				__m256 r3 = _mm256_loadu_ps(ar + 3 * step + q), i3 = _mm256_loadu_ps(ai + 3 * step + q);
+
+				__m256 t1r = _mm256_fmsub_ps(r1, w2r, _mm256_mul_ps(i1, w2i));
+				__m256 t1i = _mm256_fmadd_ps(r1, w2i, _mm256_mul_ps(i1, w2r));
+				__m256 t2r = _mm256_fmsub_ps(r2, w1r, _mm256_mul_ps(i2, w1i));
+				__m256 t2i = _mm256_fmadd_ps(r2, w1i, _mm256_mul_ps(i2, w1r));
+				__m256 t3r = _mm256_fmsub_ps(r3, w3r, _mm256_mul_ps(i3, w3i));
+				__m256 t3i = _mm256_fmadd_ps(r3, w3i, _mm256_mul_ps(i3, w3r));
+
+				__m256 s0r = _mm256_add_ps(r0, t1r), s0i = _mm256_add_ps(i0, t1i);
+				__m256 s1r = _mm256_sub_ps(r0, t1r), s1i = _mm256_sub_ps(i0, t1i);
+				__m256 pr = _mm256_add_ps(t2r, t3r), pi = _mm256_add_ps(t2i, t3i);
+				__m256 qr = _mm256_sub_ps(t2r, t3r), qi = _mm256_sub_ps(t2i, t3i);
+
+				_mm256_storeu_ps(ar + q, _mm256_add_ps(s0r, pr));
+				_mm256_storeu_ps(ai + q, _mm256_add_ps(s0i, pi));
+				_mm256_storeu_ps(ar + step + q, _mm256_add_ps(s1r, qi));
+				_mm256_storeu_ps(ai + step + q, _mm256_sub_ps(s1i, qr));
+				_mm256_storeu_ps(ar + 2 * step + q, _mm256_sub_ps(s0r, pr));
+				_mm256_storeu_ps(ai + 2 * step + q, _mm256_sub_ps(s0i, pi));
+				_mm256_storeu_ps(ar + 3 * step + q, _mm256_sub_ps(s1r, qi));
+				_mm256_storeu_ps(ai + 3 * step + q, _mm256_add_ps(s1i, qr));
+			}
+		}
+	}
+}
+
+CK_TARGET("avx2,fma") static void
+splitAVX2(float* re, float* im, int32_t m, const float* tw)
+{
+	float* lastR = re + size_t(m) * Lanes;
+	float* lastI = im + size_t(m) * Lanes;
+	for (int32_t q = 0; q < Lanes; q += 8)
+	{
+		__m256 zr = _mm256_loadu_ps(re + q), zi = _mm256_loadu_ps(im + q);
+		_mm256_storeu_ps(re + q, _mm256_add_ps(zr, zi));
+		_mm256_storeu_ps(im + q, _mm256_setzero_ps());
+		_mm256_storeu_ps(lastR + q, _mm256_sub_ps(zr, zi));
+		_mm256_storeu_ps(lastI + q, _mm256_setzero_ps());
+	}
+
+	__m256 half = _mm256_set1_ps(0.5f);
+	for (int32_t k = 1; k <= m / 2; k++)
+	{
+		__m256 wr = _mm256_set1_ps(tw[2 * k]), wi = _mm256_set1_ps(tw[2 * k + 1]);
+		float* ar = re + size_t(k) * Lanes;
+		float* ai = im + size_t(k) * Lanes;
+		float* br = re + size_t(m - k) * Lanes;
+		float* bi = im + size_t(m - k) * Lanes;
+		for (int32_t q = 0; q < Lanes; q += 8)
+		{
+			__m256 xr = _mm256_loadu_ps(ar + q), xi = _mm256_loadu_ps(ai + q);
+			__m256 yr = _mm256_loadu_ps(br + q), yi = _mm256_loadu_ps(bi + q);
+			__m256 er = _mm256_mul_ps(half, _mm256_add_ps(xr, yr));
+			__m256 ei = _mm256_mul_ps(half, _mm256_sub_ps(xi, yi));
+			__m256 or_ = _mm256_mul_ps(half, _mm256_add_ps(xi, yi));
+			__m256 oi = _mm256_mul_ps(half, _mm256_sub_ps(yr, xr));
+			__m256 tr = _mm256_fmsub_ps(or_, wr, _mm256_mul_ps(oi, wi));
+			__m256 ti = _mm256_fmadd_ps(or_, wi, _mm256_mul_ps(oi, wr));
+			_mm256_storeu_ps(ar + q, _mm256_add_ps(er, tr));
+			_mm256_storeu_ps(ai + q, _mm256_add_ps(ei, ti));
+			_mm256_storeu_ps(br + q, _mm256_sub_ps(er, tr));
+			_mm256_storeu_ps(bi + q, _mm256_sub_ps(ti, ei));
+		}
+	}
+}
+
+
+// ----------------------------------------------------------------------------
+// AVX-512, a whole row at a time
+
+CK_TARGET("avx512f") static void
+radix2AVX512(float* re, float* im, int32_t m)
+{
+	for (int32_t r = 0; r < m; r += 2)
+	{
+		float* ar = re + size_t(r) * Lanes;
+		float* ai = im + size_t(r) * Lanes;
+		__m512 xr = _mm512_loadu_ps(ar), xi = _mm512_loadu_ps(ai);
+		__m512 yr = _mm512_loadu_ps(ar + Lanes), yi = _mm512_loadu_ps(ai + Lanes);
+		_mm512_storeu_ps(ar, _mm512_add_ps(xr, yr));
+		_mm512_storeu_ps(ai, _mm512_add_ps(xi, yi));
+		_mm512_storeu_ps(ar + Lanes, _mm512_sub_ps(xr, yr));
+		_mm512_storeu_ps(ai + Lanes, _mm512_sub_ps(xi, yi));
+	}
+}
+
+CK_TARGET("avx512f") static void
+radix4AVX512(float* re, float* im, int32_t m, int32_t h, const float* tw)
+{
+	size_t step = size_t(h) * Lanes;
+	for (int32_t s = 0; s < m; s += 4 * h)
+	{
+		for (int32_t k = 0; k < h; k++)
+		{
+			const float* w = tw + 6 * k;
+			__m512 w1r = _mm512_set1_ps(w[0]), w1i = _mm512_set1_ps(w[1]);
+			__m512 w2r = _mm512_set1_ps(w[2]), w2i = _mm512_set1_ps(w[3]);
+			__m512 w3r = _mm512_set1_ps(w[4]), w3i = _mm512_set1_ps(w[5]);
+			float* ar = re + size_t(s + k) * Lanes;
+			float* ai = im + size_t(s + k) * Lanes;
+
+			__m512 r0 = _mm512_loadu_ps(ar), i0 = _mm512_loadu_ps(ai);
+			__m512 r1 = _mm512_loadu_ps(ar + step), i1 = _mm512_loadu_ps(ai + step);
+			__m512 r2 = _mm512_loadu_ps(ar + 2 * step), i2 = _mm512_loadu_ps(ai + 2 * step);
+			__m512 r3 = _mm512_loadu_ps(ar + 3 * step), i3 = _mm512_loadu_ps(ai + 3 * step);
+
+			__m512 t1r = _mm512_fmsub_ps(r1, w2r, _mm512_mul_ps(i1, w2i));
+			__m512 t1i = _mm512_fmadd_ps(r1, w2i, _mm512_mul_ps(i1, w2r));
+			__m512 t2r = _mm512_fmsub_ps(r2, w1r, _mm512_mul_ps(i2, w1i));
+			__m512 t2i = _mm512_fmadd_ps(r2, w1i, _mm512_mul_ps(i2, w1r));
+			__m512 t3r = _mm512_fmsub_ps(r3, w3r, _mm512_mul_ps(i3, w3i));
+			__m512 t3i = _mm512_fmadd_ps(r3, w3i, _mm512_mul_ps(i3, w3r));
+
+			__m512 s0r = _mm512_add_ps(r0, t1r), s0i = _mm512_add_ps(i0, t1i);
+			__m512 s1r = _mm512_sub_ps(r0, t1r), s1i = _mm512_sub_ps(i0, t1i);
+			__m512 pr = _mm512_add_ps(t2r, t3r), pi = _mm512_add_ps(t2i, t3i);
+			__m512 qr = _mm512_sub_ps(t2r, t3r), qi = _mm512_sub_ps(t2i, t3i);
+
+			_mm512_storeu_ps(ar, _mm512_add_ps(s0r, pr));
+			_mm512_storeu_ps(ai, _mm512_add_ps(s0i, pi));
+			_mm512_storeu_ps(ar + step, _mm512_add_ps(s1r, qi));
+			_mm512_storeu_ps(ai + step, _mm512_sub_ps(s1i, qr));
+			_mm512_storeu_ps(ar + 2 * step, _mm512_sub_ps(s0r, pr));
+			_mm512_storeu_ps(ai + 2 * step, _mm512_sub_ps(s0i, pi));
+			_mm512_storeu_ps(ar + 3 * step, _mm512_sub_ps(s1r, qi));
+			_mm512_storeu_ps(ai + 3 * step, _mm512_add_ps(s1i, qr));
+		}
+	}
+}
+
+CK_TARGET("avx512f") static void
+splitAVX512(float* re, float* im, int32_t m, const float* tw)
+{
+	float* lastR = re + size_t(m) * Lanes;
+	float* lastI = im + size_t(m) * Lanes;
+	__m512 zr = _mm512_loadu_ps(re), zi = _mm512_loadu_ps(im);
+	_mm512_storeu_ps(re, _mm512_add_ps(zr, zi));
+	_mm512_storeu_ps(im, _mm512_setzero_ps());
+	_mm512_storeu_ps(lastR, _mm512_sub_ps(zr, zi));
+	_mm512_storeu_ps(lastI, _mm512_setzero_ps());
+
+	__m512 half = _mm512_set1_ps(0.5f);
+	for (int32_t k = 1; k <= m / 2; k++)
+	{
+		__m512 wr = _mm512_set1_ps(tw[2 * k]), wi = _mm512_set1_ps(tw[2 * k + 1]);
+		float* ar = re + size_t(k) * Lanes;
+		float* ai = im + size_t(k) * Lanes;
+		float* br = re + size_t(m - k) * Lanes;
+		float* bi = im + size_t(m - k) * Lanes;
+		__m512 xr = _mm512_loadu_ps(ar), xi = _mm512_loadu_ps(ai);
+		__m512 yr = _mm512_loadu_ps(br), yi = _mm512_loadu_ps(bi);
+		__m512 er = _mm512_mul_ps(half, _mm512_add_ps(xr, yr));
+		__m512 ei = _mm512_mul_ps(half, _mm512_sub_ps(xi, yi));
+		__m512 or_ = _mm512_mul_ps(half, _mm512_add_ps(xi, yi));
+		__m512 oi = _mm512_mul_ps(half, _mm512_sub_ps(yr, xr));
+		__m512 tr = _mm512_fmsub_ps(or_, wr, _mm512_mul_ps(oi, wi));
+		__m512 ti = _mm512_fmadd_ps(or_, wi, _mm512_mul_ps(oi, wr));
+		_mm512_storeu_ps(ar, _mm512_add_ps(er, tr));
+		_mm512_storeu_ps(ai, _mm512_add_ps(ei, ti));
+		_mm512_storeu_ps(br, _mm512_sub_ps(er, tr));
+		_mm512_storeu_ps(bi, _mm512_sub_ps(ti, ei));
+	}
+}
+
+#endif // CK_X86
+
+static FFTKernels
+selectKernels()
+{
+	switch (ChannelKernels::get().level)
+	{
+#ifdef CK_X86
+		case CPUFeatureLevel::AVX512:	return { loadAVX2, radix2AVX512, radix4AVX512, splitAVX512 };
+		case CPUFeatureLevel::AVX2:		return { loadAVX2, radix2AVX2, radix4AVX2, splitAVX2 };
+		case CPUFeatureLevel::SSE2:		return { loadSSE2, radix2SSE2, radix4SSE2, splitSSE2 };
+#endif
+		default:						return { loadScalar, radix2Scalar, radix4Scalar, splitScalar };
+	}
+}
+
+
+// ----------------------------------------------------------------------------
+
+const FFTPlan&
+FFTPlan::get(int32_t size)
+{
+	int32_t n = MinSize;
+	while (n < size && n < MaxSize)
+		n *= 2;
+
+	// Plans are never freed, so the references handed out stay valid
+	static std::mutex lock;
+	static std::map<int32_t, std::unique_ptr<FFTPlan>> plans;
+	std::lock_guard<std::mutex> guard(lock);
+	std::unique_ptr<FFTPlan>& plan = plans[n];
+	if (!plan)
+		plan.reset(new FFTPlan(n));
+	return *plan;
+}
+
+FFTPlan::FFTPlan(int32_t size) :
+	mySize(size),
+	myRadix2(false)
+{
+	const double pi = 3.14159265358979323846;
+	int32_t m = size / 2;
+	int32_t bits = 0;
+	while ((1 << bits) < m)
+		bits++;
+
+	myOrder.resize(m);
+	for (int32_t i = 0; i < m; i++)
+	{
+		int32_t r = 0;
+		for (int32_t b = 0; b < bits; b++)
+			r |= ((i >> b) & 1) << (bits - 1 - b);
+		myOrder[i] = r;
+	}
+
+	// An odd number of bits leaves one radix-2 pass over pairs of rows
+	myRadix2 = (bits & 1) != 0;
+	for (int32_t h = myRadix2 ? 2 : 1; 4 * h <= m; h *= 4)
+	{
+		myQuarters.push_back(h);
+		myPassTwiddles.push_back(myTwiddles.size());
+		for (int32_t k = 0; k < h; k++)
+		{
+			for (int32_t j = 1; j <= 3; j++)
+			{
+				double a = 2.0 * pi * j * k / (4.0 * h);
+				myTwiddles.push_back(float(cos(a)));
+				myTwiddles.push_back(float(-sin(a)));
+			}
+		}
+	}
+
+	for (int32_t k = 0; k <= m / 2; k++)
+	{
+		double a = 2.0 * pi * k / size;
+		mySplitTwiddles.push_back(float(cos(a)));
+		mySplitTwiddles.push_back(float(-sin(a)));
+	}
+}
+
+void
+FFTPlan::load(const float* const* frames, const float* window, float* re, float* im) const
+{
+	selectKernels().load(frames, window, myOrder.data(), mySize / 2, re, im);
+}
+
+void
+FFTPlan::transform(float* re, float* im) const
+{
+	FFTKernels kernels = selectKernels();
+	int32_t m = mySize / 2;
+	if (myRadix2)
+		kernels.radix2(re, im, m);
+	for (size_t p = 0; p < myQuarters.size(); p++)
+		kernels.radix4(re, im, m, myQuarters[p], &myTwiddles[myPassTwiddles[p]]);
+	kernels.split(re, im, m, mySplitTwiddles.data());
+}
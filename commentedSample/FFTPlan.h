@@ -0,0 +1,81 @@
+/*
+	Real FFTs of many channels at once, for the spectrum mode of the example.
+
+	A plan holds everything about one transform size that can be worked out
+	ahead of time: the order the samples are loaded in and the twiddle
+	factors of every pass. A plan is made the first time its size is asked
+	for and kept for the life of the process, shared by every instance, so
+	going back to a size used before costs nothing.
+
+	The transform works on Lanes frames at once, one per SIMD lane, the same
+	way BiquadBank filters channels: every point of the transform is a row of
+	Lanes floats, one from each frame, so every butterfly is a handful of
+	vector operations on whole rows and nothing is ever shuffled between
+	lanes. AVX-512 does a row at a time, AVX2 halves and SSE2 quarters.
+
+	A real frame of N samples is transformed as N/2 complex samples, the
+	even samples as the real part and the odd ones as the imaginary part.
+	That's done in place with radix-4 passes, plus one radix-2 pass first
+	when N/2 is an odd power of two, and the result is then split into the
+	N/2 + 1 bins of the real frame.
+*/
+
+#ifndef __FFTPlan__
+#define __FFTPlan__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class FFTPlan
+{
+public:
+	// Frames transformed together
+	static const int32_t	Lanes = 16;
+
+	static const int32_t	MinSize = 16;
+	static const int32_t	MaxSize = 65536;
+
+	// The plan for frames of 'size' samples, a power of two between MinSize
+	// and MaxSize. Can be called from any thread.
+	static const FFTPlan&	get(int32_t size);
+
+	int32_t				size() const { return mySize; }
+	int32_t				numBins() const { return mySize / 2 + 1; }
+
+	// The row samples 2m and 2m + 1 of every frame are loaded into, for m
+	// in [0, size() / 2). The rows are in bit reversed order, which is what
+	// the passes need, so loading the frames is the only reordering.
+	int32_t				row(int32_t m) const { return myOrder[m]; }
+
+	// Loads the Lanes frames of size() samples in 'frames', multiplied by
+	// 'window', into 're' and 'im' for transform(). Sample 2m of frame l
+	// goes in re[row(m) * Lanes + l] and sample 2m + 1 in
+	// im[row(m) * Lanes + l], a transpose done a square at a time.
+	void				load(const float* const* frames, const float* window, float* re,
+							 float* im) const;
+
+	// Transforms the Lanes frames in 're' and 'im', which hold numBins()
+	// rows of Lanes floats each, loaded by load(). Afterwards row k holds
+	// bin k of every frame, not normalized.
+	void				transform(float* re, float* im) const;
+
+private:
+	explicit FFTPlan(int32_t size);
+
+	int32_t					mySize;
+	std::vector<int32_t>	myOrder;
+
+	// One radix-4 pass per entry: a quarter of its block size, and where
+	// its twiddles start in myTwiddles. Every butterfly k of a pass has
+	// W^k, W^2k and W^3k there, as re, im pairs.
+	std::vector<int32_t>	myQuarters;
+	std::vector<size_t>		myPassTwiddles;
+	std::vector<float>		myTwiddles;
+	bool					myRadix2;
+
+	// W^k of the whole frame, for the split into bins, k in [0, size / 4]
+	std::vector<float>		mySplitTwiddles;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#include "InfoTable.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+static const size_t	MinText = 1024;
+
+InfoTable::InfoTable() :
+	myUsed(0),
+	myCols(0)
+{
+	myEmpty[0] = 0;
+}
+
+void
+InfoTable::clear(int32_t cols)
+{
+	myUsed = 0;
+	myCells.clear();
+	myCols = cols;
+}
+
+void
+InfoTable::add(const char* format, ...)
+{
+	if (myText.size() < MinText)
+		myText.resize(MinText);
+
+	for (;;)
+	{
+		size_t room = myText.size() - myUsed;
+
+		va_list args;
+		va_start(args, format);
+		int n = vsnprintf(&myText[myUsed], room, format, args);
+		va_end(args);
+
+		if (n < 0)
+		{
+			// Bad format, leave the cell empty
+			myText[myUsed] = 0;
+			n = 0;
+		}
+		else if (size_t(n) >= room)
+		{
+			// Didn't fit with its terminator, grow and format it again.
+			// Cells are offsets, so moving the text is fine.
+			size_t size = myText.size() * 2;
+			while (size - myUsed <= size_t(n))
+				size *= 2;
+			myText.resize(size);
+			continue;
+		}
+
+		myCells.push_back(myUsed);
+		myUsed += size_t(n) + 1;
+		return;
+	}
+}
+
+char*
+InfoTable::cell(int32_t row, int32_t col)
+{
+	size_t i = size_t(row) * myCols + col;
+	if (row < 0 || col < 0 || col >= myCols || i >= myCells.size())
+		return myEmpty;
+	return &myText[myCells[i]];
+}
@@ -0,0 +1,56 @@
+/*
+	A table of strings for the Info DAT, owned by one CHOP instance.
+
+	Every cell is printf-formatted into one arena of text that belongs to the
+	table, and only remembered by its offset into it. clear() just rewinds
+	the arena, so once the table has been built a couple of times it's
+	rebuilt without allocating anything, and any number of rows and columns
+	can be handed to TouchDesigner at once. (A static buffer is shared by
+	every instance of the CHOP and only holds one cell at a time.)
+
+	The pointers from cell() stay valid until the next clear(), which is
+	long enough: TouchDesigner copies the strings as soon as
+	getInfoDATEntries() returns.
+*/
+
+#ifndef __InfoTable__
+#define __InfoTable__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class InfoTable
+{
+public:
+	InfoTable();
+
+	// Empties the table, keeping the memory. Every row has 'cols' cells.
+	void			clear(int32_t cols);
+
+	// Appends a cell to the current row, starting a new row when the
+	// current one is full
+	void			add(const char* format, ...)
+#if defined(__GNUC__) || defined(__clang__)
+					__attribute__((format(printf, 2, 3)))
+#endif
+					;
+
+	int32_t			rows() const { return myCols > 0 ? int32_t((myCells.size() + myCols - 1) / myCols) : 0; }
+	int32_t			cols() const { return myCols; }
+
+	// "" for cells that were never added
+	char*			cell(int32_t row, int32_t col);
+
+	// Bytes of text in the arena, for the curious
+	size_t			textBytes() const { return myUsed; }
+
+private:
+	std::vector<char>		myText;
+	size_t					myUsed;
+	std::vector<size_t>		myCells;
+	int32_t					myCols;
+	char					myEmpty[1];
+};
+
+#endif
@@ -0,0 +1,303 @@
+#include "InputMixer.h"
+#include "ChannelKernels.h"
+#include "CookCache.h"
+#include "Resampler.h"
+
+#include <string.h>
+#include <string>
+#include <unordered_map>
+
+InputMixer::InputMixer() :
+	myMode(Mode::First),
+	myScale(1.0f),
+	myChannelKernel(mixChannelT<Mode::First, true>),
+	myOutStart(0.0),
+	myOutSamples(0),
+	myOutRate(0.0),
+	myNumChannels(0),
+	myLayoutKey(0),
+	myLayoutValid(false),
+	myRemaps(0)
+{
+}
+
+int32_t
+InputMixer::widestInput(OP_Inputs* inputs, Mode mode)
+{
+	int32_t n = inputs->getNumInputs();
+	if (mode == Mode::First || mode == Mode::Route || n <= 1)
+		return 0;
+	if (n > MaxInputs)
+		n = MaxInputs;
+
+	int32_t widest = 0;
+	int32_t most = -1;
+	for (int32_t k = 0; k < n; k++)
+	{
+		const OP_CHOPInput* in = inputs->getInputCHOP(k);
+		if (in && in->numChannels > most)
+		{
+			most = in->numChannels;
+			widest = k;
+		}
+	}
+	return widest;
+}
+
+void
+InputMixer::prepare(OP_Inputs* inputs, const CHOP_Output* output, Mode mode, Match match,
+					const double* gains, int32_t numGains, float scale)
+{
+	bool first = mode == Mode::First || mode == Mode::Route;
+	int32_t n = first ? 1 : inputs->getNumInputs();
+	if (n > MaxInputs)
+		n = MaxInputs;
+
+	myInputs.clear();
+	mySlots.clear();
+	myGains.clear();
+	for (int32_t k = 0; k < n; k++)
+	{
+		const OP_CHOPInput* in = inputs->getInputCHOP(k);
+		if (!in)
+			continue;
+		myInputs.push_back(in);
+		mySlots.push_back(k);
+		myGains.push_back(first || k >= numGains ? 1.0f : (float)gains[k]);
+	}
+
+	// Rings stay with the input slot they were made for, so a ring only
+	// starts over when its own input changes, not when an empty slot
+	// before it is connected or disconnected.
+	if (myRings.size() < size_t(n))
+		myRings.resize(n);
+	for (size_t k = 0; k < myInputs.size(); k++)
+		ring(int32_t(k)).begin(myInputs[k], output->startIndex, output->numSamples, output->sampleRate);
+
+	// Pick the loop for this mode and scale. Routing goes through the
+	// ChannelRouter instead, it just gets the sum's.
+	if (mode != myMode || (scale == 1.0f) != (myScale == 1.0f))
+	{
+		static const ChannelKernel kernels[3][2] =
+		{
+			{ mixChannelT<Mode::First, false>,		mixChannelT<Mode::First, true> },
+			{ mixChannelT<Mode::Sum, false>,		mixChannelT<Mode::Sum, true> },
+			{ mixChannelT<Mode::Average, false>,	mixChannelT<Mode::Average, true> },
+		};
+		int32_t m = mode == Mode::First || mode == Mode::Average ? int32_t(mode) : int32_t(Mode::Sum);
+		myChannelKernel = kernels[m][scale == 1.0f];
+	}
+	myMode = mode;
+	myScale = scale;
+	myOutStart = output->startIndex;
+	myOutSamples = output->numSamples;
+	myOutRate = output->sampleRate;
+
+	// The router has its own mapping
+	if (mode == Mode::Route)
+		return;
+
+	uint64_t key = layoutKey(output, match);
+	if (!myLayoutValid || key != myLayoutKey || myNumChannels != output->numChannels)
+	{
+		remap(output, match);
+		myLayoutKey = key;
+		myLayoutValid = true;
+	}
+}
+
+uint64_t
+InputMixer::layoutKey(const CHOP_Output* output, Match match) const
+{
+	uint64_t key = CookCache::mix((uint64_t)0, (uint64_t)match);
+	key = CookCache::mix(key, (uint64_t)output->numChannels);
+	for (const OP_CHOPInput* in : myInputs)
+	{
+		key = CookCache::mix(key, (uint64_t)in->opId);
+		key = CookCache::mix(key, (uint64_t)(uint32_t)in->numChannels);
+	}
+
+	// Matching by name has to notice a rename. That's one pass over the
+	// names each cook, much less than remapping.
+	if (match == Match::Name)
+	{
+		for (int32_t c = 0; c < output->numChannels; c++)
+			key = CookCache::hash(output->names[c], strlen(output->names[c]), key);
+		for (const OP_CHOPInput* in : myInputs)
+		{
+			for (int32_t c = 0; c < in->numChannels; c++)
+			{
+				const char* name = in->getChannelName(c);
+				key = CookCache::hash(name, strlen(name), key);
+			}
+		}
+	}
+	return key;
+}
+
+void
+InputMixer::remap(const CHOP_Output* output, Match match)
+{
+	int32_t numInputs = (int32_t)myInputs.size();
+	myNumChannels = output->numChannels;
+	mySources.assign(size_t(myNumChannels) * numInputs, -1);
+	myRemaps++;
+
+	for (int32_t k = 0; k < numInputs; k++)
+	{
+		const OP_CHOPInput* in = myInputs[k];
+
+		// Mono inputs feed every channel
+		if (in->numChannels == 1)
+		{
+			for (int32_t c = 0; c < myNumChannels; c++)
+				mySources[size_t(c) * numInputs + k] = 0;
+			continue;
+		}
+
+		if (match == Match::Index)
+		{
+			for (int32_t c = 0; c < myNumChannels && c < in->numChannels; c++)
+				mySources[size_t(c) * numInputs + k] = c;
+			continue;
+		}
+
+		std::unordered_map<std::string, int32_t> byName;
+		byName.reserve(in->numChannels);
+		for (int32_t c = in->numChannels - 1; c >= 0; c--)
+			byName[in->getChannelName(c)] = c;
+
+		for (int32_t c = 0; c < myNumChannels; c++)
+		{
+			auto it = byName.find(output->names[c]);
+			if (it != byName.end())
+				mySources[size_t(c) * numInputs + k] = it->second;
+		}
+	}
+}
+
+double
+InputMixer::resampleDelay() const
+{
+	double longest = 0.0;
+	for (size_t k = 0; k < myInputs.size(); k++)
+	{
+		const Resampler* r = ring(int32_t(k)).resampler();
+		if (r && r->delay() / r->inputRate() > longest)
+			longest = r->delay() / r->inputRate();
+	}
+	return longest;
+}
+
+void
+InputMixer::appendChannels(int32_t k, int32_t begin, int32_t end)
+{
+	for (int32_t c = begin; c < end; c++)
+		ring(k).appendChannel(c);
+}
+
+const float*
+InputMixer::window(int32_t k, int32_t channel) const
+{
+	return ring(k).window(channel, myOutStart, myOutSamples, myOutRate);
+}
+
+void
+InputMixer::windows(int32_t k, const int32_t* channels, int32_t count, const float** dst) const
+{
+	ring(k).windows(channels, count, dst, myOutStart, myOutSamples, myOutRate);
+}
+
+void
+InputMixer::readInput(int32_t k, int32_t channel, float* dst, const ChannelKernels& kernels,
+					  ScratchArena::Buffer<float>& assembly) const
+{
+	ring(k).readChannel(channel, dst, myOutStart, myOutSamples, myOutRate, 1.0f, kernels,
+						   assembly);
+}
+
+uint64_t
+InputMixer::hashSources(int32_t channel) const
+{
+	int32_t numInputs = (int32_t)myInputs.size();
+	uint64_t h = (uint64_t)channel;
+	for (int32_t k = 0; k < numInputs; k++)
+	{
+		int32_t src = mySources[size_t(channel) * numInputs + k];
+		if (src < 0)
+			continue;
+		const OP_CHOPInput* in = myInputs[k];
+		h = CookCache::hash(in->getChannelData(src), sizeof(float) * in->numSamples, h);
+	}
+	return h;
+}
+
+template <InputMixer::Mode M, bool Unity>
+void
+InputMixer::mixChannelT(const InputMixer& mixer, int32_t channel, float* dst,
+						Scratch& scratch, const ChannelKernels& kernels)
+{
+	int32_t numInputs = (int32_t)mixer.myInputs.size();
+	int32_t numSamples = mixer.myOutSamples;
+
+	// One input, its gain is always 1, so the samples are copied or scaled
+	// straight into the output
+	if (M == Mode::First)
+	{
+		int32_t src = numInputs > 0 ? mixer.mySources[size_t(channel) * numInputs] : -1;
+		if (src < 0)
+		{
+			memset(dst, 0, sizeof(float) * numSamples);
+			return;
+		}
+
+		const InputRing& ring = mixer.ring(0);
+		const float* p = ring.window(src, mixer.myOutStart, numSamples, mixer.myOutRate);
+		if (!p)
+			ring.readChannel(src, dst, mixer.myOutStart, numSamples, mixer.myOutRate,
+							 Unity ? 1.0f : mixer.myScale, kernels, scratch.assembly);
+		else if (Unity)
+			memcpy(dst, p, sizeof(float) * numSamples);
+		else
+			kernels.scale(dst, p, numSamples, mixer.myScale);
+		return;
+	}
+
+	const float* srcs[MaxInputs];
+	float gains[MaxInputs];
+	int32_t n = 0;
+	float total = 0.0f;
+
+	for (int32_t k = 0; k < numInputs; k++)
+	{
+		int32_t src = mixer.mySources[size_t(channel) * numInputs + k];
+		if (src < 0)
+			continue;
+
+		const float* p = mixer.ring(k).window(src, mixer.myOutStart, numSamples, mixer.myOutRate);
+		if (!p)
+		{
+			// Sized for every input at once so earlier pointers stay valid
+			float* tmp = scratch.inputs.get(size_t(numInputs) * numSamples) + size_t(k) * numSamples;
+			mixer.ring(k).readChannel(src, tmp, mixer.myOutStart, numSamples, mixer.myOutRate,
+										 1.0f, kernels, scratch.assembly);
+			p = tmp;
+		}
+
+		srcs[n] = p;
+		gains[n] = mixer.myGains[k];
+		total += mixer.myGains[k];
+		n++;
+	}
+
+	float norm = Unity ? 1.0f : mixer.myScale;
+	if (M == Mode::Average && total != 0.0f)
+		norm /= total;
+	if (M == Mode::Average || !Unity)
+	{
+		for (int32_t i = 0; i < n; i++)
+			gains[i] *= norm;
+	}
+
+	kernels.mix(dst, srcs, gains, n, numSamples);
+}
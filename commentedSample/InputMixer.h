@@ -0,0 +1,174 @@
+/*
+	Mixes every connected input CHOP into the output, with a gain per input.
+
+	Each output channel is fed by at most one channel of every input:
+	- an input with a single channel is broadcast to every output channel,
+	- otherwise the channel is found by index (output channel 3 takes
+	  channel 3 of every input that has one) or by name.
+	That mapping is only worked out again when the inputs or the matching
+	mode change, not every cook.
+
+	Every input has its own InputRing, so inputs with different timeslices
+	are still lined up by their startIndex. The samples are then summed
+	straight out of the inputs with ChannelKernels::mix, one pass over the
+	output channel no matter how many inputs there are. Only an input whose
+	window isn't contiguous (it lags the output) is copied to scratch first.
+*/
+
+#ifndef __InputMixer__
+#define __InputMixer__
+
+#include "CHOP_CPlusPlusBase.h"
+#include "InputRing.h"
+
+#include <stdint.h>
+#include <vector>
+
+class ChannelKernels;
+
+class InputMixer
+{
+public:
+	// Matches the order of the "Mix" menu
+	enum class Mode : int32_t
+	{
+		// Only the first input, multiplied by the scale
+		First = 0,
+
+		// gain[0] * input[0] + gain[1] * input[1] + ...
+		Sum,
+
+		// The sum divided by the gains of the inputs that feed the channel
+		Average,
+
+		// Only the first input, routed to the output by a ChannelRouter
+		Route,
+	};
+
+	// Matches the order of the "Match" menu
+	enum class Match : int32_t
+	{
+		Index = 0,
+		Name,
+	};
+
+	// Inputs past this many are ignored
+	static const int32_t	MaxInputs = 64;
+
+	InputMixer();
+
+	// The input whose channels the output has in this mode, the one with
+	// the most channels when mixing. Used from getOutputInfo().
+	static int32_t		widestInput(OP_Inputs* inputs, Mode mode);
+
+	// Sets up this cook: one ring per input, and which channel of every
+	// input feeds each output channel. 'gains' holds a gain per input,
+	// inputs past 'numGains' get a gain of 1. Everything is also multiplied
+	// by 'scale'.
+	void				prepare(OP_Inputs* inputs, const CHOP_Output* output, Mode mode,
+								Match match, const double* gains, int32_t numGains,
+								float scale);
+
+	int32_t				numInputs() const { return (int32_t)myInputs.size(); }
+	const OP_CHOPInput*	input(int32_t k) const { return myInputs[k]; }
+
+	// True if input k has new samples for its ring this cook
+	bool				needsAppend(int32_t k) const { return ring(k).appended() > 0; }
+
+	// Number of new samples per channel input k has for its ring this cook
+	int64_t				appended(int32_t k) const { return ring(k).appended(); }
+
+	// True if input k's startIndex changed since the last cook, as it does
+	// every cook for a streaming timesliced input
+	bool				moved(int32_t k) const { return ring(k).moved(); }
+
+	// Copies the new samples of input k's channels [begin, end) into its
+	// ring. Safe to call for different channels from different threads.
+	void				appendChannels(int32_t k, int32_t begin, int32_t end);
+
+	// A fingerprint of every input sample feeding output channel c, for
+	// the cook cache
+	uint64_t			hashSources(int32_t channel) const;
+
+	// This cook's samples of channel c of input k, straight from the input
+	// or its ring. nullptr when they aren't contiguous, then readInput()
+	// assembles them.
+	const float*		window(int32_t k, int32_t channel) const;
+	void				windows(int32_t k, const int32_t* channels, int32_t count,
+								const float** dst) const;
+	void				readInput(int32_t k, int32_t channel, float* dst,
+								  const ChannelKernels& kernels,
+								  ScratchArena::Buffer<float>& assembly) const;
+
+	// Where mixChannel() puts the samples of inputs that have to be
+	// assembled first. One per thread, the buffers are only taken from the
+	// arena when a channel needs them.
+	struct Scratch
+	{
+		explicit Scratch(ScratchArena& arena) :
+			inputs(arena),
+			assembly(arena)
+		{
+		}
+
+		ScratchArena::Buffer<float>	inputs;
+		ScratchArena::Buffer<float>	assembly;
+	};
+
+	// Writes output channel c. Runs the loop prepare() picked for the mode
+	// and scale.
+	void				mixChannel(int32_t channel, float* dst, Scratch& scratch,
+								   const ChannelKernels& kernels) const
+						{
+							myChannelKernel(*this, channel, dst, scratch, kernels);
+						}
+
+	// Number of times the channel mapping was worked out again
+	int64_t				remaps() const { return myRemaps; }
+
+	// How far the output lags the inputs resampled to its rate, in seconds.
+	// The longest of any input, 0 when none is resampled.
+	double				resampleDelay() const;
+
+private:
+	typedef void		(*ChannelKernel)(const InputMixer& mixer, int32_t channel, float* dst,
+										 Scratch& scratch, const ChannelKernels& kernels);
+
+	// mixChannel() for one mode, with a scale of 1 or any other
+	template <Mode M, bool Unity>
+	static void			mixChannelT(const InputMixer& mixer, int32_t channel, float* dst,
+									Scratch& scratch, const ChannelKernels& kernels);
+
+	// The ring of input k, which belongs to its input slot
+	InputRing&			ring(int32_t k) { return myRings[mySlots[k]]; }
+	const InputRing&	ring(int32_t k) const { return myRings[mySlots[k]]; }
+
+	uint64_t			layoutKey(const CHOP_Output* output, Match match) const;
+	void				remap(const CHOP_Output* output, Match match);
+
+	std::vector<const OP_CHOPInput*>	myInputs;
+
+	// The input slot each of myInputs is connected to, empty slots are
+	// left out of myInputs. myRings is indexed by slot.
+	std::vector<int32_t>				mySlots;
+	std::vector<InputRing>				myRings;
+	std::vector<float>					myGains;
+
+	Mode								myMode;
+	float								myScale;
+	ChannelKernel						myChannelKernel;
+
+	double								myOutStart;
+	int32_t								myOutSamples;
+	double								myOutRate;
+
+	// numChannels x numInputs, the input channel feeding each output
+	// channel or -1
+	std::vector<int32_t>				mySources;
+	int32_t								myNumChannels;
+	uint64_t							myLayoutKey;
+	bool								myLayoutValid;
+	int64_t								myRemaps;
+};
+
+#endif
@@ -0,0 +1,316 @@
+#include "InputRing.h"
+#include "ChannelKernels.h"
+#include "Resampler.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+static const int64_t	MinCapacity = 256;
+
+InputRing::InputRing() :
+	myInput(nullptr),
+	myOpId(0),
+	myNumChannels(0),
+	mySampleRate(0.0),
+	myResampler(nullptr),
+	myInStart(0),
+	myInEnd(0),
+	myMoved(false),
+	myStart(0),
+	myEnd(0),
+	myCopyFrom(0),
+	myCopyTo(0),
+	myCapacity(0),
+	myResets(0)
+{
+}
+
+void
+InputRing::grow(int64_t capacity)
+{
+	int64_t cap = myCapacity > 0 ? myCapacity : MinCapacity;
+	while (cap < capacity)
+		cap *= 2;
+	if (cap == myCapacity && myData.size() == size_t(cap) * myNumChannels)
+		return;
+
+	// Move what the ring holds into the new layout, positions are just the
+	// absolute index masked by the capacity.
+	std::vector<float> data(size_t(cap) * myNumChannels, 0.0f);
+	if (myCapacity > 0 && myData.size() == size_t(myCapacity) * myNumChannels)
+	{
+		for (int32_t c = 0; c < myNumChannels; c++)
+		{
+			const float* src = &myData[size_t(c) * myCapacity];
+			float* dst = &data[size_t(c) * cap];
+			for (int64_t a = myStart; a < myEnd; a++)
+				dst[a & (cap - 1)] = src[a & (myCapacity - 1)];
+		}
+	}
+	else
+	{
+		myStart = myEnd;
+	}
+	myData.swap(data);
+	myCapacity = cap;
+}
+
+void
+InputRing::begin(const OP_CHOPInput* input, double outputStart, int32_t outputSamples,
+				 double outputRate)
+{
+	myInput = input;
+	int64_t inStart = (int64_t)floor(input->startIndex + 0.5);
+	int64_t inEnd = inStart + input->numSamples;
+
+	bool reset = input->opId != myOpId || input->numChannels != myNumChannels ||
+				 input->sampleRate != mySampleRate || inEnd < myStart;
+	myMoved = reset || inStart != myInStart;
+	if (reset)
+	{
+		myOpId = input->opId;
+		myNumChannels = input->numChannels;
+		mySampleRate = input->sampleRate;
+		myStart = inStart;
+		myEnd = inStart;
+		myCapacity = 0;
+		myResets++;
+	}
+
+	// The output's rate is only a float, so allow for rounding
+	if (outputRate > 0.0 && fabs(outputRate - mySampleRate) > 1e-6 * mySampleRate)
+	{
+		if (!myResampler || myResampler->inputRate() != mySampleRate ||
+			myResampler->outputRate() != outputRate)
+			myResampler = &Resampler::get(mySampleRate, outputRate);
+	}
+	else
+	{
+		myResampler = nullptr;
+	}
+
+	// Enough history for a few cooks' worth of either window, and the
+	// resampler's reach back from the first of them
+	int64_t need = 2 * (int64_t)(input->numSamples > outputSamples ? input->numSamples : outputSamples);
+	if (myResampler)
+		need += myResampler->taps();
+	grow(need);
+
+	// The output moves forward, so nothing before the end of this cook's
+	// window will be asked for again. Only the samples the input has
+	// delivered past that point need to go in the ring; when the input and
+	// output windows line up that's none at all. Resampling, the next
+	// cook's first sample reaches back a filter's length from there.
+	int64_t keep, used;
+	if (myResampler)
+	{
+		int64_t count;
+		int64_t start = (int64_t)floor(outputStart + 0.5);
+		myResampler->span(start + outputSamples, 1, keep, count);
+		myResampler->span(start, outputSamples, used, count);
+	}
+	else
+	{
+		double ratio = outputRate > 0.0 ? mySampleRate / outputRate : 1.0;
+		keep = (int64_t)floor((outputStart + outputSamples) * ratio + 1e-9);
+		used = (int64_t)floor(outputStart * ratio + 1e-9);
+	}
+
+	int64_t from = myEnd;
+	if (from < inStart)
+		from = inStart;
+	if (from < keep)
+		from = keep < inEnd ? keep : inEnd;
+	if (from > myEnd)
+	{
+		// This cook still reads what the ring holds, so the ring carries on
+		// through the input up to where it's needed. Otherwise everything in
+		// it has been used, start it again here.
+		if (used < myEnd && myEnd >= inStart)
+		{
+			from = myEnd;
+		}
+		else
+		{
+			myStart = from;
+			myEnd = from;
+		}
+	}
+
+	myInStart = inStart;
+	myInEnd = inEnd;
+	myCopyFrom = from;
+	myCopyTo = inEnd > from ? inEnd : from;
+	if (myCopyTo - myCopyFrom > myCapacity)
+		myCopyFrom = myCopyTo - myCapacity;
+
+	if (myCopyTo > myEnd)
+		myEnd = myCopyTo;
+	if (myStart < myEnd - myCapacity)
+		myStart = myEnd - myCapacity;
+}
+
+void
+InputRing::appendChannel(int32_t channel)
+{
+	if (myCopyTo <= myCopyFrom)
+		return;
+
+	const float* src = myInput->getChannelData(channel) + (myCopyFrom - myInStart);
+	float* ring = &myData[size_t(channel) * myCapacity];
+	int64_t mask = myCapacity - 1;
+
+	// At most two copies, split where the ring wraps
+	int64_t a = myCopyFrom;
+	while (a < myCopyTo)
+	{
+		int64_t pos = a & mask;
+		int64_t run = myCapacity - pos;
+		if (run > myCopyTo - a)
+			run = myCopyTo - a;
+		memcpy(ring + pos, src, sizeof(float) * run);
+		src += run;
+		a += run;
+	}
+}
+
+const float*
+InputRing::locate(int32_t channel, int64_t a, int64_t& run) const
+{
+	if (a >= myInStart && a < myInEnd)
+	{
+		run = myInEnd - a;
+		return myInput->getChannelData(channel) + (a - myInStart);
+	}
+
+	if (a >= myStart && a < myEnd)
+	{
+		int64_t pos = a & (myCapacity - 1);
+		run = myEnd - a;
+		if (run > myCapacity - pos)
+			run = myCapacity - pos;
+		if (a < myInStart && run > myInStart - a)
+			run = myInStart - a;
+		return &myData[size_t(channel) * myCapacity + pos];
+	}
+
+	int64_t first = myStart < myInStart ? myStart : myInStart;
+	run = a < first ? first - a : INT64_MAX;
+	return nullptr;
+}
+
+const float*
+InputRing::window(int32_t channel, double startIndex, int32_t numSamples,
+				  double sampleRate) const
+{
+	if (sampleRate > 0.0 && fabs(sampleRate - mySampleRate) > 1e-6 * mySampleRate)
+		return nullptr;
+
+	int64_t run;
+	const float* p = locate(channel, (int64_t)floor(startIndex + 0.5), run);
+	return p && run >= numSamples ? p : nullptr;
+}
+
+void
+InputRing::windows(const int32_t* channels, int32_t count, const float** dst,
+				   double startIndex, int32_t numSamples, double sampleRate) const
+{
+	if (count < 1)
+		return;
+
+	// Where the first one is, as an offset into the input or the ring
+	const float* first = window(channels[0], startIndex, numSamples, sampleRate);
+	if (!first)
+	{
+		for (int32_t i = 0; i < count; i++)
+			dst[i] = nullptr;
+		return;
+	}
+
+	int64_t a = (int64_t)floor(startIndex + 0.5);
+	if (a >= myInStart && a < myInEnd)
+	{
+		for (int32_t i = 0; i < count; i++)
+			dst[i] = myInput->getChannelData(channels[i]) + (a - myInStart);
+	}
+	else
+	{
+		ptrdiff_t pos = first - &myData[size_t(channels[0]) * myCapacity];
+		for (int32_t i = 0; i < count; i++)
+			dst[i] = &myData[size_t(channels[i]) * myCapacity + pos];
+	}
+}
+
+float
+InputRing::sampleAt(int32_t channel, int64_t a) const
+{
+	int64_t first = myStart < myInStart ? myStart : myInStart;
+	int64_t last = (myEnd > myInEnd ? myEnd : myInEnd) - 1;
+	if (last < first)
+		return 0.0f;
+	if (a < first)
+		a = first;
+	if (a > last)
+		a = last;
+
+	int64_t run;
+	const float* p = locate(channel, a, run);
+	return p ? *p : 0.0f;
+}
+
+void
+InputRing::readChannel(int32_t channel, float* dst, double startIndex, int32_t numSamples,
+					   double sampleRate, float scale, const ChannelKernels& kernels,
+					   ScratchArena::Buffer<float>& assembly) const
+{
+	int64_t start = (int64_t)floor(startIndex + 0.5);
+	if (sampleRate > 0.0 && fabs(sampleRate - mySampleRate) > 1e-6 * mySampleRate)
+	{
+		const Resampler& resampler = myResampler && myResampler->outputRate() == sampleRate ?
+									 *myResampler : Resampler::get(mySampleRate, sampleRate);
+
+		// The input samples the filter needs are usually in one piece,
+		// otherwise they're put together first
+		int64_t first, count;
+		resampler.span(start, numSamples, first, count);
+		int64_t run;
+		const float* src = locate(channel, first, run);
+		if (!src || run < count)
+		{
+			float* assembled = assembly.get(size_t(count));
+			readSamples(channel, assembled, first, (int32_t)count, 1.0f, kernels);
+			src = assembled;
+		}
+		resampler.process(dst, start, numSamples, src, scale);
+		return;
+	}
+
+	readSamples(channel, dst, start, numSamples, scale, kernels);
+}
+
+void
+InputRing::readSamples(int32_t channel, float* dst, int64_t a, int32_t numSamples, float scale,
+					   const ChannelKernels& kernels) const
+{
+	int32_t j = 0;
+	while (j < numSamples)
+	{
+		int64_t run;
+		const float* p = locate(channel, a, run);
+		int32_t take = run < numSamples - j ? (int32_t)run : numSamples - j;
+
+		if (p)
+		{
+			kernels.scale(dst + j, p, take, scale);
+		}
+		else
+		{
+			float v = sampleAt(channel, a) * scale;
+			for (int32_t k = 0; k < take; k++)
+				dst[j + k] = v;
+		}
+		j += take;
+		a += take;
+	}
+}
@@ -0,0 +1,132 @@
+/*
+	Timeslice-aware history of an input CHOP, for the pass-through branch of
+	the example.
+
+	Every sample is addressed by its absolute index on the input's timeline
+	(OP_CHOPInput::startIndex + i). The output window (CHOP_Output::startIndex,
+	numSamples) is read back from the input and the ring by index, so the
+	output lines up with the input no matter how many samples a cook covers,
+	including cooks that cover several frames after dropped frames.
+
+	Each cook only appends samples that are new and that the output hasn't
+	reached yet, one ring per channel. When the input runs ahead of the
+	output those samples are output on a later cook; when the two line up,
+	as they normally do, nothing is copied at all.
+
+	Samples inside the input's current window are always read straight from
+	the input, which keeps a non-timesliced input that is being edited up to
+	date. The ring only serves the history before that window. Indexes before
+	the first sample seen or after the last one hold that first/last sample.
+
+	When the output's rate isn't the input's, every output sample is made
+	from the input samples around its time by a Resampler, which also keeps
+	enough history in the ring for the filter to reach back over cooks.
+*/
+
+#ifndef __InputRing__
+#define __InputRing__
+
+#include "CPlusPlus_Common.h"
+#include "ScratchArena.h"
+
+#include <stdint.h>
+#include <vector>
+
+class ChannelKernels;
+class Resampler;
+
+class InputRing
+{
+public:
+	InputRing();
+
+	// Works out which of the input's samples are new since the last cook
+	// and still needed, given the output window of this cook (in the
+	// output's rate). Starts over when the input is a different CHOP,
+	// changes channel count or rate, or jumps back before what the ring
+	// holds (the timeline moved).
+	void			begin(const OP_CHOPInput* input, double outputStart,
+						  int32_t outputSamples, double outputRate);
+
+	// Copies this channel's new samples into the ring. Different channels
+	// can be appended from different threads.
+	void			appendChannel(int32_t channel);
+
+	// Writes samples [startIndex, startIndex + numSamples) of the output's
+	// timeline to 'dst', multiplied by 'scale'. 'sampleRate' is the output's
+	// rate, the input is resampled to it when they differ. 'assembly' holds
+	// the input samples the resampler reads when they aren't in one piece.
+	// Call after appendChannel() for the same channel.
+	void			readChannel(int32_t channel, float* dst, double startIndex,
+								int32_t numSamples, double sampleRate, float scale,
+								const ChannelKernels& kernels,
+								ScratchArena::Buffer<float>& assembly) const;
+
+	// A pointer straight to samples [startIndex, startIndex + numSamples) of
+	// the output's timeline when they're contiguous in the input or the
+	// ring, which they normally are. nullptr when they aren't, or the rates
+	// differ, and readChannel() has to assemble them instead.
+	const float*	window(int32_t channel, double startIndex, int32_t numSamples,
+						   double sampleRate) const;
+
+	// window() of 'count' channels at once. Every channel's samples are in
+	// the same place, so where that is only has to be worked out once.
+	void			windows(const int32_t* channels, int32_t count, const float** dst,
+							double startIndex, int32_t numSamples, double sampleRate) const;
+
+	// Number of new samples per channel found by the last begin()
+	int64_t			appended() const { return myCopyTo - myCopyFrom; }
+
+	// True when the last begin() saw the input's window at a different
+	// startIndex than the one before, or a different input
+	bool			moved() const { return myMoved; }
+
+	// Number of times the ring started over
+	int64_t			resets() const { return myResets; }
+
+	// What converts the input to the output's rate, nullptr when the rates
+	// are the same
+	const Resampler*	resampler() const { return myResampler; }
+
+private:
+	// Where the sample at absolute index 'a' lives. 'run' is how many
+	// samples from 'a' on are contiguous there. Returns nullptr when nothing
+	// holds 'a', with 'run' the distance to the first sample that exists.
+	const float*	locate(int32_t channel, int64_t a, int64_t& run) const;
+
+	float			sampleAt(int32_t channel, int64_t a) const;
+
+	// Input samples [a, a + numSamples), at the input's rate
+	void			readSamples(int32_t channel, float* dst, int64_t a, int32_t numSamples,
+								float scale, const ChannelKernels& kernels) const;
+
+	void			grow(int64_t capacity);
+
+	const OP_CHOPInput*		myInput;
+
+	uint32_t				myOpId;
+	int32_t					myNumChannels;
+	double					mySampleRate;
+	const Resampler*		myResampler;
+
+	// The current input window
+	int64_t					myInStart;
+	int64_t					myInEnd;
+	bool					myMoved;
+
+	// What the ring holds, [myStart, myEnd)
+	int64_t					myStart;
+	int64_t					myEnd;
+
+	// What appendChannel() copies this cook
+	int64_t					myCopyFrom;
+	int64_t					myCopyTo;
+
+	// Power of two, per channel
+	int64_t					myCapacity;
+	std::vector<float>		myData;
+
+	int64_t					myResets;
+};
+
+#endif
@@ -0,0 +1,110 @@
+/*
+	A fixed size, lock-free queue for any number of producing threads and
+	one consuming thread.
+
+	Every cell carries a sequence number saying whose turn it is. A producer
+	claims the next cell with a compare-and-swap on myHead, fills it in and
+	then sets the cell's sequence to say it's ready, so producers never wait
+	for each other while writing and the consumer never sees a half written
+	item. The consumer alone moves myTail, and hands the cell back to the
+	producers a whole lap later by setting its sequence again.
+
+	A producer that has claimed a cell but not finished writing it holds up
+	the consumer at that cell, the items after it are popped once it's done.
+	Indexes run freely and are masked by the capacity, which must be a power
+	of two.
+*/
+
+#ifndef __MpscQueue__
+#define __MpscQueue__
+
+#include <atomic>
+#include <stdint.h>
+
+template <typename T, int32_t Capacity>
+class MpscQueue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	MpscQueue() :
+		myHead(0),
+		myTail(0)
+	{
+		for (int32_t i = 0; i < Capacity; i++)
+			myCells[i].sequence.store(uint64_t(i), std::memory_order_relaxed);
+	}
+
+	// Any thread. False when the queue is full.
+	bool
+	push(const T& item)
+	{
+		uint64_t head = myHead.load(std::memory_order_relaxed);
+		Cell* cell;
+		for (;;)
+		{
+			cell = &myCells[head & (Capacity - 1)];
+			uint64_t sequence = cell->sequence.load(std::memory_order_acquire);
+			int64_t diff = int64_t(sequence - head);
+			if (diff == 0)
+			{
+				// On failure 'head' is reloaded with the cell another producer
+				// got to first
+				if (myHead.compare_exchange_weak(head, head + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				// Still holding the item pushed a lap ago
+				return false;
+			}
+			else
+			{
+				head = myHead.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->item = item;
+		cell->sequence.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only. False when the queue is empty, or the next item's
+	// producer hasn't finished writing it.
+	bool
+	pop(T& item)
+	{
+		uint64_t tail = myTail.load(std::memory_order_relaxed);
+		Cell& cell = myCells[tail & (Capacity - 1)];
+		if (cell.sequence.load(std::memory_order_acquire) != tail + 1)
+			return false;
+		item = cell.item;
+		cell.sequence.store(tail + Capacity, std::memory_order_release);
+		myTail.store(tail + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Either side, only a hint while producers are running
+	bool
+	empty() const
+	{
+		return myHead.load(std::memory_order_acquire) == myTail.load(std::memory_order_acquire);
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<uint64_t>	sequence;
+		T						item;
+	};
+
+	// Padded rather than alignas(64), so the owner can still be created with
+	// a plain new before C++17
+	std::atomic<uint64_t>	myHead;
+	char					myHeadPad[64 - sizeof(std::atomic<uint64_t>)];
+	std::atomic<uint64_t>	myTail;
+	char					myTailPad[64 - sizeof(std::atomic<uint64_t>)];
+	Cell					myCells[Capacity];
+};
+
+#endif
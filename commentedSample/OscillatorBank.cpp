@@ -0,0 +1,399 @@
+#include "OscillatorBank.h"
+#include "ChannelKernels.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifdef CK_X86
+	#include <immintrin.h>
+#endif
+
+
+// The sine kernels below work on a phase measured in cycles, as 32-bit
+// fixed point with 2^32 to a cycle. sinePhases() works out every sample's
+// from its 64-bit phase, the kernels take the top 24 bits of each as t in
+// [0, 1) exactly as a float and compute sin(2*pi*t). With Unity the scale
+// is 1 and the multiply is left out.
+//
+// Every sample's value only depends on its own phase, never on where the
+// block it's in started, so the output is the same bits however the
+// samples are split into cooks, and whether myAsync or the cook rendered
+// them. That's also why the polynomial is evaluated with a separate
+// multiply and add at every level, never a fused one: AVX2 and AVX-512
+// would otherwise round differently from the scalar code that does their
+// last few samples. CMakeLists.txt stops the compiler fusing them itself.
+
+// Samples whose cycle phases are worked out at once
+static const int32_t	MaxBlock = 256;
+
+// 2^32 / (2*pi), rounded: a phase times this has the phase in cycles, as
+// 2^32 to a cycle, in its top 32 bits. Rounding it makes the sine's period
+// 6e-10 of itself too short, far below anything that could be heard or seen.
+static const uint64_t	CyclesPerUnit = 683565276;
+
+// 2^-24, from the top 24 bits of a 32-bit phase to cycles
+static const float		CycleScale = 1.0f / 16777216.0f;
+
+// sin(2*pi*u) for u in [-0.25, 0.25], as an odd polynomial (Taylor series of
+// sin to the 11th power). Error is below 1e-7 over the range.
+static const float		S1 = 6.28318530718f;
+static const float		S3 = -41.3417022404f;
+static const float		S5 = 81.6052492761f;
+static const float		S7 = -76.7058597531f;
+static const float		S9 = 42.0586939449f;
+static const float		S11 = -15.0946425768f;
+
+
+static inline float
+sinCycles(float t)
+{
+	// Move t from [0, 1) to u in [-0.5, 0.5), where sin(2*pi*t) = -sin(2*pi*u),
+	// then fold u into [-0.25, 0.25] using sin(pi - a) = sin(a).
+	float u = t - 0.5f;
+	float a = fabsf(u);
+	a = a < 0.5f - a ? a : 0.5f - a;
+	u = u < 0.0f ? -a : a;
+	float u2 = u * u;
+	float p = S9 + u2 * S11;
+	p = S7 + u2 * p;
+	p = S5 + u2 * p;
+	p = S3 + u2 * p;
+	p = S1 + u2 * p;
+	return -u * p;
+}
+
+template <bool Unity>
+static void
+sineScalar(float* dst, int32_t n, const uint32_t* cycles, float scale)
+{
+	for (int32_t j = 0; j < n; j++)
+	{
+		float v = sinCycles((float)(cycles[j] >> 8) * CycleScale);
+		dst[j] = Unity ? v : v * scale;
+	}
+}
+
+
+#ifdef CK_X86
+
+static inline __m128
+sinCyclesSSE2(__m128 t)
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+
+	__m128 u = _mm_sub_ps(t, half);
+	__m128 sign = _mm_and_ps(u, signBit);
+	__m128 a = _mm_andnot_ps(signBit, u);
+	a = _mm_min_ps(a, _mm_sub_ps(half, a));
+	u = _mm_or_ps(a, sign);
+
+	__m128 u2 = _mm_mul_ps(u, u);
+	__m128 p = _mm_add_ps(_mm_set1_ps(S9), _mm_mul_ps(u2, _mm_set1_ps(S11)));
+	p = _mm_add_ps(_mm_set1_ps(S7), _mm_mul_ps(u2, p));
+	p = _mm_add_ps(_mm_set1_ps(S5), _mm_mul_ps(u2, p));
+	p = _mm_add_ps(_mm_set1_ps(S3), _mm_mul_ps(u2, p));
+	p = _mm_add_ps(_mm_set1_ps(S1), _mm_mul_ps(u2, p));
+	return _mm_xor_ps(_mm_mul_ps(u, p), signBit);
+}
+
+template <bool Unity>
+static void
+sineSSE2(float* dst, int32_t n, const uint32_t* cycles, float scale)
+{
+	const __m128 s = _mm_set1_ps(scale);
+	const __m128 toCycles = _mm_set1_ps(CycleScale);
+
+	int32_t j = 0;
+	for (; j + 4 <= n; j += 4)
+	{
+		__m128i c = _mm_loadu_si128((const __m128i*)(cycles + j));
+		__m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(c, 8)), toCycles);
+		__m128 v = sinCyclesSSE2(t);
+		_mm_storeu_ps(dst + j, Unity ? v : _mm_mul_ps(v, s));
+	}
+	sineScalar<Unity>(dst + j, n - j, cycles + j, scale);
+}
+
+
+CK_TARGET("avx2") static inline __m256
+sinCyclesAVX2(__m256 t)
+{
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 signBit = _mm256_set1_ps(-0.0f);
+
+	__m256 u = _mm256_sub_ps(t, half);
+	__m256 sign = _mm256_and_ps(u, signBit);
+	__m256 a = _mm256_andnot_ps(signBit, u);
+	a = _mm256_min_ps(a, _mm256_sub_ps(half, a));
+	u = _mm256_or_ps(a, sign);
+
+	__m256 u2 = _mm256_mul_ps(u, u);
+	__m256 p = _mm256_add_ps(_mm256_set1_ps(S9), _mm256_mul_ps(u2, _mm256_set1_ps(S11)));
+	p = _mm256_add_ps(_mm256_set1_ps(S7), _mm256_mul_ps(u2, p));
+	p = _mm256_add_ps(_mm256_set1_ps(S5), _mm256_mul_ps(u2, p));
+	p = _mm256_add_ps(_mm256_set1_ps(S3), _mm256_mul_ps(u2, p));
+	p = _mm256_add_ps(_mm256_set1_ps(S1), _mm256_mul_ps(u2, p));
+	return _mm256_xor_ps(_mm256_mul_ps(u, p), signBit);
+}
+
+template <bool Unity>
+CK_TARGET("avx2") static void
+sineAVX2(float* dst, int32_t n, const uint32_t* cycles, float scale)
+{
+	const __m256 s = _mm256_set1_ps(scale);
+	const __m256 toCycles = _mm256_set1_ps(CycleScale);
+
+	int32_t j = 0;
+	for (; j + 8 <= n; j += 8)
+	{
+		__m256i c = _mm256_loadu_si256((const __m256i*)(cycles + j));
+		__m256 t = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(c, 8)), toCycles);
+		__m256 v = sinCyclesAVX2(t);
+		_mm256_storeu_ps(dst + j, Unity ? v : _mm256_mul_ps(v, s));
+	}
+	sineScalar<Unity>(dst + j, n - j, cycles + j, scale);
+}
+
+
+CK_TARGET("avx512f") static inline __m512
+sinCyclesAVX512(__m512 t)
+{
+	const __m512 half = _mm512_set1_ps(0.5f);
+	const __m512i signBit = _mm512_set1_epi32((int32_t)0x80000000);
+
+	// The sign goes back on as a bit like the other levels do, so a zero
+	// keeps its sign just the same
+	__m512 u = _mm512_sub_ps(t, half);
+	__m512i sign = _mm512_and_si512(_mm512_castps_si512(u), signBit);
+	__m512 a = _mm512_abs_ps(u);
+	a = _mm512_min_ps(a, _mm512_sub_ps(half, a));
+	u = _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(a), sign));
+
+	__m512 u2 = _mm512_mul_ps(u, u);
+	__m512 p = _mm512_add_ps(_mm512_set1_ps(S9), _mm512_mul_ps(u2, _mm512_set1_ps(S11)));
+	p = _mm512_add_ps(_mm512_set1_ps(S7), _mm512_mul_ps(u2, p));
+	p = _mm512_add_ps(_mm512_set1_ps(S5), _mm512_mul_ps(u2, p));
+	p = _mm512_add_ps(_mm512_set1_ps(S3), _mm512_mul_ps(u2, p));
+	p = _mm512_add_ps(_mm512_set1_ps(S1), _mm512_mul_ps(u2, p));
+	return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(_mm512_mul_ps(u, p)), signBit));
+}
+
+template <bool Unity>
+CK_TARGET("avx512f") static void
+sineAVX512(float* dst, int32_t n, const uint32_t* cycles, float scale)
+{
+	const __m512 s = _mm512_set1_ps(scale);
+	const __m512 toCycles = _mm512_set1_ps(CycleScale);
+
+	for (int32_t j = 0; j < n; j += 16)
+	{
+		__mmask16 m = n - j >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - j)) - 1);
+		__m512i c = _mm512_maskz_loadu_epi32(m, cycles + j);
+		__m512 t = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_srli_epi32(c, 8)), toCycles);
+		__m512 v = sinCyclesAVX512(t);
+		_mm512_mask_storeu_ps(dst + j, m, Unity ? v : _mm512_mul_ps(v, s));
+	}
+}
+
+#endif // CK_X86
+
+
+template <bool Unity>
+static OscillatorBank::SineKernel
+selectSine()
+{
+	switch (ChannelKernels::get().level)
+	{
+#ifdef CK_X86
+		case CPUFeatureLevel::AVX512:	return sineAVX512<Unity>;
+		case CPUFeatureLevel::AVX2:		return sineAVX2<Unity>;
+		case CPUFeatureLevel::SSE2:		return sineSSE2<Unity>;
+#endif
+		default:						return sineScalar<Unity>;
+	}
+}
+
+// Where each of the 'n' samples from 'phase' on is in the sine's cycle of
+// 2*pi units, 2^32 to a cycle. Multiplying wraps around at 2^64 the same
+// way adding does, so stepping gives every sample the same bits as
+// multiplying its own phase would, only faster, even where the phase
+// itself wraps.
+static inline void
+sinePhases(int64_t phase, int64_t step, int32_t n, uint32_t* cycles)
+{
+	uint64_t c = (uint64_t)phase * CyclesPerUnit;
+	uint64_t dc = (uint64_t)step * CyclesPerUnit;
+	for (int32_t j = 0; j < n; j++)
+	{
+		cycles[j] = (uint32_t)(c >> 32);
+		c += dc;
+	}
+}
+
+
+OscillatorBank::OscillatorBank() :
+	mySpread(0.0)
+{
+	myRenderer.range = nullptr;
+}
+
+int64_t
+OscillatorBank::toFixed(double units)
+{
+	return (int64_t)floor(units * 4294967296.0 + 0.5);
+}
+
+double
+OscillatorBank::toUnits(int64_t phase)
+{
+	return (double)phase / 4294967296.0;
+}
+
+int64_t
+OscillatorBank::advance(int64_t phase, int64_t step, int64_t numSamples)
+{
+	// Unsigned, so going past the end wraps instead of overflowing
+	return (int64_t)((uint64_t)phase + (uint64_t)step * (uint64_t)numSamples);
+}
+
+void
+OscillatorBank::setup(int32_t numChannels, int64_t offset, double spread)
+{
+	if (numChannels == (int32_t)myPhases.size() && spread == mySpread)
+		return;
+
+	myPhases.resize(numChannels);
+	mySpread = spread;
+	reset(offset);
+}
+
+void
+OscillatorBank::reset(int64_t offset)
+{
+	int64_t spread = toFixed(mySpread);
+	for (size_t i = 0; i < myPhases.size(); i++)
+		myPhases[i] = advance(offset, spread, (int64_t)i);
+}
+
+OscillatorBank::Renderer
+OscillatorBank::renderer(Shape shape, bool unity)
+{
+	// Every shape and scale has its own loop, each compiled with the shape
+	// and whether to scale fixed, so nothing inside them asks which shape
+	// it's drawing. The per sample kernels are picked for the CPU once.
+	static const RangeKernel ranges[5][2] =
+	{
+		{ renderRangeT<Shape::Sine, false>,		renderRangeT<Shape::Sine, true> },
+		{ renderRangeT<Shape::Square, false>,	renderRangeT<Shape::Square, true> },
+		{ renderRangeT<Shape::Ramp, false>,		renderRangeT<Shape::Ramp, true> },
+		{ renderRangeT<Shape::Triangle, false>,	renderRangeT<Shape::Triangle, true> },
+		{ renderRangeT<Shape::Table, false>,	renderRangeT<Shape::Table, true> },
+	};
+	static const SineKernel sines[2] = { selectSine<false>(), selectSine<true>() };
+
+	int32_t s = shape >= Shape::Sine && shape <= Shape::Table ? int32_t(shape) : 0;
+	Renderer r;
+	r.shape = Shape(s);
+	r.unity = unity;
+	r.range = ranges[s][unity];
+	r.sine = sines[unity];
+	r.lookup = WavetableEngine::lookupKernel(unity);
+	return r;
+}
+
+void
+OscillatorBank::select(Shape shape, float scale)
+{
+	bool unity = scale == 1.0f;
+	if (myRenderer.range && myRenderer.shape == shape && myRenderer.unity == unity)
+		return;
+	myRenderer = renderer(shape, unity);
+}
+
+void
+OscillatorBank::render(float** channels, int32_t numSamples, Shape shape,
+					   int64_t step, float scale)
+{
+	select(shape, scale);
+	renderRange(channels, 0, numChannels(), numSamples, step, scale);
+}
+
+void
+OscillatorBank::renderRange(float** channels, int32_t begin, int32_t end,
+							int32_t numSamples, int64_t step, float scale)
+{
+	myRenderer.range(*this, channels, begin, end, numSamples, step, scale);
+}
+
+template <OscillatorBank::Shape S, bool Unity>
+void
+OscillatorBank::renderRangeT(OscillatorBank& bank, float** channels, int32_t begin, int32_t end,
+							 int32_t numSamples, int64_t step, float scale)
+{
+	const Renderer& r = bank.myRenderer;
+
+	if (S == Shape::Sine)
+	{
+		uint32_t cycles[MaxBlock];
+		for (int32_t i = begin; i < end; i++)
+		{
+			int64_t phase = bank.myPhases[i];
+			for (int32_t j = 0; j < numSamples; j += MaxBlock)
+			{
+				int32_t n = numSamples - j < MaxBlock ? numSamples - j : MaxBlock;
+				sinePhases(advance(phase, step, j), step, n, cycles);
+				r.sine(channels[i] + j, n, cycles, scale);
+			}
+			bank.myPhases[i] = advance(phase, step, numSamples);
+		}
+		return;
+	}
+
+	// Every other shape has a cycle of 1 unit, so the fraction bits are
+	// already its position in the cycle, and the low 32 bits of the step
+	// move it on exactly. Every channel runs at the same rate, so they all
+	// read the same level of the table.
+	const float* level = bank.myWavetables.levelFor(WavetableEngine::Table(S), (uint32_t)step);
+	for (int32_t i = begin; i < end; i++)
+	{
+		float* dst = channels[i];
+		int64_t phase = bank.myPhases[i];
+		bank.myPhases[i] = advance(phase, step, numSamples);
+
+		if (!level)
+		{
+			memset(dst, 0, sizeof(float) * numSamples);
+			continue;
+		}
+		if (S != Shape::Square && S != Shape::Ramp)
+		{
+			r.lookup(dst, numSamples, level, (uint32_t)phase, (uint32_t)step, scale);
+			continue;
+		}
+
+		// Square and ramp use |phase| like fabs(fmod(offset, 1.0)) did, so
+		// split the block where the phase crosses zero and render each side
+		// with the phase running in the matching direction.
+		int32_t j = 0;
+		while (j < numSamples)
+		{
+			int64_t x = advance(phase, step, j);
+			int32_t stop = numSamples;
+			uint64_t run = UINT64_MAX;
+			if (x < 0 && step > 0)
+				run = (0 - (uint64_t)x + (uint64_t)step - 1) / (uint64_t)step;
+			else if (x >= 0 && step < 0)
+				run = (uint64_t)x / (0 - (uint64_t)step) + 1;
+			if (run > 0 && run < uint64_t(numSamples - j))
+				stop = j + (int32_t)run;
+
+			if (x < 0)
+				r.lookup(dst + j, stop - j, level, (uint32_t)(0 - (uint64_t)x),
+						 (uint32_t)(0 - (uint64_t)step), scale);
+			else
+				r.lookup(dst + j, stop - j, level, (uint32_t)x, (uint32_t)step, scale);
+			j = stop;
+		}
+	}
+}
@@ -0,0 +1,125 @@
+/*
+	A bank of oscillators, one per output channel, for the generator branch of
+	the example.
+
+	Every channel keeps its own phase accumulator which advances by 'step'
+	every sample, so each output sample gets its own value (the original loop
+	computed one value per channel per cook and held it for the whole block).
+
+	The sine is evaluated with a SIMD polynomial a block of samples at a
+	time, picked at runtime the same way as ChannelKernels. Every other shape
+	is read from the band-limited wavetables in WavetableEngine.
+
+	Phases are kept in the same units as the example's 'offset': the sine
+	has a period of 2*pi, the square and ramp a period of 1, and the square
+	and ramp mirror for negative phases just like fabs(fmod(offset, 1.0)).
+
+	They are 64-bit fixed point numbers rather than doubles, 32 bits of
+	whole units and 32 of fraction, so moving a phase on is an integer add
+	that's exact however long the generator has been running. A double
+	gets less precise as the phase grows, and sin() slower. The fraction
+	is already the position in a cycle of 1, so it goes straight to the
+	wavetable index. The sine multiplies the whole phase by 1/(2*pi) in
+	fixed point to get its cycle, which keeps it just as precise, and gives
+	every sample the same value however the samples are split into cooks.
+	A phase wraps around at 2^31 units, years at any sensible Speed.
+*/
+
+#ifndef __OscillatorBank__
+#define __OscillatorBank__
+
+#include "WavetableEngine.h"
+
+#include <stdint.h>
+#include <vector>
+
+class OscillatorBank
+{
+public:
+	// Matches the order of the "Shape" menu
+	enum class Shape : int32_t
+	{
+		Sine = 0,
+		Square,
+		Ramp,
+		Triangle,
+		Table,
+	};
+
+	// Bits of a phase after the point
+	static const int32_t	FracBits = 32;
+
+	OscillatorBank();
+
+	// Converts between the example's offset units and fixed point phases.
+	// Offsets and steps are worked out with these once, after that they
+	// only ever get added.
+	static int64_t	toFixed(double units);
+	static double	toUnits(int64_t phase);
+
+	// 'phase' moved on by 'numSamples' steps, wrapping around like every
+	// phase does
+	static int64_t	advance(int64_t phase, int64_t step, int64_t numSamples);
+
+	// Makes sure there is one oscillator per channel. The oscillators are
+	// re-seeded to 'offset + spread * channel' only when the channel count
+	// or spread changes, otherwise they keep running.
+	void			setup(int32_t numChannels, int64_t offset, double spread);
+
+	// Puts every oscillator back at 'offset + spread * channel'
+	void			reset(int64_t offset);
+
+	// Writes 'numSamples' samples into each of the setup() channels and
+	// advances every phase by 'step' per sample.
+	void			render(float** channels, int32_t numSamples, Shape shape,
+						   int64_t step, float scale);
+
+	// Picks the loop renderRange() runs, one made for just this shape and
+	// either a scale of 1 or any other. Only looks again when one of them
+	// changes, so it's cheap to call every cook.
+	void			select(Shape shape, float scale);
+
+	// Same as render() but only for channels [begin, end), with the shape
+	// given to select(). Different ranges can be rendered from different
+	// threads at the same time.
+	void			renderRange(float** channels, int32_t begin, int32_t end,
+								int32_t numSamples, int64_t step, float scale);
+
+	int32_t			numChannels() const { return (int32_t)myPhases.size(); }
+
+	// The tables used by every shape but Sine. The user table for the
+	// Table shape is loaded through this.
+	WavetableEngine&	wavetables() { return myWavetables; }
+
+	// One block of a sine from each sample's phase in cycles, see
+	// OscillatorBank.cpp
+	typedef void	(*SineKernel)(float* dst, int32_t n, const uint32_t* cycles, float scale);
+
+private:
+	typedef void	(*RangeKernel)(OscillatorBank& bank, float** channels, int32_t begin,
+								   int32_t end, int32_t numSamples, int64_t step, float scale);
+
+	// The loops for a shape and scale, and the per sample kernels they run
+	// for this CPU
+	struct Renderer
+	{
+		Shape						shape;
+		bool						unity;
+		RangeKernel					range;
+		SineKernel					sine;
+		WavetableEngine::LookupKernel	lookup;
+	};
+
+	static Renderer	renderer(Shape shape, bool unity);
+
+	template <Shape S, bool Unity>
+	static void		renderRangeT(OscillatorBank& bank, float** channels, int32_t begin,
+								 int32_t end, int32_t numSamples, int64_t step, float scale);
+
+	std::vector<int64_t>	myPhases;
+	double					mySpread;
+	Renderer				myRenderer;
+	WavetableEngine			myWavetables;
+};
+
+#endif
@@ -0,0 +1,260 @@
+#include "ParameterRegistry.h"
+
+#include <assert.h>
+#include <string.h>
+
+// FNV-1a over 64 bit words, for the parameter fingerprint
+static inline void
+mixFingerprint(uint64_t& hash, uint64_t v)
+{
+	hash ^= v;
+	hash *= 1099511628211ULL;
+}
+
+ParameterRegistry::ParameterRegistry() :
+	myChangedMask(0),
+	myFingerprint(0),
+	myChangeCount(0),
+	myFirst(true)
+{
+}
+
+void
+ParameterRegistry::bind(const char* name, Kind kind, void* value, int32_t size)
+{
+	// changedMask() has one bit per parameter
+	assert(myEntries.size() < 64);
+
+	Entry e;
+	e.name = name;
+	e.kind = kind;
+	e.value = value;
+	e.size = size;
+	e.opId = -1;
+	myEntries.push_back(e);
+}
+
+OP_ParAppendResult
+ParameterRegistry::appendFloat(OP_ParameterManager* manager,
+							   const OP_NumericParameter& np, double* value,
+							   int32_t size)
+{
+	OP_ParAppendResult res = manager->appendFloat(np, size);
+	if (res == OP_ParAppendResult::Success)
+	{
+		for (int32_t i = 0; i < size; i++)
+			value[i] = np.defaultValues[i];
+		bind(np.name, Kind::Float, value, size);
+	}
+	return res;
+}
+
+OP_ParAppendResult
+ParameterRegistry::appendInt(OP_ParameterManager* manager,
+							 const OP_NumericParameter& np, int32_t* value)
+{
+	OP_ParAppendResult res = manager->appendInt(np);
+	if (res == OP_ParAppendResult::Success)
+	{
+		*value = (int32_t)np.defaultValues[0];
+		bind(np.name, Kind::Int, value);
+	}
+	return res;
+}
+
+OP_ParAppendResult
+ParameterRegistry::appendToggle(OP_ParameterManager* manager,
+								const OP_NumericParameter& np, bool* value)
+{
+	OP_ParAppendResult res = manager->appendToggle(np);
+	if (res == OP_ParAppendResult::Success)
+	{
+		*value = np.defaultValues[0] != 0.0;
+		bind(np.name, Kind::Toggle, value);
+	}
+	return res;
+}
+
+OP_ParAppendResult
+ParameterRegistry::appendMenu(OP_ParameterManager* manager,
+							  const OP_StringParameter& sp, int32_t size,
+							  const char** names, const char** labels,
+							  int32_t* value)
+{
+	OP_ParAppendResult res = manager->appendMenu(sp, size, names, labels);
+	if (res == OP_ParAppendResult::Success)
+	{
+		*value = 0;
+		bind(sp.name, Kind::Menu, value);
+	}
+	return res;
+}
+
+OP_ParAppendResult
+ParameterRegistry::appendString(OP_ParameterManager* manager,
+								const OP_StringParameter& sp, std::string* value)
+{
+	OP_ParAppendResult res = manager->appendString(sp);
+	if (res == OP_ParAppendResult::Success)
+	{
+		*value = sp.defaultValue ? sp.defaultValue : "";
+		bind(sp.name, Kind::String, value);
+	}
+	return res;
+}
+
+OP_ParAppendResult
+ParameterRegistry::appendFile(OP_ParameterManager* manager,
+							  const OP_StringParameter& sp, std::string* value)
+{
+	OP_ParAppendResult res = manager->appendFile(sp);
+	if (res == OP_ParAppendResult::Success)
+	{
+		*value = sp.defaultValue ? sp.defaultValue : "";
+		bind(sp.name, Kind::File, value);
+	}
+	return res;
+}
+
+OP_ParAppendResult
+ParameterRegistry::appendDAT(OP_ParameterManager* manager,
+							 const OP_StringParameter& sp, const OP_DATInput** value)
+{
+	OP_ParAppendResult res = manager->appendDAT(sp);
+	if (res == OP_ParAppendResult::Success)
+	{
+		*value = nullptr;
+		bind(sp.name, Kind::DAT, value);
+	}
+	return res;
+}
+
+OP_ParAppendResult
+ParameterRegistry::appendTOP(OP_ParameterManager* manager,
+							 const OP_StringParameter& sp, const OP_TOPInput** value)
+{
+	OP_ParAppendResult res = manager->appendTOP(sp);
+	if (res == OP_ParAppendResult::Success)
+	{
+		*value = nullptr;
+		bind(sp.name, Kind::TOP, value);
+	}
+	return res;
+}
+
+OP_ParAppendResult
+ParameterRegistry::appendPulse(OP_ParameterManager* manager,
+							   const OP_NumericParameter& np)
+{
+	return manager->appendPulse(np);
+}
+
+bool
+ParameterRegistry::update(OP_Inputs* inputs)
+{
+	uint64_t mask = 0;
+	uint64_t fingerprint = 1469598103934665603ULL;
+	for (size_t i = 0; i < myEntries.size(); i++)
+	{
+		Entry& e = myEntries[i];
+		const char* name = e.name.c_str();
+		bool diff = false;
+
+		switch (e.kind)
+		{
+			case Kind::Float:
+			{
+				double* dst = (double*)e.value;
+				for (int32_t j = 0; j < e.size; j++)
+				{
+					double v = inputs->getParDouble(name, j);
+					diff |= v != dst[j];
+					dst[j] = v;
+
+					uint64_t bits;
+					memcpy(&bits, &v, sizeof(bits));
+					mixFingerprint(fingerprint, bits);
+				}
+				break;
+			}
+			case Kind::Int:
+			case Kind::Menu:
+			{
+				int32_t v = inputs->getParInt(name);
+				int32_t* dst = (int32_t*)e.value;
+				diff = v != *dst;
+				*dst = v;
+				mixFingerprint(fingerprint, (uint64_t)(uint32_t)v);
+				break;
+			}
+			case Kind::Toggle:
+			{
+				bool v = inputs->getParInt(name) != 0;
+				bool* dst = (bool*)e.value;
+				diff = v != *dst;
+				*dst = v;
+				mixFingerprint(fingerprint, v ? 1 : 0);
+				break;
+			}
+			case Kind::String:
+			case Kind::File:
+			{
+				const char* v = e.kind == Kind::File ? inputs->getParFilePath(name) :
+													   inputs->getParString(name);
+				std::string* dst = (std::string*)e.value;
+				if (!v)
+					v = "";
+				diff = *dst != v;
+				if (diff)
+					*dst = v;
+				for (const char* c = v; *c; c++)
+					mixFingerprint(fingerprint, (uint8_t)*c);
+				mixFingerprint(fingerprint, 0xFF);
+				break;
+			}
+			case Kind::DAT:
+			{
+				const OP_DATInput* v = inputs->getParDAT(name);
+				const OP_DATInput** dst = (const OP_DATInput**)e.value;
+				int32_t id = v ? (int32_t)v->opId : -1;
+				diff = v != *dst || id != e.opId;
+				*dst = v;
+				e.opId = id;
+				mixFingerprint(fingerprint, (uint64_t)(uint32_t)id);
+				break;
+			}
+			case Kind::TOP:
+			{
+				const OP_TOPInput* v = inputs->getParTOP(name);
+				const OP_TOPInput** dst = (const OP_TOPInput**)e.value;
+				int32_t id = v ? (int32_t)v->opId : -1;
+				diff = v != *dst || id != e.opId;
+				*dst = v;
+				e.opId = id;
+				mixFingerprint(fingerprint, (uint64_t)(uint32_t)id);
+				break;
+			}
+		}
+
+		if (diff || myFirst)
+			mask |= uint64_t(1) << i;
+	}
+
+	myFirst = false;
+	myChangedMask = mask;
+	myFingerprint = fingerprint;
+	if (mask)
+		myChangeCount++;
+	return mask != 0;
+}
+
+bool
+ParameterRegistry::changed(const void* value) const
+{
+	for (size_t i = 0; i < myEntries.size(); i++)
+	{
+		if (myEntries[i].value == value)
+			return (myChangedMask >> i) & 1;
+	}
+	return false;
+}
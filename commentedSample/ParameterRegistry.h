@@ -0,0 +1,117 @@
+/*
+	A typed registry of a CHOP's parameters.
+
+	Every OP_Inputs::getPar*() call is a virtual call that looks the
+	parameter up by name, so reading the same parameter from getOutputInfo(),
+	execute() and again inside loops adds up. The registry is filled in from
+	setupParameters(): each append*() function adds the parameter to the
+	OP_ParameterManager exactly like the function of the same name, and also
+	binds it to a field of the CHOP's own parameter struct.
+
+	update() then fetches every bound parameter once per cook, writes it into
+	its field and records which fields changed, so later stages can skip work
+	whose inputs are the same as last cook.
+*/
+
+#ifndef __ParameterRegistry__
+#define __ParameterRegistry__
+
+#include "CPlusPlus_Common.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class ParameterRegistry
+{
+public:
+	ParameterRegistry();
+
+	// Adds the parameter to 'manager' and binds it to 'value'. 'value' must
+	// stay valid for the life of the registry, normally it's a member of
+	// the same class.
+	// A float parameter with 'size' values fills value[0] to value[size - 1].
+	OP_ParAppendResult	appendFloat(OP_ParameterManager* manager,
+									const OP_NumericParameter& np, double* value,
+									int32_t size = 1);
+	OP_ParAppendResult	appendInt(OP_ParameterManager* manager,
+								  const OP_NumericParameter& np, int32_t* value);
+	OP_ParAppendResult	appendToggle(OP_ParameterManager* manager,
+									 const OP_NumericParameter& np, bool* value);
+
+	// Menus are fetched as the index of the selected item
+	OP_ParAppendResult	appendMenu(OP_ParameterManager* manager,
+								   const OP_StringParameter& sp, int32_t size,
+								   const char** names, const char** labels,
+								   int32_t* value);
+	OP_ParAppendResult	appendString(OP_ParameterManager* manager,
+									 const OP_StringParameter& sp, std::string* value);
+	// File parameters are fetched as an absolute path (getParFilePath())
+	OP_ParAppendResult	appendFile(OP_ParameterManager* manager,
+								   const OP_StringParameter& sp, std::string* value);
+	OP_ParAppendResult	appendDAT(OP_ParameterManager* manager,
+								  const OP_StringParameter& sp, const OP_DATInput** value);
+	OP_ParAppendResult	appendTOP(OP_ParameterManager* manager,
+								  const OP_StringParameter& sp, const OP_TOPInput** value);
+
+	// Pulses have no value to fetch, they arrive through pulsePressed()
+	OP_ParAppendResult	appendPulse(OP_ParameterManager* manager,
+									const OP_NumericParameter& np);
+
+	// Fetches every bound parameter into its value. Returns true if any of
+	// them differs from the previous update(). The first update() counts
+	// everything as changed.
+	bool				update(OP_Inputs* inputs);
+
+	// True if 'value' (one of the pointers passed to append*()) changed in
+	// the last update()
+	bool				changed(const void* value) const;
+
+	bool				anyChanged() const { return myChangedMask != 0; }
+
+	// One bit per bound parameter, in the order they were appended, set if
+	// it changed in the last update()
+	uint64_t			changedMask() const { return myChangedMask; }
+
+	// A fingerprint of every bound value as of the last update(). Two cooks
+	// with the same fingerprint saw the same parameters.
+	uint64_t			fingerprint() const { return myFingerprint; }
+
+	// Number of update() calls that found a change
+	int64_t				changeCount() const { return myChangeCount; }
+
+private:
+	enum class Kind : int32_t
+	{
+		Float,
+		Int,
+		Toggle,
+		Menu,
+		String,
+		File,
+		DAT,
+		TOP,
+	};
+
+	struct Entry
+	{
+		std::string		name;
+		Kind			kind;
+		void*			value;
+		int32_t			size;
+
+		// What the DAT or TOP parameter pointed at last time, a new one can
+		// come back at the address of a deleted one
+		int32_t			opId;
+	};
+
+	void				bind(const char* name, Kind kind, void* value, int32_t size = 1);
+
+	std::vector<Entry>	myEntries;
+	uint64_t			myChangedMask;
+	uint64_t			myFingerprint;
+	int64_t				myChangeCount;
+	bool				myFirst;
+};
+
+#endif
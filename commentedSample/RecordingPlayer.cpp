@@ -0,0 +1,386 @@
+#include "RecordingPlayer.h"
+#include "ChannelRecorder.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+static const size_t		DefaultPrefetchBytes = 64 << 20;
+
+static uint32_t
+get32(const char* src)
+{
+	uint32_t v;
+	memcpy(&v, src, sizeof(v));
+	return v;
+}
+
+static uint64_t
+get64(const char* src)
+{
+	uint64_t v;
+	memcpy(&v, src, sizeof(v));
+	return v;
+}
+
+RecordingPlayer::RecordingPlayer() :
+	myBase(nullptr),
+	mySize(0),
+#ifdef _WIN32
+	myFile(INVALID_HANDLE_VALUE),
+	myMapping(nullptr),
+#else
+	myFile(-1),
+#endif
+	myNumChannels(0),
+	mySampleRate(0.0),
+	myBlocksChunk(-1),
+	myStop(false),
+	myHead(0),
+	myPrefetchBytes(DefaultPrefetchBytes),
+	myPrefetched(0)
+{
+}
+
+RecordingPlayer::~RecordingPlayer()
+{
+	close();
+}
+
+void
+RecordingPlayer::fail(const char* message)
+{
+	myError = message;
+	close();
+}
+
+bool
+RecordingPlayer::open(const char* path)
+{
+	close();
+	myError.clear();
+
+#ifdef _WIN32
+	myFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+						 OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	LARGE_INTEGER size;
+	if (myFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(myFile, &size))
+	{
+		fail("Can't open the playback file");
+		return false;
+	}
+	mySize = (size_t)size.QuadPart;
+	if (mySize > 0)
+		myMapping = CreateFileMappingA(myFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (myMapping)
+		myBase = (const char*)MapViewOfFile(myMapping, FILE_MAP_READ, 0, 0, 0);
+#else
+	myFile = ::open(path, O_RDONLY);
+	struct stat st;
+	if (myFile < 0 || fstat(myFile, &st) != 0)
+	{
+		fail("Can't open the playback file");
+		return false;
+	}
+	mySize = (size_t)st.st_size;
+	if (mySize > 0)
+	{
+		void* p = mmap(nullptr, mySize, PROT_READ, MAP_SHARED, myFile, 0);
+		myBase = p == MAP_FAILED ? nullptr : (const char*)p;
+	}
+#endif
+	if (!myBase)
+	{
+		fail("Can't map the playback file");
+		return false;
+	}
+
+	// The header and the channel names
+	if (mySize < ChannelRecorder::FileHeaderBytes || memcmp(myBase, "CHOPREC1", 8) != 0 ||
+		get32(myBase + 8) != 1)
+	{
+		fail("The playback file isn't a recording");
+		return false;
+	}
+	size_t headerBytes = get32(myBase + 12);
+	myNumChannels = (int32_t)get32(myBase + 16);
+	memcpy(&mySampleRate, myBase + 24, sizeof(double));
+	if (headerBytes > mySize || myNumChannels < 1)
+	{
+		fail("The playback file is damaged");
+		return false;
+	}
+
+	const char* name = myBase + ChannelRecorder::FileHeaderBytes;
+	const char* end = myBase + headerBytes;
+	myNames.clear();
+	for (int32_t c = 0; c < myNumChannels; c++)
+	{
+		const char* zero = (const char*)memchr(name, 0, end - name);
+		if (!zero)
+		{
+			fail("The playback file is damaged");
+			return false;
+		}
+		myNames.push_back(name);
+		name = zero + 1;
+	}
+
+	if (!indexChunks())
+	{
+		fail("The playback file holds no samples");
+		return false;
+	}
+
+	myBlocksChunk = -1;
+	myStop = false;
+	myHead.store(myChunks.front().offset);
+	myPrefetched.store(0);
+	myPrefetcher = std::thread(&RecordingPlayer::prefetchLoop, this);
+	return true;
+}
+
+bool
+RecordingPlayer::indexChunks()
+{
+	myChunks.clear();
+
+	// A recording that was cut short can end in a partly written chunk, so
+	// stop at the first one that doesn't add up
+	size_t offset = get32(myBase + 12);
+	while (offset + ChannelRecorder::ChunkHeaderBytes <= mySize)
+	{
+		const char* h = myBase + offset;
+		Chunk chunk;
+		chunk.offset = offset;
+		chunk.used = (size_t)get64(h + 16);
+		chunk.bytes = (size_t)get64(h + 24);
+		chunk.firstIndex = (int64_t)get64(h + 40);
+		chunk.endIndex = (int64_t)get64(h + 48);
+
+		if (memcmp(h, "CHNK", 4) != 0 || (int32_t)get32(h + 4) != myNumChannels ||
+			chunk.bytes < chunk.used || chunk.used < ChannelRecorder::ChunkHeaderBytes ||
+			chunk.bytes == 0 || offset + chunk.bytes > mySize)
+		{
+			break;
+		}
+
+		if (get32(h + 8) > 0)
+			myChunks.push_back(chunk);
+		offset += chunk.bytes;
+	}
+	return !myChunks.empty();
+}
+
+void
+RecordingPlayer::close()
+{
+	if (myPrefetcher.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> guard(myMutex);
+			myStop = true;
+		}
+		myWake.notify_one();
+		myPrefetcher.join();
+	}
+
+#ifdef _WIN32
+	if (myBase)
+		UnmapViewOfFile(myBase);
+	if (myMapping)
+		CloseHandle(myMapping);
+	if (myFile != INVALID_HANDLE_VALUE)
+		CloseHandle(myFile);
+	myMapping = nullptr;
+	myFile = INVALID_HANDLE_VALUE;
+#else
+	if (myBase)
+		munmap((void*)myBase, mySize);
+	if (myFile >= 0)
+		::close(myFile);
+	myFile = -1;
+#endif
+	myBase = nullptr;
+	mySize = 0;
+	myNames.clear();
+	myChunks.clear();
+	myBlocks.clear();
+	myBlocksChunk = -1;
+}
+
+int32_t
+RecordingPlayer::findChunk(int64_t a) const
+{
+	// The first chunk that ends after 'a'
+	int32_t lo = 0;
+	int32_t hi = (int32_t)myChunks.size();
+	while (lo < hi)
+	{
+		int32_t mid = (lo + hi) / 2;
+		if (myChunks[mid].endIndex <= a)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo < (int32_t)myChunks.size() ? lo : -1;
+}
+
+const std::vector<RecordingPlayer::Block>&
+RecordingPlayer::blocksOf(int32_t chunk)
+{
+	if (chunk == myBlocksChunk)
+		return myBlocks;
+
+	myBlocks.clear();
+	myBlocksChunk = chunk;
+
+	const Chunk& c = myChunks[chunk];
+	const char* p = myBase + c.offset + ChannelRecorder::ChunkHeaderBytes;
+	const char* end = myBase + c.offset + c.used;
+	size_t sampleBytes = sizeof(float) * myNumChannels;
+	while (p + ChannelRecorder::BlockHeaderBytes <= end)
+	{
+		Block b;
+		b.startIndex = (int64_t)get64(p);
+		b.numSamples = (int32_t)get32(p + 8);
+		b.data = (const float*)(p + ChannelRecorder::BlockHeaderBytes);
+
+		size_t bytes = ChannelRecorder::BlockHeaderBytes + sampleBytes * b.numSamples;
+		if (b.numSamples <= 0 || p + bytes > end)
+			break;
+		myBlocks.push_back(b);
+		p += (bytes + 15) & ~size_t(15);
+	}
+	return myBlocks;
+}
+
+void
+RecordingPlayer::read(float** channels, int32_t numChannels, int64_t startIndex,
+					  int32_t numSamples)
+{
+	int32_t n = numChannels < myNumChannels ? numChannels : myNumChannels;
+	for (int32_t c = n; c < numChannels; c++)
+		memset(channels[c], 0, sizeof(float) * numSamples);
+
+	int32_t j = 0;
+	while (j < numSamples)
+	{
+		int64_t a = startIndex + j;
+		int32_t chunk = findChunk(a);
+		if (chunk < 0)
+			break;
+
+		// Let the prefetcher know when the play head moves to another chunk.
+		// Stored under myMutex, or the prefetcher could check myHead just
+		// before the store and start waiting just after the notify.
+		size_t offset = myChunks[chunk].offset;
+		if (myHead.load(std::memory_order_relaxed) != offset)
+		{
+			{
+				std::lock_guard<std::mutex> guard(myMutex);
+				myHead.store(offset);
+			}
+			myWake.notify_one();
+		}
+
+		// The block holding 'a', or the next one
+		const std::vector<Block>& blocks = blocksOf(chunk);
+		const Block* b = nullptr;
+		for (const Block& candidate : blocks)
+		{
+			if (candidate.startIndex + candidate.numSamples > a &&
+				(!b || candidate.startIndex < b->startIndex))
+			{
+				b = &candidate;
+				if (candidate.startIndex <= a)
+					break;
+			}
+		}
+
+		int32_t take;
+		if (!b || b->startIndex > a)
+		{
+			// A gap in the recording
+			int64_t gap = b ? b->startIndex - a : myChunks[chunk].endIndex - a;
+			if (chunk + 1 < (int32_t)myChunks.size() && !b)
+				gap = myChunks[chunk + 1].firstIndex - a;
+			take = gap < numSamples - j ? (int32_t)(gap > 0 ? gap : 1) : numSamples - j;
+			for (int32_t c = 0; c < n; c++)
+				memset(channels[c] + j, 0, sizeof(float) * take);
+		}
+		else
+		{
+			int64_t from = a - b->startIndex;
+			take = b->numSamples - (int32_t)from;
+			if (take > numSamples - j)
+				take = numSamples - j;
+			for (int32_t c = 0; c < n; c++)
+				memcpy(channels[c] + j, b->data + size_t(c) * b->numSamples + from, sizeof(float) * take);
+		}
+		j += take;
+	}
+
+	for (int32_t c = 0; c < n; c++)
+		memset(channels[c] + j, 0, sizeof(float) * (numSamples - j));
+}
+
+void
+RecordingPlayer::prefetch(size_t from, size_t to)
+{
+	if (to <= from)
+		return;
+#ifdef _WIN32
+	// Touching one byte a page makes Windows read them in
+	volatile char sink = 0;
+	for (size_t p = from; p < to; p += ChannelRecorder::PageBytes)
+		sink += myBase[p];
+	(void)sink;
+#else
+	madvise((void*)(myBase + from), to - from, MADV_WILLNEED);
+#endif
+	myPrefetched.fetch_add(int64_t(to - from), std::memory_order_relaxed);
+}
+
+void
+RecordingPlayer::prefetchLoop()
+{
+	size_t seen = ~size_t(0);
+	size_t doneFrom = 0;
+	size_t doneTo = 0;
+	for (;;)
+	{
+		size_t head;
+		{
+			std::unique_lock<std::mutex> guard(myMutex);
+			myWake.wait(guard, [&]() { return myStop || myHead.load() != seen; });
+			if (myStop)
+				return;
+			head = myHead.load();
+			seen = head;
+		}
+
+		// Only ask for what hasn't been asked for already, unless the play
+		// head jumped somewhere else
+		size_t to = head + myPrefetchBytes.load();
+		if (to > mySize)
+			to = mySize;
+		if (head < doneFrom || head > doneTo)
+		{
+			doneFrom = head;
+			doneTo = head;
+		}
+		if (to > doneTo)
+		{
+			prefetch(doneTo, to);
+			doneTo = to;
+		}
+	}
+}
@@ -0,0 +1,125 @@
+/*
+	Plays back a file written by ChannelRecorder straight from a memory
+	mapping, for recordings far too big to load.
+
+	open() maps the whole file and reads only the chunk headers, one page
+	every 4MB, to index which sample indexes each chunk holds; nothing else
+	is read until it's played. A cook then copies its samples from the
+	mapped pages of the blocks that hold them, looked up by sample index
+	(the output's startIndex), so what's resident is whatever the play head
+	has touched lately and the OS can drop it again whenever it likes.
+
+	To keep page faults off the cook, a prefetch thread follows the play
+	head and asks the OS to read the next few chunks in ahead of time
+	(madvise(MADV_WILLNEED), or touching the pages on Windows).
+
+	The sample indexes in the file are expected to go up, as they do when
+	recording a running timeline. Indexes no block holds play as 0.
+*/
+
+#ifndef __RecordingPlayer__
+#define __RecordingPlayer__
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+class RecordingPlayer
+{
+public:
+	RecordingPlayer();
+	~RecordingPlayer();
+
+	// Maps 'path' and indexes it. Returns false and sets error() if it
+	// can't be opened or isn't a recording.
+	bool				open(const char* path);
+	void				close();
+
+	bool				isOpen() const { return myBase != nullptr; }
+
+	// nullptr while all is well
+	const char*			error() const { return myError.empty() ? nullptr : myError.c_str(); }
+
+	int32_t				numChannels() const { return myNumChannels; }
+	double				sampleRate() const { return mySampleRate; }
+	const char*			channelName(int32_t c) const { return myNames[c]; }
+
+	// The range of sample indexes in the recording
+	int64_t				firstIndex() const { return myChunks.empty() ? 0 : myChunks.front().firstIndex; }
+	int64_t				endIndex() const { return myChunks.empty() ? 0 : myChunks.back().endIndex; }
+
+	// Copies samples [startIndex, startIndex + numSamples) of the first
+	// 'numChannels' channels into 'channels'. Channels past the
+	// recording's are filled with 0.
+	void				read(float** channels, int32_t numChannels, int64_t startIndex,
+							 int32_t numSamples);
+
+	// How far ahead of the play head to read, 64MB unless set
+	void				setPrefetchBytes(size_t bytes) { myPrefetchBytes.store(bytes); }
+
+	// Bytes the prefetch thread has asked for so far
+	int64_t				prefetched() const { return myPrefetched.load(std::memory_order_relaxed); }
+
+private:
+	struct Chunk
+	{
+		size_t			offset;
+		size_t			used;
+		size_t			bytes;
+		int64_t			firstIndex;
+		int64_t			endIndex;
+	};
+
+	struct Block
+	{
+		const float*	data;
+		int64_t			startIndex;
+		int32_t			numSamples;
+	};
+
+	void				fail(const char* message);
+	bool				indexChunks();
+
+	// The chunk holding 'a', or the first one after it. -1 if there isn't one.
+	int32_t				findChunk(int64_t a) const;
+	const std::vector<Block>&	blocksOf(int32_t chunk);
+
+	void				prefetchLoop();
+	void				prefetch(size_t from, size_t to);
+
+	std::string			myError;
+
+	const char*			myBase;
+	size_t				mySize;
+#ifdef _WIN32
+	void*				myFile;
+	void*				myMapping;
+#else
+	int					myFile;
+#endif
+
+	int32_t				myNumChannels;
+	double				mySampleRate;
+	std::vector<const char*>	myNames;
+	std::vector<Chunk>	myChunks;
+
+	// Blocks of the chunk read last, a cook nearly always reads the same
+	// chunk as the one before it
+	int32_t				myBlocksChunk;
+	std::vector<Block>	myBlocks;
+
+	std::thread				myPrefetcher;
+	std::mutex				myMutex;
+	std::condition_variable	myWake;
+	bool					myStop;
+	std::atomic<size_t>		myHead;
+	std::atomic<size_t>		myPrefetchBytes;
+	std::atomic<int64_t>	myPrefetched;
+};
+
+#endif
@@ -0,0 +1,325 @@
+#include "Resampler.h"
+#include "ChannelKernels.h"
+
+#include <math.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#ifdef CK_X86
+	#include <immintrin.h>
+#endif
+
+// The cutoff as a fraction of the lower Nyquist frequency. The filter
+// rolls off from there, so it's down by the time it reaches Nyquist.
+static const double		Cutoff = 0.9;
+
+// Kaiser window shape, about 70 dB of stop band
+static const double		Beta = 7.0;
+
+// Sum of a[i] * b[i]
+typedef float	(*DotKernel)(const float* a, const float* b, int32_t n);
+
+
+// ----------------------------------------------------------------------------
+// Scalar
+
+static float
+dotScalar(const float* a, const float* b, int32_t n)
+{
+	// Separate sums so the adds don't all wait on each other
+	float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+	int32_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		s0 += a[i] * b[i];
+		s1 += a[i + 1] * b[i + 1];
+		s2 += a[i + 2] * b[i + 2];
+		s3 += a[i + 3] * b[i + 3];
+	}
+	for (; i < n; i++)
+		s0 += a[i] * b[i];
+	return (s0 + s1) + (s2 + s3);
+}
+
+#ifdef CK_X86
+
+// ----------------------------------------------------------------------------
+// SSE2
+
+static inline float
+sumSSE2(__m128 v)
+{
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+static float
+dotSSE2(const float* a, const float* b, int32_t n)
+{
+	__m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+	int32_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+	}
+	float s = sumSSE2(_mm_add_ps(s0, s1));
+	for (; i < n; i++)
+		s += a[i] * b[i];
+	return s;
+}
+
+// ----------------------------------------------------------------------------
+// AVX2
+
+CK_TARGET("avx2,fma") static float
+dotAVX2(const float* a, const float* b, int32_t n)
+{
+	__m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+	int32_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), s0);
+		s1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), s1);
+	}
+	for (; i + 8 <= n; i += 8)
+		s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), s0);
+	s0 = _mm256_add_ps(s0, s1);
+	float s = sumSSE2(_mm_add_ps(_mm256_castps256_ps128(s0), _mm256_extractf128_ps(s0, 1)));
+	for (; i < n; i++)
+		s += a[i] * b[i];
+	return s;
+}
+
+// ----------------------------------------------------------------------------
+// AVX-512, the tail is a masked load instead of a scalar loop
+
+CK_TARGET("avx512f") static float
+dotAVX512(const float* a, const float* b, int32_t n)
+{
+	__m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+	int32_t i = 0;
+	for (; i + 32 <= n; i += 32)
+	{
+		s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), s0);
+		s1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), s1);
+	}
+	for (; i + 16 <= n; i += 16)
+		s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), s0);
+	if (i < n)
+	{
+		__mmask16 m = (__mmask16)((1u << (n - i)) - 1);
+		s1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a + i), _mm512_maskz_loadu_ps(m, b + i), s1);
+	}
+	return _mm512_reduce_add_ps(_mm512_add_ps(s0, s1));
+}
+
+#endif
+
+static DotKernel
+selectDot()
+{
+	switch (ChannelKernels::get().level)
+	{
+#ifdef CK_X86
+		case CPUFeatureLevel::AVX512:	return dotAVX512;
+		case CPUFeatureLevel::AVX2:		return dotAVX2;
+		case CPUFeatureLevel::SSE2:		return dotSSE2;
+#endif
+		default:						return dotScalar;
+	}
+}
+
+
+// ----------------------------------------------------------------------------
+
+// Rounds towards minus infinity, timeline indexes can be negative
+static int64_t
+floorDiv(int64_t a, int64_t b)
+{
+	int64_t q = a / b;
+	return q * b > a ? q - 1 : q;
+}
+
+// Modified Bessel function of the first kind, order 0, for the window
+static double
+besselI0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+	for (int k = 1; k < 50; k++)
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+		if (term < 1e-12 * sum)
+			break;
+	}
+	return sum;
+}
+
+const Resampler&
+Resampler::get(double inputRate, double outputRate)
+{
+	// Resamplers are never freed, so the references handed out stay valid
+	static std::mutex lock;
+	static std::map<std::pair<double, double>, std::unique_ptr<Resampler>> resamplers;
+	std::lock_guard<std::mutex> guard(lock);
+	std::unique_ptr<Resampler>& r = resamplers[std::make_pair(inputRate, outputRate)];
+	if (!r)
+		r.reset(new Resampler(inputRate, outputRate));
+	return *r;
+}
+
+Resampler::Resampler(double inputRate, double outputRate) :
+	myInputRate(inputRate),
+	myOutputRate(outputRate),
+	myRatio(outputRate > 0.0 ? inputRate / outputRate : 1.0),
+	myUp(0),
+	myDown(0),
+	myHalf(1),
+	myPhases(PhaseSteps)
+{
+	const double pi = 3.14159265358979323846;
+
+	// The smallest denominator that gives the ratio exactly is in lowest terms
+	for (int64_t up = 1; up <= MaxPhases; up++)
+	{
+		double down = floor(myRatio * up + 0.5);
+		if (down >= 1.0 && fabs(down - myRatio * up) < 1e-9 * down)
+		{
+			myUp = up;
+			myDown = (int64_t)down;
+			myPhases = (int32_t)up;
+			break;
+		}
+	}
+
+	// In cycles per input sample. Going down the cutoff follows the output's
+	// Nyquist, so the filter gets longer by the same factor.
+	double cutoff = 0.5 * Cutoff * (myRatio > 1.0 ? 1.0 / myRatio : 1.0);
+	myHalf = (int32_t)ceil(ZeroCrossings / (2.0 * cutoff));
+
+	int32_t taps = 2 * myHalf;
+	myTable.resize(size_t(myPhases + 1) * taps);
+	double i0Beta = besselI0(Beta);
+	std::vector<double> h(taps);
+	for (int32_t p = 0; p <= myPhases; p++)
+	{
+		float* row = &myTable[size_t(p) * taps];
+		double frac = double(p) / myPhases;
+		double sum = 0.0;
+		for (int32_t m = 0; m < taps; m++)
+		{
+			// Distance from the output sample to tap m, in input samples
+			double x = frac + myHalf - 1 - m;
+			double r = x / myHalf;
+			double window = r * r < 1.0 ? besselI0(Beta * sqrt(1.0 - r * r)) / i0Beta : 0.0;
+			double y = 2.0 * cutoff * x;
+			double sinc = fabs(y) < 1e-12 ? 1.0 : sin(pi * y) / (pi * y);
+			h[m] = sinc * window;
+			sum += h[m];
+		}
+
+		// Every phase passes a constant through unchanged, otherwise the
+		// gain would ripple from one output sample to the next
+		for (int32_t m = 0; m < taps; m++)
+			row[m] = float(h[m] / sum);
+	}
+}
+
+void
+Resampler::locate(int64_t j, int64_t& index, int32_t& phase, float& between) const
+{
+	if (myUp > 0)
+	{
+		int64_t n = j * myDown;
+		index = floorDiv(n, myUp);
+		phase = (int32_t)(n - index * myUp);
+		between = 0.0f;
+		return;
+	}
+
+	double t = double(j) * myRatio;
+	double whole = floor(t);
+	double pos = (t - whole) * myPhases;
+	index = (int64_t)whole;
+	phase = (int32_t)pos;
+	if (phase >= myPhases)
+		phase = myPhases - 1;
+	between = float(pos - phase);
+}
+
+void
+Resampler::span(int64_t start, int32_t numSamples, int64_t& first, int64_t& count) const
+{
+	if (numSamples < 1)
+	{
+		first = 0;
+		count = 0;
+		return;
+	}
+
+	int64_t a, b;
+	int32_t phase;
+	float between;
+	locate(start, a, phase, between);
+	locate(start + numSamples - 1, b, phase, between);
+
+	// The taps of an output sample end at the input sample at or before it
+	first = a - taps() + 1;
+	count = b - a + taps();
+}
+
+void
+Resampler::process(float* dst, int64_t start, int32_t numSamples, const float* src,
+				   float scale) const
+{
+	DotKernel dot = selectDot();
+	int32_t taps = 2 * myHalf;
+	int64_t first, count;
+	span(start, numSamples, first, count);
+
+	int64_t index;
+	int32_t phase;
+	float between;
+	locate(start, index, phase, between);
+
+	// A rational ratio moves the same whole samples and phases every output
+	// sample, so only the first one needs a division
+	if (myUp > 0)
+	{
+		int64_t whole = myDown / myUp;
+		int32_t step = (int32_t)(myDown % myUp);
+		for (int32_t j = 0; j < numSamples; j++)
+		{
+			const float* x = src + (index - taps + 1 - first);
+			dst[j] = dot(&myTable[size_t(phase) * taps], x, taps) * scale;
+
+			index += whole;
+			phase += step;
+			if (phase >= myPhases)
+			{
+				phase -= myPhases;
+				index++;
+			}
+		}
+		return;
+	}
+
+	for (int32_t j = 0; j < numSamples; j++)
+	{
+		if (j > 0)
+			locate(start + j, index, phase, between);
+
+		const float* x = src + (index - taps + 1 - first);
+		const float* row = &myTable[size_t(phase) * taps];
+		float y = dot(row, x, taps);
+		if (between > 0.0f)
+			y += between * (dot(row + taps, x, taps) - y);
+		dst[j] = y * scale;
+	}
+}
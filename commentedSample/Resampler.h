@@ -0,0 +1,98 @@
+/*
+	Converts a channel from one sample rate to another, for inputs whose
+	rate isn't the output's (see InputRing.h).
+
+	Every output sample is a windowed-sinc low pass filter of the input
+	evaluated at that sample's time: the input samples around it, each
+	multiplied by the filter's value at its distance. The filter cuts off a
+	little below the lower of the two Nyquist frequencies, so going down
+	(1 kHz into 60 Hz) removes what the output can't hold instead of
+	folding it back down as aliases, and going up interpolates smoothly.
+
+	Where the output's sample falls between two input samples is its phase.
+	When the ratio of the rates is a fraction with a small denominator
+	(1000 / 60 is 50 / 3) there are only that many phases, and the filter
+	of every one is worked out once into a table. Other ratios use a table
+	of PhaseSteps phases and interpolate between the two nearest.
+
+	Output sample j is at input index j * inputRate / outputRate on the
+	same timeline, so nothing has to be remembered between cooks but the
+	input samples themselves, and a cook of any size lines up with the one
+	before. The filter needs as many input samples after that point as
+	before it, so the output is delayed by half the filter's length
+	(delay()) rather than waiting for samples that haven't arrived.
+
+	A resampler holds nothing but the tables for one pair of rates, and is
+	shared by every channel and instance that converts between them.
+*/
+
+#ifndef __Resampler__
+#define __Resampler__
+
+#include <stdint.h>
+#include <vector>
+
+class Resampler
+{
+public:
+	// Zero crossings of the sinc on each side of the center. More makes
+	// the cutoff steeper and the filter longer.
+	static const int32_t	ZeroCrossings = 8;
+
+	// Ratios needing more phases than this are treated as arbitrary
+	static const int32_t	MaxPhases = 1024;
+
+	// Phases of the table used for arbitrary ratios
+	static const int32_t	PhaseSteps = 256;
+
+	// The resampler from 'inputRate' to 'outputRate'. Can be called from any
+	// thread.
+	static const Resampler&	get(double inputRate, double outputRate);
+
+	double				inputRate() const { return myInputRate; }
+	double				outputRate() const { return myOutputRate; }
+
+	// True when the ratio was a fraction with at most MaxPhases phases
+	bool				isRational() const { return myUp > 0; }
+
+	// Input samples each output sample is made from
+	int32_t				taps() const { return 2 * myHalf; }
+
+	// How far the output lags the input, in input samples
+	int32_t				delay() const { return myHalf; }
+
+	// Input samples [first, first + count) that output samples
+	// [start, start + numSamples) are made from
+	void				span(int64_t start, int32_t numSamples, int64_t& first,
+							 int64_t& count) const;
+
+	// Writes output samples [start, start + numSamples) to 'dst', multiplied
+	// by 'scale'. 'src' holds the input samples found by span().
+	void				process(float* dst, int64_t start, int32_t numSamples,
+								const float* src, float scale) const;
+
+private:
+	Resampler(double inputRate, double outputRate);
+
+	// Input index of output sample j, split into the input sample at or
+	// before it and a phase in [0, myPhases)
+	void				locate(int64_t j, int64_t& index, int32_t& phase, float& between) const;
+
+	double				myInputRate;
+	double				myOutputRate;
+	double				myRatio;
+
+	// inputRate / outputRate as myDown / myUp in lowest terms, myUp is 0
+	// when the ratio isn't rational
+	int64_t				myUp;
+	int64_t				myDown;
+
+	int32_t				myHalf;
+	int32_t				myPhases;
+
+	// myPhases + 1 rows of taps() coefficients, the filter for each phase.
+	// The extra row is the next input sample's phase 0, for interpolating.
+	std::vector<float>	myTable;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "ScratchArena.h"
+
+#include <new>
+#include <stdlib.h>
+
+#ifdef _WIN32
+	#include <malloc.h>
+#endif
+
+// The block grows in steps of this, so a cook using a little more than the
+// one before doesn't grow it again
+static const size_t	GrowStep = 64 * 1024;
+
+static size_t
+roundUp(size_t bytes, size_t to)
+{
+	return (bytes + to - 1) / to * to;
+}
+
+static char*
+allocAligned(size_t bytes)
+{
+#ifdef _WIN32
+	return (char*)_aligned_malloc(bytes, ScratchArena::Alignment);
+#else
+	void* p = nullptr;
+	if (posix_memalign(&p, ScratchArena::Alignment, bytes) != 0)
+		return nullptr;
+	return (char*)p;
+#endif
+}
+
+static void
+freeAligned(char* p)
+{
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+ScratchArena::ScratchArena() :
+	myBlock(nullptr),
+	myCapacity(0),
+	myUsed(0),
+	myPeak(0),
+	myGrowths(0)
+{
+}
+
+ScratchArena::~ScratchArena()
+{
+	for (char* p : myOverflow)
+		freeAligned(p);
+	freeAligned(myBlock);
+}
+
+void
+ScratchArena::reset()
+{
+	size_t used = myUsed.load(std::memory_order_relaxed);
+	if (used > myPeak)
+		myPeak = used;
+
+	for (char* p : myOverflow)
+		freeAligned(p);
+	myOverflow.clear();
+
+	// Everything the last cook used fits in one block from now on
+	if (myPeak > myCapacity)
+	{
+		size_t capacity = roundUp(myPeak, GrowStep);
+		char* block = allocAligned(capacity);
+		if (block)
+		{
+			freeAligned(myBlock);
+			myBlock = block;
+			myCapacity = capacity;
+			myGrowths++;
+		}
+	}
+	myUsed.store(0, std::memory_order_relaxed);
+}
+
+void*
+ScratchArena::allocate(size_t bytes)
+{
+	size_t size = roundUp(bytes > 0 ? bytes : 1, Alignment);
+	size_t at = myUsed.fetch_add(size, std::memory_order_relaxed);
+	if (at + size <= myCapacity)
+		return myBlock + at;
+	return overflow(size);
+}
+
+void*
+ScratchArena::overflow(size_t bytes)
+{
+	char* p = allocAligned(bytes);
+	if (!p)
+		throw std::bad_alloc();
+
+	std::lock_guard<std::mutex> guard(myOverflowLock);
+	myOverflow.push_back(p);
+	return p;
+}
+
+size_t
+ScratchArena::peak() const
+{
+	size_t used = myUsed.load(std::memory_order_relaxed);
+	return used > myPeak ? used : myPeak;
+}
@@ -0,0 +1,109 @@
+/*
+	Temporary buffers for a cook, without going to the heap for them.
+
+	Every stage of execute() that needs somewhere to put samples for a
+	moment (an input assembled before it's resampled, a spectrum's frames,
+	a row of luminance) takes it from the instance's arena instead of making
+	a std::vector. Taking memory is just moving an offset forward, and
+	nothing is given back one buffer at a time: reset() at the top of every
+	cook makes the whole arena free again.
+
+	The arena is a single block, 64 byte aligned, as are all the buffers in
+	it. A cook that needs more than the block holds still gets its memory,
+	from extra blocks on the heap, and the next reset() replaces the block
+	with one big enough for everything that cook used. So the heap is only
+	touched when a cook needs more than any cook before it, and the memory
+	an instance holds is that most any cook has needed.
+
+	allocate() can be called from several threads at once.
+*/
+
+#ifndef __ScratchArena__
+#define __ScratchArena__
+
+#include <atomic>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class ScratchArena
+{
+public:
+	// Every buffer starts on a cache line
+	static const size_t	Alignment = 64;
+
+	ScratchArena();
+	~ScratchArena();
+
+	ScratchArena(const ScratchArena&) = delete;
+	ScratchArena&	operator=(const ScratchArena&) = delete;
+
+	// Starts a cook, everything allocated before is free again. Grows the
+	// block first if the last cook used more than it holds.
+	void			reset();
+
+	// 'bytes' of memory, not cleared, valid until the next reset()
+	void*			allocate(size_t bytes);
+
+	template <typename T>
+	T*				allocate(size_t count) { return static_cast<T*>(allocate(sizeof(T) * count)); }
+
+	// Bytes in the block
+	size_t			capacity() const { return myCapacity; }
+
+	// Most bytes any cook has used, including this one so far
+	size_t			peak() const;
+
+	// Number of times the block was made bigger
+	int64_t			growths() const { return myGrowths; }
+
+	// A buffer reused through a loop, like a std::vector that's only ever
+	// made bigger, but kept in the arena. Asking for more than it holds
+	// takes a new one, the old one is freed with the rest at reset(). One
+	// per thread.
+	template <typename T>
+	class Buffer
+	{
+	public:
+		explicit Buffer(ScratchArena& arena) :
+			myArena(arena),
+			myData(nullptr),
+			mySize(0)
+		{
+		}
+
+		// At least 'count' items, not cleared
+		T*			get(size_t count)
+		{
+			if (count > mySize)
+			{
+				myData = myArena.allocate<T>(count);
+				mySize = count;
+			}
+			return myData;
+		}
+
+	private:
+		ScratchArena&	myArena;
+		T*				myData;
+		size_t			mySize;
+	};
+
+private:
+	void*			overflow(size_t bytes);
+
+	char*					myBlock;
+	size_t					myCapacity;
+
+	// Bytes handed out this cook, past myCapacity once it has overflowed
+	std::atomic<size_t>		myUsed;
+	size_t					myPeak;
+	int64_t					myGrowths;
+
+	// Blocks taken from the heap after the block ran out, freed at reset()
+	std::mutex				myOverflowLock;
+	std::vector<char*>		myOverflow;
+};
+
+#endif
@@ -0,0 +1,120 @@
+/*
+	The layout of the shared memory SharedOutputPublisher writes the CHOP's
+	output to, shared with the readers (linuxHost/SharedOutputReader.h).
+	Only standard headers are used, so a reader can include it without the
+	TouchDesigner SDK.
+
+	The segment is a ring of slots, each holding one cook's output. The
+	writer fills slot n % numSlots with cook n and never waits for anyone:
+	a reader that falls more than numSlots cooks behind has lost the
+	oldest ones, and finds out because the slot's sequence has moved on.
+
+		Header, padded to headerBytes (a multiple of 64):
+			char		magic[8]		"CHOPSHM"
+			uint32		version			1
+			uint32		headerBytes		offset of the first slot
+			uint32		numChannels
+			uint32		maxSamples		samples per channel a slot holds
+			uint32		numSlots
+			uint32		closed			set when the writer is done with it
+			uint64		slotBytes
+			uint64		totalBytes		size of the whole segment
+			uint64		published		number of cooks written so far
+			char		names[]			numChannels null-terminated names
+
+		Then numSlots slots of slotBytes each:
+			uint64		sequence		see below
+			int64		startIndex		index of the first sample
+			double		sampleRate
+			uint32		numSamples		samples per channel, up to maxSamples
+			uint32		reserved
+			(padding to 64 bytes)
+			float		samples[numChannels][maxSamples]
+
+	Every slot is a seqlock. Before writing cook n into it the writer sets
+	its sequence to 2n + 1, and once it's done to 2n + 2. A reader reads the
+	sequence, then the samples, then the sequence again: if both were the
+	same even number the samples are cook sequence / 2 - 1, whole.
+
+	When the channels, their names or the number of samples outgrow the
+	segment, the writer sets 'closed' and makes a new segment with the same
+	name. Readers notice 'closed' and open the name again. Everything is in
+	the writer's byte order, both sides run on the same machine.
+*/
+
+#ifndef __SharedOutputFormat__
+#define __SharedOutputFormat__
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace SharedOutput
+{
+
+static const char		Magic[8] = "CHOPSHM";
+static const uint32_t	Version = 1;
+
+// Slots, the header and every channel's samples start on a cache line
+static const size_t		Alignment = 64;
+
+// The atomics are read and written by other processes, so they have to be
+// plain lock free words
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t), "atomic<uint64_t> isn't a plain word");
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "atomic<uint32_t> isn't a plain word");
+
+struct Header
+{
+	char					magic[8];
+	uint32_t				version;
+	uint32_t				headerBytes;
+	uint32_t				numChannels;
+	uint32_t				maxSamples;
+	uint32_t				numSlots;
+	std::atomic<uint32_t>	closed;
+	uint64_t				slotBytes;
+	uint64_t				totalBytes;
+	std::atomic<uint64_t>	published;
+};
+
+static const size_t		HeaderBytes = sizeof(Header);
+
+struct alignas(64) Slot
+{
+	std::atomic<uint64_t>	sequence;
+	int64_t					startIndex;
+	double					sampleRate;
+	uint32_t				numSamples;
+	uint32_t				reserved;
+};
+
+static_assert(sizeof(Slot) == Alignment, "the samples start right after a slot's header");
+
+// The slot cook 'index' is written to
+inline Slot*
+slot(void* base, const Header& h, uint64_t index)
+{
+	return (Slot*)((char*)base + h.headerBytes + (index % h.numSlots) * h.slotBytes);
+}
+
+inline const Slot*
+slot(const void* base, const Header& h, uint64_t index)
+{
+	return (const Slot*)((const char*)base + h.headerBytes + (index % h.numSlots) * h.slotBytes);
+}
+
+inline float*
+samples(Slot* s, const Header& h, uint32_t channel)
+{
+	return (float*)(s + 1) + size_t(channel) * h.maxSamples;
+}
+
+inline const float*
+samples(const Slot* s, const Header& h, uint32_t channel)
+{
+	return (const float*)(s + 1) + size_t(channel) * h.maxSamples;
+}
+
+}
+
+#endif
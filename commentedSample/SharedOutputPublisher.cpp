@@ -0,0 +1,225 @@
+#include "SharedOutputPublisher.h"
+#include "CookCache.h"
+
+#include <string.h>
+
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+using namespace SharedOutput;
+
+// A slot holds at least this many samples per channel, and room for twice
+// the cook that made the segment, so a few dropped frames don't make it
+// again
+static const uint32_t	MinSamples = 16;
+
+static size_t
+roundUp(size_t bytes, size_t to)
+{
+	return (bytes + to - 1) / to * to;
+}
+
+SharedOutputPublisher::SharedOutputPublisher() :
+	myNumSlots(DefaultSlots),
+	myBase(nullptr),
+	myBytes(0),
+	myHeader(nullptr),
+	myLayoutKey(0),
+	mySlot(nullptr),
+	myCook(0),
+	myPublished(0),
+	mySegments(0)
+{
+}
+
+SharedOutputPublisher::~SharedOutputPublisher()
+{
+	close();
+}
+
+bool
+SharedOutputPublisher::open(const char* name, int32_t numSlots)
+{
+	close();
+	myError.clear();
+
+#ifdef _WIN32
+	(void)name;
+	(void)numSlots;
+	myError = "Publishing needs POSIX shared memory, which Windows doesn't have";
+	return false;
+#else
+	if (!name || !name[0] || strchr(name + 1, '/'))
+	{
+		myError = "The publish name can't be empty or have a '/' past its start";
+		return false;
+	}
+	myName = name[0] == '/' ? name : std::string("/") + name;
+	myNumSlots = numSlots > 1 ? numSlots : 2;
+	return true;
+#endif
+}
+
+void
+SharedOutputPublisher::close()
+{
+	unmap();
+#ifndef _WIN32
+	if (!myName.empty())
+		shm_unlink(myName.c_str());
+#endif
+	myName.clear();
+}
+
+void
+SharedOutputPublisher::unmap()
+{
+	if (!myBase)
+		return;
+
+	// Readers still have it mapped, they open the name again
+	myHeader->closed.store(1, std::memory_order_release);
+#ifndef _WIN32
+	munmap(myBase, myBytes);
+#endif
+	myBase = nullptr;
+	myHeader = nullptr;
+	mySlot = nullptr;
+	myBytes = 0;
+}
+
+uint64_t
+SharedOutputPublisher::layoutKey(const CHOP_Output* output)
+{
+	uint64_t key = CookCache::mix((uint64_t)0, (uint64_t)(uint32_t)output->numChannels);
+	for (int32_t c = 0; c < output->numChannels; c++)
+		key = CookCache::hash(output->names[c], strlen(output->names[c]) + 1, key);
+	return key;
+}
+
+bool
+SharedOutputPublisher::create(const CHOP_Output* output, uint64_t layoutKey)
+{
+	unmap();
+
+#ifdef _WIN32
+	(void)output;
+	(void)layoutKey;
+	return false;
+#else
+	uint32_t numChannels = (uint32_t)output->numChannels;
+	uint32_t maxSamples = 2 * (uint32_t)output->numSamples;
+	if (maxSamples < MinSamples)
+		maxSamples = MinSamples;
+	maxSamples = (uint32_t)roundUp(maxSamples, Alignment / sizeof(float));
+
+	size_t namesBytes = 0;
+	for (uint32_t c = 0; c < numChannels; c++)
+		namesBytes += strlen(output->names[c]) + 1;
+	size_t headerBytes = roundUp(HeaderBytes + namesBytes, Alignment);
+	size_t slotBytes = sizeof(Slot) + sizeof(float) * size_t(numChannels) * maxSamples;
+	size_t totalBytes = headerBytes + slotBytes * myNumSlots;
+
+	// A new object under the same name, readers of the old one keep it
+	// until they let go
+	shm_unlink(myName.c_str());
+	int fd = shm_open(myName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0)
+	{
+		myError = "Can't create the shared memory to publish to";
+		return false;
+	}
+	void* p = MAP_FAILED;
+	if (ftruncate(fd, (off_t)totalBytes) == 0)
+		p = mmap(nullptr, totalBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (p == MAP_FAILED)
+	{
+		shm_unlink(myName.c_str());
+		myError = "Can't map the shared memory to publish to";
+		return false;
+	}
+
+	// A new object is all zeros, so every slot's sequence starts at 0,
+	// nothing written yet
+	myBase = (char*)p;
+	myBytes = totalBytes;
+	myHeader = (Header*)myBase;
+	myHeader->version = Version;
+	myHeader->headerBytes = (uint32_t)headerBytes;
+	myHeader->numChannels = numChannels;
+	myHeader->maxSamples = maxSamples;
+	myHeader->numSlots = (uint32_t)myNumSlots;
+	myHeader->slotBytes = slotBytes;
+	myHeader->totalBytes = totalBytes;
+
+	char* name = myBase + HeaderBytes;
+	for (uint32_t c = 0; c < numChannels; c++)
+	{
+		size_t n = strlen(output->names[c]) + 1;
+		memcpy(name, output->names[c], n);
+		name += n;
+	}
+
+	// The magic goes in last, a reader that finds it finds the rest too
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(myHeader->magic, Magic, sizeof(Magic));
+
+	myLayoutKey = layoutKey;
+	myCook = 0;
+	mySegments++;
+	myError.clear();
+	return true;
+#endif
+}
+
+bool
+SharedOutputPublisher::begin(const CHOP_Output* output)
+{
+	mySlot = nullptr;
+	if (!isOpen())
+		return false;
+
+	uint64_t key = layoutKey(output);
+	if (!myBase || key != myLayoutKey || (uint32_t)output->numSamples > myHeader->maxSamples)
+	{
+		if (!create(output, key))
+			return false;
+	}
+
+	// Odd while it's being written, readers leave it alone
+	mySlot = slot(myBase, *myHeader, myCook);
+	mySlot->sequence.store(2 * myCook + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	mySlot->startIndex = (int64_t)output->startIndex;
+	mySlot->sampleRate = output->sampleRate;
+	mySlot->numSamples = (uint32_t)output->numSamples;
+	return true;
+}
+
+void
+SharedOutputPublisher::writeChannels(const CHOP_Output* output, int32_t begin, int32_t end)
+{
+	if (!mySlot)
+		return;
+	for (int32_t c = begin; c < end; c++)
+		memcpy(samples(mySlot, *myHeader, c), output->channels[c], sizeof(float) * output->numSamples);
+}
+
+void
+SharedOutputPublisher::end()
+{
+	if (!mySlot)
+		return;
+
+	mySlot->sequence.store(2 * myCook + 2, std::memory_order_release);
+	myCook++;
+	myHeader->published.store(myCook, std::memory_order_release);
+	myPublished++;
+	mySlot = nullptr;
+}
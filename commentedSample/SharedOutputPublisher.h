@@ -0,0 +1,100 @@
+/*
+	Publishes every cook's output channels to shared memory, for programs
+	running next to TouchDesigner that want them as they're made.
+
+	The memory is a POSIX shared memory object (shm_open), laid out as
+	described in SharedOutputFormat.h: a header with the channel names and
+	a ring of slots, one cook per slot, each guarded by a seqlock. Readers
+	map it and read the samples where they are, see
+	linuxHost/SharedOutputReader.h.
+
+	Publishing is a copy of the output into the next slot, which different
+	threads can share, and a couple of atomic stores around it. The writer
+	never waits for readers and doesn't know how many there are; one that
+	falls behind by more than the ring finds out from the sequences that it
+	missed some cooks.
+
+	The segment is only made again when the output no longer fits it: the
+	channels or their names change, or a cook has more samples than a slot
+	holds (after dropped frames). The old one is marked closed for its
+	readers and the name moves to the new one.
+
+	Windows has no shm_open, so there open() fails.
+*/
+
+#ifndef __SharedOutputPublisher__
+#define __SharedOutputPublisher__
+
+#include "CHOP_CPlusPlusBase.h"
+#include "SharedOutputFormat.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+class SharedOutputPublisher
+{
+public:
+	static const int32_t	DefaultSlots = 8;
+
+	SharedOutputPublisher();
+	~SharedOutputPublisher();
+
+	SharedOutputPublisher(const SharedOutputPublisher&) = delete;
+	SharedOutputPublisher&	operator=(const SharedOutputPublisher&) = delete;
+
+	// Starts publishing to the shared memory called 'name' (a leading '/'
+	// is added if it's missing), with a ring of 'numSlots' cooks. The
+	// memory itself is made by the first begin(). Returns false and sets
+	// error() if the name can't be used.
+	bool				open(const char* name, int32_t numSlots);
+
+	// Marks the memory closed for the readers and removes the name
+	void				close();
+
+	bool				isOpen() const { return !myName.empty(); }
+
+	// nullptr while all is well
+	const char*			error() const { return myError.empty() ? nullptr : myError.c_str(); }
+
+	// Starts writing this cook's output into the next slot, making the
+	// memory first if the output doesn't fit it. Returns false if there's
+	// nowhere to write it, then error() says why.
+	bool				begin(const CHOP_Output* output);
+
+	// Copies channels [begin, end) of the output into the slot. Different
+	// ranges can be copied from different threads. Call between begin()
+	// and end().
+	void				writeChannels(const CHOP_Output* output, int32_t begin, int32_t end);
+
+	// Lets readers have the slot
+	void				end();
+
+	// Number of cooks published, and of segments made for them
+	int64_t				published() const { return myPublished; }
+	int64_t				segments() const { return mySegments; }
+
+private:
+	bool				create(const CHOP_Output* output, uint64_t layoutKey);
+	void				unmap();
+
+	static uint64_t		layoutKey(const CHOP_Output* output);
+
+	std::string				myName;
+	int32_t					myNumSlots;
+	std::string				myError;
+
+	char*					myBase;
+	size_t					myBytes;
+	SharedOutput::Header*	myHeader;
+
+	// What the segment was made for, and the slot being written
+	uint64_t				myLayoutKey;
+	SharedOutput::Slot*		mySlot;
+	uint64_t				myCook;
+
+	int64_t					myPublished;
+	int64_t					mySegments;
+};
+
+#endif
@@ -0,0 +1,290 @@
+#include "SpectrumAnalyzer.h"
+#include "ChannelKernels.h"
+#include "CookCache.h"
+
+#include <math.h>
+#include <string.h>
+
+SpectrumAnalyzer::SpectrumAnalyzer() :
+	myMode(Mode::Off),
+	mySize(0),
+	myHop(1),
+	myNumBands(0),
+	mySpacing(Spacing::Linear),
+	myLow(0.0),
+	myHigh(0.0),
+	myPlan(nullptr),
+	myValues(0),
+	myNumInputs(0),
+	myInputRate(0.0),
+	myRate(0.0),
+	myLayoutKey(0),
+	myFrames(0)
+{
+}
+
+void
+SpectrumAnalyzer::setup(const OP_CHOPInput* input, Mode mode, int32_t size, int32_t overlap,
+						int32_t bands, Spacing spacing, double low, double high)
+{
+	if (!myPlan || myPlan->size() < size || myPlan->size() / 2 >= size)
+		myPlan = &FFTPlan::get(size);
+	if (overlap < 1)
+		overlap = 1;
+	if (bands < 1)
+		bands = 1;
+
+	myMode = mode;
+	mySize = myPlan->size();
+	myHop = mySize / overlap > 0 ? mySize / overlap : 1;
+	myNumBands = bands;
+	mySpacing = spacing;
+	myLow = low;
+	myHigh = high;
+	myNumInputs = input->numChannels;
+	myInputRate = input->sampleRate;
+	myRate = myInputRate / myHop;
+	myValues = mode == Mode::Bands ? bands : myPlan->numBins();
+
+	// The names come from the input's, so a rename has to be noticed. One
+	// pass over the names is much less than making them all again.
+	uint64_t key = CookCache::mix((uint64_t)input->opId, (uint64_t)(uint32_t)myNumInputs);
+	key = CookCache::mix(key, (uint64_t)(uint32_t)mode);
+	key = CookCache::mix(key, (uint64_t)(uint32_t)mySize);
+	key = CookCache::mix(key, (uint64_t)(uint32_t)myValues);
+	key = CookCache::mix(key, (uint64_t)(uint32_t)spacing);
+	key = CookCache::mix(key, low);
+	key = CookCache::mix(key, high);
+	key = CookCache::mix(key, myInputRate);
+	for (int32_t c = 0; c < myNumInputs; c++)
+	{
+		const char* name = input->getChannelName(c);
+		key = CookCache::hash(name, strlen(name), key);
+	}
+	if (key == myLayoutKey && myNames.size() == numChannels())
+		return;
+	myLayoutKey = key;
+	layout(input);
+}
+
+void
+SpectrumAnalyzer::layout(const OP_CHOPInput* input)
+{
+	const double pi = 3.14159265358979323846;
+	int32_t bins = myPlan->numBins();
+
+	// A periodic Hann window, which overlaps into a constant at 2x and more
+	myWindow.resize(mySize);
+	double sum = 0.0;
+	double sumSquares = 0.0;
+	for (int32_t n = 0; n < mySize; n++)
+	{
+		double w = 0.5 - 0.5 * cos(2.0 * pi * n / mySize);
+		myWindow[n] = float(w);
+		sum += w;
+		sumSquares += w * w;
+	}
+
+	// Every bin but the first and last stands for itself and its mirror
+	// image above Nyquist, so counts twice. By Parseval, the power of every
+	// bin then adds up to the mean square of the (windowed) frame.
+	myBinScale.resize(bins);
+	for (int32_t k = 0; k < bins; k++)
+	{
+		double twice = k == 0 || k == bins - 1 ? 1.0 : 2.0;
+		if (myMode == Mode::Bands)
+			myBinScale[k] = float(twice / (double(mySize) * sumSquares));
+		else
+			myBinScale[k] = float(twice / sum);
+	}
+
+	myBandFirst.clear();
+	myBandLast.clear();
+	if (myMode == Mode::Bands)
+	{
+		double binWidth = myInputRate / mySize;
+		double high = myHigh < 0.5 * myInputRate ? myHigh : 0.5 * myInputRate;
+		double low = myLow > 0.0 ? myLow : 0.0;
+		if (mySpacing == Spacing::Log && low < 0.5 * binWidth)
+			low = 0.5 * binWidth;
+		if (high <= low)
+			high = low + binWidth;
+
+		for (int32_t b = 0; b < myNumBands; b++)
+		{
+			double t0 = double(b) / myNumBands;
+			double t1 = double(b + 1) / myNumBands;
+			double f0, f1;
+			if (mySpacing == Spacing::Log)
+			{
+				f0 = low * pow(high / low, t0);
+				f1 = low * pow(high / low, t1);
+			}
+			else
+			{
+				f0 = low + (high - low) * t0;
+				f1 = low + (high - low) * t1;
+			}
+
+			// The last band includes its top edge
+			int32_t first = (int32_t)ceil(f0 / binWidth);
+			int32_t last = b == myNumBands - 1 ? (int32_t)floor(f1 / binWidth) + 1 : (int32_t)ceil(f1 / binWidth);
+			if (last > bins)
+				last = bins;
+			if (first >= last)
+			{
+				first = (int32_t)floor(0.5 * (f0 + f1) / binWidth + 0.5);
+				if (first > bins - 1)
+					first = bins - 1;
+				last = first + 1;
+			}
+			myBandFirst.push_back(first);
+			myBandLast.push_back(last);
+		}
+	}
+
+	const char* suffix = myMode == Mode::Bands ? "_band" : "_bin";
+	myNames.clear();
+	for (int32_t c = 0; c < myNumInputs; c++)
+	{
+		const char* name = input->getChannelName(c);
+		for (int32_t v = 0; v < myValues; v++)
+			myNames.start().append(name).append(suffix).append((int64_t)v);
+	}
+}
+
+void
+SpectrumAnalyzer::begin(const OP_CHOPInput* input, const CHOP_Output* output)
+{
+	myFrameStarts.clear();
+	if (!myPlan || myNumInputs == 0)
+		return;
+
+	// Every new input sample is kept. Asking the ring for an output window
+	// that ends where the input starts does that, with room for a frame.
+	int64_t inStart = (int64_t)floor(input->startIndex + 0.5);
+	int64_t inEnd = inStart + input->numSamples;
+	myRing.begin(input, double(inStart - mySize), mySize, myInputRate);
+
+	// A frame the input hasn't got to yet is the latest one it has
+	int64_t first = (int64_t)floor(output->startIndex + 0.5);
+	for (int32_t j = 0; j < output->numSamples; j++)
+	{
+		int64_t end = (first + j + 1) * myHop;
+		if (end > inEnd)
+			end = inEnd;
+		myFrameStarts.push_back(end - mySize);
+	}
+	myFrames += output->numSamples;
+}
+
+void
+SpectrumAnalyzer::appendChannels(int32_t begin, int32_t end)
+{
+	for (int32_t c = begin; c < end; c++)
+		myRing.appendChannel(c);
+}
+
+void
+SpectrumAnalyzer::process(float* const* channels, int32_t numChannels, int32_t begin, int32_t end,
+						  const ChannelKernels& kernels, ScratchArena& arena) const
+{
+	const int32_t Lanes = FFTPlan::Lanes;
+	if (!myPlan || myFrameStarts.empty())
+		return;
+
+	int32_t bins = myPlan->numBins();
+	float* re = arena.allocate<float>(size_t(bins) * Lanes);
+	float* im = arena.allocate<float>(size_t(bins) * Lanes);
+	float* assembled = arena.allocate<float>(size_t(mySize) * Lanes);
+	float* values = arena.allocate<float>(size_t(myValues) * Lanes);
+	float* silence = nullptr;
+	ScratchArena::Buffer<float> assembly(arena);
+	const float* frames[Lanes];
+	const float* scale = myBinScale.data();
+
+	for (int32_t g = begin; g < end; g++)
+	{
+		int32_t used = myNumInputs - g * Lanes < Lanes ? myNumInputs - g * Lanes : Lanes;
+		for (int32_t f = 0; f < (int32_t)myFrameStarts.size(); f++)
+		{
+			// Every channel's frame, straight from the input or the ring
+			// when it's in one piece. Lanes without a channel are silent.
+			double start = double(myFrameStarts[f]);
+			for (int32_t l = 0; l < Lanes; l++)
+			{
+				if (l >= used)
+				{
+					if (!silence)
+					{
+						silence = arena.allocate<float>(mySize);
+						memset(silence, 0, sizeof(float) * mySize);
+					}
+					frames[l] = silence;
+					continue;
+				}
+
+				int32_t ch = g * Lanes + l;
+				frames[l] = myRing.window(ch, start, mySize, myInputRate);
+				if (!frames[l])
+				{
+					float* dst = &assembled[size_t(l) * mySize];
+					myRing.readChannel(ch, dst, start, mySize, myInputRate, 1.0f, kernels,
+									   assembly);
+					frames[l] = dst;
+				}
+			}
+
+			myPlan->load(frames, myWindow.data(), re, im);
+			myPlan->transform(re, im);
+
+			// Whole rows at a time, every lane is worked out the same way
+			if (myMode == Mode::Phase)
+			{
+				for (size_t i = 0; i < size_t(bins) * Lanes; i++)
+					values[i] = atan2f(im[i], re[i]);
+			}
+			else if (myMode == Mode::Magnitude)
+			{
+				for (int32_t k = 0; k < bins; k++)
+				{
+					const float* xr = &re[size_t(k) * Lanes];
+					const float* xi = &im[size_t(k) * Lanes];
+					float* dst = &values[size_t(k) * Lanes];
+					for (int32_t l = 0; l < Lanes; l++)
+						dst[l] = sqrtf(xr[l] * xr[l] + xi[l] * xi[l]) * scale[k];
+				}
+			}
+			else
+			{
+				for (int32_t k = 0; k < bins; k++)
+				{
+					float* xr = &re[size_t(k) * Lanes];
+					const float* xi = &im[size_t(k) * Lanes];
+					for (int32_t l = 0; l < Lanes; l++)
+						xr[l] = (xr[l] * xr[l] + xi[l] * xi[l]) * scale[k];
+				}
+				for (int32_t b = 0; b < myNumBands; b++)
+				{
+					float* dst = &values[size_t(b) * Lanes];
+					for (int32_t l = 0; l < Lanes; l++)
+						dst[l] = 0.0f;
+					for (int32_t k = myBandFirst[b]; k < myBandLast[b]; k++)
+					{
+						const float* power = &re[size_t(k) * Lanes];
+						for (int32_t l = 0; l < Lanes; l++)
+							dst[l] += power[l];
+					}
+				}
+			}
+
+			// Sample f of each of the channel's output channels
+			for (int32_t l = 0; l < used; l++)
+			{
+				int32_t base = (g * Lanes + l) * myValues;
+				for (int32_t v = 0; v < myValues && base + v < numChannels; v++)
+					channels[base + v][f] = values[size_t(v) * Lanes + l];
+			}
+		}
+	}
+}
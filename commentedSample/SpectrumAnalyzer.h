@@ -0,0 +1,147 @@
+/*
+	The spectrum of every channel of the first input, for the spectrum
+	mode of the example.
+
+	The input is cut into frames of 'size' samples, a new frame every
+	size / overlap samples, each multiplied by a Hann window and put through
+	an FFT (see FFTPlan.h). Every input channel becomes one output channel
+	per value of a frame, one of:
+		Magnitude	the amplitude of every bin, a sine of amplitude 1 in the
+					middle of a bin reads 1
+		Phase		the phase of every bin, in radians
+		Bands		the mean square of the part of the signal in each band,
+					adding up the power of the bins whose frequency is in it
+	The bands split a frequency range into equal parts, either in Hz or on a
+	log scale (every band the same number of octaves). A band narrower than
+	a bin takes the bin nearest its middle.
+
+	The output runs at one sample per frame, the input's rate divided by
+	the hop. Output sample i is the frame ending at input index
+	(i + 1) * hop, so both timelines stay lined up and every cook analyzes
+	exactly the frames the host asks for, usually one to a few. The input's
+	samples are kept in an InputRing, which holds enough history for the
+	overlap between frames.
+
+	A cook's frames are worked on a batch at a time: the same frame of
+	FFTPlan::Lanes channels is transformed together, one channel per SIMD
+	lane, so 64 channels are only 4 transforms per frame. Different batches
+	can be worked on from different threads.
+*/
+
+#ifndef __SpectrumAnalyzer__
+#define __SpectrumAnalyzer__
+
+#include "CHOP_CPlusPlusBase.h"
+#include "ChannelNamePool.h"
+#include "FFTPlan.h"
+#include "InputRing.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class ChannelKernels;
+
+class SpectrumAnalyzer
+{
+public:
+	// Matches the order of the "Spectrum" menu
+	enum class Mode : int32_t
+	{
+		Off = 0,
+		Magnitude,
+		Phase,
+		Bands,
+	};
+
+	// Matches the order of the "Bandspacing" menu
+	enum class Spacing : int32_t
+	{
+		Linear = 0,
+		Log,
+	};
+
+	SpectrumAnalyzer();
+
+	// Sets up the analysis of 'input' and works out the output's channels,
+	// used from getOutputInfo(). 'size' is rounded up to a power of two.
+	// The bands split [low, high] Hz, capped at the input's Nyquist
+	// frequency.
+	void				setup(const OP_CHOPInput* input, Mode mode, int32_t size,
+							  int32_t overlap, int32_t bands, Spacing spacing, double low,
+							  double high);
+
+	int32_t				numChannels() const { return myNumInputs * myValues; }
+	const char*			channelName(int32_t c) const { return myNames.name(c); }
+
+	// Frames per second, the rate of the output
+	double				sampleRate() const { return myRate; }
+
+	// Finds this cook's frames, one per output sample, and which of the
+	// input's samples are new. 'input' is the one given to setup().
+	void				begin(const OP_CHOPInput* input, const CHOP_Output* output);
+
+	// Keeps the new samples of input channels [begin, end) for the frames
+	// of later cooks. Different channels can be appended from different
+	// threads.
+	void				appendChannels(int32_t begin, int32_t end);
+
+	// Batches of FFTPlan::Lanes input channels, the last one may be partly
+	// used
+	int32_t				numBatches() const { return (myNumInputs + FFTPlan::Lanes - 1) / FFTPlan::Lanes; }
+
+	// Analyzes this cook's frames of the channels in batches [begin, end)
+	// and writes their output channels. Call after appendChannels(). The
+	// buffers for the transforms come from 'arena'.
+	void				process(float* const* channels, int32_t numChannels, int32_t begin,
+								int32_t end, const ChannelKernels& kernels,
+								ScratchArena& arena) const;
+
+	// Number of frames of this cook, and every cook so far
+	int32_t				numFrames() const { return (int32_t)myFrameStarts.size(); }
+	int64_t				frames() const { return myFrames; }
+
+	// Number of input samples in a frame
+	int32_t				frameSize() const { return myPlan ? myPlan->size() : 0; }
+
+private:
+	void				layout(const OP_CHOPInput* input);
+
+	Mode				myMode;
+	int32_t				mySize;
+	int32_t				myHop;
+	int32_t				myNumBands;
+	Spacing				mySpacing;
+	double				myLow;
+	double				myHigh;
+
+	const FFTPlan*		myPlan;
+	std::vector<float>	myWindow;
+
+	// What every bin is multiplied by: for Magnitude its amplitude, for
+	// Bands its share of the mean square
+	std::vector<float>	myBinScale;
+
+	// Bins [myBandFirst[b], myBandLast[b]) are added up into band b
+	std::vector<int32_t>	myBandFirst;
+	std::vector<int32_t>	myBandLast;
+
+	// Values per input channel, bins or bands
+	int32_t				myValues;
+	int32_t				myNumInputs;
+	double				myInputRate;
+	double				myRate;
+
+	// The output's channel names, only made again when the input's
+	// channels or the layout change
+	ChannelNamePool		myNames;
+	uint64_t			myLayoutKey;
+
+	InputRing			myRing;
+
+	// Input index of the first sample of every frame of this cook
+	std::vector<int64_t>	myFrameStarts;
+	int64_t				myFrames;
+};
+
+#endif
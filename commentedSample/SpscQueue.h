@@ -0,0 +1,74 @@
+/*
+	A fixed size, lock-free queue for exactly one producing thread and one
+	consuming thread.
+
+	Each side only ever writes its own index (the producer myHead, the
+	consumer myTail) and reads the other's, so a push or pop is a couple of
+	atomic loads and one release store, with no compare-and-swap. The two
+	indexes are kept a cache line apart so the threads don't keep stealing
+	the line from each other.
+
+	Indexes run freely and are masked by the capacity, which must be a power
+	of two.
+*/
+
+#ifndef __SpscQueue__
+#define __SpscQueue__
+
+#include <atomic>
+#include <stdint.h>
+
+template <typename T, int32_t Capacity>
+class SpscQueue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	SpscQueue() :
+		myHead(0),
+		myTail(0)
+	{
+	}
+
+	// Producer only. False when the queue is full.
+	bool
+	push(const T& item)
+	{
+		uint64_t head = myHead.load(std::memory_order_relaxed);
+		if (head - myTail.load(std::memory_order_acquire) >= (uint64_t)Capacity)
+			return false;
+		myItems[head & (Capacity - 1)] = item;
+		myHead.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only. False when the queue is empty.
+	bool
+	pop(T& item)
+	{
+		uint64_t tail = myTail.load(std::memory_order_relaxed);
+		if (tail == myHead.load(std::memory_order_acquire))
+			return false;
+		item = myItems[tail & (Capacity - 1)];
+		myTail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Either side, only a hint while the other side is running
+	bool
+	empty() const
+	{
+		return myHead.load(std::memory_order_acquire) == myTail.load(std::memory_order_acquire);
+	}
+
+private:
+	// Padded rather than alignas(64), so the owner can still be created with
+	// a plain new before C++17
+	std::atomic<uint64_t>	myHead;
+	char					myHeadPad[64 - sizeof(std::atomic<uint64_t>)];
+	std::atomic<uint64_t>	myTail;
+	char					myTailPad[64 - sizeof(std::atomic<uint64_t>)];
+	T						myItems[Capacity];
+};
+
+#endif
@@ -0,0 +1,237 @@
+#include "ThreadPool.h"
+
+static inline uint64_t
+packRange(int32_t begin, int32_t end)
+{
+	return (uint64_t)(uint32_t)begin | ((uint64_t)(uint32_t)end << 32);
+}
+
+static inline void
+unpackRange(uint64_t r, int32_t& begin, int32_t& end)
+{
+	begin = (int32_t)(uint32_t)(r & 0xFFFFFFFFu);
+	end = (int32_t)(uint32_t)(r >> 32);
+}
+
+
+std::shared_ptr<ThreadPool>
+ThreadPool::acquire()
+{
+	static std::mutex lock;
+	static std::weak_ptr<ThreadPool> current;
+
+	std::lock_guard<std::mutex> guard(lock);
+	std::shared_ptr<ThreadPool> pool = current.lock();
+	if (!pool)
+	{
+		pool.reset(new ThreadPool());
+		current = pool;
+	}
+	return pool;
+}
+
+int32_t
+ThreadPool::hardwareThreads()
+{
+	unsigned n = std::thread::hardware_concurrency();
+	return n > 0 ? (int32_t)n : 1;
+}
+
+ThreadPool::ThreadPool() :
+	mySlotStorage(new Slot[MaxThreads + 1]),
+	mySlots(mySlotStorage.get() + 1),
+	myGeneration(0),
+	myQuit(false),
+	myPending(0),
+	myActive(0),
+	myLastSteals(0),
+	myLastThreads(1)
+{
+	myJob.body = nullptr;
+	myJob.grain = 1;
+	myJob.participants = 1;
+	for (int32_t i = 0; i < MaxThreads; i++)
+		mySlots[i].range.store(0);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(myWakeMutex);
+		myQuit = true;
+	}
+	myWake.notify_all();
+	for (std::thread& t : myWorkers)
+		t.join();
+}
+
+void
+ThreadPool::ensureWorkers(int32_t count)
+{
+	while ((int32_t)myWorkers.size() < count)
+	{
+		int32_t index = (int32_t)myWorkers.size();
+		myWorkers.emplace_back(&ThreadPool::workerLoop, this, index);
+	}
+}
+
+void
+ThreadPool::parallelFor(int32_t count, int32_t grain, int32_t maxThreads,
+						const RangeFunc& body)
+{
+	if (count <= 0)
+		return;
+	if (grain < 1)
+		grain = 1;
+
+	int32_t threads = maxThreads > 0 ? maxThreads : hardwareThreads();
+	if (threads > MaxThreads)
+		threads = MaxThreads;
+	int32_t chunks = count / grain;
+	if (threads > chunks)
+		threads = chunks;
+
+	std::unique_lock<std::mutex> call(myCallMutex, std::try_to_lock);
+	if (threads <= 1 || !call.owns_lock())
+	{
+		body(0, count);
+		if (call.owns_lock())
+			myLastThreads = 1;
+		return;
+	}
+
+	ensureWorkers(threads - 1);
+
+	// Give each participant an even share up front; stealing evens out
+	// whatever imbalance is left.
+	for (int32_t i = 0; i < threads; i++)
+	{
+		int32_t b = (int32_t)((int64_t)count * i / threads);
+		int32_t e = (int32_t)((int64_t)count * (i + 1) / threads);
+		mySlots[i].range.store(packRange(b, e), std::memory_order_relaxed);
+	}
+
+	myPending.store(count);
+	myActive.store(threads - 1);
+	myLastSteals.store(0);
+	myLastThreads = threads;
+
+	// The job is published under the wake mutex so a worker that is late
+	// waking up from the previous job never sees half of this one.
+	Job job;
+	job.body = &body;
+	job.grain = grain;
+	job.participants = threads;
+	{
+		std::lock_guard<std::mutex> guard(myWakeMutex);
+		myJob = job;
+		myGeneration++;
+	}
+	myWake.notify_all();
+
+	runSlot(0, job);
+
+	// Wait for the stragglers. 'body' lives on our stack, so the workers
+	// must all be done with the job before returning.
+	while (myPending.load() > 0 || myActive.load() > 0)
+		std::this_thread::yield();
+}
+
+void
+ThreadPool::workerLoop(int32_t index)
+{
+	uint64_t seen = 0;
+	for (;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> guard(myWakeMutex);
+			myWake.wait(guard, [&]() { return myQuit || myGeneration != seen; });
+			if (myQuit)
+				return;
+			seen = myGeneration;
+			job = myJob;
+		}
+
+		// Worker 'index' runs slot index + 1, slot 0 belongs to the caller
+		if (index + 1 < job.participants)
+		{
+			runSlot(index + 1, job);
+			myActive.fetch_sub(1);
+		}
+	}
+}
+
+void
+ThreadPool::runSlot(int32_t index, const Job& job)
+{
+	const RangeFunc& body = *job.body;
+	for (;;)
+	{
+		int32_t b, e;
+		while (takeFront(index, job, b, e))
+		{
+			body(b, e);
+			myPending.fetch_sub(e - b);
+		}
+
+		if (!stealBack(index, job, b, e))
+			return;
+
+		// Put the stolen range in our own slot so it can be stolen from
+		// again, and carry on taking from its front.
+		mySlots[index].range.store(packRange(b, e));
+	}
+}
+
+bool
+ThreadPool::takeFront(int32_t index, const Job& job, int32_t& begin, int32_t& end)
+{
+	std::atomic<uint64_t>& range = mySlots[index].range;
+	uint64_t r = range.load();
+	for (;;)
+	{
+		int32_t b, e;
+		unpackRange(r, b, e);
+		if (b >= e)
+			return false;
+
+		int32_t nb = e - b > job.grain ? b + job.grain : e;
+		if (range.compare_exchange_weak(r, packRange(nb, e)))
+		{
+			begin = b;
+			end = nb;
+			return true;
+		}
+	}
+}
+
+bool
+ThreadPool::stealBack(int32_t thief, const Job& job, int32_t& begin, int32_t& end)
+{
+	int32_t n = job.participants;
+	for (int32_t k = 1; k < n; k++)
+	{
+		std::atomic<uint64_t>& range = mySlots[(thief + k) % n].range;
+		uint64_t r = range.load();
+		for (;;)
+		{
+			int32_t b, e;
+			unpackRange(r, b, e);
+			int32_t remaining = e - b;
+			if (remaining <= 0)
+				break;
+
+			// Take the back half, or all of it if it's no more than a grain
+			int32_t take = remaining > job.grain ? remaining / 2 : remaining;
+			if (range.compare_exchange_weak(r, packRange(b, e - take)))
+			{
+				begin = e - take;
+				end = e;
+				myLastSteals.fetch_add(1);
+				return true;
+			}
+		}
+	}
+	return false;
+}
@@ -0,0 +1,115 @@
+/*
+	A persistent pool of worker threads for splitting a cook across cores.
+
+	The pool is shared by every instance of the CHOP in the process (Touch
+	cooks CHOPs one at a time, so there is normally only one caller), and
+	its threads stay alive between cooks, sleeping until there is work.
+	Instances hold on to it through acquire(); the threads are joined when
+	the last instance lets go, rather than while the library is unloading.
+
+	parallelFor() splits a range of items (channels, for the example) into
+	one sub-range per participating thread. Each thread takes 'grain' items
+	at a time from the front of its own sub-range; when that runs out it
+	steals the back half of another thread's remaining sub-range. The range
+	bookkeeping is lock free, so stealing costs a compare-and-swap.
+
+	The calling thread always takes part, and a range too small to be worth
+	splitting simply runs inline on the caller.
+*/
+
+#ifndef __ThreadPool__
+#define __ThreadPool__
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	typedef std::function<void(int32_t begin, int32_t end)>	RangeFunc;
+
+	// Most threads a single parallelFor will use
+	static const int32_t	MaxThreads = 64;
+
+	// The process wide pool, created on first use
+	static std::shared_ptr<ThreadPool>	acquire();
+
+	~ThreadPool();
+
+	// Calls body(begin, end) over sub-ranges covering [0, count) and returns
+	// once all of them are done.
+	// 'grain' is the smallest number of items worth handing to a thread;
+	// ranges shorter than two grains run inline.
+	// 'maxThreads' caps how many threads (including the caller) take part,
+	// 0 means one per hardware thread. Asking for more threads than there
+	// are cores is allowed, up to MaxThreads.
+	// If another thread is already running a parallelFor on the pool, this
+	// one runs inline instead of waiting.
+	void					parallelFor(int32_t count, int32_t grain, int32_t maxThreads,
+										const RangeFunc& body);
+
+	// Number of hardware threads, at least 1
+	static int32_t			hardwareThreads();
+
+	// Number of threads that took part in the last parallelFor, including
+	// the caller. 1 means it ran inline.
+	int32_t					lastThreadCount() const { return myLastThreads; }
+
+	// Number of sub-ranges taken by stealing in the last parallelFor
+	int32_t					lastSteals() const { return myLastSteals.load(); }
+
+private:
+	ThreadPool();
+
+	// One thread's share of the range. begin/end are packed into one 64 bit
+	// word so the owner (taking from the front) and thieves (taking from the
+	// back) can both update it with a single compare-and-swap. Padded rather
+	// than alignas(64), which a plain new ignores before C++17, so two
+	// slots' ranges are always a whole cache line apart.
+	struct Slot
+	{
+		std::atomic<uint64_t>	range;
+		char					pad[64 - sizeof(std::atomic<uint64_t>)];
+	};
+
+	struct Job
+	{
+		const RangeFunc*		body;
+		int32_t					grain;
+		int32_t					participants;
+	};
+
+	void					ensureWorkers(int32_t count);
+	void					workerLoop(int32_t index);
+	void					runSlot(int32_t index, const Job& job);
+	bool					takeFront(int32_t index, const Job& job, int32_t& begin, int32_t& end);
+	bool					stealBack(int32_t thief, const Job& job, int32_t& begin, int32_t& end);
+
+	std::vector<std::thread>	myWorkers;
+	// MaxThreads slots after an unused one, which keeps whatever the heap
+	// put before them off the first slot's cache line
+	std::unique_ptr<Slot[]>		mySlotStorage;
+	Slot*						mySlots;
+
+	std::mutex					myCallMutex;
+
+	std::mutex					myWakeMutex;
+	std::condition_variable		myWake;
+	uint64_t					myGeneration;
+	bool						myQuit;
+
+	// Guarded by myWakeMutex, workers take a copy when they wake up
+	Job							myJob;
+	std::atomic<int32_t>		myPending;
+	std::atomic<int32_t>		myActive;
+	std::atomic<int32_t>		myLastSteals;
+	int32_t						myLastThreads;
+};
+
+#endif
@@ -0,0 +1,863 @@
+#include "TopReducer.h"
+#include "ChannelKernels.h"
+#include "ScratchArena.h"
+#include "ThreadPool.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef CK_X86
+	#include <immintrin.h>
+#endif
+
+
+// Most bands the rows are split into
+static const int32_t	MaxBands = 16;
+
+// Rec. 709 luminance weights
+static const float		LumaR = 0.2126f;
+static const float		LumaG = 0.7152f;
+static const float		LumaB = 0.0722f;
+
+// The output colors, and which of the 4 bytes of a BGRA8Fixed pixel holds each
+static const char*		ColorNames[] = { "r", "g", "b", "a" };
+static const int32_t	BGRALane[] = { 2, 1, 0, 3 };
+
+// GL internal formats the "Auto" download type looks for
+static const GLint		GL_R8_ = 0x8229;
+static const GLint		GL_R16_ = 0x822A;
+static const GLint		GL_R16F_ = 0x822D;
+static const GLint		GL_R32F_ = 0x822E;
+static const GLint		GL_RG16F_ = 0x822F;
+static const GLint		GL_RG32F_ = 0x8230;
+static const GLint		GL_RGB10_A2_ = 0x8059;
+static const GLint		GL_RGBA16_ = 0x805B;
+static const GLint		GL_RGBA32F_ = 0x8814;
+static const GLint		GL_RGB32F_ = 0x8815;
+static const GLint		GL_RGBA16F_ = 0x881A;
+static const GLint		GL_RGB16F_ = 0x881B;
+static const GLint		GL_R11F_G11F_B10F_ = 0x8C3A;
+
+
+struct ReduceKernels
+{
+	// sums[k] += every 4th byte from k on, over 'n' BGRA pixels
+	void	(*sumBytes)(const uint8_t* src, int32_t n, uint32_t* sums);
+
+	// sums[k] += every 4th float from k on, over 'n' floats
+	void	(*sumFloats)(const float* src, int32_t n, float* sums);
+
+	// acc[i] += src[i], over 'n' bytes
+	void	(*addBytes)(float* acc, const uint8_t* src, int32_t n);
+
+	// dst[i] = luminance of pixel i, over 'n' BGRA pixels, white is 1
+	void	(*lumaBytes)(float* dst, const uint8_t* src, int32_t n);
+
+	// dst[i] = luminance of pixel i, over 'n' RGBA float pixels
+	void	(*lumaFloats)(float* dst, const float* src, int32_t n);
+
+	// dst[i] = where to count src[i] in a histogram of 'bins' bins covering
+	// 0 to 1, interleaved 4 ways: bin * 4 + (i & 3)
+	void	(*binIndex)(int32_t* dst, const float* src, int32_t n, int32_t bins);
+};
+
+
+// ----------------------------------------------------------------------------
+// Scalar versions, used on non-x86 builds and for the tails of the SIMD loops
+// ----------------------------------------------------------------------------
+
+static void
+sumBytesScalar(const uint8_t* src, int32_t n, uint32_t* sums)
+{
+	uint32_t b = 0, g = 0, r = 0, a = 0;
+	for (int32_t i = 0; i < n; i++, src += 4)
+	{
+		b += src[0];
+		g += src[1];
+		r += src[2];
+		a += src[3];
+	}
+	sums[0] += b;
+	sums[1] += g;
+	sums[2] += r;
+	sums[3] += a;
+}
+
+static void
+sumFloatsScalar(const float* src, int32_t n, float* sums)
+{
+	for (int32_t i = 0; i < n; i++)
+		sums[i & 3] += src[i];
+}
+
+static void
+addBytesScalar(float* acc, const uint8_t* src, int32_t n)
+{
+	for (int32_t i = 0; i < n; i++)
+		acc[i] += (float)src[i];
+}
+
+static void
+lumaBytesScalar(float* dst, const uint8_t* src, int32_t n)
+{
+	const float k = 1.0f / 255.0f;
+	for (int32_t i = 0; i < n; i++, src += 4)
+		dst[i] = (LumaB * src[0] + LumaG * src[1] + LumaR * src[2]) * k;
+}
+
+static void
+lumaFloatsScalar(float* dst, const float* src, int32_t n)
+{
+	for (int32_t i = 0; i < n; i++, src += 4)
+		dst[i] = LumaR * src[0] + LumaG * src[1] + LumaB * src[2];
+}
+
+static void
+binIndexScalar(int32_t* dst, const float* src, int32_t n, int32_t bins, int32_t offset)
+{
+	float scale = float(bins);
+	float top = float(bins - 1);
+	for (int32_t i = offset; i < n; i++)
+	{
+		float v = src[i] * scale;
+		v = v > 0.0f ? v : 0.0f;
+		dst[i] = int32_t(v < top ? v : top) * 4 + (i & 3);
+	}
+}
+
+static void
+binIndexScalar(int32_t* dst, const float* src, int32_t n, int32_t bins)
+{
+	binIndexScalar(dst, src, n, bins, 0);
+}
+
+
+#ifdef CK_X86
+
+// ----------------------------------------------------------------------------
+// SSE2, one pixel per register
+// ----------------------------------------------------------------------------
+
+static void
+sumBytesSSE2(const uint8_t* src, int32_t n, uint32_t* sums)
+{
+	// Widen 4 pixels to one 32 bit lane per byte. A row is far too short for
+	// the lanes to overflow.
+	__m128i zero = _mm_setzero_si128();
+	__m128i acc0 = _mm_setzero_si128();
+	__m128i acc1 = _mm_setzero_si128();
+	int32_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + 4 * i));
+		__m128i lo = _mm_unpacklo_epi8(v, zero);
+		__m128i hi = _mm_unpackhi_epi8(v, zero);
+		acc0 = _mm_add_epi32(acc0, _mm_unpacklo_epi16(lo, zero));
+		acc1 = _mm_add_epi32(acc1, _mm_unpackhi_epi16(lo, zero));
+		acc0 = _mm_add_epi32(acc0, _mm_unpacklo_epi16(hi, zero));
+		acc1 = _mm_add_epi32(acc1, _mm_unpackhi_epi16(hi, zero));
+	}
+
+	uint32_t lanes[4];
+	_mm_storeu_si128((__m128i*)lanes, _mm_add_epi32(acc0, acc1));
+	for (int32_t k = 0; k < 4; k++)
+		sums[k] += lanes[k];
+	sumBytesScalar(src + 4 * i, n - i, sums);
+}
+
+static void
+sumFloatsSSE2(const float* src, int32_t n, float* sums)
+{
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+	int32_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		acc0 = _mm_add_ps(acc0, _mm_loadu_ps(src + i));
+		acc1 = _mm_add_ps(acc1, _mm_loadu_ps(src + i + 4));
+	}
+
+	float lanes[4];
+	_mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+	for (int32_t k = 0; k < 4; k++)
+		sums[k] += lanes[k];
+	sumFloatsScalar(src + i, n - i, sums);
+}
+
+static void
+addBytesSSE2(float* acc, const uint8_t* src, int32_t n)
+{
+	__m128i zero = _mm_setzero_si128();
+	int32_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i lo = _mm_unpacklo_epi8(v, zero);
+		__m128i hi = _mm_unpackhi_epi8(v, zero);
+		__m128i w[4] =
+		{
+			_mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+			_mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)
+		};
+		for (int32_t k = 0; k < 4; k++)
+		{
+			float* d = acc + i + 4 * k;
+			_mm_storeu_ps(d, _mm_add_ps(_mm_loadu_ps(d), _mm_cvtepi32_ps(w[k])));
+		}
+	}
+	addBytesScalar(acc + i, src + i, n - i);
+}
+
+// Adds up the weighted colors of 4 pixels, one per register
+static inline __m128
+luma4SSE2(__m128 p0, __m128 p1, __m128 p2, __m128 p3, __m128 weights)
+{
+	p0 = _mm_mul_ps(p0, weights);
+	p1 = _mm_mul_ps(p1, weights);
+	p2 = _mm_mul_ps(p2, weights);
+	p3 = _mm_mul_ps(p3, weights);
+	_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+	return _mm_add_ps(_mm_add_ps(p0, p1), _mm_add_ps(p2, p3));
+}
+
+static void
+lumaBytesSSE2(float* dst, const uint8_t* src, int32_t n)
+{
+	const float k = 1.0f / 255.0f;
+	__m128 weights = _mm_setr_ps(LumaB * k, LumaG * k, LumaR * k, 0.0f);
+	__m128i zero = _mm_setzero_si128();
+	int32_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + 4 * i));
+		__m128i lo = _mm_unpacklo_epi8(v, zero);
+		__m128i hi = _mm_unpackhi_epi8(v, zero);
+		_mm_storeu_ps(dst + i, luma4SSE2(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)),
+										 _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)),
+										 _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)),
+										 _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), weights));
+	}
+	lumaBytesScalar(dst + i, src + 4 * i, n - i);
+}
+
+static void
+lumaFloatsSSE2(float* dst, const float* src, int32_t n)
+{
+	__m128 weights = _mm_setr_ps(LumaR, LumaG, LumaB, 0.0f);
+	int32_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		const float* p = src + 4 * i;
+		_mm_storeu_ps(dst + i, luma4SSE2(_mm_loadu_ps(p), _mm_loadu_ps(p + 4),
+										 _mm_loadu_ps(p + 8), _mm_loadu_ps(p + 12), weights));
+	}
+	lumaFloatsScalar(dst + i, src + 4 * i, n - i);
+}
+
+static void
+binIndexSSE2(int32_t* dst, const float* src, int32_t n, int32_t bins)
+{
+	__m128 scale = _mm_set1_ps(float(bins));
+	__m128 zero = _mm_setzero_ps();
+	__m128 top = _mm_set1_ps(float(bins - 1));
+	__m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+	int32_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), zero), top);
+		__m128i b = _mm_add_epi32(_mm_slli_epi32(_mm_cvttps_epi32(v), 2), lane);
+		_mm_storeu_si128((__m128i*)(dst + i), b);
+	}
+	binIndexScalar(dst, src, n, bins, i);
+}
+
+
+// ----------------------------------------------------------------------------
+// AVX2, two pixels per register. The AVX-512 level uses these too, a row of
+// pixels is short enough that wider registers don't buy anything.
+// ----------------------------------------------------------------------------
+
+CK_TARGET("avx2,fma") static void
+sumBytesAVX2(const uint8_t* src, int32_t n, uint32_t* sums)
+{
+	__m256i acc0 = _mm256_setzero_si256();
+	__m256i acc1 = _mm256_setzero_si256();
+	int32_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		const uint8_t* p = src + 4 * i;
+		acc0 = _mm256_add_epi32(acc0, _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p)));
+		acc1 = _mm256_add_epi32(acc1, _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(p + 8))));
+		acc0 = _mm256_add_epi32(acc0, _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(p + 16))));
+		acc1 = _mm256_add_epi32(acc1, _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(p + 24))));
+	}
+
+	// Both halves hold B, G, R, A
+	__m256i acc = _mm256_add_epi32(acc0, acc1);
+	__m128i folded = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+	uint32_t lanes[4];
+	_mm_storeu_si128((__m128i*)lanes, folded);
+	for (int32_t k = 0; k < 4; k++)
+		sums[k] += lanes[k];
+	sumBytesScalar(src + 4 * i, n - i, sums);
+}
+
+CK_TARGET("avx2,fma") static void
+sumFloatsAVX2(const float* src, int32_t n, float* sums)
+{
+	__m256 acc0 = _mm256_setzero_ps();
+	__m256 acc1 = _mm256_setzero_ps();
+	int32_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		acc0 = _mm256_add_ps(acc0, _mm256_loadu_ps(src + i));
+		acc1 = _mm256_add_ps(acc1, _mm256_loadu_ps(src + i + 8));
+	}
+
+	__m256 acc = _mm256_add_ps(acc0, acc1);
+	float lanes[4];
+	_mm_storeu_ps(lanes, _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1)));
+	for (int32_t k = 0; k < 4; k++)
+		sums[k] += lanes[k];
+	sumFloatsScalar(src + i, n - i, sums);
+}
+
+CK_TARGET("avx2,fma") static void
+addBytesAVX2(float* acc, const uint8_t* src, int32_t n)
+{
+	int32_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		__m256 a = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i))));
+		__m256 b = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i + 8))));
+		_mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i), a));
+		_mm256_storeu_ps(acc + i + 8, _mm256_add_ps(_mm256_loadu_ps(acc + i + 8), b));
+	}
+	addBytesScalar(acc + i, src + i, n - i);
+}
+
+// Adds up the weighted colors of 8 pixels, two per register. The horizontal
+// adds leave them in the order 0 2 4 6 | 1 3 5 7, the permute puts them back.
+CK_TARGET("avx2,fma") static inline __m256
+luma8AVX2(__m256 p0, __m256 p1, __m256 p2, __m256 p3, __m256 weights)
+{
+	__m256 h01 = _mm256_hadd_ps(_mm256_mul_ps(p0, weights), _mm256_mul_ps(p1, weights));
+	__m256 h23 = _mm256_hadd_ps(_mm256_mul_ps(p2, weights), _mm256_mul_ps(p3, weights));
+	__m256 h = _mm256_hadd_ps(h01, h23);
+	return _mm256_permutevar8x32_ps(h, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+CK_TARGET("avx2,fma") static void
+lumaBytesAVX2(float* dst, const uint8_t* src, int32_t n)
+{
+	const float k = 1.0f / 255.0f;
+	__m256 weights = _mm256_setr_ps(LumaB * k, LumaG * k, LumaR * k, 0.0f,
+									LumaB * k, LumaG * k, LumaR * k, 0.0f);
+	int32_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		const uint8_t* p = src + 4 * i;
+		__m256 p0 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p)));
+		__m256 p1 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(p + 8))));
+		__m256 p2 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(p + 16))));
+		__m256 p3 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(p + 24))));
+		_mm256_storeu_ps(dst + i, luma8AVX2(p0, p1, p2, p3, weights));
+	}
+	lumaBytesScalar(dst + i, src + 4 * i, n - i);
+}
+
+CK_TARGET("avx2,fma") static void
+lumaFloatsAVX2(float* dst, const float* src, int32_t n)
+{
+	__m256 weights = _mm256_setr_ps(LumaR, LumaG, LumaB, 0.0f, LumaR, LumaG, LumaB, 0.0f);
+	int32_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		const float* p = src + 4 * i;
+		_mm256_storeu_ps(dst + i, luma8AVX2(_mm256_loadu_ps(p), _mm256_loadu_ps(p + 8),
+											_mm256_loadu_ps(p + 16), _mm256_loadu_ps(p + 24),
+											weights));
+	}
+	lumaFloatsScalar(dst + i, src + 4 * i, n - i);
+}
+
+CK_TARGET("avx2,fma") static void
+binIndexAVX2(int32_t* dst, const float* src, int32_t n, int32_t bins)
+{
+	__m256 scale = _mm256_set1_ps(float(bins));
+	__m256 zero = _mm256_setzero_ps();
+	__m256 top = _mm256_set1_ps(float(bins - 1));
+	__m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 0, 1, 2, 3);
+	int32_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), zero), top);
+		__m256i b = _mm256_add_epi32(_mm256_slli_epi32(_mm256_cvttps_epi32(v), 2), lane);
+		_mm256_storeu_si256((__m256i*)(dst + i), b);
+	}
+	binIndexScalar(dst, src, n, bins, i);
+}
+
+#endif // CK_X86
+
+
+static const ReduceKernels&
+selectKernels()
+{
+	static const ReduceKernels scalar =
+		{ sumBytesScalar, sumFloatsScalar, addBytesScalar, lumaBytesScalar, lumaFloatsScalar,
+		  binIndexScalar };
+#ifdef CK_X86
+	static const ReduceKernels sse2 =
+		{ sumBytesSSE2, sumFloatsSSE2, addBytesSSE2, lumaBytesSSE2, lumaFloatsSSE2,
+		  binIndexSSE2 };
+	static const ReduceKernels avx2 =
+		{ sumBytesAVX2, sumFloatsAVX2, addBytesAVX2, lumaBytesAVX2, lumaFloatsAVX2,
+		  binIndexAVX2 };
+#endif
+
+	switch (ChannelKernels::get().level)
+	{
+#ifdef CK_X86
+		case CPUFeatureLevel::AVX512:
+		case CPUFeatureLevel::AVX2:		return avx2;
+		case CPUFeatureLevel::SSE2:		return sse2;
+#endif
+		default:						return scalar;
+	}
+}
+
+static size_t
+bytesPerPixel(OP_CPUMemPixelType type)
+{
+	return type == OP_CPUMemPixelType::RGBA32Float ? 16 : 4;
+}
+
+
+TopReducer::TopReducer() :
+	myMode(Mode::Rows),
+	myType(OP_CPUMemPixelType::BGRA8Fixed),
+	myWidth(0),
+	myHeight(0),
+	myBins(0),
+	myColors(4),
+	myRegionsHash(0),
+	myPending(false),
+	myPendingWidth(0),
+	myPendingHeight(0),
+	myPendingType(OP_CPUMemPixelType::BGRA8Fixed),
+	myReductions(0)
+{
+}
+
+OP_CPUMemPixelType
+TopReducer::downloadType(const OP_TOPInput* top, Pixels pixels)
+{
+	switch (pixels)
+	{
+		case Pixels::BGRA8:			return OP_CPUMemPixelType::BGRA8Fixed;
+		case Pixels::R32Float:		return OP_CPUMemPixelType::R32Float;
+		case Pixels::RGBA32Float:	return OP_CPUMemPixelType::RGBA32Float;
+		default:					break;
+	}
+
+	switch (top->pixelFormat)
+	{
+		case GL_R8_:
+		case GL_R16_:
+		case GL_R16F_:
+		case GL_R32F_:
+			return OP_CPUMemPixelType::R32Float;
+
+		case GL_RG16F_:
+		case GL_RG32F_:
+		case GL_RGB10_A2_:
+		case GL_RGBA16_:
+		case GL_RGBA32F_:
+		case GL_RGB32F_:
+		case GL_RGBA16F_:
+		case GL_RGB16F_:
+		case GL_R11F_G11F_B10F_:
+			return OP_CPUMemPixelType::RGBA32Float;
+
+		default:
+			return OP_CPUMemPixelType::BGRA8Fixed;
+	}
+}
+
+void
+TopReducer::setup(Mode mode, OP_CPUMemPixelType type, int32_t width, int32_t height,
+				  int32_t bins, const OP_DATInput* regions)
+{
+	if (type != OP_CPUMemPixelType::R32Float && type != OP_CPUMemPixelType::RGBA32Float)
+		type = OP_CPUMemPixelType::BGRA8Fixed;
+	if (bins < 1)
+		bins = 1;
+
+	bool regionsChanged = false;
+	if (mode == Mode::Regions)
+	{
+		uint64_t before = myRegionsHash;
+		parseRegions(regions);
+		regionsChanged = myRegionsHash != before;
+	}
+
+	if (mode == myMode && type == myType && width == myWidth && height == myHeight &&
+		bins == myBins && !regionsChanged && !myNames.empty())
+	{
+		return;
+	}
+
+	myMode = mode;
+	myType = type;
+	myWidth = width > 0 ? width : 0;
+	myHeight = height > 0 ? height : 0;
+	myBins = bins;
+	myColors = type == OP_CPUMemPixelType::R32Float ? 1 : 4;
+	buildNames();
+	myValues.assign(myNames.size(), 0.0f);
+}
+
+void
+TopReducer::parseRegions(const OP_DATInput* dat)
+{
+	// FNV-1a over the cell contents, the same as the Table shape's DAT
+	uint64_t hash = 1469598103934665603ULL;
+	auto mix = [&hash](uint64_t v)
+	{
+		hash ^= v;
+		hash *= 1099511628211ULL;
+	};
+	if (dat)
+	{
+		mix(dat->opId);
+		mix((uint64_t)dat->numRows);
+		mix((uint64_t)dat->numCols);
+		for (int32_t r = 0; r < dat->numRows; r++)
+		{
+			for (int32_t c = 0; c < dat->numCols; c++)
+			{
+				for (const char* p = dat->getCell(r, c); p && *p; p++)
+					mix((uint8_t)*p);
+				mix(0xFF);
+			}
+		}
+	}
+
+	if (hash == myRegionsHash)
+		return;
+	myRegionsHash = hash;
+
+	myRegions.clear();
+	if (!dat || dat->numCols < 5)
+		return;
+
+	for (int32_t r = 0; r < dat->numRows; r++)
+	{
+		Region region;
+		double* fields[] = { &region.u, &region.v, &region.width, &region.height };
+		bool ok = true;
+		for (int32_t c = 0; c < 4 && ok; c++)
+		{
+			const char* cell = dat->getCell(r, c + 1);
+			char* end = nullptr;
+			*fields[c] = cell ? strtod(cell, &end) : 0.0;
+			ok = cell && end != cell;
+		}
+		if (!ok)
+			continue;
+
+		const char* name = dat->getCell(r, 0);
+		region.name = name && *name ? name : "region" + std::to_string(myRegions.size());
+		myRegions.push_back(region);
+	}
+}
+
+void
+TopReducer::buildNames()
+{
+	myNames.clear();
+	switch (myMode)
+	{
+		case Mode::Rows:
+		case Mode::Columns:
+		{
+			// Every row (or column) of red, then of green...
+			const char* prefix = myMode == Mode::Rows ? "row" : "col";
+			int32_t count = myMode == Mode::Rows ? myHeight : myWidth;
+			for (int32_t c = 0; c < myColors; c++)
+			{
+				for (int32_t i = 0; i < count; i++)
+					myNames.start().append(prefix).append((int64_t)i).append("_").append(ColorNames[c]);
+			}
+			break;
+		}
+		case Mode::Histogram:
+		{
+			for (int32_t b = 0; b < myBins; b++)
+				myNames.start().append("bin").append((int64_t)b);
+			break;
+		}
+		case Mode::Regions:
+		{
+			for (const Region& r : myRegions)
+			{
+				for (int32_t c = 0; c < myColors; c++)
+					myNames.start().append(r.name.c_str()).append("_").append(ColorNames[c]);
+			}
+			break;
+		}
+	}
+}
+
+int64_t
+TopReducer::imageBytes() const
+{
+	return int64_t(myWidth) * myHeight * bytesPerPixel(myType);
+}
+
+void
+TopReducer::reset()
+{
+	myPending = false;
+	myValues.assign(myValues.size(), 0.0f);
+}
+
+bool
+TopReducer::update(OP_Inputs* inputs, const OP_TOPInput* top, ThreadPool& pool,
+				   int32_t maxThreads, int32_t minWork, ScratchArena& arena)
+{
+	OP_TOPInputDownloadOptions options;
+	options.downloadType = OP_TOPInputDownloadType::Delayed;
+	options.cpuMemPixelType = myType;
+	const void* pixels = inputs->getTOPDataInCPUMemory(top, &options);
+
+	// What arrives is what was asked for last cook, which is only any use if
+	// it's the size and type the channels were set up for
+	bool usable = pixels && myPending && myPendingWidth == myWidth &&
+				  myPendingHeight == myHeight && myPendingType == myType;
+	myPending = true;
+	myPendingWidth = top->width;
+	myPendingHeight = top->height;
+	myPendingType = myType;
+
+	if (!usable || myWidth == 0 || myHeight == 0)
+		return false;
+
+	reduce(pixels, pool, maxThreads, minWork, arena);
+	myReductions++;
+	return true;
+}
+
+int32_t
+TopReducer::numBands(int32_t minWork) const
+{
+	int64_t pixels = int64_t(myWidth) * myHeight;
+	int64_t bands = minWork > 0 ? pixels / minWork : MaxBands;
+	if (bands > MaxBands)
+		bands = MaxBands;
+	if (bands > myHeight)
+		bands = myHeight;
+	return bands < 1 ? 1 : int32_t(bands);
+}
+
+void
+TopReducer::reduce(const void* pixels, ThreadPool& pool, int32_t maxThreads, int32_t minWork,
+				   ScratchArena& arena)
+{
+	switch (myMode)
+	{
+		case Mode::Rows:		reduceRows(pixels, pool, maxThreads, minWork); break;
+		case Mode::Columns:		reduceColumns(pixels, pool, maxThreads, minWork); break;
+		case Mode::Histogram:	reduceHistogram(pixels, pool, maxThreads, minWork, arena); break;
+		case Mode::Regions:		reduceRegions(pixels, pool, maxThreads); break;
+	}
+}
+
+void
+TopReducer::sumRow(const void* pixels, int32_t y, int32_t x0, int32_t x1, double* sums) const
+{
+	const ReduceKernels& k = selectKernels();
+	size_t row = size_t(y) * myWidth;
+	int32_t n = x1 - x0;
+
+	if (myType == OP_CPUMemPixelType::BGRA8Fixed)
+	{
+		uint32_t lanes[4] = { 0, 0, 0, 0 };
+		k.sumBytes((const uint8_t*)pixels + 4 * (row + x0), n, lanes);
+		for (int32_t c = 0; c < 4; c++)
+			sums[c] = lanes[BGRALane[c]] / 255.0;
+	}
+	else
+	{
+		float lanes[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		k.sumFloats((const float*)pixels + myColors * (row + x0), myColors * n, lanes);
+		if (myColors == 1)
+			sums[0] = double(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+		else
+			for (int32_t c = 0; c < 4; c++)
+				sums[c] = lanes[c];
+	}
+}
+
+void
+TopReducer::reduceRows(const void* pixels, ThreadPool& pool, int32_t maxThreads, int32_t minWork)
+{
+	int32_t grain = minWork / myWidth > 1 ? minWork / myWidth : 1;
+	float* values = myValues.data();
+	pool.parallelFor(myHeight, grain, maxThreads,
+		[&](int32_t begin, int32_t end)
+		{
+			double sums[4];
+			for (int32_t y = begin; y < end; y++)
+			{
+				sumRow(pixels, y, 0, myWidth, sums);
+				for (int32_t c = 0; c < myColors; c++)
+					values[size_t(c) * myHeight + y] = float(sums[c] / myWidth);
+			}
+		});
+}
+
+void
+TopReducer::reduceColumns(const void* pixels, ThreadPool& pool, int32_t maxThreads,
+						  int32_t minWork)
+{
+	// Each band adds its rows into its own copy of the columns, laid out
+	// like a row of pixels, and the bands are added up at the end
+	const ReduceKernels& k = selectKernels();
+	const ChannelKernels& ck = ChannelKernels::get();
+	int32_t bands = numBands(minWork);
+	size_t rowFloats = size_t(myWidth) * myColors;
+	myPartials.assign(rowFloats * bands, 0.0f);
+
+	pool.parallelFor(bands, 1, maxThreads,
+		[&](int32_t begin, int32_t end)
+		{
+			for (int32_t b = begin; b < end; b++)
+			{
+				float* acc = &myPartials[rowFloats * b];
+				int32_t y0 = int32_t(int64_t(myHeight) * b / bands);
+				int32_t y1 = int32_t(int64_t(myHeight) * (b + 1) / bands);
+				for (int32_t y = y0; y < y1; y++)
+				{
+					size_t row = size_t(y) * myWidth;
+					if (myType == OP_CPUMemPixelType::BGRA8Fixed)
+						k.addBytes(acc, (const uint8_t*)pixels + 4 * row, int32_t(rowFloats));
+					else
+						ck.mulAdd(acc, (const float*)pixels + myColors * row, int32_t(rowFloats), 1.0f);
+				}
+			}
+		});
+
+	float* total = &myPartials[0];
+	for (int32_t b = 1; b < bands; b++)
+		ck.mulAdd(total, &myPartials[rowFloats * b], int32_t(rowFloats), 1.0f);
+
+	bool bytes = myType == OP_CPUMemPixelType::BGRA8Fixed;
+	float norm = 1.0f / (float(myHeight) * (bytes ? 255.0f : 1.0f));
+	for (int32_t c = 0; c < myColors; c++)
+	{
+		int32_t lane = bytes ? BGRALane[c] : c;
+		float* dst = &myValues[size_t(c) * myWidth];
+		for (int32_t x = 0; x < myWidth; x++)
+			dst[x] = total[size_t(x) * myColors + lane] * norm;
+	}
+}
+
+void
+TopReducer::reduceHistogram(const void* pixels, ThreadPool& pool, int32_t maxThreads,
+							int32_t minWork, ScratchArena& arena)
+{
+	// Every band counts into 4 histograms, one for every 4th pixel, so runs
+	// of pixels in the same bin don't wait on each other's increments
+	const ReduceKernels& k = selectKernels();
+	int32_t bands = numBands(minWork);
+	size_t stride = size_t(myBins) * 4;
+	myCounts.assign(stride * bands, 0);
+
+	pool.parallelFor(bands, 1, maxThreads,
+		[&](int32_t begin, int32_t end)
+		{
+			float* luma = arena.allocate<float>(myWidth);
+			int32_t* index = arena.allocate<int32_t>(myWidth);
+			for (int32_t b = begin; b < end; b++)
+			{
+				uint32_t* counts = &myCounts[stride * b];
+				int32_t y0 = int32_t(int64_t(myHeight) * b / bands);
+				int32_t y1 = int32_t(int64_t(myHeight) * (b + 1) / bands);
+				for (int32_t y = y0; y < y1; y++)
+				{
+					size_t row = size_t(y) * myWidth;
+					const float* l = luma;
+					if (myType == OP_CPUMemPixelType::BGRA8Fixed)
+						k.lumaBytes(luma, (const uint8_t*)pixels + 4 * row, myWidth);
+					else if (myType == OP_CPUMemPixelType::RGBA32Float)
+						k.lumaFloats(luma, (const float*)pixels + 4 * row, myWidth);
+					else
+						l = (const float*)pixels + row;
+
+					// Luminance from 0 to 1 is spread over the bins, anything
+					// outside lands in the first or last one. Only the
+					// increments themselves are left for scalar code.
+					k.binIndex(index, l, myWidth, myBins);
+					for (int32_t x = 0; x < myWidth; x++)
+						counts[index[x]]++;
+				}
+			}
+		});
+
+	double norm = 1.0 / (double(myWidth) * myHeight);
+	for (int32_t bin = 0; bin < myBins; bin++)
+	{
+		uint64_t count = 0;
+		for (int32_t b = 0; b < bands; b++)
+		{
+			const uint32_t* counts = &myCounts[stride * b + size_t(bin) * 4];
+			count += uint64_t(counts[0]) + counts[1] + counts[2] + counts[3];
+		}
+		myValues[bin] = float(count * norm);
+	}
+}
+
+void
+TopReducer::reduceRegions(const void* pixels, ThreadPool& pool, int32_t maxThreads)
+{
+	float* values = myValues.data();
+	pool.parallelFor((int32_t)myRegions.size(), 1, maxThreads,
+		[&](int32_t begin, int32_t end)
+		{
+			for (int32_t r = begin; r < end; r++)
+			{
+				// The pixels whose centers are inside the rectangle
+				const Region& region = myRegions[r];
+				auto toPixel = [](double f, int32_t size)
+				{
+					double p = floor(f * size + 0.5);
+					return p < 0.0 ? 0 : (p > size ? size : int32_t(p));
+				};
+				int32_t x0 = toPixel(region.u, myWidth);
+				int32_t x1 = toPixel(region.u + region.width, myWidth);
+				int32_t y0 = toPixel(region.v, myHeight);
+				int32_t y1 = toPixel(region.v + region.height, myHeight);
+
+				double total[4] = { 0.0, 0.0, 0.0, 0.0 };
+				if (x1 > x0 && y1 > y0)
+				{
+					double sums[4];
+					for (int32_t y = y0; y < y1; y++)
+					{
+						sumRow(pixels, y, x0, x1, sums);
+						for (int32_t c = 0; c < myColors; c++)
+							total[c] += sums[c];
+					}
+					double count = double(x1 - x0) * (y1 - y0);
+					for (int32_t c = 0; c < myColors; c++)
+						total[c] /= count;
+				}
+
+				for (int32_t c = 0; c < myColors; c++)
+					values[size_t(r) * myColors + c] = float(total[c]);
+			}
+		});
+}
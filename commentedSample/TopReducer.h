@@ -0,0 +1,158 @@
+/*
+	Reduces a TOP's image to a handful of numbers per cook, for the TOP
+	branch of the example.
+
+	The image is downloaded with OP_TOPInputDownloadType::Delayed, so the
+	GPU copy of this cook's texture overlaps with the rest of the frame and
+	what arrives is the image requested the cook before (nothing arrives on
+	the very first cook). The download is asked for in one of three CPU
+	pixel types, BGRA8Fixed, R32Float or RGBA32Float, picked from the TOP's
+	own pixel format unless set.
+
+	The image is then reduced to one value per channel, one of:
+		Rows		the average of every row, one channel per row and color
+		Columns		the average of every column, one channel per column and color
+		Histogram	the fraction of pixels in each of 'bins' luminance bins
+		Regions		the average color of every rectangle listed in a DAT
+
+	The reductions run straight on the downloaded pixels, a row at a time,
+	with SIMD kernels picked at runtime the same way as ChannelKernels. The
+	rows are split into bands that are worked on by different threads, each
+	band summing into its own partial columns or histogram.
+
+	Rows are in the order OpenGL keeps them, row 0 at the bottom, which is
+	also where v = 0 is for the region DAT.
+*/
+
+#ifndef __TopReducer__
+#define __TopReducer__
+
+#include "CPlusPlus_Common.h"
+#include "ChannelNamePool.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class ScratchArena;
+class ThreadPool;
+
+class TopReducer
+{
+public:
+	// Matches the order of the "Topreduce" menu
+	enum class Mode : int32_t
+	{
+		Rows = 0,
+		Columns,
+		Histogram,
+		Regions,
+	};
+
+	// Matches the order of the "Toppixels" menu
+	enum class Pixels : int32_t
+	{
+		Auto = 0,
+		BGRA8,
+		R32Float,
+		RGBA32Float,
+	};
+
+	TopReducer();
+
+	// The CPU pixel type to download 'top' as. Auto picks R32Float for
+	// single channel textures, RGBA32Float for other float and 16 bit ones,
+	// and BGRA8Fixed for the rest.
+	static OP_CPUMemPixelType	downloadType(const OP_TOPInput* top, Pixels pixels);
+
+	// Sets up the channels for an image of 'width' x 'height' pixels
+	// downloaded as 'type'. 'regions' is only read in Regions mode: one
+	// rectangle per row as name, u, v, width, height, with u, v and the size
+	// measured in fractions of the image. Rows that don't start with a name
+	// and 4 numbers (like a header) are skipped.
+	void				setup(Mode mode, OP_CPUMemPixelType type, int32_t width,
+							  int32_t height, int32_t bins, const OP_DATInput* regions);
+
+	int32_t				numChannels() const { return myNames.size(); }
+	const char*			channelName(int32_t c) const { return myNames.name(c); }
+
+	// Requests this cook's download of 'top' and reduces the one requested
+	// last cook, if it's the size and type setup() was given. Returns true
+	// if values() were updated, otherwise they hold the last image's. Any
+	// buffers the reduction needs come from 'arena'.
+	bool				update(OP_Inputs* inputs, const OP_TOPInput* top, ThreadPool& pool,
+							   int32_t maxThreads, int32_t minWork, ScratchArena& arena);
+
+	// One value per channel
+	const float*		values() const { return myValues.data(); }
+
+	// Number of images reduced
+	int64_t				reductions() const { return myReductions; }
+
+	// Bytes of pixels in each image
+	int64_t				imageBytes() const;
+
+	// Forgets the pending download and the last values
+	void				reset();
+
+private:
+	// One row of the region DAT, in fractions of the image
+	struct Region
+	{
+		std::string		name;
+		double			u;
+		double			v;
+		double			width;
+		double			height;
+	};
+
+	void				parseRegions(const OP_DATInput* dat);
+	void				buildNames();
+	void				reduce(const void* pixels, ThreadPool& pool, int32_t maxThreads,
+							   int32_t minWork, ScratchArena& arena);
+	void				reduceRows(const void* pixels, ThreadPool& pool, int32_t maxThreads,
+								   int32_t minWork);
+	void				reduceColumns(const void* pixels, ThreadPool& pool, int32_t maxThreads,
+									  int32_t minWork);
+	void				reduceHistogram(const void* pixels, ThreadPool& pool, int32_t maxThreads,
+										int32_t minWork, ScratchArena& arena);
+	void				reduceRegions(const void* pixels, ThreadPool& pool, int32_t maxThreads);
+
+	// Sums of each color of pixels [x0, x1) of row y, in output color order
+	// and scaled so white is 1
+	void				sumRow(const void* pixels, int32_t y, int32_t x0, int32_t x1,
+							   double* sums) const;
+
+	// Number of bands to split 'height' rows into
+	int32_t				numBands(int32_t minWork) const;
+
+	Mode				myMode;
+	OP_CPUMemPixelType	myType;
+	int32_t				myWidth;
+	int32_t				myHeight;
+	int32_t				myBins;
+
+	// 1 for R32Float, 4 for the others
+	int32_t				myColors;
+
+	// What the region DAT held last time, so it's only parsed when it changes
+	uint64_t			myRegionsHash;
+	std::vector<Region>	myRegions;
+
+	ChannelNamePool		myNames;
+	std::vector<float>	myValues;
+
+	// Partial column sums or histograms, one set per band
+	std::vector<float>		myPartials;
+	std::vector<uint32_t>	myCounts;
+
+	// The download requested last cook
+	bool				myPending;
+	int32_t				myPendingWidth;
+	int32_t				myPendingHeight;
+	OP_CPUMemPixelType	myPendingType;
+
+	int64_t				myReductions;
+};
+
+#endif
@@ -0,0 +1,356 @@
+#include "WavetableEngine.h"
+#include "ChannelKernels.h"
+#include "CPlusPlus_Common.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#ifdef CK_X86
+	#include <immintrin.h>
+#endif
+
+static const double		TwoPi = 6.283185307179586;
+static const double		Pi = 3.141592653589793;
+
+// A 32-bit phase is the table index in its top bits and the position
+// between that sample and the next in the rest
+static const int32_t	IndexShift = 32 - Wavetable::SizeBits;
+static const uint32_t	FracMask = (1u << IndexShift) - 1;
+static const float		FracScale = 1.0f / float(1u << IndexShift);
+
+
+// ----------------------------------------------------------------------------
+// Lookup kernels: c = c0 + dc * j, then linear interpolation between
+// table[i] and table[i + 1] where i is the top bits of c. The phase wraps
+// around at the end of the cycle by itself, so there's no floor to take.
+// With Unity the scale is 1 and the multiply is left out.
+// ----------------------------------------------------------------------------
+
+template <bool Unity>
+static void
+lookupScalar(float* dst, int32_t n, const float* table, uint32_t c0, uint32_t dc, float scale)
+{
+	for (int32_t j = 0; j < n; j++)
+	{
+		uint32_t c = c0 + dc * (uint32_t)j;
+		uint32_t i = c >> IndexShift;
+		float f = (float)(c & FracMask) * FracScale;
+		float a = table[i];
+		float v = a + f * (table[i + 1] - a);
+		dst[j] = Unity ? v : v * scale;
+	}
+}
+
+#ifdef CK_X86
+
+template <bool Unity>
+CK_TARGET("avx2,fma") static void
+lookupAVX2(float* dst, int32_t n, const float* table, uint32_t c0, uint32_t dc, float scale)
+{
+	const __m256i mask = _mm256_set1_epi32((int32_t)FracMask);
+	const __m256 fracScale = _mm256_set1_ps(FracScale);
+	const __m256 s = _mm256_set1_ps(scale);
+	const __m256i step = _mm256_set1_epi32((int32_t)(dc * 8));
+	__m256i c = _mm256_add_epi32(_mm256_set1_epi32((int32_t)c0),
+								 _mm256_mullo_epi32(_mm256_set1_epi32((int32_t)dc),
+													_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+
+	int32_t j = 0;
+	for (; j + 8 <= n; j += 8)
+	{
+		__m256i i = _mm256_srli_epi32(c, IndexShift);
+		__m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(c, mask)), fracScale);
+		__m256 a = _mm256_i32gather_ps(table, i, 4);
+		__m256 b = _mm256_i32gather_ps(table + 1, i, 4);
+		__m256 v = _mm256_fmadd_ps(f, _mm256_sub_ps(b, a), a);
+		_mm256_storeu_ps(dst + j, Unity ? v : _mm256_mul_ps(v, s));
+		c = _mm256_add_epi32(c, step);
+	}
+	lookupScalar<Unity>(dst + j, n - j, table, c0 + dc * (uint32_t)j, dc, scale);
+}
+
+template <bool Unity>
+CK_TARGET("avx512f") static void
+lookupAVX512(float* dst, int32_t n, const float* table, uint32_t c0, uint32_t dc, float scale)
+{
+	const __m512i mask = _mm512_set1_epi32((int32_t)FracMask);
+	const __m512 fracScale = _mm512_set1_ps(FracScale);
+	const __m512 s = _mm512_set1_ps(scale);
+	const __m512i step = _mm512_set1_epi32((int32_t)(dc * 16));
+	__m512i c = _mm512_add_epi32(_mm512_set1_epi32((int32_t)c0),
+								 _mm512_mullo_epi32(_mm512_set1_epi32((int32_t)dc),
+													_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+																	  8, 9, 10, 11, 12, 13, 14, 15)));
+
+	for (int32_t j = 0; j < n; j += 16)
+	{
+		__mmask16 m = n - j >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - j)) - 1);
+		__m512i i = _mm512_srli_epi32(c, IndexShift);
+		__m512 f = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_and_si512(c, mask)), fracScale);
+		__m512 a = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), m, i, table, 4);
+		__m512 b = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), m, i, table + 1, 4);
+		__m512 v = _mm512_fmadd_ps(f, _mm512_sub_ps(b, a), a);
+		_mm512_mask_storeu_ps(dst + j, m, Unity ? v : _mm512_mul_ps(v, s));
+		c = _mm512_add_epi32(c, step);
+	}
+}
+
+#endif // CK_X86
+
+template <bool Unity>
+static WavetableEngine::LookupKernel
+selectKernel()
+{
+	switch (ChannelKernels::get().level)
+	{
+#ifdef CK_X86
+		case CPUFeatureLevel::AVX512:	return lookupAVX512<Unity>;
+		case CPUFeatureLevel::AVX2:		return lookupAVX2<Unity>;
+#endif
+		// SSE2 has no gather, so the scalar loop is as good as it gets there
+		default:						return lookupScalar<Unity>;
+	}
+}
+
+
+// ----------------------------------------------------------------------------
+// Wavetable
+// ----------------------------------------------------------------------------
+
+Wavetable::Wavetable()
+{
+}
+
+void
+Wavetable::build(float dc, const std::vector<float>& sinAmps,
+				 const std::vector<float>& cosAmps)
+{
+	// One cycle of sin() at the table size, so sin(2*pi*k*n/Size) is just
+	// sine[(k*n) % Size] and building the levels needs no trig calls.
+	static const std::vector<double> sine = []()
+	{
+		std::vector<double> s(Size);
+		for (int32_t i = 0; i < Size; i++)
+			s[i] = sin(TwoPi * i / Size);
+		return s;
+	}();
+
+	myData.assign(size_t(NumLevels) * (Size + 1), 0.0f);
+
+	std::vector<double> acc(Size);
+	for (int32_t l = 0; l < NumLevels; l++)
+	{
+		int32_t harmonics = MaxHarmonics >> l;
+		for (int32_t n = 0; n < Size; n++)
+			acc[n] = dc;
+
+		for (int32_t k = 1; k <= harmonics; k++)
+		{
+			double sa = k < (int32_t)sinAmps.size() ? sinAmps[k] : 0.0;
+			double ca = k < (int32_t)cosAmps.size() ? cosAmps[k] : 0.0;
+			if (sa == 0.0 && ca == 0.0)
+				continue;
+			for (int32_t n = 0; n < Size; n++)
+			{
+				int32_t idx = (k * n) & (Size - 1);
+				acc[n] += sa * sine[idx] + ca * sine[(idx + Size / 4) & (Size - 1)];
+			}
+		}
+
+		float* out = &myData[size_t(l) * (Size + 1)];
+		for (int32_t n = 0; n < Size; n++)
+			out[n] = (float)acc[n];
+		out[Size] = out[0];
+	}
+}
+
+const float*
+Wavetable::level(float cyclesPerSample) const
+{
+	// Highest harmonic that stays under Nyquist at this rate
+	float d = fabsf(cyclesPerSample);
+	float limit = d > 0.0f ? 0.5f / d : (float)MaxHarmonics;
+
+	int32_t l = 0;
+	while (l < NumLevels - 1 && float(MaxHarmonics >> l) > limit)
+		l++;
+	return &myData[size_t(l) * (Size + 1)];
+}
+
+
+// ----------------------------------------------------------------------------
+// WavetableEngine
+// ----------------------------------------------------------------------------
+
+// The built-in shapes, in the same 0..1 range the naive versions used.
+static const Wavetable&
+builtinTable(WavetableEngine::Table table)
+{
+	struct Builtins
+	{
+		Wavetable	square;
+		Wavetable	ramp;
+		Wavetable	triangle;
+
+		Builtins()
+		{
+			std::vector<float> s(Wavetable::MaxHarmonics + 1, 0.0f);
+			std::vector<float> c(Wavetable::MaxHarmonics + 1, 0.0f);
+
+			// Square: 0 for the first half of the cycle, 1 for the second
+			for (int32_t k = 1; k <= Wavetable::MaxHarmonics; k += 2)
+				s[k] = float(-2.0 / (Pi * k));
+			square.build(0.5f, s, c);
+
+			// Ramp: rises from 0 to 1 over the cycle
+			for (int32_t k = 1; k <= Wavetable::MaxHarmonics; k++)
+				s[k] = float(-1.0 / (Pi * k));
+			ramp.build(0.5f, s, c);
+
+			// Triangle: 0 at the start of the cycle, 1 half way through
+			for (int32_t k = 1; k <= Wavetable::MaxHarmonics; k++)
+			{
+				s[k] = 0.0f;
+				c[k] = (k & 1) ? float(-4.0 / (Pi * Pi * k * k)) : 0.0f;
+			}
+			triangle.build(0.5f, s, c);
+		}
+	};
+
+	static const Builtins builtins;
+	switch (table)
+	{
+		case WavetableEngine::Table::Square:	return builtins.square;
+		case WavetableEngine::Table::Ramp:		return builtins.ramp;
+		default:								return builtins.triangle;
+	}
+}
+
+WavetableEngine::WavetableEngine() :
+	myUserHash(0),
+	myUserBuilds(0)
+{
+}
+
+bool
+WavetableEngine::updateUserTable(const OP_DATInput* dat)
+{
+	if (!dat)
+	{
+		myUser = Wavetable();
+		myUserHash = 0;
+		return false;
+	}
+
+	// FNV-1a over the cell contents, so the DFT below only runs when the
+	// table actually changes.
+	uint64_t hash = 1469598103934665603ULL;
+	auto mix = [&hash](uint64_t v)
+	{
+		hash ^= v;
+		hash *= 1099511628211ULL;
+	};
+	mix(dat->opId);
+	mix((uint64_t)dat->numRows);
+	mix((uint64_t)dat->numCols);
+	for (int32_t r = 0; r < dat->numRows; r++)
+	{
+		for (int32_t c = 0; c < dat->numCols; c++)
+		{
+			for (const char* p = dat->getCell(r, c); p && *p; p++)
+				mix((uint8_t)*p);
+			mix(0xFF);
+		}
+	}
+
+	if (hash == myUserHash)
+		return !myUser.empty();
+	myUserHash = hash;
+
+	std::vector<double> values;
+	for (int32_t r = 0; r < dat->numRows; r++)
+	{
+		for (int32_t c = 0; c < dat->numCols; c++)
+		{
+			const char* cell = dat->getCell(r, c);
+			char* end = nullptr;
+			double v = cell ? strtod(cell, &end) : 0.0;
+			if (cell && end != cell)
+				values.push_back(v);
+		}
+	}
+
+	int32_t m = (int32_t)values.size();
+	if (m < 2)
+	{
+		myUser = Wavetable();
+		return false;
+	}
+
+	// Direct DFT of the user's cycle. Only harmonics the table can hold are
+	// kept, which is what band-limits it.
+	int32_t harmonics = m / 2 < Wavetable::MaxHarmonics ? m / 2 : Wavetable::MaxHarmonics;
+	std::vector<float> s(harmonics + 1, 0.0f);
+	std::vector<float> c(harmonics + 1, 0.0f);
+
+	double dc = 0.0;
+	for (double v : values)
+		dc += v;
+	dc /= m;
+
+	for (int32_t k = 1; k <= harmonics; k++)
+	{
+		double a = 0.0;
+		double b = 0.0;
+		for (int32_t n = 0; n < m; n++)
+		{
+			double w = TwoPi * k * n / m;
+			a += values[n] * cos(w);
+			b += values[n] * sin(w);
+		}
+		double norm = (2 * k == m) ? 1.0 / m : 2.0 / m;
+		c[k] = float(a * norm);
+		s[k] = float(b * norm);
+	}
+
+	myUser.build((float)dc, s, c);
+	myUserBuilds++;
+	return true;
+}
+
+const Wavetable*
+WavetableEngine::get(Table table) const
+{
+	if (table == Table::User)
+		return myUser.empty() ? nullptr : &myUser;
+	return &builtinTable(table);
+}
+
+WavetableEngine::LookupKernel
+WavetableEngine::lookupKernel(bool unity)
+{
+	static const LookupKernel kernels[2] = { selectKernel<false>(), selectKernel<true>() };
+	return kernels[unity];
+}
+
+const float*
+WavetableEngine::levelFor(Table table, uint32_t dc) const
+{
+	// The level only cares how fast the phase moves, either way
+	const Wavetable* wt = get(table);
+	return wt ? wt->level((float)(int32_t)dc * (1.0f / 4294967296.0f)) : nullptr;
+}
+
+void
+WavetableEngine::render(float* dst, int32_t n, Table table, uint32_t c0, uint32_t dc,
+						float scale) const
+{
+	const float* level = levelFor(table, dc);
+	if (!level)
+	{
+		for (int32_t j = 0; j < n; j++)
+			dst[j] = 0.0f;
+		return;
+	}
+	lookupKernel(scale == 1.0f)(dst, n, level, c0, dc, scale);
+}
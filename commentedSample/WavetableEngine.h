@@ -0,0 +1,104 @@
+/*
+	Band-limited, mip-mapped wavetables for the generator shapes.
+
+	A naive square or ramp has harmonics all the way up, so at high Speed the
+	ones above Nyquist fold back as aliasing. Instead, every shape is stored
+	as a set of tables ("mip levels") built from its Fourier series, each
+	level holding half as many harmonics as the one before it. At render time
+	the level is picked from the phase increment so that no harmonic goes
+	past Nyquist, and the table is read with linear interpolation.
+
+	The built-in tables (square, ramp, triangle) are built once and shared by
+	every instance. The user table is built per instance from a DAT, and only
+	rebuilt when the DAT's contents change.
+*/
+
+#ifndef __WavetableEngine__
+#define __WavetableEngine__
+
+#include <stdint.h>
+#include <vector>
+
+class OP_DATInput;
+
+class Wavetable
+{
+public:
+	// Samples per cycle in every level
+	static const int32_t	SizeBits = 11;
+	static const int32_t	Size = 1 << SizeBits;
+
+	// Level 0 holds MaxHarmonics harmonics, level L holds MaxHarmonics >> L
+	static const int32_t	MaxHarmonics = 512;
+	static const int32_t	NumLevels = 10;
+
+	Wavetable();
+
+	// Builds every level from a Fourier series:
+	//		v(t) = dc + sum_k sinAmps[k] * sin(2*pi*k*t) + cosAmps[k] * cos(2*pi*k*t)
+	// Index 0 of both arrays is ignored. Missing harmonics are treated as 0.
+	void			build(float dc, const std::vector<float>& sinAmps,
+						  const std::vector<float>& cosAmps);
+
+	bool			empty() const { return myData.empty(); }
+
+	// The level to use for a phase increment of 'dc' cycles per sample.
+	// Each level has Size + 1 samples; the last repeats the first so the
+	// interpolation never has to wrap.
+	const float*	level(float cyclesPerSample) const;
+
+private:
+	std::vector<float>		myData;
+};
+
+
+class WavetableEngine
+{
+public:
+	// Matches OscillatorBank::Shape for the shapes that use tables
+	enum class Table : int32_t
+	{
+		Square = 1,
+		Ramp = 2,
+		Triangle = 3,
+		User = 4,
+	};
+
+	WavetableEngine();
+
+	// Rebuilds the user table from the numbers in 'dat' (read row by row) if
+	// the DAT changed since the last call. One cycle of the waveform is
+	// spread over all the values. Returns false if the DAT is missing or has
+	// fewer than 2 numbers, in which case the user table outputs 0.
+	bool			updateUserTable(const OP_DATInput* dat);
+
+	// dst[j] = scale * table(c0 + dc * j), for j < n. The phases are
+	// fixed point with 2^32 to a cycle and wrap around at the end of it,
+	// their top SizeBits bits are the table index.
+	void			render(float* dst, int32_t n, Table table, uint32_t c0, uint32_t dc,
+						   float scale) const;
+
+	// The loop render() runs on a level of a table, for the best instruction
+	// set this CPU supports. With 'unity' it's the one that leaves out the
+	// multiply by a scale of 1. Callers that render many channels at the
+	// same rate pick the kernel and the level once instead of every call.
+	typedef void	(*LookupKernel)(float* dst, int32_t n, const float* level, uint32_t c0,
+									uint32_t dc, float scale);
+	static LookupKernel	lookupKernel(bool unity);
+
+	// The level of 'table' to read at 'dc' cycles per sample, nullptr if
+	// it's the user table and that's empty
+	const float*	levelFor(Table table, uint32_t dc) const;
+
+	// Number of times the user table has been rebuilt
+	int32_t			userTableBuilds() const { return myUserBuilds; }
+
+private:
+	const Wavetable*	get(Table table) const;
+
+	Wavetable			myUser;
+	uint64_t			myUserHash;
+	int32_t				myUserBuilds;
+};
+
+#endif
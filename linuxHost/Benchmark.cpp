@@ -0,0 +1,557 @@
+/*
+	Benchmark suite for CPlusPlusCHOPExample.
+
+	Every case loads the CHOP library through CHOPHost, so the numbers include
+	the full cook sequence TouchDesigner would run (getGeneralInfo,
+	getOutputInfo, getChannelName, execute). The Info CHOP/DAT queries are
+	skipped while timing.
+
+	Usage:
+		chop_bench [--quick] [--csv] [--filter <text>] [--min-ms <ms>] [--levels] [library]
+
+	'--filter' only runs cases whose name contains the given text.
+
+	'--levels' runs every case once for each instruction set the kernels are
+	built for (scalar, sse2, avx2, avx512, through CHOP_KERNEL_LEVEL) and
+	shows how much faster each is than scalar. Levels the CPU doesn't have
+	run the best one it does.
+*/
+
+#include "MockHost.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#ifndef CHOP_LIBRARY_PATH
+#define CHOP_LIBRARY_PATH "./CPlusPlusCHOPExample.so"
+#endif
+
+
+namespace
+{
+
+struct BenchCase
+{
+	std::string							name;
+	int32_t								channels;
+	int32_t								samples;
+
+	// Called once after the instance is created, to set parameters and wire
+	// up inputs.
+	std::function<void(CHOPHost&)>		setup;
+};
+
+struct BenchResult
+{
+	int32_t		channels;
+	double		nsPerCook;
+	double		nsPerSample;
+	double		samplesPerSec;
+	int64_t		cooks;
+};
+
+typedef std::chrono::steady_clock	Clock;
+
+
+void
+fillInput(MockCHOPInput* in)
+{
+	for (int32_t c = 0; c < in->numChannels; c++)
+	{
+		float* d = in->data(c);
+		for (int32_t s = 0; s < in->numSamples; s++)
+			d[s] = (float)sin(0.01 * s + c);
+	}
+}
+
+// One cycle of a 256 sample waveform for the "Table" shape
+void
+addWaveTable(CHOPHost& host)
+{
+	const int32_t n = 256;
+	MockDATInput* dat = host.addDAT("/project1/wave", n, 1);
+	for (int32_t i = 0; i < n; i++)
+	{
+		double t = double(i) / n;
+		dat->setCell(i, 0, std::to_string(t < 0.25 ? 4.0 * t : 1.0 - (t - 0.25) / 0.75).c_str());
+	}
+	host.setParString("Tabledat", dat->opPath);
+}
+
+// 2000 sensor channels routed to 300 outputs, each fed by 7 of them
+void
+addRoutes(CHOPHost& host)
+{
+	const int32_t outputs = 300;
+	const int32_t fanIn = 7;
+	MockDATInput* dat = host.addDAT("/project1/routes", outputs * fanIn + 1, 3);
+	dat->setCell(0, 0, "source");
+	dat->setCell(0, 1, "destination");
+	dat->setCell(0, 2, "gain");
+	for (int32_t i = 0; i < outputs * fanIn; i++)
+	{
+		int32_t out = i / fanIn;
+		dat->setCell(i + 1, 0, std::to_string((out * 613 + (i % fanIn) * 283) % 2000).c_str());
+		dat->setCell(i + 1, 1, ("out" + std::to_string(out)).c_str());
+		dat->setCell(i + 1, 2, std::to_string(1.0 / (1 + i % fanIn)).c_str());
+	}
+	host.setMenu("Mix", "Route");
+	host.setParString("Routedat", dat->opPath);
+}
+
+// A gradient, so every row and column averages to something different
+void
+fillTOP(MockTOPInput* top)
+{
+	size_t pixels = size_t(top->width) * top->height;
+	if (top->pixelType == OP_CPUMemPixelType::BGRA8Fixed)
+	{
+		for (size_t i = 0; i < top->pixels.size(); i++)
+			top->pixels[i] = uint8_t(i * 7 + i / (4 * top->width));
+	}
+	else
+	{
+		float* f = (float*)top->pixels.data();
+		size_t n = top->pixels.size() / sizeof(float);
+		for (size_t i = 0; i < n; i++)
+			f[i] = float(i % 1021) / 1021.0f + float(i / (n / pixels * top->width)) / top->height;
+	}
+}
+
+// A 4 x 4 grid of regions covering the image
+void
+addRegions(CHOPHost& host)
+{
+	MockDATInput* dat = host.addDAT("/project1/regions", 17, 5);
+	const char* header[] = { "name", "u", "v", "width", "height" };
+	for (int32_t c = 0; c < 5; c++)
+		dat->setCell(0, c, header[c]);
+	for (int32_t i = 0; i < 16; i++)
+	{
+		dat->setCell(i + 1, 0, ("cell" + std::to_string(i)).c_str());
+		dat->setCell(i + 1, 1, std::to_string((i % 4) * 0.25).c_str());
+		dat->setCell(i + 1, 2, std::to_string((i / 4) * 0.25).c_str());
+		dat->setCell(i + 1, 3, "0.25");
+		dat->setCell(i + 1, 4, "0.25");
+	}
+	host.setParString("Regiondat", dat->opPath);
+}
+
+bool
+runCase(const char* library, const BenchCase& bc, double minMs, BenchResult& result)
+{
+	CHOPHost host;
+	if (!host.load(library) || !host.createInstance())
+	{
+		fprintf(stderr, "%s: %s\n", bc.name.c_str(), host.errorString.c_str());
+		return false;
+	}
+
+	// The CHOP runs at 120hz, so pick the cook rate that makes every cook
+	// produce exactly 'samples' samples.
+	host.cookRate = 120.0 / bc.samples;
+	host.queryInfo = false;
+	bc.setup(host);
+
+	for (int i = 0; i < 8; i++)
+		host.cook();
+
+	int64_t cooks = 0;
+	Clock::duration total = Clock::duration::zero();
+	while (cooks < 16 || std::chrono::duration<double, std::milli>(total).count() < minMs)
+	{
+		Clock::time_point t0 = Clock::now();
+		host.cook();
+		total += Clock::now() - t0;
+		cooks++;
+	}
+
+	double ns = std::chrono::duration<double, std::nano>(total).count();
+	double samplesPerCook = double(host.outputChannels()) * host.outputSamples();
+
+	result.channels = host.outputChannels();
+	result.cooks = cooks;
+	result.nsPerCook = ns / cooks;
+	result.nsPerSample = result.nsPerCook / samplesPerCook;
+	result.samplesPerSec = samplesPerCook * 1e9 / result.nsPerCook;
+	return true;
+}
+
+// Runs the case with the kernels capped at 'level'. The level is read once
+// when the library is first loaded, and the library can't be unloaded again
+// (it has unique symbols), so every level runs in its own process.
+bool
+runCaseAtLevel(const char* library, const BenchCase& bc, double minMs, const char* level,
+			   BenchResult& result)
+{
+	int fds[2];
+	if (pipe(fds) != 0)
+		return false;
+
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		close(fds[0]);
+		setenv("CHOP_KERNEL_LEVEL", level, 1);
+		BenchResult r;
+		bool ok = runCase(library, bc, minMs, r);
+		if (ok && write(fds[1], &r, sizeof(r)) != ssize_t(sizeof(r)))
+			ok = false;
+		_exit(ok ? 0 : 1);
+	}
+
+	close(fds[1]);
+	bool ok = pid > 0 && read(fds[0], &result, sizeof(result)) == ssize_t(sizeof(result));
+	close(fds[0]);
+	if (pid > 0)
+		waitpid(pid, nullptr, 0);
+	return ok;
+}
+
+std::vector<BenchCase>
+buildCases(bool quick)
+{
+	std::vector<int32_t> channelCounts = { 1, 16, 128, 512, 4096 };
+	std::vector<int32_t> sampleCounts = { 1, 2, 16, 128, 1024 };
+	if (quick)
+	{
+		channelCounts = { 16, 512 };
+		sampleCounts = { 2, 128 };
+	}
+	const char* shapes[] = { "Sine", "Square", "Ramp", "Triangle", "Table" };
+
+	std::vector<BenchCase> cases;
+	for (int32_t nc : channelCounts)
+	{
+		for (int32_t ns : sampleCounts)
+		{
+			// Every shape with a Scale of 1 and of something else, each
+			// runs its own specialized loop
+			for (const char* shape : shapes)
+			{
+				for (double scale : { 1.0, 0.5 })
+				{
+					BenchCase bc;
+					bc.name = std::string("generator/") + shape + (scale == 1.0 ? "" : "/scaled");
+					bc.channels = nc;
+					bc.samples = ns;
+					bc.setup = [nc, shape, scale](CHOPHost& host)
+					{
+						host.setPar("Channels", nc);
+						host.setPar("Scale", scale);
+						host.setMenu("Shape", shape);
+						if (!strcmp(shape, "Table"))
+							addWaveTable(host);
+					};
+					cases.push_back(bc);
+				}
+			}
+
+			// The sine rendered ahead by the producer thread, the cook only
+			// copies it out of the ring
+			BenchCase bc;
+			bc.name = "generator/async";
+			bc.channels = nc;
+			bc.samples = ns;
+			bc.setup = [nc](CHOPHost& host)
+			{
+				host.setPar("Channels", nc);
+				host.setPar("Async", 1.0);
+			};
+			cases.push_back(bc);
+
+			bc.name = "input/scale";
+			bc.channels = nc;
+			bc.samples = ns;
+			bc.setup = [nc, ns](CHOPHost& host)
+			{
+				host.setPar("Scale", 0.5);
+				fillInput(host.connectInput(nc, ns, 120.0));
+			};
+			cases.push_back(bc);
+
+			// A Scale of 1 only copies the input
+			bc.name = "input/first";
+			bc.setup = [nc, ns](CHOPHost& host)
+			{
+				fillInput(host.connectInput(nc, ns, 120.0));
+			};
+			cases.push_back(bc);
+
+			// An input that isn't moving, so every cook after the first
+			// can be served from the cook cache
+			bc.name = "input/idle";
+			bc.setup = [nc, ns](CHOPHost& host)
+			{
+				host.setPar("Scale", 0.5);
+				host.timesliceInputs = false;
+				fillInput(host.connectInput(nc, ns, 120.0));
+			};
+			cases.push_back(bc);
+		}
+	}
+
+	// The routing matrix, with the cache off so every cook routes every
+	// channel
+	for (int32_t ns : sampleCounts)
+	{
+		BenchCase bc;
+		bc.name = "input/route";
+		bc.channels = 300;
+		bc.samples = ns;
+		bc.setup = [ns](CHOPHost& host)
+		{
+			host.setPar("Cache", 0.0);
+			fillInput(host.connectInput(2000, ns, 120.0));
+			addRoutes(host);
+		};
+		cases.push_back(bc);
+	}
+
+	// 4096 generated channels named by a pattern. The host asks for every
+	// name each cook, so this shows what getChannelName() costs.
+	for (int32_t ns : sampleCounts)
+	{
+		BenchCase bc;
+		bc.name = "generator/names";
+		bc.channels = 4096;
+		bc.samples = ns;
+		bc.setup = [](CHOPHost& host)
+		{
+			host.setPar("Channels", 4096.0);
+			host.setParString("Channelnames", "sensor[0-4095]");
+		};
+		cases.push_back(bc);
+	}
+
+	// 512 channels through two low-pass biquads each, with the cache off so
+	// every cook filters
+	for (int32_t ns : sampleCounts)
+	{
+		BenchCase bc;
+		bc.name = "input/filter";
+		bc.channels = 512;
+		bc.samples = ns;
+		bc.setup = [ns](CHOPHost& host)
+		{
+			host.setPar("Cache", 0.0);
+			host.setMenu("Filter", "Lowpass");
+			host.setPar("Filterstages", 2.0);
+			fillInput(host.connectInput(512, ns, 120.0));
+		};
+		cases.push_back(bc);
+	}
+
+	// 512 channels of a streaming input, with the cook cache on and off.
+	// The input moves every cook, so the cache can never answer and should
+	// cost next to nothing.
+	for (int32_t ns : sampleCounts)
+	{
+		for (int32_t cache = 1; cache >= 0; cache--)
+		{
+			BenchCase bc;
+			bc.name = cache ? "input/stream/cache" : "input/stream/nocache";
+			bc.channels = 512;
+			bc.samples = ns;
+			bc.setup = [ns, cache](CHOPHost& host)
+			{
+				host.setPar("Cache", double(cache));
+				host.setPar("Scale", 0.5);
+				fillInput(host.connectInput(512, ns, 120.0));
+			};
+			cases.push_back(bc);
+		}
+	}
+
+	// 4096 channels of 1khz sensors resampled into a 60hz network, and 64
+	// channels of 48khz audio to 44.1khz, both cooking at 60 fps with the
+	// cache off so every cook resamples
+	struct Resampling
+	{
+		const char*		name;
+		int32_t			channels;
+		double			from;
+		double			to;
+	};
+	const Resampling resamplings[] =
+	{
+		{ "input/resample/1k-60", 4096, 1000.0, 60.0 },
+		{ "input/resample/48k-44k1", 64, 48000.0, 44100.0 },
+	};
+	for (const Resampling& r : resamplings)
+	{
+		BenchCase bc;
+		bc.name = r.name;
+		bc.channels = r.channels;
+		bc.samples = int32_t(r.to / 60.0);
+		bc.setup = [r](CHOPHost& host)
+		{
+			host.cookRate = 60.0;
+			host.setPar("Cache", 0.0);
+			host.setPar("Resample", 1.0);
+			host.setPar("Resamplerate", r.to);
+			fillInput(host.connectInput(r.channels, int32_t(r.from / 60.0), r.from));
+		};
+		cases.push_back(bc);
+	}
+
+	// The spectrum of 64 channels of 48khz audio at 60 fps, 800 input
+	// samples a cook, with 1024 sample frames every 256 samples
+	const char* spectra[] = { "Magnitude", "Phase", "Bands" };
+	for (const char* spectrum : spectra)
+	{
+		BenchCase bc;
+		bc.name = std::string("spectrum/") + spectrum;
+		bc.channels = 64;
+		bc.samples = 800;
+		bc.setup = [spectrum](CHOPHost& host)
+		{
+			host.cookRate = 60.0;
+			host.setMenu("Spectrum", spectrum);
+			host.setMenu("Fftsize", "1024");
+			host.setMenu("Overlap", "4");
+			fillInput(host.connectInput(64, 800, 48000.0));
+		};
+		cases.push_back(bc);
+	}
+
+	// A 1080p TOP reduced to channels, for every reduction and download
+	// type. The channels depend on the image, and 2 samples at 120hz is a
+	// 60 fps cook, one sample of the reduction.
+	struct TopFormat
+	{
+		const char*				name;
+		OP_CPUMemPixelType		type;
+	};
+	const TopFormat formats[] =
+	{
+		{ "bgra8", OP_CPUMemPixelType::BGRA8Fixed },
+		{ "r32f", OP_CPUMemPixelType::R32Float },
+		{ "rgba32f", OP_CPUMemPixelType::RGBA32Float },
+	};
+	const char* reductions[] = { "Rows", "Columns", "Histogram", "Regions" };
+	for (const TopFormat& format : formats)
+	{
+		if (quick && format.type != OP_CPUMemPixelType::BGRA8Fixed)
+			continue;
+		for (const char* reduce : reductions)
+		{
+			BenchCase bc;
+			bc.name = std::string("top/") + reduce + "/" + format.name;
+			bc.channels = 0;
+			bc.samples = 2;
+			bc.setup = [format, reduce](CHOPHost& host)
+			{
+				fillTOP(host.addTOP("/project1/moviefilein1", 1920, 1080, format.type));
+				host.setParString("Top", "/project1/moviefilein1");
+				host.setMenu("Topreduce", reduce);
+				if (!strcmp(reduce, "Regions"))
+					addRegions(host);
+			};
+			cases.push_back(bc);
+		}
+	}
+	return cases;
+}
+
+}
+
+
+int
+main(int argc, char** argv)
+{
+	const char* library = CHOP_LIBRARY_PATH;
+	bool quick = false;
+	bool csv = false;
+	double minMs = 100.0;
+	std::string filter;
+	std::vector<const char*> levels = { nullptr };
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--quick"))
+			quick = true;
+		else if (!strcmp(argv[i], "--csv"))
+			csv = true;
+		else if (!strcmp(argv[i], "--filter") && i + 1 < argc)
+			filter = argv[++i];
+		else if (!strcmp(argv[i], "--min-ms") && i + 1 < argc)
+			minMs = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--levels"))
+			levels = { "scalar", "sse2", "avx2", "avx512" };
+		else
+			library = argv[i];
+	}
+
+	if (quick)
+		minMs = std::min(minMs, 20.0);
+
+	bool byLevel = levels[0] != nullptr;
+	if (csv)
+		printf("case,%schannels,samples,cooks,ns_per_cook,ns_per_sample,samples_per_sec%s\n",
+			   byLevel ? "level," : "", byLevel ? ",speedup" : "");
+	else if (byLevel)
+		printf("%-24s %-7s %8s %8s %14s %14s %16s %8s\n", "case", "level",
+			   "chans", "samples", "ns/cook", "ns/sample", "samples/sec", "speedup");
+	else
+		printf("%-24s %8s %8s %14s %14s %16s\n",
+			   "case", "chans", "samples", "ns/cook", "ns/sample", "samples/sec");
+
+	int failures = 0;
+	for (const BenchCase& bc : buildCases(quick))
+	{
+		if (!filter.empty() && bc.name.find(filter) == std::string::npos)
+			continue;
+
+		double scalarNs = 0.0;
+		for (const char* level : levels)
+		{
+			BenchResult r;
+			bool ok = level ? runCaseAtLevel(library, bc, minMs, level, r) :
+							  runCase(library, bc, minMs, r);
+			if (!ok)
+			{
+				failures++;
+				continue;
+			}
+			if (!scalarNs)
+				scalarNs = r.nsPerCook;
+			double speedup = scalarNs / r.nsPerCook;
+
+			if (csv && level)
+			{
+				printf("%s,%s,%d,%d,%lld,%.1f,%.3f,%.0f,%.2f\n", bc.name.c_str(), level,
+					   r.channels, bc.samples, (long long)r.cooks, r.nsPerCook, r.nsPerSample,
+					   r.samplesPerSec, speedup);
+			}
+			else if (csv)
+			{
+				printf("%s,%d,%d,%lld,%.1f,%.3f,%.0f\n", bc.name.c_str(), r.channels,
+					   bc.samples, (long long)r.cooks, r.nsPerCook, r.nsPerSample,
+					   r.samplesPerSec);
+			}
+			else if (level)
+			{
+				printf("%-24s %-7s %8d %8d %14.1f %14.3f %16.0f %7.2fx\n", bc.name.c_str(),
+					   level, r.channels, bc.samples, r.nsPerCook, r.nsPerSample,
+					   r.samplesPerSec, speedup);
+			}
+			else
+			{
+				printf("%-24s %8d %8d %14.1f %14.3f %16.0f\n", bc.name.c_str(),
+					   r.channels, bc.samples, r.nsPerCook, r.nsPerSample, r.samplesPerSec);
+			}
+			fflush(stdout);
+		}
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+/*
+	Checks that the generator's output doesn't depend on how its samples are
+	split into cooks.
+
+	Every case renders the same stretch of the timeline three ways: one
+	frame per cook, cooks of uneven sizes like a network that drops frames,
+	and the uneven cooks again with "Async" on. The three streams have to be
+	the same bits. Run by ctest once for every instruction set level, see
+	CMakeLists.txt.
+
+	Usage:
+		chop_check [library]
+
+	Exits with 1 if any case differs.
+*/
+
+#include "MockHost.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#ifndef CHOP_LIBRARY_PATH
+#define CHOP_LIBRARY_PATH "./CPlusPlusCHOPExample.so"
+#endif
+
+
+namespace
+{
+
+const int32_t	NumChannels = 5;
+
+// Frames per cook of the uneven split. They add up to TotalFrames.
+const int32_t	Split[] = { 7, 1, 3, 64, 2, 11, 1, 1, 29, 5, 16, 4, 77, 19 };
+const int32_t	TotalFrames = 240;
+
+// Cooks the generator for TotalFrames frames, one per cook or with 'split'
+// the frames of Split, and returns each channel's samples one after the
+// other
+std::vector<float>
+render(const char* library, const char* shape, double speed, double scale, bool split, bool async)
+{
+	std::vector<std::vector<float>> stream(NumChannels);
+
+	CHOPHost host;
+	if (!host.load(library) || !host.createInstance())
+	{
+		fprintf(stderr, "%s\n", host.errorString.c_str());
+		return std::vector<float>();
+	}
+	host.cookRate = 60.0;
+	host.setPar("Channels", NumChannels);
+	host.setMenu("Shape", shape);
+	host.setPar("Speed", speed);
+	host.setPar("Scale", scale);
+	host.setPar("Async", async ? 1.0 : 0.0);
+
+	int32_t cooked = 0;
+	for (int32_t k = 0; cooked < TotalFrames; k++)
+	{
+		int32_t frames = split ? Split[k % (sizeof(Split) / sizeof(Split[0]))] : 1;
+		if (frames > TotalFrames - cooked)
+			frames = TotalFrames - cooked;
+		host.cook(frames);
+		cooked += frames;
+
+		for (int32_t c = 0; c < NumChannels && c < host.outputChannels(); c++)
+			stream[c].insert(stream[c].end(), host.outputChannel(c),
+							 host.outputChannel(c) + host.outputSamples());
+	}
+
+	std::vector<float> all;
+	for (const std::vector<float>& s : stream)
+		all.insert(all.end(), s.begin(), s.end());
+	return all;
+}
+
+bool
+same(const std::vector<float>& a, const std::vector<float>& b)
+{
+	return !a.empty() && a.size() == b.size() &&
+		   memcmp(a.data(), b.data(), sizeof(float) * a.size()) == 0;
+}
+
+}
+
+
+int
+main(int argc, char** argv)
+{
+	const char* library = argc > 1 ? argv[1] : CHOP_LIBRARY_PATH;
+
+	const char* shapes[] = { "Sine", "Square", "Ramp", "Triangle" };
+	const double speeds[] = { 1.0, -3.7, 250.0 };
+	const double scales[] = { 1.0, 0.5 };
+
+	int32_t failures = 0;
+	int32_t cases = 0;
+	for (const char* shape : shapes)
+	{
+		for (double speed : speeds)
+		{
+			for (double scale : scales)
+			{
+				std::vector<float> whole = render(library, shape, speed, scale, false, false);
+				std::vector<float> split = render(library, shape, speed, scale, true, false);
+				std::vector<float> async = render(library, shape, speed, scale, true, true);
+
+				cases++;
+				bool splitOk = same(whole, split);
+				bool asyncOk = same(whole, async);
+				if (splitOk && asyncOk)
+					continue;
+
+				failures++;
+				printf("FAIL %s speed %g scale %g:%s%s\n", shape, speed, scale,
+					   splitOk ? "" : " split cooks differ", asyncOk ? "" : " async differs");
+			}
+		}
+	}
+
+	printf("%d of %d cases match\n", cases - failures, cases);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,850 @@
+#include "MockHost.h"
+
+#include <dlfcn.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+
+// ----------------------------------------------------------------------------
+// MockParameterManager
+// ----------------------------------------------------------------------------
+
+MockParameterManager::MockParameterManager(std::map<std::string, MockParameter>& pars) :
+	myPars(pars)
+{
+}
+
+OP_ParAppendResult
+MockParameterManager::appendNumeric(const OP_NumericParameter &np,
+									MockParameter::Type type, int32_t size)
+{
+	if (!np.name || !np.name[0] || np.name[0] < 'A' || np.name[0] > 'Z' ||
+		myPars.count(np.name))
+		return OP_ParAppendResult::InvalidName;
+	if (size < 1 || size > 4)
+		return OP_ParAppendResult::InvalidSize;
+
+	MockParameter p;
+	p.type = type;
+	p.size = size;
+	for (int i = 0; i < 4; i++)
+		p.values[i] = np.defaultValues[i];
+	p.enabled = true;
+	myPars[np.name] = p;
+	return OP_ParAppendResult::Success;
+}
+
+OP_ParAppendResult
+MockParameterManager::appendText(const OP_StringParameter &sp, MockParameter::Type type)
+{
+	if (!sp.name || !sp.name[0] || sp.name[0] < 'A' || sp.name[0] > 'Z' ||
+		myPars.count(sp.name))
+		return OP_ParAppendResult::InvalidName;
+
+	MockParameter p;
+	p.type = type;
+	p.size = 1;
+	for (int i = 0; i < 4; i++)
+		p.values[i] = 0.0;
+	p.str = sp.defaultValue ? sp.defaultValue : "";
+	p.enabled = true;
+	myPars[sp.name] = p;
+	return OP_ParAppendResult::Success;
+}
+
+OP_ParAppendResult
+MockParameterManager::appendFloat(const OP_NumericParameter &np, int32_t size)
+{
+	return appendNumeric(np, MockParameter::Type::Float, size);
+}
+
+OP_ParAppendResult
+MockParameterManager::appendInt(const OP_NumericParameter &np, int32_t size)
+{
+	return appendNumeric(np, MockParameter::Type::Int, size);
+}
+
+OP_ParAppendResult
+MockParameterManager::appendXY(const OP_NumericParameter &np)
+{
+	return appendNumeric(np, MockParameter::Type::Float, 2);
+}
+
+OP_ParAppendResult
+MockParameterManager::appendXYZ(const OP_NumericParameter &np)
+{
+	return appendNumeric(np, MockParameter::Type::Float, 3);
+}
+
+OP_ParAppendResult
+MockParameterManager::appendUV(const OP_NumericParameter &np)
+{
+	return appendNumeric(np, MockParameter::Type::Float, 2);
+}
+
+OP_ParAppendResult
+MockParameterManager::appendUVW(const OP_NumericParameter &np)
+{
+	return appendNumeric(np, MockParameter::Type::Float, 3);
+}
+
+OP_ParAppendResult
+MockParameterManager::appendRGB(const OP_NumericParameter &np)
+{
+	return appendNumeric(np, MockParameter::Type::Float, 3);
+}
+
+OP_ParAppendResult
+MockParameterManager::appendRGBA(const OP_NumericParameter &np)
+{
+	return appendNumeric(np, MockParameter::Type::Float, 4);
+}
+
+OP_ParAppendResult
+MockParameterManager::appendToggle(const OP_NumericParameter &np)
+{
+	return appendNumeric(np, MockParameter::Type::Toggle, 1);
+}
+
+OP_ParAppendResult
+MockParameterManager::appendPulse(const OP_NumericParameter &np)
+{
+	return appendNumeric(np, MockParameter::Type::Pulse, 1);
+}
+
+OP_ParAppendResult
+MockParameterManager::appendString(const OP_StringParameter &sp)
+{
+	return appendText(sp, MockParameter::Type::String);
+}
+
+OP_ParAppendResult
+MockParameterManager::appendFile(const OP_StringParameter &sp)
+{
+	return appendText(sp, MockParameter::Type::File);
+}
+
+OP_ParAppendResult
+MockParameterManager::appendFolder(const OP_StringParameter &sp)
+{
+	return appendText(sp, MockParameter::Type::File);
+}
+
+OP_ParAppendResult
+MockParameterManager::appendDAT(const OP_StringParameter &sp)
+{
+	return appendText(sp, MockParameter::Type::DAT);
+}
+
+OP_ParAppendResult
+MockParameterManager::appendCHOP(const OP_StringParameter &sp)
+{
+	return appendText(sp, MockParameter::Type::CHOP);
+}
+
+OP_ParAppendResult
+MockParameterManager::appendTOP(const OP_StringParameter &sp)
+{
+	return appendText(sp, MockParameter::Type::TOP);
+}
+
+OP_ParAppendResult
+MockParameterManager::appendObject(const OP_StringParameter &sp)
+{
+	return appendText(sp, MockParameter::Type::Object);
+}
+
+OP_ParAppendResult
+MockParameterManager::appendMenu(const OP_StringParameter &sp,
+								 int32_t nitems, const char **names,
+								 const char **labels)
+{
+	OP_ParAppendResult res = appendText(sp, MockParameter::Type::Menu);
+	if (res != OP_ParAppendResult::Success)
+		return res;
+
+	MockParameter& p = myPars[sp.name];
+	for (int32_t i = 0; i < nitems; i++)
+	{
+		p.menuNames.push_back(names[i]);
+		if (p.str == names[i])
+			p.values[0] = i;
+	}
+	return OP_ParAppendResult::Success;
+}
+
+OP_ParAppendResult
+MockParameterManager::appendStringMenu(const OP_StringParameter &sp,
+									   int32_t nitems, const char **names,
+									   const char **labels)
+{
+	OP_ParAppendResult res = appendMenu(sp, nitems, names, labels);
+	if (res == OP_ParAppendResult::Success)
+		myPars[sp.name].type = MockParameter::Type::String;
+	return res;
+}
+
+
+// ----------------------------------------------------------------------------
+// MockCHOPInput / MockDATInput / MockTOPInput
+// ----------------------------------------------------------------------------
+
+MockCHOPInput::MockCHOPInput(const char* path, uint32_t id, int32_t nchans,
+							 int32_t nsamples, double rate) :
+	myPath(path)
+{
+	opPath = myPath.c_str();
+	opId = id;
+	numChannels = nchans;
+	numSamples = nsamples;
+	sampleRate = rate;
+	startIndex = 0.0;
+
+	myData.resize(nchans, std::vector<float>(nsamples, 0.0f));
+	for (int32_t i = 0; i < nchans; i++)
+		myNames.push_back("chan" + std::to_string(i + 1));
+	rebind();
+}
+
+void
+MockCHOPInput::setChannelName(int32_t chan, const char* name)
+{
+	myNames[chan] = name;
+	rebind();
+}
+
+void
+MockCHOPInput::setWindow(double start, int32_t nsamples)
+{
+	startIndex = start;
+	if (nsamples != numSamples)
+	{
+		numSamples = nsamples;
+		for (auto& d : myData)
+			d.resize(nsamples, 0.0f);
+		rebind();
+	}
+}
+
+void
+MockCHOPInput::rebind()
+{
+	myChannelPtrs.resize(myData.size());
+	myNamePtrs.resize(myNames.size());
+	for (size_t i = 0; i < myData.size(); i++)
+	{
+		myChannelPtrs[i] = myData[i].data();
+		myNamePtrs[i] = myNames[i].c_str();
+	}
+	channelData = myChannelPtrs.data();
+	nameData = myNamePtrs.data();
+}
+
+
+MockDATInput::MockDATInput(const char* path, uint32_t id, int32_t rows, int32_t cols) :
+	myPath(path)
+{
+	opPath = myPath.c_str();
+	opId = id;
+	isTable = true;
+	numRows = 0;
+	numCols = 0;
+	resize(rows, cols);
+}
+
+void
+MockDATInput::setCell(int32_t row, int32_t col, const char* value)
+{
+	myCells[row * numCols + col] = value;
+	rebind();
+}
+
+void
+MockDATInput::resize(int32_t rows, int32_t cols)
+{
+	std::vector<std::string> cells(rows * cols);
+	for (int32_t r = 0; r < rows && r < numRows; r++)
+		for (int32_t c = 0; c < cols && c < numCols; c++)
+			cells[r * cols + c] = myCells[r * numCols + c];
+	myCells.swap(cells);
+	numRows = rows;
+	numCols = cols;
+	rebind();
+}
+
+void
+MockDATInput::rebind()
+{
+	myCellPtrs.resize(myCells.size());
+	for (size_t i = 0; i < myCells.size(); i++)
+		myCellPtrs[i] = myCells[i].c_str();
+	cellData = myCellPtrs.data();
+}
+
+
+MockTOPInput::MockTOPInput(const char* path, uint32_t id, int32_t w, int32_t h,
+						   OP_CPUMemPixelType type) :
+	pixelType(type),
+	downloads(0),
+	myPath(path)
+{
+	opPath = myPath.c_str();
+	opId = id;
+	width = w;
+	height = h;
+	textureIndex = 0;
+	textureType = 0;
+	depth = 1;
+
+	// The GL internal format a texture holding these pixels would have
+	size_t bpp = 4;
+	switch (type)
+	{
+		case OP_CPUMemPixelType::RGBA32Float:	bpp = 16; pixelFormat = 0x8814; break;	// GL_RGBA32F
+		case OP_CPUMemPixelType::R8Fixed:		bpp = 1; pixelFormat = 0x8229; break;	// GL_R8
+		case OP_CPUMemPixelType::RG8Fixed:		bpp = 2; pixelFormat = 0x822B; break;	// GL_RG8
+		case OP_CPUMemPixelType::R32Float:		bpp = 4; pixelFormat = 0x822E; break;	// GL_R32F
+		case OP_CPUMemPixelType::RG32Float:		bpp = 8; pixelFormat = 0x8230; break;	// GL_RG32F
+		default:								bpp = 4; pixelFormat = 0x8058; break;	// GL_RGBA8
+	}
+	pixels.resize(size_t(w) * size_t(h) * bpp, 0);
+}
+
+
+// ----------------------------------------------------------------------------
+// MockInputs
+// ----------------------------------------------------------------------------
+
+MockInputs::MockInputs() :
+	parLookups(0),
+	enableParCalls(0)
+{
+}
+
+MockParameter*
+MockInputs::find(const char* name)
+{
+	parLookups++;
+	auto it = pars.find(name);
+	return it == pars.end() ? nullptr : &it->second;
+}
+
+int32_t
+MockInputs::getNumInputs()
+{
+	return (int32_t)chopInputs.size();
+}
+
+const OP_TOPInput*
+MockInputs::getInputTOP(int32_t index)
+{
+	return nullptr;
+}
+
+const OP_CHOPInput*
+MockInputs::getInputCHOP(int32_t index)
+{
+	if (index < 0 || index >= (int32_t)chopInputs.size())
+		return nullptr;
+	return chopInputs[index];
+}
+
+const OP_DATInput*
+MockInputs::getParDAT(const char *name)
+{
+	MockParameter* p = find(name);
+	return p ? getDAT(p->str.c_str()) : nullptr;
+}
+
+const OP_TOPInput*
+MockInputs::getParTOP(const char *name)
+{
+	MockParameter* p = find(name);
+	return p ? getTOP(p->str.c_str()) : nullptr;
+}
+
+const OP_CHOPInput*
+MockInputs::getParCHOP(const char *name)
+{
+	MockParameter* p = find(name);
+	return p ? getCHOP(p->str.c_str()) : nullptr;
+}
+
+const OP_ObjectInput*
+MockInputs::getParObject(const char *name)
+{
+	return nullptr;
+}
+
+double
+MockInputs::getParDouble(const char* name, int32_t index)
+{
+	MockParameter* p = find(name);
+	if (!p || index < 0 || index > 3)
+		return 0.0;
+	return p->values[index];
+}
+
+bool
+MockInputs::getParDouble2(const char* name, double &v0, double &v1)
+{
+	MockParameter* p = find(name);
+	if (!p)
+		return false;
+	v0 = p->values[0];
+	v1 = p->values[1];
+	return true;
+}
+
+bool
+MockInputs::getParDouble3(const char* name, double &v0, double &v1, double &v2)
+{
+	MockParameter* p = find(name);
+	if (!p)
+		return false;
+	v0 = p->values[0];
+	v1 = p->values[1];
+	v2 = p->values[2];
+	return true;
+}
+
+bool
+MockInputs::getParDouble4(const char* name, double &v0, double &v1, double &v2, double &v3)
+{
+	MockParameter* p = find(name);
+	if (!p)
+		return false;
+	v0 = p->values[0];
+	v1 = p->values[1];
+	v2 = p->values[2];
+	v3 = p->values[3];
+	return true;
+}
+
+int32_t
+MockInputs::getParInt(const char* name, int32_t index)
+{
+	return (int32_t)lround(getParDouble(name, index));
+}
+
+bool
+MockInputs::getParInt2(const char* name, int32_t &v0, int32_t &v1)
+{
+	double d0, d1;
+	if (!getParDouble2(name, d0, d1))
+		return false;
+	v0 = (int32_t)lround(d0);
+	v1 = (int32_t)lround(d1);
+	return true;
+}
+
+bool
+MockInputs::getParInt3(const char* name, int32_t &v0, int32_t &v1, int32_t &v2)
+{
+	double d0, d1, d2;
+	if (!getParDouble3(name, d0, d1, d2))
+		return false;
+	v0 = (int32_t)lround(d0);
+	v1 = (int32_t)lround(d1);
+	v2 = (int32_t)lround(d2);
+	return true;
+}
+
+bool
+MockInputs::getParInt4(const char* name, int32_t &v0, int32_t &v1, int32_t &v2, int32_t &v3)
+{
+	double d0, d1, d2, d3;
+	if (!getParDouble4(name, d0, d1, d2, d3))
+		return false;
+	v0 = (int32_t)lround(d0);
+	v1 = (int32_t)lround(d1);
+	v2 = (int32_t)lround(d2);
+	v3 = (int32_t)lround(d3);
+	return true;
+}
+
+const char*
+MockInputs::getParString(const char* name)
+{
+	MockParameter* p = find(name);
+	if (!p)
+		return "";
+	if (p->type == MockParameter::Type::Menu)
+	{
+		int32_t i = (int32_t)p->values[0];
+		if (i >= 0 && i < (int32_t)p->menuNames.size())
+			return p->menuNames[i].c_str();
+	}
+	return p->str.c_str();
+}
+
+const char*
+MockInputs::getParFilePath(const char* name)
+{
+	return getParString(name);
+}
+
+bool
+MockInputs::getRelativeTransform(const char* from_name, const char* to_name,
+								 double matrix[4][4])
+{
+	return false;
+}
+
+void
+MockInputs::enablePar(const char* name, bool onoff)
+{
+	enableParCalls++;
+	MockParameter* p = find(name);
+	if (p)
+		p->enabled = onoff;
+}
+
+const OP_DATInput*
+MockInputs::getDAT(const char *path)
+{
+	auto it = dats.find(path);
+	return it == dats.end() ? nullptr : it->second;
+}
+
+const OP_TOPInput*
+MockInputs::getTOP(const char *path)
+{
+	auto it = tops.find(path);
+	return it == tops.end() ? nullptr : it->second;
+}
+
+const OP_CHOPInput*
+MockInputs::getCHOP(const char *path)
+{
+	auto it = chops.find(path);
+	return it == chops.end() ? nullptr : it->second;
+}
+
+const OP_ObjectInput*
+MockInputs::getObject(const char *path)
+{
+	return nullptr;
+}
+
+void*
+MockInputs::getTOPDataInCPUMemory(const OP_TOPInput *top,
+								  const OP_TOPInputDownloadOptions *options)
+{
+	for (auto& t : tops)
+	{
+		MockTOPInput* mt = t.second;
+		if (mt != top)
+			continue;
+
+		// A delayed download only has data from the second request onwards
+		bool first = mt->downloads++ == 0;
+		if (first && options->downloadType == OP_TOPInputDownloadType::Delayed)
+			return nullptr;
+		if (options->cpuMemPixelType != mt->pixelType)
+			return nullptr;
+		return mt->pixels.data();
+	}
+	return nullptr;
+}
+
+
+// ----------------------------------------------------------------------------
+// CHOPHost
+// ----------------------------------------------------------------------------
+
+CHOPHost::CHOPHost() :
+	cookRate(60.0),
+	timelineFrame(0.0),
+	timesliceInputs(true),
+	queryInfo(true),
+	myLibrary(nullptr),
+	myGetVersion(nullptr),
+	myCreate(nullptr),
+	myDestroy(nullptr),
+	myInstance(nullptr),
+	myNumSamples(0),
+	mySampleRate(0.0f)
+{
+	memset(&myNodeInfo, 0, sizeof(myNodeInfo));
+}
+
+CHOPHost::~CHOPHost()
+{
+	destroyInstance();
+	if (myLibrary)
+		dlclose(myLibrary);
+}
+
+bool
+CHOPHost::load(const char* libraryPath)
+{
+	myLibrary = dlopen(libraryPath, RTLD_NOW | RTLD_LOCAL);
+	if (!myLibrary)
+	{
+		errorString = dlerror();
+		return false;
+	}
+
+	myGetVersion = (GETCHOPAPIVERSION_FN)dlsym(myLibrary, "GetCHOPAPIVersion");
+	myCreate = (CREATECHOPINSTANCE_FN)dlsym(myLibrary, "CreateCHOPInstance");
+	myDestroy = (DESTROYCHOPINSTANCE_FN)dlsym(myLibrary, "DestroyCHOPInstance");
+	if (!myGetVersion || !myCreate || !myDestroy)
+	{
+		errorString = "library does not export the CHOP entry points";
+		return false;
+	}
+
+	if (myGetVersion() != CHOP_CPLUSPLUS_API_VERSION)
+	{
+		errorString = "CHOP API version mismatch";
+		return false;
+	}
+	return true;
+}
+
+bool
+CHOPHost::createInstance(const char* opPath)
+{
+	if (!myCreate)
+		return false;
+
+	myOpPath = opPath;
+	myNodeInfo.opPath = myOpPath.c_str();
+	myNodeInfo.opID = 1;
+
+	myInstance = myCreate(&myNodeInfo);
+	if (!myInstance)
+	{
+		errorString = "CreateCHOPInstance returned nullptr";
+		return false;
+	}
+
+	// FUNCTION CALL ORDER DURING INITIALIZATION
+	myInputs.pars.clear();
+	MockParameterManager manager(myInputs.pars);
+	myInstance->setupParameters(&manager);
+	return true;
+}
+
+void
+CHOPHost::destroyInstance()
+{
+	if (myInstance)
+		myDestroy(myInstance);
+	myInstance = nullptr;
+}
+
+void
+CHOPHost::cook(int32_t frames)
+{
+	myInputs.parLookups = 0;
+	myInputs.enableParCalls = 0;
+
+	CHOP_GeneralInfo ginfo;
+	memset(&ginfo, 0, sizeof(ginfo));
+	myInstance->getGeneralInfo(&ginfo);
+
+	double prevFrame = timelineFrame;
+	timelineFrame += frames;
+
+	if (timesliceInputs)
+	{
+		for (MockCHOPInput* in : myInputs.chopInputs)
+		{
+			double perFrame = in->sampleRate / cookRate;
+			int64_t start = (int64_t)floor(prevFrame * perFrame + 1e-9);
+			int64_t end = (int64_t)floor(timelineFrame * perFrame + 1e-9);
+			in->setWindow((double)start, (int32_t)(end - start > 0 ? end - start : 1));
+		}
+	}
+
+	CHOP_OutputInfo oinfo;
+	memset(&oinfo, 0, sizeof(oinfo));
+	oinfo.numChannels = 1;
+	oinfo.numSamples = 1;
+	oinfo.startIndex = 0;
+	oinfo.sampleRate = (float)cookRate;
+	oinfo.opInputs = &myInputs;
+
+	const MockCHOPInput* match = nullptr;
+	if (ginfo.inputMatchIndex >= 0 && ginfo.inputMatchIndex < (int32_t)myInputs.chopInputs.size())
+		match = myInputs.chopInputs[ginfo.inputMatchIndex];
+	if (match)
+	{
+		oinfo.numChannels = match->numChannels;
+		oinfo.numSamples = match->numSamples;
+		oinfo.startIndex = (uint32_t)match->startIndex;
+		oinfo.sampleRate = (float)match->sampleRate;
+	}
+
+	bool custom = myInstance->getOutputInfo(&oinfo);
+
+	// A timesliced CHOP gets however many samples fit in the frames that
+	// passed since the last cook, at the CHOP's own sample rate.
+	if (ginfo.timeslice)
+	{
+		double perFrame = oinfo.sampleRate / cookRate;
+		int64_t start = (int64_t)floor(prevFrame * perFrame + 1e-9);
+		int64_t end = (int64_t)floor(timelineFrame * perFrame + 1e-9);
+		oinfo.startIndex = (uint32_t)start;
+		oinfo.numSamples = (int32_t)(end - start > 0 ? end - start : 1);
+	}
+
+	myNames.resize(oinfo.numChannels);
+	for (int32_t i = 0; i < oinfo.numChannels; i++)
+	{
+		if (custom)
+		{
+			const char* n = myInstance->getChannelName(i, nullptr);
+			myNames[i] = n ? n : "";
+		}
+		else if (match && i < match->numChannels)
+			myNames[i] = match->getChannelName(i);
+		else
+			myNames[i] = "chan" + std::to_string(i + 1);
+	}
+
+	myChannels.resize(oinfo.numChannels);
+	myChannelPtrs.resize(oinfo.numChannels);
+	myNamePtrs.resize(oinfo.numChannels);
+	for (int32_t i = 0; i < oinfo.numChannels; i++)
+	{
+		myChannels[i].resize(oinfo.numSamples);
+		myChannelPtrs[i] = myChannels[i].data();
+		myNamePtrs[i] = myNames[i].c_str();
+	}
+	myNumSamples = oinfo.numSamples;
+	mySampleRate = oinfo.sampleRate;
+
+	CHOP_Output output(oinfo.numChannels, oinfo.numSamples, oinfo.sampleRate,
+					   oinfo.startIndex);
+	output.names = myNamePtrs.data();
+	output.channels = myChannelPtrs.data();
+
+	myInstance->execute(&output, &myInputs, nullptr);
+
+	if (!queryInfo)
+		return;
+
+	myInfoCHOP.clear();
+	int32_t nInfo = myInstance->getNumInfoCHOPChans();
+	for (int32_t i = 0; i < nInfo; i++)
+	{
+		OP_InfoCHOPChan chan;
+		chan.name = nullptr;
+		chan.value = 0.0f;
+		myInstance->getInfoCHOPChan(i, &chan);
+		myInfoCHOP.push_back(std::make_pair(std::string(chan.name ? chan.name : ""),
+											chan.value));
+	}
+
+	myInfoDAT.clear();
+	OP_InfoDATSize dsize;
+	dsize.rows = 0;
+	dsize.cols = 0;
+	dsize.byColumn = false;
+	if (myInstance->getInfoDATSize(&dsize))
+	{
+		myInfoDAT.assign(dsize.rows, std::vector<std::string>(dsize.cols));
+		int32_t lines = dsize.byColumn ? dsize.cols : dsize.rows;
+		int32_t entriesPer = dsize.byColumn ? dsize.rows : dsize.cols;
+		std::vector<char*> values(entriesPer);
+		for (int32_t l = 0; l < lines; l++)
+		{
+			for (auto& v : values)
+				v = nullptr;
+			OP_InfoDATEntries entries;
+			entries.values = values.data();
+			myInstance->getInfoDATEntries(l, entriesPer, &entries);
+			// Touch copies the strings right away, so do the same here
+			for (int32_t e = 0; e < entriesPer; e++)
+			{
+				std::string s = values[e] ? values[e] : "";
+				if (dsize.byColumn)
+					myInfoDAT[e][l] = s;
+				else
+					myInfoDAT[l][e] = s;
+			}
+		}
+	}
+
+	myInstance->getInfoPopupString();
+	const char* w = myInstance->getWarningString();
+	myWarning = w ? w : "";
+	const char* e = myInstance->getErrorString();
+	myError = e ? e : "";
+}
+
+void
+CHOPHost::setPar(const char* name, double v, int32_t index)
+{
+	auto it = myInputs.pars.find(name);
+	if (it != myInputs.pars.end() && index >= 0 && index < 4)
+		it->second.values[index] = v;
+}
+
+void
+CHOPHost::setParString(const char* name, const char* v)
+{
+	auto it = myInputs.pars.find(name);
+	if (it != myInputs.pars.end())
+		it->second.str = v;
+}
+
+void
+CHOPHost::setMenu(const char* name, const char* item)
+{
+	auto it = myInputs.pars.find(name);
+	if (it == myInputs.pars.end())
+		return;
+	MockParameter& p = it->second;
+	for (size_t i = 0; i < p.menuNames.size(); i++)
+	{
+		if (p.menuNames[i] == item)
+			p.values[0] = (double)i;
+	}
+}
+
+void
+CHOPHost::pulse(const char* name)
+{
+	myInstance->pulsePressed(name);
+}
+
+MockCHOPInput*
+CHOPHost::connectInput(int32_t nchans, int32_t nsamples, double rate)
+{
+	int32_t n = (int32_t)myOwnedInputs.size();
+	std::string path = "/project1/in" + std::to_string(n + 1);
+	myOwnedInputs.emplace_back(new MockCHOPInput(path.c_str(), 100 + n, nchans,
+												 nsamples, rate));
+	myInputs.chopInputs.push_back(myOwnedInputs.back().get());
+	return myOwnedInputs.back().get();
+}
+
+void
+CHOPHost::disconnectInputs()
+{
+	myInputs.chopInputs.clear();
+	myOwnedInputs.clear();
+}
+
+MockDATInput*
+CHOPHost::addDAT(const char* path, int32_t rows, int32_t cols)
+{
+	uint32_t id = 1000 + (uint32_t)myOwnedDATs.size();
+	myOwnedDATs.emplace_back(new MockDATInput(path, id, rows, cols));
+	myInputs.dats[path] = myOwnedDATs.back().get();
+	return myOwnedDATs.back().get();
+}
+
+MockTOPInput*
+CHOPHost::addTOP(const char* path, int32_t width, int32_t height, OP_CPUMemPixelType type)
+{
+	uint32_t id = 2000 + (uint32_t)myOwnedTOPs.size();
+	myOwnedTOPs.emplace_back(new MockTOPInput(path, id, width, height, type));
+	myInputs.tops[path] = myOwnedTOPs.back().get();
+	return myOwnedTOPs.back().get();
+}
@@ -0,0 +1,316 @@
+/*
+	A headless stand-in for TouchDesigner, so the CPlusPlus CHOP can be built,
+	run and profiled on Linux without the real host.
+
+	The host loads the CHOP library with dlopen(), resolves the three exported
+	C functions and then drives the instance through exactly the same call
+	order TouchDesigner uses (see "FUNCTION CALL ORDER DURING A COOK" in
+	CHOP_CPlusPlusBase.h).
+
+	Everything TouchDesigner would normally hand to the CHOP is mocked here:
+		MockParameterManager	records what setupParameters() appends
+		MockCHOPInput			owns the sample data of a wired CHOP input
+		MockDATInput			owns the cells of a table DAT
+		MockTOPInput			owns CPU pixel data for a TOP
+		MockInputs				implements OP_Inputs on top of all of the above
+		CHOPHost				owns the instance and runs cooks
+*/
+
+#ifndef __LinuxHost_MockHost__
+#define __LinuxHost_MockHost__
+
+#include "CHOP_CPlusPlusBase.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// One parameter as it was defined by setupParameters()
+struct MockParameter
+{
+	enum class Type
+	{
+		Float, Int, Toggle, Pulse, String, File, Menu, DAT, CHOP, TOP, Object
+	};
+
+	Type						type;
+	int32_t						size;
+	double						values[4];
+	std::string					str;
+	std::vector<std::string>	menuNames;
+	bool						enabled;
+};
+
+
+class MockParameterManager : public OP_ParameterManager
+{
+public:
+	MockParameterManager(std::map<std::string, MockParameter>& pars);
+
+	virtual OP_ParAppendResult		appendFloat(const OP_NumericParameter &np, int32_t size=1) override;
+	virtual OP_ParAppendResult		appendInt(const OP_NumericParameter &np, int32_t size=1) override;
+
+	virtual OP_ParAppendResult		appendXY(const OP_NumericParameter &np) override;
+	virtual OP_ParAppendResult		appendXYZ(const OP_NumericParameter &np) override;
+
+	virtual OP_ParAppendResult		appendUV(const OP_NumericParameter &np) override;
+	virtual OP_ParAppendResult		appendUVW(const OP_NumericParameter &np) override;
+
+	virtual OP_ParAppendResult		appendRGB(const OP_NumericParameter &np) override;
+	virtual OP_ParAppendResult		appendRGBA(const OP_NumericParameter &np) override;
+
+	virtual OP_ParAppendResult		appendToggle(const OP_NumericParameter &np) override;
+	virtual OP_ParAppendResult		appendPulse(const OP_NumericParameter &np) override;
+
+	virtual OP_ParAppendResult		appendString(const OP_StringParameter &sp) override;
+	virtual OP_ParAppendResult		appendFile(const OP_StringParameter &sp) override;
+	virtual OP_ParAppendResult		appendFolder(const OP_StringParameter &sp) override;
+
+	virtual OP_ParAppendResult		appendDAT(const OP_StringParameter &sp) override;
+	virtual OP_ParAppendResult		appendCHOP(const OP_StringParameter &sp) override;
+	virtual OP_ParAppendResult		appendTOP(const OP_StringParameter &sp) override;
+	virtual OP_ParAppendResult		appendObject(const OP_StringParameter &sp) override;
+
+	virtual OP_ParAppendResult		appendMenu(const OP_StringParameter &sp,
+									int32_t nitems, const char **names,
+									const char **labels) override;
+
+	virtual OP_ParAppendResult		appendStringMenu(const OP_StringParameter &sp,
+									int32_t nitems, const char **names,
+									const char **labels) override;
+
+private:
+	OP_ParAppendResult				appendNumeric(const OP_NumericParameter &np,
+												MockParameter::Type type, int32_t size);
+	OP_ParAppendResult				appendText(const OP_StringParameter &sp,
+												MockParameter::Type type);
+
+	std::map<std::string, MockParameter>&	myPars;
+};
+
+
+// A CHOP wired into one of the node inputs (or referenced by a parameter)
+class MockCHOPInput : public OP_CHOPInput
+{
+public:
+	MockCHOPInput(const char* path, uint32_t id, int32_t nchans, int32_t nsamples,
+				  double rate);
+
+	float*					data(int32_t chan) { return myData[chan].data(); }
+	void					setChannelName(int32_t chan, const char* name);
+
+	// Changes the window this input covers, the way a timesliced input
+	// advances from one cook to the next.
+	void					setWindow(double start, int32_t nsamples);
+
+private:
+	void					rebind();
+
+	std::string							myPath;
+	std::vector<std::vector<float>>		myData;
+	std::vector<std::string>			myNames;
+	std::vector<const float*>			myChannelPtrs;
+	std::vector<const char*>			myNamePtrs;
+};
+
+
+class MockDATInput : public OP_DATInput
+{
+public:
+	MockDATInput(const char* path, uint32_t id, int32_t rows, int32_t cols);
+
+	void					setCell(int32_t row, int32_t col, const char* value);
+	void					resize(int32_t rows, int32_t cols);
+
+private:
+	void					rebind();
+
+	std::string					myPath;
+	std::vector<std::string>	myCells;
+	std::vector<const char*>	myCellPtrs;
+};
+
+
+class MockTOPInput : public OP_TOPInput
+{
+public:
+	MockTOPInput(const char* path, uint32_t id, int32_t w, int32_t h,
+				 OP_CPUMemPixelType type);
+
+	OP_CPUMemPixelType		pixelType;
+	std::vector<uint8_t>	pixels;
+
+	// Number of getTOPDataInCPUMemory() calls made on this TOP, so the
+	// first delayed download can return nullptr like the real host does.
+	int32_t					downloads;
+
+private:
+	std::string				myPath;
+};
+
+
+class MockInputs : public OP_Inputs
+{
+public:
+	MockInputs();
+
+	virtual int32_t					getNumInputs() override;
+
+	virtual const OP_TOPInput*		getInputTOP(int32_t index) override;
+	virtual const OP_CHOPInput*		getInputCHOP(int32_t index) override;
+
+	virtual const OP_DATInput*		getParDAT(const char *name) override;
+	virtual const OP_TOPInput*		getParTOP(const char *name) override;
+	virtual const OP_CHOPInput*		getParCHOP(const char *name) override;
+	virtual const OP_ObjectInput*	getParObject(const char *name) override;
+
+	virtual double		getParDouble(const char* name, int32_t index=0) override;
+	virtual bool        getParDouble2(const char* name, double &v0, double &v1) override;
+	virtual bool        getParDouble3(const char* name, double &v0, double &v1, double &v2) override;
+	virtual bool        getParDouble4(const char* name, double &v0, double &v1, double &v2, double &v3) override;
+
+	virtual int32_t		getParInt(const char* name, int32_t index=0) override;
+	virtual bool        getParInt2(const char* name, int32_t &v0, int32_t &v1) override;
+	virtual bool        getParInt3(const char* name, int32_t &v0, int32_t &v1, int32_t &v2) override;
+	virtual bool        getParInt4(const char* name, int32_t &v0, int32_t &v1, int32_t &v2, int32_t &v3) override;
+
+	virtual const char*	getParString(const char* name) override;
+	virtual const char*	getParFilePath(const char* name) override;
+
+	virtual bool		getRelativeTransform(const char* from_name, const char* to_name,
+											 double matrix[4][4]) override;
+
+	virtual void		enablePar(const char* name, bool onoff) override;
+
+	virtual const OP_DATInput*		getDAT(const char *path) override;
+	virtual const OP_TOPInput*		getTOP(const char *path) override;
+	virtual const OP_CHOPInput*		getCHOP(const char *path) override;
+	virtual const OP_ObjectInput*	getObject(const char *path) override;
+
+	virtual void*		getTOPDataInCPUMemory(const OP_TOPInput *top,
+								const OP_TOPInputDownloadOptions *options) override;
+
+	// Parameters as defined by setupParameters(), keyed by name
+	std::map<std::string, MockParameter>				pars;
+
+	// Wired CHOP inputs, in input order
+	std::vector<MockCHOPInput*>							chopInputs;
+
+	// Operators that can be referenced by path from DAT/CHOP/TOP parameters
+	std::map<std::string, MockDATInput*>				dats;
+	std::map<std::string, MockCHOPInput*>				chops;
+	std::map<std::string, MockTOPInput*>				tops;
+
+	// How many string-keyed parameter calls the CHOP made. Reset by the host
+	// at the top of every cook.
+	int64_t							parLookups;
+	int64_t							enableParCalls;
+
+private:
+	MockParameter*					find(const char* name);
+};
+
+
+typedef int32_t (*GETCHOPAPIVERSION_FN)(void);
+typedef CHOP_CPlusPlusBase* (*CREATECHOPINSTANCE_FN)(const OP_NodeInfo*);
+typedef void (*DESTROYCHOPINSTANCE_FN)(CHOP_CPlusPlusBase*);
+
+
+// Loads the CHOP library, owns one instance of it and cooks it.
+class CHOPHost
+{
+public:
+	CHOPHost();
+	~CHOPHost();
+
+	// dlopen() the library and resolve the exported functions.
+	// Returns false and fills errorString on failure.
+	bool				load(const char* libraryPath);
+
+	// CreateCHOPInstance() followed by setupParameters(), like a new node.
+	bool				createInstance(const char* opPath = "/project1/cplusplus1");
+
+	// DestroyCHOPInstance()
+	void				destroyInstance();
+
+	// Runs one cook in the documented order. 'frames' is how many timeline
+	// frames elapsed since the previous cook, which drives the timeslice size.
+	void				cook(int32_t frames = 1);
+
+	// Parameter helpers. pulse() calls pulsePressed() like clicking the button.
+	void				setPar(const char* name, double v, int32_t index = 0);
+	void				setParString(const char* name, const char* v);
+	void				setMenu(const char* name, const char* item);
+	void				pulse(const char* name);
+
+	// Wire a new CHOP into the next free input. The host keeps ownership.
+	MockCHOPInput*		connectInput(int32_t nchans, int32_t nsamples, double rate);
+	void				disconnectInputs();
+
+	// Create an operator that parameters can reference by path. The host
+	// keeps ownership.
+	MockDATInput*		addDAT(const char* path, int32_t rows, int32_t cols);
+	MockTOPInput*		addTOP(const char* path, int32_t width, int32_t height,
+							   OP_CPUMemPixelType type);
+
+	CHOP_CPlusPlusBase*	instance() { return myInstance; }
+	MockInputs&			inputs() { return myInputs; }
+
+	// Results of the last cook
+	int32_t				outputChannels() const { return (int32_t)myChannels.size(); }
+	int32_t				outputSamples() const { return myNumSamples; }
+	float				outputSampleRate() const { return mySampleRate; }
+	const float*		outputChannel(int32_t i) const { return myChannels[i].data(); }
+	const std::string&	outputName(int32_t i) const { return myNames[i]; }
+
+	const std::vector<std::pair<std::string, float>>&	infoCHOP() const { return myInfoCHOP; }
+	const std::vector<std::vector<std::string>>&		infoDAT() const { return myInfoDAT; }
+	const std::string&	cookWarning() const { return myWarning; }
+	const std::string&	cookError() const { return myError; }
+
+	// Timeline the host is pretending to run
+	double				cookRate;
+	double				timelineFrame;
+
+	// When true every wired input is advanced to the same timeslice window
+	// (at its own sample rate) before the cook, like a timesliced CHOP
+	// upstream would be. The sample values themselves are left alone.
+	bool				timesliceInputs;
+
+	// When false the Info CHOP/DAT are not queried, so benchmarks only
+	// measure the cost of the cook itself.
+	bool				queryInfo;
+
+	std::string			errorString;
+
+private:
+	void*					myLibrary;
+	GETCHOPAPIVERSION_FN	myGetVersion;
+	CREATECHOPINSTANCE_FN	myCreate;
+	DESTROYCHOPINSTANCE_FN	myDestroy;
+
+	CHOP_CPlusPlusBase*		myInstance;
+	OP_NodeInfo				myNodeInfo;
+	std::string				myOpPath;
+	MockInputs				myInputs;
+
+	std::vector<std::unique_ptr<MockCHOPInput>>	myOwnedInputs;
+	std::vector<std::unique_ptr<MockDATInput>>	myOwnedDATs;
+	std::vector<std::unique_ptr<MockTOPInput>>	myOwnedTOPs;
+
+	std::vector<std::vector<float>>		myChannels;
+	std::vector<float*>					myChannelPtrs;
+	std::vector<std::string>			myNames;
+	std::vector<const char*>			myNamePtrs;
+	int32_t								myNumSamples;
+	float								mySampleRate;
+
+	std::vector<std::pair<std::string, float>>	myInfoCHOP;
+	std::vector<std::vector<std::string>>		myInfoDAT;
+	std::string							myWarning;
+	std::string							myError;
+};
+
+#endif
@@ -0,0 +1,112 @@
+/*
+	Test reader for a CHOP publishing to shared memory.
+
+	Follows the published output and prints a line per cook: the cook,
+	its startIndex, sample rate and number of samples, and the last sample
+	of the first few channels. Opens the name again whenever the CHOP makes
+	a new segment, and waits for it if it isn't there yet.
+
+	Usage:
+		chop_shm_reader [--count <cooks>] [--channels <n>] [--quiet] [name]
+
+	'name' defaults to the "Publish Name" parameter's default. '--count'
+	stops after that many cooks, '--quiet' only prints the totals at the end.
+*/
+
+#include "SharedOutputReader.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+int
+main(int argc, char** argv)
+{
+	const char* name = "chop_output";
+	int64_t count = -1;
+	int32_t showChannels = 4;
+	bool quiet = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--count") && i + 1 < argc)
+			count = atoll(argv[++i]);
+		else if (!strcmp(argv[i], "--channels") && i + 1 < argc)
+			showChannels = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--quiet"))
+			quiet = true;
+		else
+			name = argv[i];
+	}
+
+	SharedOutputReader reader;
+	int64_t cooks = 0;
+	int64_t torn = 0;
+	int64_t dropped = 0;
+	int64_t segments = 0;
+	bool waiting = false;
+
+	while (count < 0 || cooks < count)
+	{
+		if (!reader.isOpen() || reader.closed())
+		{
+			dropped += reader.dropped();
+			if (!reader.open(name))
+			{
+				if (!waiting)
+					fprintf(stderr, "%s, waiting...\n", reader.error());
+				waiting = true;
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				continue;
+			}
+			waiting = false;
+			segments++;
+			if (!quiet)
+			{
+				printf("# %d channels:", reader.numChannels());
+				for (int32_t c = 0; c < reader.numChannels() && c < showChannels; c++)
+					printf(" %s", reader.channelName(c));
+				printf("\n");
+			}
+		}
+
+		SharedOutputReader::Frame f;
+		if (!reader.next(f))
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		// Only the last sample of each channel is printed, but it's read
+		// where the writer put it before checking nothing changed
+		float values[16];
+		int32_t shown = f.numChannels < showChannels ? f.numChannels : showChannels;
+		if (shown > 16)
+			shown = 16;
+		for (int32_t c = 0; c < shown; c++)
+			values[c] = f.numSamples > 0 ? f.channel(c)[f.numSamples - 1] : 0.0f;
+		if (!reader.valid(f))
+		{
+			torn++;
+			continue;
+		}
+
+		cooks++;
+		if (!quiet)
+		{
+			printf("%llu start %lld rate %g samples %d:", (unsigned long long)f.cook,
+				   (long long)f.startIndex, f.sampleRate, f.numSamples);
+			for (int32_t c = 0; c < shown; c++)
+				printf(" %g", values[c]);
+			printf("\n");
+			fflush(stdout);
+		}
+	}
+
+	dropped += reader.dropped();
+	printf("cooks %lld dropped %lld torn %lld segments %lld\n", (long long)cooks,
+		   (long long)dropped, (long long)torn, (long long)segments);
+	return 0;
+}
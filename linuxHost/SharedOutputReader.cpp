@@ -0,0 +1,183 @@
+#include "SharedOutputReader.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace SharedOutput;
+
+SharedOutputReader::SharedOutputReader() :
+	myBase(nullptr),
+	myBytes(0),
+	myHeader(nullptr),
+	myNumChannels(0),
+	myNext(0),
+	myDropped(0)
+{
+}
+
+SharedOutputReader::~SharedOutputReader()
+{
+	close();
+}
+
+bool
+SharedOutputReader::fail(const char* message)
+{
+	close();
+	myError = message;
+	return false;
+}
+
+bool
+SharedOutputReader::open(const char* name)
+{
+	close();
+	myError.clear();
+
+	std::string path = name[0] == '/' ? name : std::string("/") + name;
+	int fd = shm_open(path.c_str(), O_RDONLY, 0);
+	if (fd < 0)
+		return fail("No shared memory by that name, is the CHOP publishing?");
+
+	struct stat st;
+	void* p = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && (size_t)st.st_size >= HeaderBytes)
+		p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (p == MAP_FAILED)
+		return fail("Can't map the shared memory");
+
+	myBase = (const char*)p;
+	myBytes = (size_t)st.st_size;
+	myHeader = (const Header*)myBase;
+
+	// The writer puts the magic in last
+	if (memcmp(myHeader->magic, Magic, sizeof(Magic)) != 0)
+		return fail("The shared memory isn't set up yet, or isn't a published CHOP");
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (myHeader->version != Version)
+		return fail("The shared memory was published by a different version");
+	if (myHeader->totalBytes > myBytes || myHeader->numSlots < 1 ||
+		myHeader->headerBytes < HeaderBytes)
+		return fail("The shared memory is damaged");
+
+	myNumChannels = (int32_t)myHeader->numChannels;
+	const char* n = myBase + HeaderBytes;
+	const char* end = myBase + myHeader->headerBytes;
+	for (int32_t c = 0; c < myNumChannels; c++)
+	{
+		const char* zero = (const char*)memchr(n, 0, end - n);
+		if (!zero)
+			return fail("The shared memory is damaged");
+		myNames.push_back(n);
+		n = zero + 1;
+	}
+
+	uint64_t published = this->published();
+	myNext = published > 0 ? published - 1 : 0;
+	return true;
+}
+
+void
+SharedOutputReader::close()
+{
+	if (myBase)
+		munmap((void*)myBase, myBytes);
+	myBase = nullptr;
+	myBytes = 0;
+	myHeader = nullptr;
+	myNumChannels = 0;
+	myNames.clear();
+	myNext = 0;
+	myDropped = 0;
+}
+
+bool
+SharedOutputReader::closed() const
+{
+	return !myHeader || myHeader->closed.load(std::memory_order_acquire) != 0;
+}
+
+uint64_t
+SharedOutputReader::published() const
+{
+	return myHeader ? myHeader->published.load(std::memory_order_acquire) : 0;
+}
+
+bool
+SharedOutputReader::read(uint64_t cook, Frame& frame) const
+{
+	const Slot* s = slot(myBase, *myHeader, cook);
+	uint64_t sequence = s->sequence.load(std::memory_order_acquire);
+	if (sequence != 2 * cook + 2)
+		return false;
+
+	frame.cook = cook;
+	frame.startIndex = s->startIndex;
+	frame.sampleRate = s->sampleRate;
+	frame.numSamples = (int32_t)s->numSamples;
+	frame.numChannels = myNumChannels;
+	frame.mySlot = s;
+	frame.mySamples = samples(s, *myHeader, 0);
+	frame.myStride = myHeader->maxSamples;
+	frame.mySequence = sequence;
+	return valid(frame) && frame.numSamples <= (int32_t)myHeader->maxSamples;
+}
+
+bool
+SharedOutputReader::valid(const Frame& frame) const
+{
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return frame.mySlot->sequence.load(std::memory_order_relaxed) == frame.mySequence;
+}
+
+bool
+SharedOutputReader::latest(Frame& frame)
+{
+	uint64_t published = this->published();
+	if (!myHeader || published == 0 || !read(published - 1, frame))
+		return false;
+	myNext = published;
+	return true;
+}
+
+bool
+SharedOutputReader::next(Frame& frame)
+{
+	if (!myHeader)
+		return false;
+
+	// The slot after the newest cook is the oldest one's, and may be being
+	// written already
+	uint64_t published = this->published();
+	uint64_t slots = myHeader->numSlots;
+	uint64_t oldest = published >= slots ? published - slots + 1 : 0;
+	if (myNext < oldest)
+	{
+		myDropped += int64_t(oldest - myNext);
+		myNext = oldest;
+	}
+
+	while (myNext < published)
+	{
+		if (read(myNext++, frame))
+			return true;
+
+		// Overwritten while we looked
+		myDropped++;
+	}
+	return false;
+}
+
+bool
+SharedOutputReader::copy(const Frame& frame, float* dst, int32_t numChannels) const
+{
+	if (numChannels > frame.numChannels)
+		numChannels = frame.numChannels;
+	for (int32_t c = 0; c < numChannels; c++)
+		memcpy(dst + size_t(c) * frame.numSamples, frame.channel(c), sizeof(float) * frame.numSamples);
+	return valid(frame);
+}
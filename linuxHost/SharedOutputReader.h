@@ -0,0 +1,124 @@
+/*
+	Reads the output a CPlusPlusCHOPExample publishes to shared memory with
+	"Publish" on, from another process.
+
+	The memory is mapped read only and frames are handed out as pointers
+	straight into it, nothing is copied. The writer never waits for a
+	reader, so it can reuse a frame's slot while the reader is still
+	looking at it. After using a frame's samples, check valid(): if it's
+	false the writer got there first and the samples may be torn.
+
+		SharedOutputReader reader;
+		reader.open("chop_output");
+		SharedOutputReader::Frame f;
+		while (reader.next(f))
+		{
+			float last = f.channel(0)[f.numSamples - 1];
+			if (reader.valid(f))
+				use(last);
+		}
+
+	When the CHOP's channels change it makes a new segment under the same
+	name and closes this one; closed() turns true and open() has to be
+	called again.
+
+	See commentedSample/SharedOutputFormat.h for the layout.
+*/
+
+#ifndef __LinuxHost_SharedOutputReader__
+#define __LinuxHost_SharedOutputReader__
+
+#include "SharedOutputFormat.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class SharedOutputReader
+{
+public:
+	// One cook of the output, in the shared memory
+	struct Frame
+	{
+		// 0 for the first cook published to this segment
+		uint64_t		cook;
+		int64_t			startIndex;
+		double			sampleRate;
+		int32_t			numSamples;
+		int32_t			numChannels;
+
+		const float*	channel(int32_t c) const { return mySamples + size_t(c) * myStride; }
+
+	private:
+		friend class SharedOutputReader;
+
+		const SharedOutput::Slot*	mySlot;
+		const float*				mySamples;
+		size_t						myStride;
+		uint64_t					mySequence;
+	};
+
+	SharedOutputReader();
+	~SharedOutputReader();
+
+	SharedOutputReader(const SharedOutputReader&) = delete;
+	SharedOutputReader&	operator=(const SharedOutputReader&) = delete;
+
+	// Maps the shared memory called 'name' (a leading '/' is added if it's
+	// missing). Returns false and sets error() if it doesn't exist yet or
+	// isn't one of ours. next() starts from the newest cook.
+	bool				open(const char* name);
+	void				close();
+
+	bool				isOpen() const { return myBase != nullptr; }
+	const char*			error() const { return myError.c_str(); }
+
+	// True once the writer is done with this segment
+	bool				closed() const;
+
+	int32_t				numChannels() const { return myNumChannels; }
+	const char*			channelName(int32_t c) const { return myNames[c]; }
+
+	// Number of cooks written to this segment so far
+	uint64_t			published() const;
+
+	// The newest cook. False if nothing is published yet.
+	bool				latest(Frame& frame);
+
+	// The cook after the last one next() or latest() returned. A reader
+	// that fell more than the ring behind skips to the oldest cook still in
+	// it and counts the ones it missed in dropped(). False when there's
+	// nothing new.
+	bool				next(Frame& frame);
+
+	// True if the writer hasn't started reusing the frame's slot since it
+	// was returned, so everything read from it so far is whole
+	bool				valid(const Frame& frame) const;
+
+	// Copies the frame's samples of 'numChannels' channels, one after the
+	// other, to 'dst'. Returns false, and 'dst' may be torn, if the writer
+	// overwrote them meanwhile.
+	bool				copy(const Frame& frame, float* dst, int32_t numChannels) const;
+
+	// Cooks next() skipped because they were overwritten before it got to
+	// them
+	int64_t				dropped() const { return myDropped; }
+
+private:
+	bool				fail(const char* message);
+	bool				read(uint64_t cook, Frame& frame) const;
+
+	const char*						myBase;
+	size_t							myBytes;
+	const SharedOutput::Header*		myHeader;
+	int32_t							myNumChannels;
+	std::vector<const char*>		myNames;
+	std::string						myError;
+
+	// The cook next() returns
+	uint64_t						myNext;
+	int64_t							myDropped;
+};
+
+#endif
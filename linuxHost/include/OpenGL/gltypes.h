@@ -0,0 +1,16 @@
+// Stub file so CPlusPlus_Common.h can be compiled on Linux.
+//
+// On macOS CPlusPlus_Common.h pulls the GL typedefs from the OpenGL framework.
+// The headless host never touches OpenGL, so all it needs are the few
+// typedefs CPlusPlus_Common.h uses.
+
+#ifndef __LinuxHost_gltypes__
+#define __LinuxHost_gltypes__
+
+#include <stdint.h>
+
+typedef uint32_t	GLuint;
+typedef uint32_t	GLenum;
+typedef int32_t		GLint;
+
+#endif